@@ -0,0 +1,194 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+#include "allocation_counter.h"
+
+namespace magnet {
+namespace benchmark {
+namespace {
+// the size and the offset from the malloc block are stored in front of
+// every block, the user pointer is aligned to at least the header size
+static const size_t kHeaderSize = 16;
+
+struct BlockHeader {
+  size_t size;
+  size_t offset;
+};
+static_assert(sizeof(BlockHeader) <= kHeaderSize,
+  "block header does not fit in front of the block");
+
+std::atomic<int64_t> g_allocations_count(0);
+std::atomic<int64_t> g_frees_count(0);
+std::atomic<int64_t> g_allocated_bytes(0);
+std::atomic<int64_t> g_live_bytes(0);
+std::atomic<int64_t> g_peak_live_bytes(0);
+
+// alignment a power of two, what aligned new asks for
+void* CountedAllocate(size_t size, size_t alignment = kHeaderSize) {
+  if (alignment < kHeaderSize)
+    alignment = kHeaderSize;
+  unsigned char* block = static_cast<unsigned char*>(
+    malloc(size + kHeaderSize + alignment - 1));
+  if (block == nullptr)
+    return nullptr;
+  unsigned char* pointer = reinterpret_cast<unsigned char*>(
+    (reinterpret_cast<uintptr_t>(block) + kHeaderSize + alignment - 1) &
+    ~static_cast<uintptr_t>(alignment - 1));
+  BlockHeader* header = reinterpret_cast<BlockHeader*>(pointer) - 1;
+  header->size = size;
+  header->offset = static_cast<size_t>(pointer - block);
+
+  g_allocations_count.fetch_add(1, std::memory_order_relaxed);
+  g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  int64_t live = g_live_bytes.fetch_add(size, std::memory_order_relaxed) +
+    static_cast<int64_t>(size);
+  int64_t peak = g_peak_live_bytes.load(std::memory_order_relaxed);
+  while (live > peak &&
+    !g_peak_live_bytes.compare_exchange_weak(peak, live,
+      std::memory_order_relaxed)) {
+  }
+
+  return pointer;
+}
+
+void CountedFree(void* pointer) {
+  if (pointer == nullptr)
+    return;
+  const BlockHeader* header = static_cast<const BlockHeader*>(pointer) - 1;
+  const size_t size = header->size;
+
+  g_frees_count.fetch_add(1, std::memory_order_relaxed);
+  g_live_bytes.fetch_sub(size, std::memory_order_relaxed);
+  free(static_cast<unsigned char*>(pointer) - header->offset);
+}
+}  // namespace
+
+AllocationSnapshot GetAllocationSnapshot() {
+  AllocationSnapshot snapshot;
+  snapshot.allocations_count = g_allocations_count.load();
+  snapshot.frees_count = g_frees_count.load();
+  snapshot.allocated_bytes = g_allocated_bytes.load();
+  snapshot.live_bytes = g_live_bytes.load();
+  snapshot.peak_live_bytes = g_peak_live_bytes.load();
+  return snapshot;
+}
+
+AllocationSnapshot operator-(const AllocationSnapshot& later,
+  const AllocationSnapshot& earlier) {
+  AllocationSnapshot delta;
+  delta.allocations_count = later.allocations_count - earlier.allocations_count;
+  delta.frees_count = later.frees_count - earlier.frees_count;
+  delta.allocated_bytes = later.allocated_bytes - earlier.allocated_bytes;
+  delta.live_bytes = later.live_bytes;
+  delta.peak_live_bytes = later.peak_live_bytes;
+  return delta;
+}
+}  // namespace benchmark
+}  // namespace magnet
+
+void* operator new(size_t size) {
+  void* pointer = magnet::benchmark::CountedAllocate(size);
+  if (pointer == nullptr)
+    throw std::bad_alloc();
+  return pointer;
+}
+
+void* operator new[](size_t size) {
+  void* pointer = magnet::benchmark::CountedAllocate(size);
+  if (pointer == nullptr)
+    throw std::bad_alloc();
+  return pointer;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return magnet::benchmark::CountedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return magnet::benchmark::CountedAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+
+// sized deallocation is what the compiler calls by default from c++14 on,
+// the size is in the header anyway
+void operator delete(void* pointer, size_t) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+
+#ifdef __cpp_aligned_new
+// over aligned types
+void* operator new(size_t size, std::align_val_t alignment) {
+  void* pointer = magnet::benchmark::CountedAllocate(size,
+    static_cast<size_t>(alignment));
+  if (pointer == nullptr)
+    throw std::bad_alloc();
+  return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+  void* pointer = magnet::benchmark::CountedAllocate(size,
+    static_cast<size_t>(alignment));
+  if (pointer == nullptr)
+    throw std::bad_alloc();
+  return pointer;
+}
+
+void* operator new(size_t size, std::align_val_t alignment,
+  const std::nothrow_t&) noexcept {
+  return magnet::benchmark::CountedAllocate(size,
+    static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment,
+  const std::nothrow_t&) noexcept {
+  return magnet::benchmark::CountedAllocate(size,
+    static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t,
+  const std::nothrow_t&) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t,
+  const std::nothrow_t&) noexcept {
+  magnet::benchmark::CountedFree(pointer);
+}
+#endif
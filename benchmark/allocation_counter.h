@@ -0,0 +1,29 @@
+#ifndef MAGNET_BENCHMARK_ALLOCATION_COUNTER_H_
+#define MAGNET_BENCHMARK_ALLOCATION_COUNTER_H_
+
+#include <stdint.h>
+
+namespace magnet {
+namespace benchmark {
+// counters of the global operator new/delete, which are replaced in the
+// benchmark executable. raw malloc calls are not counted.
+struct AllocationSnapshot {
+  AllocationSnapshot() : allocations_count(0), frees_count(0),
+    allocated_bytes(0), live_bytes(0), peak_live_bytes(0) {}
+
+  int64_t allocations_count;
+  int64_t frees_count;
+  int64_t allocated_bytes;
+  int64_t live_bytes;
+  int64_t peak_live_bytes;
+};
+
+AllocationSnapshot GetAllocationSnapshot();
+
+// difference of the cumulative counters, live and peak bytes are taken
+// from the later snapshot
+AllocationSnapshot operator-(const AllocationSnapshot& later,
+  const AllocationSnapshot& earlier);
+}  // namespace benchmark
+}  // namespace magnet
+#endif  // MAGNET_BENCHMARK_ALLOCATION_COUNTER_H_
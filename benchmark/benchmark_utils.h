@@ -0,0 +1,101 @@
+#ifndef MAGNET_BENCHMARK_BENCHMARK_UTILS_H_
+#define MAGNET_BENCHMARK_BENCHMARK_UTILS_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "json_writer.h"
+
+namespace magnet {
+namespace benchmark {
+class Stopwatch {
+ public:
+  Stopwatch() : start_(std::chrono::high_resolution_clock::now()) {}
+
+  void Restart() {
+    start_ = std::chrono::high_resolution_clock::now();
+  }
+
+  double GetElapsedMilliseconds() const {
+    std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::high_resolution_clock::now() - start_;
+    return elapsed.count();
+  }
+
+ private:
+  std::chrono::high_resolution_clock::time_point start_;
+};
+
+struct SampleStats {
+  SampleStats() : min(0.0), max(0.0), mean(0.0), p50(0.0), p95(0.0),
+    count(0) {}
+
+  double min;
+  double max;
+  double mean;
+  double p50;
+  double p95;
+  int count;
+};
+
+inline SampleStats ComputeStats(std::vector<double> samples) {
+  SampleStats stats;
+  if (samples.empty())
+    return stats;
+
+  std::sort(samples.begin(), samples.end());
+  double sum = 0.0;
+  for (double sample : samples)
+    sum += sample;
+
+  const size_t count = samples.size();
+  stats.count = static_cast<int>(count);
+  stats.min = samples.front();
+  stats.max = samples.back();
+  stats.mean = sum / count;
+  stats.p50 = samples[(count - 1) / 2];
+  stats.p95 = samples[std::min(count - 1, (count * 95) / 100)];
+  return stats;
+}
+
+inline void WriteStats(JsonWriter* writer, const char* key,
+  const SampleStats& stats) {
+  writer->BeginObject(key);
+  writer->Write("count", stats.count);
+  writer->Write("min", stats.min);
+  writer->Write("mean", stats.mean);
+  writer->Write("p50", stats.p50);
+  writer->Write("p95", stats.p95);
+  writer->Write("max", stats.max);
+  writer->EndObject();
+}
+
+// command line helpers, options are "--name value" pairs
+inline const char* FindOption(int argc, char** argv, const char* name) {
+  for (int i = 0; i + 1 < argc; ++i) {
+    if (argv[i][0] == '-' && argv[i][1] == '-' &&
+      strcmp(argv[i] + 2, name) == 0) {
+      return argv[i + 1];
+    }
+  }
+  return nullptr;
+}
+
+inline int GetIntOption(int argc, char** argv, const char* name,
+  int default_value) {
+  const char* value = FindOption(argc, argv, name);
+  return value ? atoi(value) : default_value;
+}
+
+inline std::string GetStringOption(int argc, char** argv, const char* name,
+  const char* default_value) {
+  const char* value = FindOption(argc, argv, name);
+  return std::string(value ? value : default_value);
+}
+}  // namespace benchmark
+}  // namespace magnet
+#endif  // MAGNET_BENCHMARK_BENCHMARK_UTILS_H_
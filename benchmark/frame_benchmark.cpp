@@ -0,0 +1,382 @@
+#include <direct.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "core/allocator.h"
+#include "core/task_manager.h"
+#include "render/render_manager.h"
+#include "render/resource_manager.h"
+#include "scene/component_factory.h"
+#include "scene/entity_factory.h"
+#include "scene/ientity.h"
+#include "scene/mesh_component.h"
+#include "scene/scene_manager.h"
+
+#include "allocation_counter.h"
+#include "benchmark_utils.h"
+#include "frame_benchmark.h"
+#include "json_writer.h"
+#include "synthetic_scene.h"
+
+namespace magnet {
+namespace benchmark {
+namespace {
+enum Stage {
+  STAGE_UPDATE,
+  STAGE_SWAP,
+  STAGE_SUBMIT,
+  STAGE_FRAME,
+  STAGE_COUNT
+};
+
+static const char* kStageNames[STAGE_COUNT] = {
+  "update",
+  "swap",
+  "submit",
+  "frame"
+};
+
+struct StageSamples {
+  std::vector<double> milliseconds;
+  std::vector<double> allocations;
+  std::vector<double> allocated_bytes;
+};
+
+// the component and its children made the way a game spawns them, the
+// meshes and materials are shared
+scene::IComponent* CloneMeshComponent(const scene::MeshComponent& component) {
+  scene::MeshComponent* clone = static_cast<scene::MeshComponent*>(
+    scene::ComponentFactory::GetInstance()->CreateComponent("MeshComponent",
+    component.GetName()));
+  clone->SetTransformation(component.GetTransformation());
+  for (size_t i = 0; i < component.GetMeshes().size(); ++i) {
+    clone->AddMesh(component.GetMeshes()[i]);
+    clone->AddMaterial(component.GetMaterials()[i]);
+  }
+  for (const scene::IComponent* child : component.GetComponents()) {
+    clone->AddComponent(CloneMeshComponent(
+      static_cast<const scene::MeshComponent&>(*child)));
+  }
+  return clone;
+}
+
+// destroys the entity and adds a copy of it, false if it has components
+// other than meshes
+bool RespawnEntity(scene::SceneManager* scene_manager,
+  scene::EntityHandle handle) {
+  scene::IEntity* entity = scene_manager->GetEntity(handle);
+  if (entity == nullptr || !entity->IsInStore())
+    return false;
+  scene::IEntity* clone = scene::EntityFactory::GetInstance()->CreateEntity(
+    "NormalEntity", entity->GetName());
+  clone->SetTransformation(entity->GetTransformation());
+  for (const scene::IComponent* component : entity->GetComponents()) {
+    clone->AddComponent(CloneMeshComponent(
+      static_cast<const scene::MeshComponent&>(*component)));
+  }
+  clone->Initialize();
+  scene_manager->DestroyEntity(handle);
+  return scene_manager->AddEntity(clone) != scene::kInvalidEntityHandle;
+}
+
+void WriteSamples(JsonWriter* writer, const char* key,
+  const StageSamples& samples) {
+  writer->BeginObject(key);
+  WriteStats(writer, "milliseconds", ComputeStats(samples.milliseconds));
+  WriteStats(writer, "allocations", ComputeStats(samples.allocations));
+  WriteStats(writer, "allocated_bytes", ComputeStats(samples.allocated_bytes));
+  writer->EndObject();
+}
+}  // namespace
+
+void PrintFrameBenchmarkUsage() {
+  printf("frame [options]\n"
+    "  --entities N       entities in the scene (1000)\n"
+    "  --meshes M         unique obj files (16)\n"
+    "  --materials K      materials (8)\n"
+    "  --triangles T      triangles per obj file (512)\n"
+    "  --parts P          objects per obj file (1)\n"
+    "  --children C       child components per component (1)\n"
+    "  --depth D          nesting levels of components (1)\n"
+    "  --moving N         entities moved every frame, their transforms\n"
+    "                     and those below them are recomputed (0)\n"
+    "  --churn N          entities destroyed and spawned again every\n"
+    "                     frame (0)\n"
+    "  --texture-size S   generate S x S textures, 0 for none (0)\n"
+    "  --frames F         measured frames (200)\n"
+    "  --warmup W         frames before measuring (10)\n"
+    "  --threads T        worker threads for entity updates, 0 runs the\n"
+    "                     updates on the calling thread (3)\n"
+    "  --seed S           random seed (1)\n"
+    "  --mesh-cache N     0 parses every obj, 1 uses and writes cooked\n"
+    "                     .mcache files next to them (1)\n"
+    "  --texture-budget M megabytes of streamed texture mips on the gpu,\n"
+    "                     0 uploads whole textures (512)\n"
+    "  --folder PATH      folder of the generated scene (synthetic\\)\n"
+    "  --output FILE      json report, stdout if not set\n");
+}
+
+int RunFrameBenchmark(int argc, char** argv) {
+  SyntheticSceneDesc desc;
+  desc.entities_count = GetIntOption(argc, argv, "entities", 1000);
+  desc.meshes_count = GetIntOption(argc, argv, "meshes", 16);
+  desc.materials_count = GetIntOption(argc, argv, "materials", 8);
+  desc.triangles_count = GetIntOption(argc, argv, "triangles", 512);
+  desc.parts_count = GetIntOption(argc, argv, "parts", 1);
+  desc.children_count = GetIntOption(argc, argv, "children", 1);
+  desc.depth = GetIntOption(argc, argv, "depth", 1);
+  desc.texture_size = GetIntOption(argc, argv, "texture-size", 0);
+  desc.seed = GetIntOption(argc, argv, "seed", 1);
+
+  const int frames_count = GetIntOption(argc, argv, "frames", 200);
+  const int warmup_count = GetIntOption(argc, argv, "warmup", 10);
+  const int threads_count = GetIntOption(argc, argv, "threads", 3);
+  const int moving_count = GetIntOption(argc, argv, "moving", 0);
+  const int churn_count = GetIntOption(argc, argv, "churn", 0);
+  const bool mesh_cache = GetIntOption(argc, argv, "mesh-cache", 1) != 0;
+  const int texture_budget = GetIntOption(argc, argv, "texture-budget", 512);
+  std::string folder = GetStringOption(argc, argv, "folder", "synthetic\\");
+  const std::string output = GetStringOption(argc, argv, "output", "");
+
+  if (!folder.empty() && folder.back() != '\\' && folder.back() != '/')
+    folder += '\\';
+  _mkdir(folder.c_str());
+
+  // generate
+  Stopwatch stopwatch;
+  SyntheticSceneInfo info;
+  if (!GenerateSyntheticScene(desc, folder, &info)) {
+    fprintf(stderr, "failed to generate the scene in %s\n", folder.c_str());
+    return 1;
+  }
+  const double generate_ms = stopwatch.GetElapsedMilliseconds();
+
+  // systems, the render manager runs without a window
+  scene::SceneManager::Initialize();
+  render::ResourceManager::Initialize();
+  render::RenderManager::Initialize(1024, 1024, nullptr);
+  core::TaskManager::Initialize();
+  if (threads_count > 0)
+    core::TaskManager::GetInstance()->BeginThreads(threads_count);
+
+  scene::SceneManager* scene_manager = scene::SceneManager::GetInstance();
+  render::RenderManager* render_manager =
+    render::RenderManager::GetInstance();
+  if (render_manager->GetDevice() == nullptr) {
+    fprintf(stderr, "failed to create a device\n");
+    return 1;
+  }
+  scene_manager->SetMeshFolderPath(folder);
+  scene_manager->SetTextureFolderPath(folder);
+  scene_manager->SetMeshCacheEnabled(mesh_cache);
+  render::TextureStreamer* texture_streamer =
+    render::ResourceManager::GetInstance()->GetTextureStreamer();
+  texture_streamer->SetBudget(static_cast<size_t>(texture_budget) << 20);
+
+  // load
+  AllocationSnapshot before_load = GetAllocationSnapshot();
+  stopwatch.Restart();
+  scene_manager->LoadSceneFile(info.scene_path);
+  const double load_ms = stopwatch.GetElapsedMilliseconds();
+  AllocationSnapshot load_allocations = GetAllocationSnapshot() - before_load;
+
+  stopwatch.Restart();
+  scene_manager->CreateRenderResources();
+  const double upload_ms = stopwatch.GetElapsedMilliseconds();
+
+  // frames
+  std::vector<scene::IEntity*>* entities = scene_manager->GetEntities();
+  StageSamples samples[STAGE_COUNT];
+  render::RenderStats render_stats;
+
+  for (int frame = 0; frame < warmup_count + frames_count; ++frame) {
+    double milliseconds[STAGE_COUNT];
+    AllocationSnapshot allocations[STAGE_COUNT];
+
+    AllocationSnapshot frame_begin = GetAllocationSnapshot();
+    Stopwatch frame_stopwatch;
+
+    AllocationSnapshot stage_begin = GetAllocationSnapshot();
+    stopwatch.Restart();
+    for (int i = 0; i < moving_count && i < static_cast<int>(entities->size());
+      ++i) {
+      math::Transformationf transformation =
+        (*entities)[i]->GetTransformation();
+      transformation.Translate(0.f, frame % 2 == 0 ? 0.01f : -0.01f, 0.f);
+      (*entities)[i]->SetTransformation(transformation);
+    }
+    // a respawned entity is added at the end of the entities
+    for (int i = 0; i < churn_count && !entities->empty(); ++i) {
+      const size_t kPosition = (static_cast<size_t>(frame) * churn_count + i) %
+        entities->size();
+      RespawnEntity(scene_manager,
+        scene_manager->GetEntityHandles()[kPosition]);
+    }
+    scene_manager->UpdateEntities();
+    milliseconds[STAGE_UPDATE] = stopwatch.GetElapsedMilliseconds();
+    allocations[STAGE_UPDATE] = GetAllocationSnapshot() - stage_begin;
+
+    stage_begin = GetAllocationSnapshot();
+    stopwatch.Restart();
+    render_manager->IncreaseUpdateFrameCount();
+    render_manager->SwapDoubleBuffers();
+    milliseconds[STAGE_SWAP] = stopwatch.GetElapsedMilliseconds();
+    allocations[STAGE_SWAP] = GetAllocationSnapshot() - stage_begin;
+
+    stage_begin = GetAllocationSnapshot();
+    stopwatch.Restart();
+    render_manager->RenderFrame();
+    milliseconds[STAGE_SUBMIT] = stopwatch.GetElapsedMilliseconds();
+    allocations[STAGE_SUBMIT] = GetAllocationSnapshot() - stage_begin;
+
+    milliseconds[STAGE_FRAME] = frame_stopwatch.GetElapsedMilliseconds();
+    allocations[STAGE_FRAME] = GetAllocationSnapshot() - frame_begin;
+
+    if (frame < warmup_count)
+      continue;
+
+    for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+      samples[stage].milliseconds.push_back(milliseconds[stage]);
+      samples[stage].allocations.push_back(
+        static_cast<double>(allocations[stage].allocations_count));
+      samples[stage].allocated_bytes.push_back(
+        static_cast<double>(allocations[stage].allocated_bytes));
+    }
+    render_stats = render_manager->GetRenderStats();
+  }
+
+  // report
+  FILE* file = output.empty() ? stdout : fopen(output.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "failed to open %s\n", output.c_str());
+    return 1;
+  }
+
+  JsonWriter writer(file);
+  writer.BeginObject();
+  writer.Write("benchmark", "frame");
+
+  writer.BeginObject("config");
+  writer.Write("entities", desc.entities_count);
+  writer.Write("meshes", desc.meshes_count);
+  writer.Write("materials", desc.materials_count);
+  writer.Write("triangles_per_mesh", desc.triangles_count);
+  writer.Write("parts", desc.parts_count);
+  writer.Write("children", desc.children_count);
+  writer.Write("depth", desc.depth);
+  writer.Write("texture_size", desc.texture_size);
+  writer.Write("frames", frames_count);
+  writer.Write("warmup", warmup_count);
+  writer.Write("threads", threads_count);
+  writer.Write("moving", moving_count);
+  writer.Write("churn", churn_count);
+  writer.Write("seed", static_cast<int64_t>(desc.seed));
+  writer.Write("mesh_cache", mesh_cache);
+  writer.Write("texture_budget_mb", texture_budget);
+  writer.Write("headless", render_manager->IsHeadless());
+  writer.EndObject();
+
+  writer.BeginObject("scene");
+  writer.Write("entities", static_cast<int64_t>(entities->size()));
+  writer.Write("store_entities",
+    static_cast<int64_t>(scene_manager->GetEntityStore()->GetEntitiesCount()));
+  writer.Write("transform_nodes", static_cast<int64_t>(
+    scene_manager->GetTransformHierarchy()->GetNodesCount()));
+  writer.Write("free_transform_nodes", static_cast<int64_t>(
+    scene_manager->GetTransformHierarchy()->GetFreeNodesCount()));
+  writer.Write("components", info.components_count);
+  writer.Write("triangles", static_cast<int64_t>(info.triangles_count));
+  writer.Write("meshes_loaded",
+    static_cast<int64_t>(scene_manager->GetMeshes().size()));
+  writer.Write("textures_loaded",
+    static_cast<int64_t>(scene_manager->GetTextures().size()));
+  writer.Write("file_bytes", static_cast<int64_t>(info.file_bytes));
+  writer.EndObject();
+
+  writer.BeginObject("load");
+  writer.Write("generate_ms", generate_ms);
+  writer.Write("load_ms", load_ms);
+  writer.Write("upload_ms", upload_ms);
+  writer.Write("allocations", load_allocations.allocations_count);
+  writer.Write("allocated_bytes", load_allocations.allocated_bytes);
+  writer.Write("live_bytes", load_allocations.live_bytes);
+  writer.EndObject();
+
+  writer.BeginObject("stages");
+  for (int stage = 0; stage < STAGE_COUNT; ++stage)
+    WriteSamples(&writer, kStageNames[stage], samples[stage]);
+  writer.EndObject();
+
+  writer.BeginObject("draw");
+  writer.Write("surfaces", render_stats.surfaces_count);
+  writer.Write("draw_calls", render_stats.draw_calls_count);
+  writer.Write("primitives", render_stats.primitives_count);
+  writer.Write("shader_nodes", render_stats.shader_nodes_count);
+  writer.EndObject();
+
+  const render::TextureStreamingStats kStreaming = texture_streamer->GetStats();
+  writer.BeginObject("texture_streaming");
+  writer.Write("textures", kStreaming.textures_count);
+  writer.Write("budget_bytes", static_cast<int64_t>(kStreaming.budget_bytes));
+  writer.Write("resident_bytes",
+    static_cast<int64_t>(kStreaming.resident_bytes));
+  writer.Write("requested_bytes",
+    static_cast<int64_t>(kStreaming.requested_bytes));
+  writer.Write("uploaded_bytes",
+    static_cast<int64_t>(kStreaming.uploaded_bytes));
+  writer.Write("evicted_bytes", static_cast<int64_t>(kStreaming.evicted_bytes));
+  writer.EndObject();
+
+  std::map<std::string, core::FixedPoolStats> pool_stats;
+  scene::ComponentFactory::GetInstance()->GetPoolStats(&pool_stats);
+  writer.BeginObject("component_pools");
+  for (const auto& type_stats : pool_stats) {
+    const core::FixedPoolStats& kStats = type_stats.second;
+    writer.BeginObject(type_stats.first.c_str());
+    writer.Write("objects", static_cast<int64_t>(kStats.blocks_count));
+    writer.Write("capacity", static_cast<int64_t>(kStats.capacity));
+    writer.Write("slabs", static_cast<int64_t>(kStats.slabs_count));
+    writer.Write("empty_slabs",
+      static_cast<int64_t>(kStats.empty_slabs_count));
+    writer.Write("block_bytes", static_cast<int64_t>(kStats.block_size));
+    writer.Write("reserved_bytes",
+      static_cast<int64_t>(kStats.reserved_bytes));
+    writer.Write("fragmentation", static_cast<double>(kStats.fragmentation));
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  AllocationSnapshot total = GetAllocationSnapshot();
+  writer.BeginObject("memory");
+  writer.Write("live_bytes", total.live_bytes);
+  writer.Write("peak_live_bytes", total.peak_live_bytes);
+  writer.EndObject();
+
+  writer.BeginObject("memory_tags");
+  for (int tag = 0; tag < core::MEMORY_TAG_COUNT; ++tag) {
+    const core::MemoryTagStats kStats =
+      core::TaggedHeap::GetStats(static_cast<core::MemoryTag>(tag));
+    writer.BeginObject(
+      core::TaggedHeap::GetTagName(static_cast<core::MemoryTag>(tag)));
+    writer.Write("allocations", kStats.allocations_count);
+    writer.Write("live_allocations", kStats.live_allocations_count);
+    writer.Write("live_bytes", kStats.live_bytes);
+    writer.Write("peak_live_bytes", kStats.peak_live_bytes);
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  writer.EndObject();
+  if (file != stdout)
+    fclose(file);
+
+  core::TaskManager::Terminate();
+  render::RenderManager::Terminate();
+  render::ResourceManager::Terminate();
+  scene::SceneManager::Terminate();
+  return 0;
+}
+}  // namespace benchmark
+}  // namespace magnet
@@ -0,0 +1,13 @@
+#ifndef MAGNET_BENCHMARK_FRAME_BENCHMARK_H_
+#define MAGNET_BENCHMARK_FRAME_BENCHMARK_H_
+
+namespace magnet {
+namespace benchmark {
+// generates a synthetic scene, loads it and runs the entity update, double
+// buffer swap and render submission stages headless for a fixed number of
+// frames. the report is written as json.
+int RunFrameBenchmark(int argc, char** argv);
+void PrintFrameBenchmarkUsage();
+}  // namespace benchmark
+}  // namespace magnet
+#endif  // MAGNET_BENCHMARK_FRAME_BENCHMARK_H_
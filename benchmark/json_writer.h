@@ -0,0 +1,137 @@
+#ifndef MAGNET_BENCHMARK_JSON_WRITER_H_
+#define MAGNET_BENCHMARK_JSON_WRITER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace magnet {
+namespace benchmark {
+// minimal streaming json writer for benchmark reports
+class JsonWriter {
+ public:
+  explicit JsonWriter(FILE* file);
+
+  void BeginObject(const char* key = nullptr);
+  void EndObject();
+  void BeginArray(const char* key = nullptr);
+  void EndArray();
+
+  void Write(const char* key, const std::string& value);
+  void Write(const char* key, const char* value);
+  void Write(const char* key, int64_t value);
+  void Write(const char* key, int value);
+  void Write(const char* key, double value);
+  void Write(const char* key, bool value);
+
+ private:
+  void BeginValue(const char* key);
+  void WriteString(const char* value);
+  void Indent();
+
+ private:
+  FILE* file_;
+  // one entry per open scope, true until the first value is written
+  std::vector<bool> first_in_scope_;
+};
+
+inline JsonWriter::JsonWriter(FILE* file) : file_(file) {}
+
+inline void JsonWriter::Indent() {
+  for (size_t i = 0; i < first_in_scope_.size(); ++i)
+    fputs("  ", file_);
+}
+
+inline void JsonWriter::WriteString(const char* value) {
+  fputc('"', file_);
+  for (const char* c = value; *c; ++c) {
+    switch (*c) {
+    case '"': fputs("\\\"", file_); break;
+    case '\\': fputs("\\\\", file_); break;
+    case '\n': fputs("\\n", file_); break;
+    case '\t': fputs("\\t", file_); break;
+    default: fputc(*c, file_); break;
+    }
+  }
+  fputc('"', file_);
+}
+
+inline void JsonWriter::BeginValue(const char* key) {
+  if (!first_in_scope_.empty()) {
+    if (!first_in_scope_.back())
+      fputc(',', file_);
+    first_in_scope_.back() = false;
+    fputc('\n', file_);
+    Indent();
+  }
+  if (key) {
+    WriteString(key);
+    fputs(": ", file_);
+  }
+}
+
+inline void JsonWriter::BeginObject(const char* key) {
+  BeginValue(key);
+  fputc('{', file_);
+  first_in_scope_.push_back(true);
+}
+
+inline void JsonWriter::EndObject() {
+  bool empty = first_in_scope_.back();
+  first_in_scope_.pop_back();
+  if (!empty) {
+    fputc('\n', file_);
+    Indent();
+  }
+  fputc('}', file_);
+  if (first_in_scope_.empty())
+    fputc('\n', file_);
+}
+
+inline void JsonWriter::BeginArray(const char* key) {
+  BeginValue(key);
+  fputc('[', file_);
+  first_in_scope_.push_back(true);
+}
+
+inline void JsonWriter::EndArray() {
+  bool empty = first_in_scope_.back();
+  first_in_scope_.pop_back();
+  if (!empty) {
+    fputc('\n', file_);
+    Indent();
+  }
+  fputc(']', file_);
+}
+
+inline void JsonWriter::Write(const char* key, const std::string& value) {
+  Write(key, value.c_str());
+}
+
+inline void JsonWriter::Write(const char* key, const char* value) {
+  BeginValue(key);
+  WriteString(value);
+}
+
+inline void JsonWriter::Write(const char* key, int64_t value) {
+  BeginValue(key);
+  fprintf(file_, "%lld", static_cast<long long>(value));
+}
+
+inline void JsonWriter::Write(const char* key, int value) {
+  Write(key, static_cast<int64_t>(value));
+}
+
+inline void JsonWriter::Write(const char* key, double value) {
+  BeginValue(key);
+  fprintf(file_, "%.6f", value);
+}
+
+inline void JsonWriter::Write(const char* key, bool value) {
+  BeginValue(key);
+  fputs(value ? "true" : "false", file_);
+}
+}  // namespace benchmark
+}  // namespace magnet
+#endif  // MAGNET_BENCHMARK_JSON_WRITER_H_
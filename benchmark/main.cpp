@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "frame_benchmark.h"
+#include "obj_benchmark.h"
+#include "sh_benchmark.h"
+#include "texture_benchmark.h"
+#include "vfs_benchmark.h"
+#include "weld_benchmark.h"
+
+namespace {
+struct BenchmarkEntry {
+  const char* name;
+  int (*run)(int argc, char** argv);
+  void (*print_usage)();
+};
+
+static const BenchmarkEntry kBenchmarks[] = {
+  { "frame", magnet::benchmark::RunFrameBenchmark,
+    magnet::benchmark::PrintFrameBenchmarkUsage },
+  { "obj", magnet::benchmark::RunObjBenchmark,
+    magnet::benchmark::PrintObjBenchmarkUsage },
+  { "sh", magnet::benchmark::RunShBenchmark,
+    magnet::benchmark::PrintShBenchmarkUsage },
+  { "texture", magnet::benchmark::RunTextureBenchmark,
+    magnet::benchmark::PrintTextureBenchmarkUsage },
+  { "vfs", magnet::benchmark::RunVfsBenchmark,
+    magnet::benchmark::PrintVfsBenchmarkUsage },
+  { "weld", magnet::benchmark::RunWeldBenchmark,
+    magnet::benchmark::PrintWeldBenchmarkUsage },
+};
+
+void PrintUsage() {
+  printf("usage: benchmark <name> [options]\n\n");
+  for (const BenchmarkEntry& entry : kBenchmarks) {
+    entry.print_usage();
+    printf("\n");
+  }
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    PrintUsage();
+    return 1;
+  }
+
+  for (const BenchmarkEntry& entry : kBenchmarks) {
+    if (strcmp(argv[1], entry.name) == 0)
+      return entry.run(argc - 2, argv + 2);
+  }
+
+  PrintUsage();
+  return 1;
+}
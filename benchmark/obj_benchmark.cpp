@@ -0,0 +1,265 @@
+#include <direct.h>
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "scene/obj_parser.h"
+
+#include "benchmark_utils.h"
+#include "json_writer.h"
+#include "obj_benchmark.h"
+#include "synthetic_scene.h"
+
+namespace magnet {
+namespace benchmark {
+namespace {
+struct ParseCounts {
+  ParseCounts() : positions_count(0), uvs_count(0), normals_count(0),
+    triangles_count(0) {}
+
+  int64_t positions_count;
+  int64_t uvs_count;
+  int64_t normals_count;
+  int64_t triangles_count;
+};
+
+// the token loop SceneManager::LoadMeshObj was built on, without the vertex
+// deduplication, as reference
+bool ParseObjStream(const std::string& path, ParseCounts* counts) {
+  std::ifstream in_file(path);
+  if (!in_file.is_open())
+    return false;
+
+  std::vector<math::Vector3f> positions;
+  std::vector<math::Vector2f> uvs;
+  std::vector<math::Vector3f> normals;
+  std::vector<scene::ObjIndex> face_vertices;
+
+  char word[32];
+  while (1) {
+    in_file >> word;
+    if (!in_file)
+      break;
+
+    if (strcmp(word, "v") == 0) {
+      float x, y, z;
+      in_file >> x >> y >> z;
+      positions.push_back(math::Vector3f(x, y, z));
+    }
+    else if (strcmp(word, "vt") == 0) {
+      float u, v;
+      in_file >> u >> v;
+      uvs.push_back(math::Vector2f(u, 1 - v));
+    }
+    else if (strcmp(word, "vn") == 0) {
+      float x, y, z;
+      in_file >> x >> y >> z;
+      normals.push_back(math::Vector3f(x, y, z));
+    }
+    else if (strcmp(word, "f") == 0) {
+      for (int i = 0; i < 3; ++i) {
+        scene::ObjIndex index = { -1, -1, -1 };
+        in_file >> index.position;
+        if ('/' == in_file.peek()) {
+          in_file.ignore();
+          if ('/' != in_file.peek())
+            in_file >> index.uv;
+          if ('/' == in_file.peek()) {
+            in_file.ignore();
+            in_file >> index.normal;
+          }
+        }
+        face_vertices.push_back(index);
+      }
+    }
+    else if (strcmp(word, "o") == 0 || strcmp(word, "g") == 0 ||
+      strcmp(word, "usemtl") == 0 || strcmp(word, "mtllib") == 0) {
+      in_file >> word;
+    }
+
+    in_file.ignore(256, '\n');
+  }
+
+  counts->positions_count = positions.size();
+  counts->uvs_count = uvs.size();
+  counts->normals_count = normals.size();
+  counts->triangles_count = face_vertices.size() / 3;
+  return true;
+}
+
+bool ParseObjMapped(const std::string& path, int threads_count,
+  ParseCounts* counts) {
+  scene::ObjData obj_data;
+  if (!scene::ObjParser::ParseFile(path, threads_count, &obj_data))
+    return false;
+
+  counts->positions_count = obj_data.positions.size();
+  counts->uvs_count = obj_data.uvs.size();
+  counts->normals_count = obj_data.normals.size();
+  counts->triangles_count = obj_data.face_vertices.size() / 3;
+  return true;
+}
+
+long long GetFileSize(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr)
+    return 0;
+  fseek(file, 0, SEEK_END);
+  long long size = _ftelli64(file);
+  fclose(file);
+  return size;
+}
+
+struct ParserRun {
+  std::string name;
+  int threads_count;   // -1 for the stream parser
+  std::vector<double> milliseconds;
+  std::vector<double> megabytes_per_second;
+  ParseCounts counts;
+  bool failed;
+};
+}  // namespace
+
+void PrintObjBenchmarkUsage() {
+  printf("obj [options]\n"
+    "  --file PATH        obj file to parse, a synthetic one is generated\n"
+    "                     if not set\n"
+    "  --triangles T      triangles of the synthetic file (2000000)\n"
+    "  --parts P          objects of the synthetic file (16)\n"
+    "  --iterations I     measured runs per parser (5)\n"
+    "  --threads T        highest thread count, 0 for all cores (0)\n"
+    "  --skip-stream N    1 skips the iostream reference parser (0)\n"
+    "  --folder PATH      folder of the synthetic file (synthetic\\)\n"
+    "  --output FILE      json report, stdout if not set\n");
+}
+
+int RunObjBenchmark(int argc, char** argv) {
+  std::string path = GetStringOption(argc, argv, "file", "");
+  const int iterations_count = GetIntOption(argc, argv, "iterations", 5);
+  int max_threads_count = GetIntOption(argc, argv, "threads", 0);
+  const bool skip_stream = GetIntOption(argc, argv, "skip-stream", 0) != 0;
+  const std::string output = GetStringOption(argc, argv, "output", "");
+
+  if (max_threads_count <= 0) {
+    max_threads_count = static_cast<int>(std::thread::hardware_concurrency());
+    if (max_threads_count <= 0)
+      max_threads_count = 1;
+  }
+
+  SyntheticSceneDesc desc;
+  desc.triangles_count = GetIntOption(argc, argv, "triangles", 2000000);
+  desc.parts_count = GetIntOption(argc, argv, "parts", 16);
+  const bool synthetic = path.empty();
+  if (synthetic) {
+    std::string folder = GetStringOption(argc, argv, "folder", "synthetic\\");
+    if (!folder.empty() && folder.back() != '\\' && folder.back() != '/')
+      folder += '\\';
+    _mkdir(folder.c_str());
+
+    path = folder + "obj_benchmark.obj";
+    long long bytes = 0;
+    if (!GenerateSyntheticMesh(desc, path, &bytes)) {
+      fprintf(stderr, "failed to generate %s\n", path.c_str());
+      return 1;
+    }
+  }
+
+  const long long file_bytes = GetFileSize(path);
+  if (file_bytes == 0) {
+    fprintf(stderr, "failed to open %s\n", path.c_str());
+    return 1;
+  }
+  const double megabytes = file_bytes / (1024.0 * 1024.0);
+
+  // stream reference, then 1, 2, 4 ... threads up to the maximum
+  std::vector<ParserRun> runs;
+  if (!skip_stream) {
+    ParserRun run;
+    run.name = "stream";
+    run.threads_count = -1;
+    runs.push_back(run);
+  }
+  for (int threads_count = 1; ; threads_count *= 2) {
+    if (threads_count > max_threads_count)
+      threads_count = max_threads_count;
+
+    ParserRun run;
+    run.name = "mapped_" + std::to_string(threads_count);
+    run.threads_count = threads_count;
+    runs.push_back(run);
+
+    if (threads_count == max_threads_count)
+      break;
+  }
+
+  for (ParserRun& run : runs) {
+    run.failed = false;
+    // one untimed run warms the file cache
+    for (int i = 0; i <= iterations_count && !run.failed; ++i) {
+      Stopwatch stopwatch;
+      ParseCounts counts;
+      if (run.threads_count < 0)
+        run.failed = !ParseObjStream(path, &counts);
+      else
+        run.failed = !ParseObjMapped(path, run.threads_count, &counts);
+      const double milliseconds = stopwatch.GetElapsedMilliseconds();
+
+      run.counts = counts;
+      if (i == 0)
+        continue;
+      run.milliseconds.push_back(milliseconds);
+      run.megabytes_per_second.push_back(
+        megabytes / (milliseconds > 0.0 ? milliseconds / 1000.0 : 1e-6));
+    }
+  }
+
+  // report
+  FILE* file = output.empty() ? stdout : fopen(output.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "failed to open %s\n", output.c_str());
+    return 1;
+  }
+
+  JsonWriter writer(file);
+  writer.BeginObject();
+  writer.Write("benchmark", "obj");
+
+  writer.BeginObject("config");
+  writer.Write("file", path);
+  writer.Write("synthetic", synthetic);
+  if (synthetic) {
+    writer.Write("triangles", desc.triangles_count);
+    writer.Write("parts", desc.parts_count);
+  }
+  writer.Write("iterations", iterations_count);
+  writer.Write("max_threads", max_threads_count);
+  writer.Write("file_bytes", static_cast<int64_t>(file_bytes));
+  writer.EndObject();
+
+  writer.BeginArray("parsers");
+  for (const ParserRun& run : runs) {
+    writer.BeginObject();
+    writer.Write("name", run.name);
+    writer.Write("threads", run.threads_count);
+    writer.Write("failed", run.failed);
+    writer.Write("positions", run.counts.positions_count);
+    writer.Write("uvs", run.counts.uvs_count);
+    writer.Write("normals", run.counts.normals_count);
+    writer.Write("triangles", run.counts.triangles_count);
+    WriteStats(&writer, "milliseconds", ComputeStats(run.milliseconds));
+    WriteStats(&writer, "megabytes_per_second",
+      ComputeStats(run.megabytes_per_second));
+    writer.EndObject();
+  }
+  writer.EndArray();
+
+  writer.EndObject();
+  if (file != stdout)
+    fclose(file);
+  return 0;
+}
+}  // namespace benchmark
+}  // namespace magnet
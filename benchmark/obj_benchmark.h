@@ -0,0 +1,12 @@
+#ifndef MAGNET_BENCHMARK_OBJ_BENCHMARK_H_
+#define MAGNET_BENCHMARK_OBJ_BENCHMARK_H_
+
+namespace magnet {
+namespace benchmark {
+// parse throughput of obj files in MB/s, the iostream tokenizer the scene
+// manager used before against scene::ObjParser with growing thread counts
+int RunObjBenchmark(int argc, char** argv);
+void PrintObjBenchmarkUsage();
+}  // namespace benchmark
+}  // namespace magnet
+#endif  // MAGNET_BENCHMARK_OBJ_BENCHMARK_H_
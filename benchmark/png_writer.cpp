@@ -0,0 +1,279 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "png_writer.h"
+
+namespace magnet {
+namespace benchmark {
+namespace {
+static const int kWindowSize = 32768;
+static const int kHashBits = 15;
+static const int kMinMatch = 3;
+static const int kMaxMatch = 258;
+static const int kMaxChain = 16;
+
+static const uint16_t kLengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t kLengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t kDistanceBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+  8193, 12289, 16385, 24577 };
+static const uint8_t kDistanceExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<uint8_t>* output)
+    : output_(output), bits_(0), count_(0) {}
+
+  void Write(uint32_t value, int count) {
+    bits_ |= static_cast<uint64_t>(value) << count_;
+    count_ += count;
+    while (count_ >= 8) {
+      output_->push_back(static_cast<uint8_t>(bits_));
+      bits_ >>= 8;
+      count_ -= 8;
+    }
+  }
+
+  // huffman codes go msb first
+  void WriteCode(uint32_t code, int length) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; ++i)
+      reversed |= ((code >> i) & 1) << (length - 1 - i);
+    Write(reversed, length);
+  }
+
+  void Flush() {
+    if (count_ > 0)
+      Write(0, 8 - count_);
+  }
+
+ private:
+  std::vector<uint8_t>* output_;
+  uint64_t bits_;
+  int count_;
+};
+
+void WriteLiteralLength(BitWriter* writer, int symbol) {
+  if (symbol < 144)
+    writer->WriteCode(0x30 + symbol, 8);
+  else if (symbol < 256)
+    writer->WriteCode(0x190 + symbol - 144, 9);
+  else if (symbol < 280)
+    writer->WriteCode(symbol - 256, 7);
+  else
+    writer->WriteCode(0xc0 + symbol - 280, 8);
+}
+
+void WriteMatch(BitWriter* writer, int length, int distance) {
+  int index = 28;
+  while (kLengthBase[index] > length)
+    --index;
+  WriteLiteralLength(writer, 257 + index);
+  writer->Write(length - kLengthBase[index], kLengthExtra[index]);
+
+  index = 29;
+  while (kDistanceBase[index] > distance)
+    --index;
+  writer->WriteCode(index, 5);
+  writer->Write(distance - kDistanceBase[index], kDistanceExtra[index]);
+}
+
+inline uint32_t Hash(const uint8_t* p) {
+  const uint32_t kValue = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (kValue * 2654435761u) >> (32 - kHashBits);
+}
+
+void Compress(const std::vector<uint8_t>& input, std::vector<uint8_t>* output) {
+  // zlib header, deflate with a 32k window
+  output->push_back(0x78);
+  output->push_back(0x01);
+
+  BitWriter writer(output);
+  writer.Write(1, 1);
+  writer.Write(1, 2);
+
+  const int kSize = static_cast<int>(input.size());
+  std::vector<int> head(1 << kHashBits, -1);
+  std::vector<int> previous(kWindowSize, -1);
+  int position = 0;
+  while (position < kSize) {
+    int best_length = 0;
+    int best_distance = 0;
+    if (position + kMinMatch <= kSize) {
+      const uint32_t kHash = Hash(&input[position]);
+      int candidate = head[kHash];
+      const int kMaxLength = kSize - position < kMaxMatch ?
+        kSize - position : kMaxMatch;
+      for (int chain = 0; chain < kMaxChain && candidate >= 0 &&
+        position - candidate <= kWindowSize; ++chain) {
+        int length = 0;
+        while (length < kMaxLength &&
+          input[candidate + length] == input[position + length]) {
+          ++length;
+        }
+        if (length > best_length) {
+          best_length = length;
+          best_distance = position - candidate;
+        }
+        candidate = previous[candidate % kWindowSize];
+      }
+    }
+
+    const int kAdvance = best_length >= kMinMatch ? best_length : 1;
+    if (best_length >= kMinMatch)
+      WriteMatch(&writer, best_length, best_distance);
+    else
+      WriteLiteralLength(&writer, input[position]);
+
+    for (int i = 0; i < kAdvance; ++i, ++position) {
+      if (position + kMinMatch <= kSize) {
+        const uint32_t kHash = Hash(&input[position]);
+        previous[position % kWindowSize] = head[kHash];
+        head[kHash] = position;
+      }
+    }
+  }
+  WriteLiteralLength(&writer, 256);
+  writer.Flush();
+
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (uint8_t byte : input) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  const uint32_t kAdler = (b << 16) | a;
+  for (int shift = 24; shift >= 0; shift -= 8)
+    output->push_back(static_cast<uint8_t>(kAdler >> shift));
+}
+
+inline int Paeth(int a, int b, int c) {
+  const int kP = a + b - c;
+  const int kPa = abs(kP - a);
+  const int kPb = abs(kP - b);
+  const int kPc = abs(kP - c);
+  if (kPa <= kPb && kPa <= kPc)
+    return a;
+  return kPb <= kPc ? b : c;
+}
+
+void FilterRow(int filter, const uint8_t* row, const uint8_t* prior,
+  size_t size, uint8_t* output) {
+  for (size_t i = 0; i < size; ++i) {
+    const int kA = i >= 4 ? row[i - 4] : 0;
+    const int kB = prior[i];
+    const int kC = i >= 4 ? prior[i - 4] : 0;
+    int predictor = 0;
+    switch (filter) {
+    case 1: predictor = kA; break;
+    case 2: predictor = kB; break;
+    case 3: predictor = (kA + kB) >> 1; break;
+    case 4: predictor = Paeth(kA, kB, kC); break;
+    }
+    output[i] = static_cast<uint8_t>(row[i] - predictor);
+  }
+}
+
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc) {
+  static uint32_t table[256];
+  static bool table_ready = false;
+  if (!table_ready) {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t value = i;
+      for (int bit = 0; bit < 8; ++bit)
+        value = value & 1 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+      table[i] = value;
+    }
+    table_ready = true;
+  }
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+void WriteUint32(uint32_t value, std::vector<uint8_t>* output) {
+  for (int shift = 24; shift >= 0; shift -= 8)
+    output->push_back(static_cast<uint8_t>(value >> shift));
+}
+
+void WriteChunk(const char* type, const std::vector<uint8_t>& data,
+  std::vector<uint8_t>* output) {
+  WriteUint32(static_cast<uint32_t>(data.size()), output);
+  const size_t kTypeOffset = output->size();
+  output->insert(output->end(), type, type + 4);
+  output->insert(output->end(), data.begin(), data.end());
+  WriteUint32(Crc32(&(*output)[kTypeOffset], data.size() + 4, 0), output);
+}
+}  // namespace
+
+bool WritePng(const std::string& path, int width, int height,
+  const unsigned char* rgba, long long* bytes) {
+  const size_t kRowBytes = static_cast<size_t>(width) * 4;
+  std::vector<uint8_t> filtered;
+  filtered.reserve((kRowBytes + 1) * height);
+  std::vector<uint8_t> zero_row(kRowBytes, 0);
+  std::vector<uint8_t> candidate(kRowBytes);
+  std::vector<uint8_t> best(kRowBytes);
+
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* row = rgba + y * kRowBytes;
+    const uint8_t* prior = y > 0 ? row - kRowBytes : zero_row.data();
+    int best_filter = 0;
+    unsigned long long best_sum = ~0ull;
+    for (int filter = 0; filter < 5; ++filter) {
+      FilterRow(filter, row, prior, kRowBytes, candidate.data());
+      unsigned long long sum = 0;
+      for (uint8_t value : candidate)
+        sum += value < 128 ? value : 256 - value;
+      if (sum < best_sum) {
+        best_sum = sum;
+        best_filter = filter;
+        best.swap(candidate);
+      }
+    }
+    filtered.push_back(static_cast<uint8_t>(best_filter));
+    filtered.insert(filtered.end(), best.begin(), best.end());
+  }
+
+  std::vector<uint8_t> file;
+  static const uint8_t kSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+  file.insert(file.end(), kSignature, kSignature + 8);
+
+  std::vector<uint8_t> header;
+  WriteUint32(width, &header);
+  WriteUint32(height, &header);
+  header.push_back(8);    // bit depth
+  header.push_back(6);    // rgba
+  header.push_back(0);
+  header.push_back(0);
+  header.push_back(0);
+  WriteChunk("IHDR", header, &file);
+
+  std::vector<uint8_t> stream;
+  Compress(filtered, &stream);
+  WriteChunk("IDAT", stream, &file);
+  WriteChunk("IEND", std::vector<uint8_t>(), &file);
+
+  FILE* output = fopen(path.c_str(), "wb");
+  if (output == nullptr)
+    return false;
+  const bool kWritten = fwrite(file.data(), 1, file.size(), output) ==
+    file.size();
+  fclose(output);
+  if (bytes != nullptr)
+    *bytes += static_cast<long long>(file.size());
+  return kWritten;
+}
+}  // namespace benchmark
+}  // namespace magnet
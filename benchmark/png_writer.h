@@ -0,0 +1,16 @@
+#ifndef MAGNET_BENCHMARK_PNG_WRITER_H_
+#define MAGNET_BENCHMARK_PNG_WRITER_H_
+
+#include <string>
+
+namespace magnet {
+namespace benchmark {
+// writes 8 bit rgba as a png. rows get the filter with the smallest sum of
+// residuals like libpng picks them, the zlib stream is lz77 with the fixed
+// huffman codes. good enough to feed decoders the filters and matches real
+// files have, not meant to compress well.
+bool WritePng(const std::string& path, int width, int height,
+  const unsigned char* rgba, long long* bytes);
+}  // namespace benchmark
+}  // namespace magnet
+#endif  // MAGNET_BENCHMARK_PNG_WRITER_H_
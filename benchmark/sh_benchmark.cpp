@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/half.h"
+#include "render/texture.h"
+#include "scene/sh_projector.h"
+
+#include "benchmark_utils.h"
+#include "json_writer.h"
+#include "sh_benchmark.h"
+
+namespace magnet {
+namespace benchmark {
+namespace {
+// a bright sun spot over a sky gradient with noise, so the coefficients
+// past the first order matter and rows differ from each other
+void GenerateCube(int size, bool half, render::Texture* texture) {
+  texture->SetFormat(half ? render::TEXTURE_FORMAT_R16G16B16A16_FLOAT :
+    render::TEXTURE_FORMAT_R32G32B32A32_FLOAT);
+  texture->SetType(render::TEXTURE_TYPE_CUBE);
+  texture->SetDimension(size, size);
+  unsigned char* data = static_cast<unsigned char*>(
+    texture->CreateDataBuffer());
+
+  unsigned int state = 1;
+  std::vector<float> row(static_cast<size_t>(size) * 4);
+  for (int face = 0; face < 6; ++face) {
+    unsigned char* face_data = data + face * texture->GetFaceSize();
+    for (int y = 0; y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        const float kNoise = (state % 1000) / 10000.f;
+        const int kDx = x - size / 3;
+        const int kDy = y - size / 4;
+        const bool kSun = face == 2 && kDx * kDx + kDy * kDy < size * size / 64;
+        float* texel = &row[x * 4];
+        texel[0] = (kSun ? 50.f : 0.2f) + kNoise;
+        texel[1] = (kSun ? 45.f : 0.3f + 0.5f * y / size) + kNoise;
+        texel[2] = (kSun ? 40.f : 0.6f + 0.4f * y / size) + kNoise;
+        texel[3] = 1.f;
+      }
+      unsigned char* row_data = face_data + y * texture->GetRowPitch(0);
+      if (half) {
+        core::FloatToHalf(row.data(), row.size(),
+          reinterpret_cast<uint16_t*>(row_data));
+      }
+      else {
+        memcpy(row_data, row.data(), row.size() * sizeof(float));
+      }
+    }
+  }
+}
+
+struct ProjectorRun {
+  std::string name;
+  int face_size;
+  int threads_count;
+  bool use_simd;
+  bool cached;
+  std::vector<double> milliseconds;
+  std::vector<double> megatexels_per_second;
+  math::Vector4f coefficient0;
+  bool failed;
+};
+}  // namespace
+
+void PrintShBenchmarkUsage() {
+  printf("sh [options]\n"
+    "  --min-size S       smallest cube face edge, doubled up to max (256)\n"
+    "  --max-size S       largest cube face edge (2048)\n"
+    "  --format F         float or half texels (half)\n"
+    "  --order O          2 or 3 (3)\n"
+    "  --iterations I     measured runs per projector (5)\n"
+    "  --threads T        highest thread count, 0 for all cores (0)\n"
+    "  --output FILE      json report, stdout if not set\n");
+}
+
+int RunShBenchmark(int argc, char** argv) {
+  const int min_size = GetIntOption(argc, argv, "min-size", 256);
+  const int max_size = GetIntOption(argc, argv, "max-size", 2048);
+  const std::string format = GetStringOption(argc, argv, "format", "half");
+  const int order = GetIntOption(argc, argv, "order", 3);
+  const int iterations_count = GetIntOption(argc, argv, "iterations", 5);
+  int max_threads_count = GetIntOption(argc, argv, "threads", 0);
+  const std::string output = GetStringOption(argc, argv, "output", "");
+
+  if (max_threads_count <= 0) {
+    max_threads_count = static_cast<int>(std::thread::hardware_concurrency());
+    if (max_threads_count <= 0)
+      max_threads_count = 1;
+  }
+  if (min_size <= 0 || max_size < min_size || max_size > 16384 ||
+    (order != 2 && order != 3) ||
+    (format != "float" && format != "half")) {
+    fprintf(stderr, "invalid --min-size, --max-size, --order or --format\n");
+    return 1;
+  }
+  const bool half = format == "half";
+
+  // per face size: scalar and sse2 on one thread, sse2 on 2, 4 ... threads,
+  // then the cache once the texels were projected
+  std::vector<ProjectorRun> runs;
+  for (int size = min_size; size <= max_size; size *= 2) {
+    ProjectorRun run;
+    run.face_size = size;
+    run.threads_count = 1;
+    run.cached = false;
+    run.failed = false;
+    run.name = "scalar_" + std::to_string(size);
+    run.use_simd = false;
+    runs.push_back(run);
+    run.name = "sse2_" + std::to_string(size);
+    run.use_simd = true;
+    runs.push_back(run);
+    for (int threads_count = 2; threads_count <= max_threads_count;
+      threads_count *= 2) {
+      run.name = "sse2_" + std::to_string(size) + "_" +
+        std::to_string(threads_count);
+      run.threads_count = threads_count;
+      runs.push_back(run);
+    }
+    run.name = "cached_" + std::to_string(size);
+    run.threads_count = max_threads_count;
+    run.cached = true;
+    runs.push_back(run);
+  }
+
+  int cube_size = 0;
+  render::Texture cube("sh_benchmark");
+  for (ProjectorRun& run : runs) {
+    if (run.face_size != cube_size) {
+      cube.DestroyDataBuffer();
+      GenerateCube(run.face_size, half, &cube);
+      cube_size = run.face_size;
+    }
+    const double kMegatexels =
+      6.0 * run.face_size * run.face_size / 1e6;
+
+    // one untimed run warms the caches and, for the cached run, fills it
+    math::Vector4f coefficients[scene::kMaxShCoefficientsCount];
+    for (int i = 0; i <= iterations_count && !run.failed; ++i) {
+      Stopwatch stopwatch;
+      run.failed = run.cached ?
+        !scene::ShProjector::ProjectCached(cube, order, false,
+          run.threads_count, coefficients) :
+        !scene::ShProjector::Project(cube, order, false, run.threads_count,
+          coefficients, run.use_simd);
+      const double milliseconds = stopwatch.GetElapsedMilliseconds();
+      if (i == 0)
+        continue;
+
+      const double seconds = milliseconds > 0.0 ? milliseconds / 1000.0 : 1e-6;
+      run.milliseconds.push_back(milliseconds);
+      run.megatexels_per_second.push_back(kMegatexels / seconds);
+    }
+    run.coefficient0 = coefficients[0];
+  }
+
+  // report
+  FILE* file = output.empty() ? stdout : fopen(output.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "failed to open %s\n", output.c_str());
+    return 1;
+  }
+
+  JsonWriter writer(file);
+  writer.BeginObject();
+  writer.Write("benchmark", "sh");
+
+  writer.BeginObject("config");
+  writer.Write("min_size", min_size);
+  writer.Write("max_size", max_size);
+  writer.Write("format", format);
+  writer.Write("order", order);
+  writer.Write("iterations", iterations_count);
+  writer.Write("max_threads", max_threads_count);
+  writer.Write("f16c", core::HasF16c());
+  writer.EndObject();
+
+  writer.BeginArray("projectors");
+  for (const ProjectorRun& run : runs) {
+    writer.BeginObject();
+    writer.Write("name", run.name);
+    writer.Write("face_size", run.face_size);
+    writer.Write("threads", run.threads_count);
+    writer.Write("simd", run.use_simd);
+    writer.Write("cached", run.cached);
+    writer.Write("failed", run.failed);
+    // the same for every run of a size, a quick check they agree
+    writer.Write("coefficient0_red",
+      static_cast<double>(run.coefficient0.x_));
+    WriteStats(&writer, "milliseconds", ComputeStats(run.milliseconds));
+    WriteStats(&writer, "megatexels_per_second",
+      ComputeStats(run.megatexels_per_second));
+    writer.EndObject();
+  }
+  writer.EndArray();
+
+  writer.EndObject();
+  if (file != stdout)
+    fclose(file);
+  return 0;
+}
+}  // namespace benchmark
+}  // namespace magnet
@@ -0,0 +1,13 @@
+#ifndef MAGNET_BENCHMARK_SH_BENCHMARK_H_
+#define MAGNET_BENCHMARK_SH_BENCHMARK_H_
+
+namespace magnet {
+namespace benchmark {
+// spherical harmonics projection of synthetic hdr cube maps from 256 to
+// 2048 texels a face in megatexels/s, scene::ShProjector scalar and on
+// sse2, then on growing thread counts and from its cache
+int RunShBenchmark(int argc, char** argv);
+void PrintShBenchmarkUsage();
+}  // namespace benchmark
+}  // namespace magnet
+#endif  // MAGNET_BENCHMARK_SH_BENCHMARK_H_
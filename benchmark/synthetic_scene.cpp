@@ -0,0 +1,260 @@
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "synthetic_scene.h"
+
+namespace magnet {
+namespace benchmark {
+namespace {
+static const char kMaterialFileName[] = "synthetic.mtl";
+
+// deterministic across platforms, unlike rand()
+class Random {
+ public:
+  explicit Random(unsigned int seed) : state_(seed ? seed : 1) {}
+
+  unsigned int Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_;
+  }
+
+  float NextFloat(float min, float max) {
+    return min + (max - min) * (Next() & 0xffffff) / 16777216.f;
+  }
+
+ private:
+  unsigned int state_;
+};
+
+long long GetFileSize(FILE* file) {
+  return static_cast<long long>(ftell(file));
+}
+
+bool WriteMaterialFile(const SyntheticSceneDesc& desc,
+  const std::string& folder, Random* random, long long* bytes) {
+  FILE* file = fopen((folder + kMaterialFileName).c_str(), "w");
+  if (file == nullptr)
+    return false;
+
+  for (int i = 0; i < desc.materials_count; ++i) {
+    fprintf(file, "newmtl material_%d\n", i);
+    fprintf(file, "Ns 32.0\n");
+    fprintf(file, "Ka 0.1 0.1 0.1\n");
+    fprintf(file, "Kd %.3f %.3f %.3f\n", random->NextFloat(0.f, 1.f),
+      random->NextFloat(0.f, 1.f), random->NextFloat(0.f, 1.f));
+    fprintf(file, "Ks 0.5 0.5 0.5\n");
+    fprintf(file, "illum 2\n");
+    if (desc.texture_size > 0)
+      fprintf(file, "map_Kd texture_%d.tga\n", i);
+    fprintf(file, "\n");
+  }
+
+  *bytes += GetFileSize(file);
+  fclose(file);
+  return true;
+}
+
+// uncompressed 32 bit tga with a checker pattern
+bool WriteTexture(const std::string& path, int size, unsigned int color,
+  long long* bytes) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr)
+    return false;
+
+  unsigned char header[18] = {0};
+  header[2] = 2;
+  header[12] = static_cast<unsigned char>(size & 0xff);
+  header[13] = static_cast<unsigned char>(size >> 8);
+  header[14] = static_cast<unsigned char>(size & 0xff);
+  header[15] = static_cast<unsigned char>(size >> 8);
+  header[16] = 32;
+  header[17] = 8;
+  fwrite(header, 1, sizeof(header), file);
+
+  std::vector<unsigned char> row(size * 4);
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      bool odd = ((x >> 3) ^ (y >> 3)) & 1;
+      unsigned int texel = odd ? color : 0xffffffff;
+      row[x * 4] = texel & 0xff;
+      row[x * 4 + 1] = (texel >> 8) & 0xff;
+      row[x * 4 + 2] = (texel >> 16) & 0xff;
+      row[x * 4 + 3] = 0xff;
+    }
+    fwrite(row.data(), 1, row.size(), file);
+  }
+
+  *bytes += GetFileSize(file);
+  fclose(file);
+  return true;
+}
+
+// a grid of quads split in parts, every part is its own object with its own
+// positions and material like the exporters write them
+bool WriteMeshFile(const SyntheticSceneDesc& desc, const std::string& path,
+  int mesh_index, long long* bytes) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr)
+    return false;
+
+  fprintf(file, "# synthetic mesh %d\n", mesh_index);
+  fprintf(file, "mtllib %s\n", kMaterialFileName);
+
+  const int parts_count = desc.parts_count > 0 ? desc.parts_count : 1;
+  const int quads_per_part =
+    (desc.triangles_count / 2 + parts_count - 1) / parts_count;
+  const int side = static_cast<int>(ceil(sqrt(
+    static_cast<double>(quads_per_part > 0 ? quads_per_part : 1))));
+
+  int vertex_base = 0;
+  for (int part = 0; part < parts_count; ++part) {
+    fprintf(file, "o mesh_%d_part_%d\n", mesh_index, part);
+
+    const float offset = static_cast<float>(part);
+    for (int y = 0; y <= side; ++y) {
+      for (int x = 0; x <= side; ++x) {
+        float u = static_cast<float>(x) / side;
+        float v = static_cast<float>(y) / side;
+        fprintf(file, "v %.6f %.6f %.6f\n", u + offset,
+          0.1f * sinf(u * 6.2831853f) * cosf(v * 6.2831853f), v);
+      }
+    }
+    for (int y = 0; y <= side; ++y) {
+      for (int x = 0; x <= side; ++x) {
+        fprintf(file, "vt %.6f %.6f\n", static_cast<float>(x) / side,
+          static_cast<float>(y) / side);
+      }
+    }
+    fprintf(file, "vn 0.000000 1.000000 0.000000\n");
+
+    fprintf(file, "usemtl material_%d\n",
+      (mesh_index + part) % (desc.materials_count > 0 ? desc.materials_count : 1));
+    fprintf(file, "s off\n");
+
+    // normals are shared by all parts, one per part is written
+    const int normal_index = part + 1;
+    int quads_count = 0;
+    for (int y = 0; y < side && quads_count < quads_per_part; ++y) {
+      for (int x = 0; x < side && quads_count < quads_per_part; ++x) {
+        int i0 = vertex_base + y * (side + 1) + x + 1;
+        int i1 = i0 + 1;
+        int i2 = i0 + side + 1;
+        int i3 = i2 + 1;
+        fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", i0, i0, normal_index,
+          i2, i2, normal_index, i1, i1, normal_index);
+        fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", i1, i1, normal_index,
+          i2, i2, normal_index, i3, i3, normal_index);
+        ++quads_count;
+      }
+    }
+    vertex_base += (side + 1) * (side + 1);
+  }
+
+  *bytes += GetFileSize(file);
+  fclose(file);
+  return true;
+}
+
+void WriteTransform(FILE* file, Random* random, float extent, int indent) {
+  fprintf(file, "%*s<transform>\n", indent, "");
+  fprintf(file, "%*s  <translate>%.3f %.3f %.3f</translate>\n", indent, "",
+    random->NextFloat(-extent, extent), random->NextFloat(-extent, extent),
+    random->NextFloat(-extent, extent));
+  fprintf(file, "%*s  <scale>1 1 1</scale>\n", indent, "");
+  fprintf(file, "%*s  <rotate>0 %.3f 0</rotate>\n", indent, "",
+    random->NextFloat(0.f, 360.f));
+  fprintf(file, "%*s</transform>\n", indent, "");
+}
+
+void WriteComponent(const SyntheticSceneDesc& desc, FILE* file,
+  Random* random, const std::string& name, int level, int indent,
+  SyntheticSceneInfo* info, const std::vector<int>& mesh_triangles) {
+  const int mesh_index = random->Next() % desc.meshes_count;
+  info->components_count++;
+  info->triangles_count += mesh_triangles[mesh_index];
+
+  fprintf(file, "%*s<component name=\"%s\" type=\"mesh\">\n", indent, "",
+    name.c_str());
+  WriteTransform(file, random, 2.f, indent + 2);
+  fprintf(file, "%*s  <mesh type=\"obj\">mesh_%d.obj</mesh>\n", indent, "",
+    mesh_index);
+
+  if (level < desc.depth) {
+    for (int i = 0; i < desc.children_count; ++i) {
+      char child_name[32];
+      sprintf(child_name, "_%d", i);
+      WriteComponent(desc, file, random, name + child_name, level + 1,
+        indent + 2, info, mesh_triangles);
+    }
+  }
+  fprintf(file, "%*s</component>\n", indent, "");
+}
+}  // namespace
+
+bool GenerateSyntheticScene(const SyntheticSceneDesc& desc,
+  const std::string& folder, SyntheticSceneInfo* info) {
+  if (desc.meshes_count <= 0 || desc.materials_count <= 0)
+    return false;
+
+  Random random(desc.seed);
+  *info = SyntheticSceneInfo();
+
+  if (!WriteMaterialFile(desc, folder, &random, &info->file_bytes))
+    return false;
+
+  if (desc.texture_size > 0) {
+    for (int i = 0; i < desc.materials_count; ++i) {
+      char name[64];
+      sprintf(name, "texture_%d.tga", i);
+      if (!WriteTexture(folder + name, desc.texture_size, random.Next(),
+        &info->file_bytes)) {
+        return false;
+      }
+    }
+  }
+
+  // triangles actually written per obj, the grid is rounded per part
+  std::vector<int> mesh_triangles(desc.meshes_count);
+  for (int i = 0; i < desc.meshes_count; ++i) {
+    char name[64];
+    sprintf(name, "mesh_%d.obj", i);
+    if (!WriteMeshFile(desc, folder + name, i, &info->file_bytes))
+      return false;
+    const int parts_count = desc.parts_count > 0 ? desc.parts_count : 1;
+    const int quads_per_part =
+      (desc.triangles_count / 2 + parts_count - 1) / parts_count;
+    mesh_triangles[i] = quads_per_part * 2 * parts_count;
+  }
+
+  info->scene_path = folder + "scene.xml";
+  FILE* file = fopen(info->scene_path.c_str(), "w");
+  if (file == nullptr)
+    return false;
+
+  const float extent = sqrtf(static_cast<float>(desc.entities_count)) * 4.f;
+  fprintf(file, "<scene>\n");
+  for (int i = 0; i < desc.entities_count; ++i) {
+    fprintf(file, "  <entity name=\"entity_%d\" type=\"normal\">\n", i);
+    WriteTransform(file, &random, extent, 4);
+
+    char name[32];
+    sprintf(name, "component_%d", i);
+    WriteComponent(desc, file, &random, name, 0, 4, info, mesh_triangles);
+    fprintf(file, "  </entity>\n");
+  }
+  fprintf(file, "</scene>\n");
+
+  info->file_bytes += GetFileSize(file);
+  fclose(file);
+  return true;
+}
+bool GenerateSyntheticMesh(const SyntheticSceneDesc& desc,
+  const std::string& path, long long* bytes) {
+  *bytes = 0;
+  return WriteMeshFile(desc, path, 0, bytes);
+}
+}  // namespace benchmark
+}  // namespace magnet
@@ -0,0 +1,47 @@
+#ifndef MAGNET_BENCHMARK_SYNTHETIC_SCENE_H_
+#define MAGNET_BENCHMARK_SYNTHETIC_SCENE_H_
+
+#include <string>
+
+namespace magnet {
+namespace benchmark {
+// describes a generated scene in the scene.xml + obj/mtl format read by
+// scene::SceneManager
+struct SyntheticSceneDesc {
+  SyntheticSceneDesc() : entities_count(1000), meshes_count(16),
+    materials_count(8), triangles_count(512), parts_count(1),
+    children_count(1), depth(1), texture_size(0), seed(1) {}
+
+  int entities_count;   // N entities
+  int meshes_count;     // M unique obj files
+  int materials_count;  // K materials in the shared mtl file
+  int triangles_count;  // triangles of every obj file
+  int parts_count;      // objects with their own usemtl in every obj file
+  int children_count;   // child mesh components per component
+  int depth;            // levels of nested mesh components below the root
+  int texture_size;     // size of the generated tga textures, 0 for none
+  unsigned int seed;
+};
+
+struct SyntheticSceneInfo {
+  SyntheticSceneInfo() : components_count(0), triangles_count(0),
+    file_bytes(0) {}
+
+  std::string scene_path;
+  int components_count;
+  long long triangles_count;  // triangles referenced by all components
+  long long file_bytes;       // bytes written for xml, obj, mtl and tga
+};
+
+// writes scene.xml, mesh_<i>.obj, synthetic.mtl and texture_<k>.tga into
+// the folder, which has to exist and end with a path separator
+bool GenerateSyntheticScene(const SyntheticSceneDesc& desc,
+  const std::string& folder, SyntheticSceneInfo* info);
+
+// writes a single obj file laid out like the meshes of GenerateSyntheticScene,
+// with desc.triangles_count triangles in desc.parts_count objects
+bool GenerateSyntheticMesh(const SyntheticSceneDesc& desc,
+  const std::string& path, long long* bytes);
+}  // namespace benchmark
+}  // namespace magnet
+#endif  // MAGNET_BENCHMARK_SYNTHETIC_SCENE_H_
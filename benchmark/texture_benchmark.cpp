@@ -0,0 +1,385 @@
+#include <direct.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include "external\IL\il.h"
+#endif
+
+#include "scene/png_decoder.h"
+#include "scene/tga_decoder.h"
+
+#include "benchmark_utils.h"
+#include "json_writer.h"
+#include "png_writer.h"
+#include "texture_benchmark.h"
+
+namespace magnet {
+namespace benchmark {
+namespace {
+enum DecoderType {
+  DECODER_PNG_SCALAR,
+  DECODER_PNG_SSE2,
+  DECODER_TGA,
+  DECODER_DEVIL_PNG
+};
+
+struct EncodedImage {
+  std::vector<unsigned char> png;
+  std::vector<unsigned char> tga;
+};
+
+// smooth gradients with noise of a different strength per image, so the
+// files have every png filter in them and compress like photos or albedo
+// maps rather than like flat colors
+void GenerateImage(int size, unsigned int seed,
+  std::vector<unsigned char>* rgba) {
+  unsigned int state = seed ? seed : 1;
+  const unsigned int kNoise = 1 + (seed * 7) % 24;
+  rgba->resize(static_cast<size_t>(size) * size * 4);
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      unsigned char* texel = &(*rgba)[(static_cast<size_t>(y) * size + x) * 4];
+      const int kTile = ((x >> 5) ^ (y >> 5)) & 1 ? 64 : 0;
+      texel[0] = static_cast<unsigned char>(x * 255 / size + kTile +
+        state % kNoise);
+      texel[1] = static_cast<unsigned char>(y * 255 / size +
+        (state >> 8) % kNoise);
+      texel[2] = static_cast<unsigned char>((x + y) * 127 / size + kTile);
+      texel[3] = static_cast<unsigned char>(255 - (state >> 16) % kNoise);
+    }
+  }
+}
+
+// uncompressed 32 bit tga, bottom up like most tools write it
+bool WriteTga(const std::string& path, int size,
+  const std::vector<unsigned char>& rgba, long long* bytes) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr)
+    return false;
+
+  unsigned char header[18] = {0};
+  header[2] = 2;
+  header[12] = static_cast<unsigned char>(size & 0xff);
+  header[13] = static_cast<unsigned char>(size >> 8);
+  header[14] = static_cast<unsigned char>(size & 0xff);
+  header[15] = static_cast<unsigned char>(size >> 8);
+  header[16] = 32;
+  header[17] = 8;
+  fwrite(header, 1, sizeof(header), file);
+
+  std::vector<unsigned char> row(size * 4);
+  for (int y = size - 1; y >= 0; --y) {
+    const unsigned char* src = &rgba[static_cast<size_t>(y) * size * 4];
+    for (int x = 0; x < size; ++x) {
+      row[x * 4] = src[x * 4 + 2];
+      row[x * 4 + 1] = src[x * 4 + 1];
+      row[x * 4 + 2] = src[x * 4];
+      row[x * 4 + 3] = src[x * 4 + 3];
+    }
+    fwrite(row.data(), 1, row.size(), file);
+  }
+
+  *bytes += static_cast<long long>(ftell(file));
+  fclose(file);
+  return true;
+}
+
+bool ReadFile(const std::string& path, std::vector<unsigned char>* data) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr)
+    return false;
+  fseek(file, 0, SEEK_END);
+  const long long kSize = _ftelli64(file);
+  fseek(file, 0, SEEK_SET);
+  data->resize(static_cast<size_t>(kSize));
+  const bool kRead = kSize > 0 &&
+    fread(data->data(), 1, data->size(), file) == data->size();
+  fclose(file);
+  return kRead;
+}
+
+bool ReadSize(DecoderType type, const std::vector<unsigned char>& data,
+  int* width, int* height) {
+  if (type == DECODER_TGA)
+    return scene::TgaDecoder::ReadSize(data.data(), data.size(), width, height);
+  return scene::PngDecoder::ReadSize(data.data(), data.size(), width, height);
+}
+
+#ifdef _WIN32
+bool DecodeWithDevil(const std::vector<unsigned char>& data,
+  std::vector<unsigned char>* rgba) {
+  unsigned int image_id;
+  ilGenImages(1, &image_id);
+  ilBindImage(image_id);
+  ilEnable(IL_FORMAT_SET);
+  ilSetInteger(IL_FORMAT_MODE, IL_RGBA);
+  const bool kLoaded = ilLoadL(IL_PNG, data.data(),
+    static_cast<unsigned int>(data.size())) != 0;
+  if (kLoaded)
+    memcpy(rgba->data(), ilGetData(), rgba->size());
+  ilDeleteImage(image_id);
+  return kLoaded;
+}
+#endif  // _WIN32
+
+bool Decode(DecoderType type, const std::vector<unsigned char>& data,
+  std::vector<unsigned char>* rgba) {
+  int width = 0;
+  int height = 0;
+  if (!ReadSize(type, data, &width, &height))
+    return false;
+  rgba->resize(static_cast<size_t>(width) * height * 4);
+  const size_t kPitch = static_cast<size_t>(width) * 4;
+
+  switch (type) {
+  case DECODER_PNG_SCALAR:
+    return scene::PngDecoder::Decode(data.data(), data.size(), rgba->data(),
+      kPitch, false);
+  case DECODER_PNG_SSE2:
+    return scene::PngDecoder::Decode(data.data(), data.size(), rgba->data(),
+      kPitch, true);
+  case DECODER_TGA:
+    return scene::TgaDecoder::Decode(data.data(), data.size(), rgba->data(),
+      kPitch);
+  case DECODER_DEVIL_PNG:
+#ifdef _WIN32
+    return DecodeWithDevil(data, rgba);
+#else
+    return false;
+#endif
+  }
+  return false;
+}
+
+// decodes every image once spread over threads_count threads, each with its
+// own output buffer like the texture jobs of the asset loader
+bool DecodeAll(DecoderType type, const std::vector<EncodedImage>& images,
+  int threads_count) {
+  std::atomic<size_t> next(0);
+  std::atomic<bool> failed(false);
+  auto decode = [&]() {
+    std::vector<unsigned char> rgba;
+    for (size_t i = next++; i < images.size(); i = next++) {
+      const std::vector<unsigned char>& data = type == DECODER_TGA ?
+        images[i].tga : images[i].png;
+      if (!Decode(type, data, &rgba))
+        failed = true;
+    }
+  };
+
+  if (threads_count <= 1) {
+    decode();
+    return !failed;
+  }
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threads_count; ++i)
+    threads.push_back(std::thread(decode));
+  for (std::thread& thread : threads)
+    thread.join();
+  return !failed;
+}
+
+struct DecoderRun {
+  std::string name;
+  DecoderType type;
+  int threads_count;
+  std::vector<double> milliseconds;
+  std::vector<double> megapixels_per_second;
+  std::vector<double> megabytes_per_second;
+  bool failed;
+};
+}  // namespace
+
+void PrintTextureBenchmarkUsage() {
+  printf("texture [options]\n"
+    "  --size S           edge of the synthetic square images (1024)\n"
+    "  --images N         synthetic images, written as png and tga (16)\n"
+    "  --file PATH        decode this png or tga instead, --images times\n"
+    "  --iterations I     measured runs per decoder (5)\n"
+    "  --threads T        highest thread count, 0 for all cores (0)\n"
+    "  --folder PATH      folder of the synthetic files (synthetic\\)\n"
+    "  --output FILE      json report, stdout if not set\n");
+}
+
+int RunTextureBenchmark(int argc, char** argv) {
+  const std::string path = GetStringOption(argc, argv, "file", "");
+  const int size = GetIntOption(argc, argv, "size", 1024);
+  const int images_count = GetIntOption(argc, argv, "images", 16);
+  const int iterations_count = GetIntOption(argc, argv, "iterations", 5);
+  int max_threads_count = GetIntOption(argc, argv, "threads", 0);
+  const std::string output = GetStringOption(argc, argv, "output", "");
+
+  if (max_threads_count <= 0) {
+    max_threads_count = static_cast<int>(std::thread::hardware_concurrency());
+    if (max_threads_count <= 0)
+      max_threads_count = 1;
+  }
+  if (size <= 0 || size > 65535 || images_count <= 0) {
+    fprintf(stderr, "invalid --size or --images\n");
+    return 1;
+  }
+
+  // the files go to disk and are read back so the decoders see exactly what
+  // a texture folder holds
+  std::vector<EncodedImage> images(images_count);
+  long long png_bytes = 0;
+  long long tga_bytes = 0;
+  const bool synthetic = path.empty();
+  bool has_png = true;
+  bool has_tga = true;
+  if (synthetic) {
+    std::string folder = GetStringOption(argc, argv, "folder", "synthetic\\");
+    if (!folder.empty() && folder.back() != '\\' && folder.back() != '/')
+      folder += '\\';
+    _mkdir(folder.c_str());
+
+    std::vector<unsigned char> rgba;
+    for (int i = 0; i < images_count; ++i) {
+      GenerateImage(size, i + 1, &rgba);
+      const std::string name = folder + "texture_benchmark_" +
+        std::to_string(i);
+      long long bytes = 0;
+      if (!WritePng(name + ".png", size, size, rgba.data(), &bytes) ||
+        !WriteTga(name + ".tga", size, rgba, &bytes) ||
+        !ReadFile(name + ".png", &images[i].png) ||
+        !ReadFile(name + ".tga", &images[i].tga)) {
+        fprintf(stderr, "failed to generate %s\n", name.c_str());
+        return 1;
+      }
+      png_bytes += static_cast<long long>(images[i].png.size());
+      tga_bytes += static_cast<long long>(images[i].tga.size());
+    }
+  }
+  else {
+    std::vector<unsigned char> data;
+    if (!ReadFile(path, &data)) {
+      fprintf(stderr, "failed to open %s\n", path.c_str());
+      return 1;
+    }
+    has_png = scene::PngDecoder::IsPng(data.data(), data.size());
+    has_tga = !has_png;
+    for (EncodedImage& image : images) {
+      (has_png ? image.png : image.tga) = data;
+      (has_png ? png_bytes : tga_bytes) +=
+        static_cast<long long>(data.size());
+    }
+  }
+
+  int width = 0;
+  int height = 0;
+  if (!ReadSize(has_png ? DECODER_PNG_SSE2 : DECODER_TGA,
+    has_png ? images[0].png : images[0].tga, &width, &height)) {
+    fprintf(stderr, "unsupported image\n");
+    return 1;
+  }
+  const double megapixels =
+    static_cast<double>(width) * height * images_count / 1e6;
+
+#ifdef _WIN32
+  ilInit();
+#endif
+
+  // single threaded decoders, then the sse2 png decoder on 2, 4 ... threads
+  std::vector<DecoderRun> runs;
+  DecoderRun decoder;
+  decoder.threads_count = 1;
+  if (has_png) {
+    decoder.name = "png_scalar";
+    decoder.type = DECODER_PNG_SCALAR;
+    runs.push_back(decoder);
+    decoder.name = "png_sse2";
+    decoder.type = DECODER_PNG_SSE2;
+    runs.push_back(decoder);
+#ifdef _WIN32
+    decoder.name = "devil_png";
+    decoder.type = DECODER_DEVIL_PNG;
+    runs.push_back(decoder);
+#endif
+  }
+  if (has_tga) {
+    decoder.name = "tga";
+    decoder.type = DECODER_TGA;
+    runs.push_back(decoder);
+  }
+  if (has_png) {
+    for (int threads_count = 2; threads_count <= max_threads_count;
+      threads_count *= 2) {
+      decoder.name = "png_sse2_" + std::to_string(threads_count);
+      decoder.type = DECODER_PNG_SSE2;
+      decoder.threads_count = threads_count;
+      runs.push_back(decoder);
+    }
+  }
+
+  for (DecoderRun& run : runs) {
+    run.failed = false;
+    const double kMegabytes = (run.type == DECODER_TGA ? tga_bytes :
+      png_bytes) / (1024.0 * 1024.0);
+    // one untimed run warms the caches and the allocator
+    for (int i = 0; i <= iterations_count && !run.failed; ++i) {
+      Stopwatch stopwatch;
+      run.failed = !DecodeAll(run.type, images, run.threads_count);
+      const double milliseconds = stopwatch.GetElapsedMilliseconds();
+      if (i == 0)
+        continue;
+
+      const double seconds = milliseconds > 0.0 ? milliseconds / 1000.0 : 1e-6;
+      run.milliseconds.push_back(milliseconds);
+      run.megapixels_per_second.push_back(megapixels / seconds);
+      run.megabytes_per_second.push_back(kMegabytes / seconds);
+    }
+  }
+
+  // report
+  FILE* file = output.empty() ? stdout : fopen(output.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "failed to open %s\n", output.c_str());
+    return 1;
+  }
+
+  JsonWriter writer(file);
+  writer.BeginObject();
+  writer.Write("benchmark", "texture");
+
+  writer.BeginObject("config");
+  writer.Write("file", path);
+  writer.Write("synthetic", synthetic);
+  writer.Write("width", width);
+  writer.Write("height", height);
+  writer.Write("images", images_count);
+  writer.Write("iterations", iterations_count);
+  writer.Write("max_threads", max_threads_count);
+  writer.Write("png_bytes", static_cast<int64_t>(png_bytes));
+  writer.Write("tga_bytes", static_cast<int64_t>(tga_bytes));
+  writer.EndObject();
+
+  writer.BeginArray("decoders");
+  for (const DecoderRun& run : runs) {
+    writer.BeginObject();
+    writer.Write("name", run.name);
+    writer.Write("threads", run.threads_count);
+    writer.Write("failed", run.failed);
+    WriteStats(&writer, "milliseconds", ComputeStats(run.milliseconds));
+    WriteStats(&writer, "megapixels_per_second",
+      ComputeStats(run.megapixels_per_second));
+    WriteStats(&writer, "megabytes_per_second",
+      ComputeStats(run.megabytes_per_second));
+    writer.EndObject();
+  }
+  writer.EndArray();
+
+  writer.EndObject();
+  if (file != stdout)
+    fclose(file);
+  return 0;
+}
+}  // namespace benchmark
+}  // namespace magnet
@@ -0,0 +1,13 @@
+#ifndef MAGNET_BENCHMARK_TEXTURE_BENCHMARK_H_
+#define MAGNET_BENCHMARK_TEXTURE_BENCHMARK_H_
+
+namespace magnet {
+namespace benchmark {
+// decode throughput of png and tga textures in megapixels/s, scene::PngDecoder
+// with and without its sse2 unfilters, scene::TgaDecoder and devil, then the
+// png decoder on growing thread counts
+int RunTextureBenchmark(int argc, char** argv);
+void PrintTextureBenchmarkUsage();
+}  // namespace benchmark
+}  // namespace magnet
+#endif  // MAGNET_BENCHMARK_TEXTURE_BENCHMARK_H_
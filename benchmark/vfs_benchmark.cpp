@@ -0,0 +1,262 @@
+#include <direct.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "core/async_reader.h"
+#include "core/file_system.h"
+#include "core/pack_archive.h"
+
+#include "benchmark_utils.h"
+#include "json_writer.h"
+#include "vfs_benchmark.h"
+
+namespace magnet {
+namespace benchmark {
+namespace {
+static const char kMountPoint[] = "vfs/";
+
+enum SourceType {
+  SOURCE_LOOSE,
+  SOURCE_LOOSE_ASYNC,           // io_uring where available
+  SOURCE_LOOSE_ASYNC_THREADS,
+  SOURCE_ARCHIVE_STORED,
+  SOURCE_ARCHIVE_LZ
+};
+
+struct SourceRun {
+  std::string name;
+  SourceType type;
+  std::vector<double> milliseconds;
+  std::vector<double> files_per_second;
+  unsigned long long checksum;
+  bool failed;
+};
+
+std::string GetFileName(int index) {
+  return "vfs_benchmark_" + std::to_string(index) + ".obj";
+}
+
+// obj like text, about as compressible as the meshes and materials the
+// archives hold
+std::string GenerateFile(int index, int max_size) {
+  unsigned int state = index * 2654435761u + 1;
+  auto next = [&state]() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  };
+  const size_t kSize = 256 + next() % static_cast<unsigned int>(max_size);
+  std::string text;
+  char line[64];
+  while (text.size() < kSize) {
+    snprintf(line, sizeof(line), "v %.4f %.4f %.4f\n",
+      (next() % 20000) / 1000.f - 10.f, (next() % 20000) / 1000.f - 10.f,
+      (next() % 20000) / 1000.f - 10.f);
+    text += line;
+  }
+  text.resize(kSize);
+  return text;
+}
+
+bool Mount(SourceType type, const std::string& folder) {
+  core::FileSystem::UnmountAll();
+  if (type == SOURCE_LOOSE || type == SOURCE_LOOSE_ASYNC ||
+    type == SOURCE_LOOSE_ASYNC_THREADS) {
+    core::FileSystem::MountFolder(kMountPoint, folder);
+    return true;
+  }
+  return core::FileSystem::MountArchive(kMountPoint, folder +
+    (type == SOURCE_ARCHIVE_LZ ? "vfs_benchmark_lz.mpak" :
+      "vfs_benchmark_stored.mpak"));
+}
+
+void AddToChecksum(const core::FileView& file, unsigned long long* checksum) {
+  const unsigned char* data =
+    reinterpret_cast<const unsigned char*>(file.GetData());
+  for (size_t k = 0; k < file.GetSize(); ++k)
+    *checksum = *checksum * 31 + data[k];
+}
+
+// every byte is read, so pages are faulted in and entries decompressed
+bool ReadAll(int files_count, unsigned long long* checksum) {
+  *checksum = 0;
+  for (int i = 0; i < files_count; ++i) {
+    core::FileView file;
+    if (!core::FileSystem::Open(kMountPoint + GetFileName(i), &file))
+      return false;
+    AddToChecksum(file, checksum);
+  }
+  return true;
+}
+
+// all files in flight at once, summed in order when they are in
+bool ReadAllAsync(int files_count, core::AsyncReaderBackend backend,
+  unsigned long long* checksum) {
+  *checksum = 0;
+  std::vector<core::FileView> files(files_count);
+  std::vector<char> succeeded(files_count, 0);
+  core::AsyncReader reader(backend);
+  for (int i = 0; i < files_count; ++i) {
+    reader.Read(kMountPoint + GetFileName(i),
+      [&files, &succeeded, i](bool read, const core::FileView& file) {
+      files[i] = file;
+      succeeded[i] = read;
+    });
+  }
+  reader.Wait();
+
+  for (int i = 0; i < files_count; ++i) {
+    if (!succeeded[i])
+      return false;
+    AddToChecksum(files[i], checksum);
+  }
+  return true;
+}
+
+bool Read(SourceType type, int files_count, unsigned long long* checksum) {
+  switch (type) {
+  case SOURCE_LOOSE_ASYNC:
+    return ReadAllAsync(files_count, core::ASYNC_READER_DEFAULT, checksum);
+  case SOURCE_LOOSE_ASYNC_THREADS:
+    return ReadAllAsync(files_count, core::ASYNC_READER_THREAD_POOL,
+      checksum);
+  default:
+    return ReadAll(files_count, checksum);
+  }
+}
+
+int64_t GetFileSize(const std::string& path) {
+  core::FileView file;
+  return core::FileSystem::Open(path, &file) ?
+    static_cast<int64_t>(file.GetSize()) : 0;
+}
+}  // namespace
+
+void PrintVfsBenchmarkUsage() {
+  printf("vfs [options]\n"
+    "  --files N          synthetic files (2000)\n"
+    "  --max-size S       largest file size in bytes (16384)\n"
+    "  --iterations I     measured passes per source (5)\n"
+    "  --folder PATH      folder of the synthetic files (synthetic\\)\n"
+    "  --output FILE      json report, stdout if not set\n");
+}
+
+int RunVfsBenchmark(int argc, char** argv) {
+  const int files_count = GetIntOption(argc, argv, "files", 2000);
+  const int max_size = GetIntOption(argc, argv, "max-size", 16384);
+  const int iterations_count = GetIntOption(argc, argv, "iterations", 5);
+  std::string folder = GetStringOption(argc, argv, "folder", "synthetic\\");
+  const std::string output = GetStringOption(argc, argv, "output", "");
+
+  if (files_count <= 0 || max_size <= 0) {
+    fprintf(stderr, "invalid --files or --max-size\n");
+    return 1;
+  }
+  if (!folder.empty() && folder.back() != '\\' && folder.back() != '/')
+    folder += '\\';
+  _mkdir(folder.c_str());
+
+  // the same files loose and in both archives
+  core::PackWriter stored_writer;
+  core::PackWriter lz_writer;
+  int64_t loose_bytes = 0;
+  for (int i = 0; i < files_count; ++i) {
+    const std::string kText = GenerateFile(i, max_size);
+    const std::string kPath = folder + GetFileName(i);
+    FILE* file = fopen(kPath.c_str(), "wb");
+    const bool kWritten = file != nullptr &&
+      fwrite(kText.data(), 1, kText.size(), file) == kText.size();
+    if (file != nullptr)
+      fclose(file);
+    if (!kWritten) {
+      fprintf(stderr, "failed to write %s\n", kPath.c_str());
+      return 1;
+    }
+    stored_writer.AddFile(GetFileName(i), kText.data(), kText.size(), false);
+    lz_writer.AddFile(GetFileName(i), kText.data(), kText.size(), true);
+    loose_bytes += static_cast<int64_t>(kText.size());
+  }
+  if (!stored_writer.Write(folder + "vfs_benchmark_stored.mpak") ||
+    !lz_writer.Write(folder + "vfs_benchmark_lz.mpak")) {
+    fprintf(stderr, "failed to write the archives\n");
+    return 1;
+  }
+
+  std::vector<SourceRun> runs(5);
+  runs[0].name = "loose";
+  runs[0].type = SOURCE_LOOSE;
+  runs[1].name = "loose_async";
+  runs[1].type = SOURCE_LOOSE_ASYNC;
+  runs[2].name = "loose_async_threads";
+  runs[2].type = SOURCE_LOOSE_ASYNC_THREADS;
+  runs[3].name = "archive_stored";
+  runs[3].type = SOURCE_ARCHIVE_STORED;
+  runs[4].name = "archive_lz";
+  runs[4].type = SOURCE_ARCHIVE_LZ;
+
+  // one untimed pass warms the os file cache, a pass includes mounting
+  for (SourceRun& run : runs) {
+    run.failed = false;
+    run.checksum = 0;
+    for (int i = 0; i <= iterations_count && !run.failed; ++i) {
+      Stopwatch stopwatch;
+      run.failed = !Mount(run.type, folder) ||
+        !Read(run.type, files_count, &run.checksum);
+      const double milliseconds = stopwatch.GetElapsedMilliseconds();
+      if (i == 0)
+        continue;
+
+      const double seconds = milliseconds > 0.0 ? milliseconds / 1000.0 : 1e-6;
+      run.milliseconds.push_back(milliseconds);
+      run.files_per_second.push_back(files_count / seconds);
+    }
+  }
+  core::FileSystem::UnmountAll();
+
+  // report
+  FILE* file = output.empty() ? stdout : fopen(output.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "failed to open %s\n", output.c_str());
+    return 1;
+  }
+
+  JsonWriter writer(file);
+  writer.BeginObject();
+  writer.Write("benchmark", "vfs");
+
+  writer.BeginObject("config");
+  writer.Write("files", files_count);
+  writer.Write("max_size", max_size);
+  writer.Write("iterations", iterations_count);
+  writer.Write("loose_bytes", loose_bytes);
+  writer.Write("stored_archive_bytes",
+    GetFileSize(folder + "vfs_benchmark_stored.mpak"));
+  writer.Write("lz_archive_bytes",
+    GetFileSize(folder + "vfs_benchmark_lz.mpak"));
+  writer.Write("io_uring", core::AsyncReader().IsUsingIoUring());
+  writer.EndObject();
+
+  writer.BeginArray("sources");
+  for (const SourceRun& run : runs) {
+    writer.BeginObject();
+    writer.Write("name", run.name);
+    writer.Write("failed", run.failed);
+    // the same for every source, a quick check they agree
+    writer.Write("checksum", static_cast<int64_t>(run.checksum % 1000000007));
+    WriteStats(&writer, "milliseconds", ComputeStats(run.milliseconds));
+    WriteStats(&writer, "files_per_second",
+      ComputeStats(run.files_per_second));
+    writer.EndObject();
+  }
+  writer.EndArray();
+
+  writer.EndObject();
+  if (file != stdout)
+    fclose(file);
+  return 0;
+}
+}  // namespace benchmark
+}  // namespace magnet
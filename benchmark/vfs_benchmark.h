@@ -0,0 +1,14 @@
+#ifndef MAGNET_BENCHMARK_VFS_BENCHMARK_H_
+#define MAGNET_BENCHMARK_VFS_BENCHMARK_H_
+
+namespace magnet {
+namespace benchmark {
+// reads of many small synthetic asset files through core::FileSystem,
+// loose from a mounted folder, one at a time and all in flight through
+// core::AsyncReader, against one archive, stored and lz compressed, in
+// milliseconds per pass and files/s
+int RunVfsBenchmark(int argc, char** argv);
+void PrintVfsBenchmarkUsage();
+}  // namespace benchmark
+}  // namespace magnet
+#endif  // MAGNET_BENCHMARK_VFS_BENCHMARK_H_
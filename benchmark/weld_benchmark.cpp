@@ -0,0 +1,208 @@
+#include <direct.h>
+#include <stdio.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "core/vertex_weld_map.h"
+#include "scene/obj_parser.h"
+
+#include "allocation_counter.h"
+#include "benchmark_utils.h"
+#include "json_writer.h"
+#include "synthetic_scene.h"
+#include "weld_benchmark.h"
+
+namespace magnet {
+namespace benchmark {
+namespace {
+struct CacheEntry {
+  CacheEntry() : uv_index(-1), normal_index(-1), vertex_index(-1) {}
+  int uv_index;
+  int normal_index;
+  int vertex_index;
+};
+
+// the cache LoadMeshObj used before, kept as it was including the copy of
+// every list entry while searching
+size_t WeldWithMap(const std::vector<scene::ObjIndex>& face_vertices,
+  std::vector<unsigned int>* indices) {
+  std::map<int, std::list<CacheEntry>> cache;
+  int vertices_count = 0;
+  indices->clear();
+
+  for (const scene::ObjIndex& index : face_vertices) {
+    auto it = cache.find(index.position);
+    if (it != cache.end()) {
+      bool found_it = false;
+      std::list<CacheEntry>& list = it->second;
+      for (auto it_list : list) {
+        if (it_list.uv_index == index.uv &&
+          it_list.normal_index == index.normal) {
+          found_it = true;
+          indices->push_back(it_list.vertex_index);
+          break;
+        }
+      }
+
+      if (!found_it) {
+        indices->push_back(vertices_count);
+
+        CacheEntry entry;
+        entry.normal_index = index.normal;
+        entry.uv_index = index.uv;
+        entry.vertex_index = vertices_count++;
+        it->second.push_back(entry);
+      }
+    }
+    else {
+      indices->push_back(vertices_count);
+
+      std::list<CacheEntry> list;
+      CacheEntry entry;
+      entry.normal_index = index.normal;
+      entry.uv_index = index.uv;
+      entry.vertex_index = vertices_count++;
+      list.push_back(entry);
+      cache.insert(std::pair<int, std::list<CacheEntry>>(index.position, list));
+    }
+  }
+
+  return vertices_count;
+}
+
+size_t WeldWithFlatMap(const std::vector<scene::ObjIndex>& face_vertices,
+  std::vector<unsigned int>* indices) {
+  core::VertexWeldMap weld_map(face_vertices.size());
+  unsigned int vertices_count = 0;
+  indices->clear();
+
+  for (const scene::ObjIndex& index : face_vertices) {
+    bool inserted;
+    indices->push_back(weld_map.FindOrInsert(index.position, index.uv,
+      index.normal, vertices_count, &inserted));
+    if (inserted)
+      ++vertices_count;
+  }
+
+  return vertices_count;
+}
+
+struct WeldRun {
+  const char* name;
+  size_t (*weld)(const std::vector<scene::ObjIndex>& face_vertices,
+    std::vector<unsigned int>* indices);
+  std::vector<double> milliseconds;
+  std::vector<double> million_vertices_per_second;
+  AllocationSnapshot allocations;
+  size_t vertices_count;
+  std::vector<unsigned int> indices;
+};
+}  // namespace
+
+void PrintWeldBenchmarkUsage() {
+  printf("weld [options]\n"
+    "  --file PATH        obj file to weld, a synthetic one is generated\n"
+    "                     if not set\n"
+    "  --triangles T      triangles of the synthetic file (1000000)\n"
+    "  --parts P          objects of the synthetic file (1)\n"
+    "  --iterations I     measured runs per table (5)\n"
+    "  --folder PATH      folder of the synthetic file (synthetic\\)\n"
+    "  --output FILE      json report, stdout if not set\n");
+}
+
+int RunWeldBenchmark(int argc, char** argv) {
+  std::string path = GetStringOption(argc, argv, "file", "");
+  const int iterations_count = GetIntOption(argc, argv, "iterations", 5);
+  const std::string output = GetStringOption(argc, argv, "output", "");
+
+  SyntheticSceneDesc desc;
+  desc.triangles_count = GetIntOption(argc, argv, "triangles", 1000000);
+  desc.parts_count = GetIntOption(argc, argv, "parts", 1);
+  if (path.empty()) {
+    std::string folder = GetStringOption(argc, argv, "folder", "synthetic\\");
+    if (!folder.empty() && folder.back() != '\\' && folder.back() != '/')
+      folder += '\\';
+    _mkdir(folder.c_str());
+
+    path = folder + "weld_benchmark.obj";
+    long long bytes = 0;
+    if (!GenerateSyntheticMesh(desc, path, &bytes)) {
+      fprintf(stderr, "failed to generate %s\n", path.c_str());
+      return 1;
+    }
+  }
+
+  // the whole file is welded as one mesh
+  scene::ObjData obj_data;
+  if (!scene::ObjParser::ParseFile(path, 0, &obj_data)) {
+    fprintf(stderr, "failed to open %s\n", path.c_str());
+    return 1;
+  }
+  const std::vector<scene::ObjIndex>& face_vertices = obj_data.face_vertices;
+
+  WeldRun runs[2];
+  runs[0].name = "map_of_lists";
+  runs[0].weld = WeldWithMap;
+  runs[1].name = "vertex_weld_map";
+  runs[1].weld = WeldWithFlatMap;
+
+  for (WeldRun& run : runs) {
+    run.indices.reserve(face_vertices.size());
+    for (int i = 0; i < iterations_count; ++i) {
+      AllocationSnapshot before = GetAllocationSnapshot();
+      Stopwatch stopwatch;
+      run.vertices_count = run.weld(face_vertices, &run.indices);
+      const double milliseconds = stopwatch.GetElapsedMilliseconds();
+      run.allocations = GetAllocationSnapshot() - before;
+
+      run.milliseconds.push_back(milliseconds);
+      run.million_vertices_per_second.push_back(face_vertices.size() /
+        (milliseconds > 0.0 ? milliseconds * 1000.0 : 1e-3));
+    }
+  }
+
+  // both tables have to hand out the same indices
+  const bool matching = runs[0].indices == runs[1].indices;
+
+  // report
+  FILE* file = output.empty() ? stdout : fopen(output.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "failed to open %s\n", output.c_str());
+    return 1;
+  }
+
+  JsonWriter writer(file);
+  writer.BeginObject();
+  writer.Write("benchmark", "weld");
+
+  writer.BeginObject("config");
+  writer.Write("file", path);
+  writer.Write("iterations", iterations_count);
+  writer.Write("face_vertices", static_cast<int64_t>(face_vertices.size()));
+  writer.Write("positions", static_cast<int64_t>(obj_data.positions.size()));
+  writer.EndObject();
+
+  writer.Write("matching", matching);
+  writer.BeginArray("tables");
+  for (const WeldRun& run : runs) {
+    writer.BeginObject();
+    writer.Write("name", run.name);
+    writer.Write("vertices", static_cast<int64_t>(run.vertices_count));
+    WriteStats(&writer, "milliseconds", ComputeStats(run.milliseconds));
+    WriteStats(&writer, "million_vertices_per_second",
+      ComputeStats(run.million_vertices_per_second));
+    writer.Write("allocations", run.allocations.allocations_count);
+    writer.Write("allocated_bytes", run.allocations.allocated_bytes);
+    writer.EndObject();
+  }
+  writer.EndArray();
+
+  writer.EndObject();
+  if (file != stdout)
+    fclose(file);
+  return matching ? 0 : 1;
+}
+}  // namespace benchmark
+}  // namespace magnet
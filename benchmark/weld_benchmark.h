@@ -0,0 +1,12 @@
+#ifndef MAGNET_BENCHMARK_WELD_BENCHMARK_H_
+#define MAGNET_BENCHMARK_WELD_BENCHMARK_H_
+
+namespace magnet {
+namespace benchmark {
+// vertex welding of parsed obj face indices, the map of lists LoadMeshObj
+// used before against core::VertexWeldMap
+int RunWeldBenchmark(int argc, char** argv);
+void PrintWeldBenchmarkUsage();
+}  // namespace benchmark
+}  // namespace magnet
+#endif  // MAGNET_BENCHMARK_WELD_BENCHMARK_H_
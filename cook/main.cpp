@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scene_cooker.h"
+
+namespace {
+void PrintUsage() {
+  printf("usage: magnet_cook <scene> [options]\n"
+    "  --data PATH        folder of the scene, mesh/ and texture/ (data\\)\n"
+    "  --shaders PATH     folder of the compiled shaders, not packed if not set\n"
+    "  --shader NAME      shader program to pack, repeatable (\"\")\n"
+    "  --output PATH      caches, manifest and archive (cooked\\)\n"
+    "  --archive NAME     archive in the output folder (data.mpak)\n"
+    "  --threads N        cooking threads, 0 for all cores (0)\n"
+    "  --uncompressed     keep 8 bit textures uncompressed\n"
+    "  --compress         lz compress the caches in the archive\n");
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argv[1][0] == '-') {
+    PrintUsage();
+    return 1;
+  }
+
+  magnet::cook::SceneCookDesc desc;
+  desc.scene_path = argv[1];
+  desc.data_folder_path = "data\\";
+  desc.output_folder_path = "cooked\\";
+  for (int i = 2; i < argc; ++i) {
+    const char* kValue = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (strcmp(argv[i], "--uncompressed") == 0) {
+      desc.texture_cook.compression =
+        magnet::scene::TEXTURE_COMPRESSION_NONE;
+      continue;
+    }
+    if (strcmp(argv[i], "--compress") == 0) {
+      desc.compress_caches = true;
+      continue;
+    }
+    if (kValue == nullptr) {
+      PrintUsage();
+      return 1;
+    }
+
+    if (strcmp(argv[i], "--data") == 0) {
+      desc.data_folder_path = kValue;
+    }
+    else if (strcmp(argv[i], "--shaders") == 0) {
+      desc.shader_folder_path = kValue;
+    }
+    else if (strcmp(argv[i], "--shader") == 0) {
+      desc.shader_names.push_back(kValue);
+    }
+    else if (strcmp(argv[i], "--output") == 0) {
+      desc.output_folder_path = kValue;
+    }
+    else if (strcmp(argv[i], "--archive") == 0) {
+      desc.archive_name = kValue;
+    }
+    else if (strcmp(argv[i], "--threads") == 0) {
+      desc.threads_count = atoi(kValue);
+    }
+    else {
+      PrintUsage();
+      return 1;
+    }
+    ++i;
+  }
+  // the opaque pass loads the program with the empty name
+  if (desc.shader_names.empty())
+    desc.shader_names.push_back("");
+
+  magnet::cook::SceneCooker cooker(desc);
+  return cooker.Run() ? 0 : 1;
+}
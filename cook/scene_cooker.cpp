@@ -0,0 +1,395 @@
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+#include "core/hash.h"
+#include "core/pack_archive.h"
+#include "core/task_manager.h"
+#include "render/texture.h"
+#include "scene/asset_loader.h"
+#include "scene/compiled_scene.h"
+#include "scene/ibl_baker.h"
+#include "scene/mesh_cache.h"
+#include "scene/sh_projector.h"
+#include "scene/texture_cache.h"
+#include "scene/texture_loader.h"
+
+#include "scene_cooker.h"
+
+namespace magnet {
+namespace cook {
+namespace {
+// the virtual folders the runtime reads meshes, textures and shaders from
+static const char kMeshFolder[] = "mesh/";
+static const char kTextureFolder[] = "texture/";
+static const char kShaderFolder[] = "shader/";
+static const char* const kShaderExtensions[] = { ".v", ".p", ".c" };
+
+std::string AddSeparator(const std::string& folder_path) {
+  if (folder_path.empty() || folder_path.back() == '/' ||
+    folder_path.back() == '\\') {
+    return folder_path;
+  }
+  return folder_path + '/';
+}
+
+// paths below the data folder are mounted, the output folder has to be
+// absolute so its files are written where they are asked for
+std::string GetAbsolutePath(const std::string& path) {
+#ifdef _WIN32
+  char* absolute_path = _fullpath(nullptr, path.c_str(), 0);
+  if (absolute_path == nullptr)
+    return path;
+  const std::string kResult(absolute_path);
+  free(absolute_path);
+  return kResult;
+#else
+  if (!path.empty() && path[0] == '/')
+    return path;
+  char working_folder[4096];
+  if (getcwd(working_folder, sizeof(working_folder)) == nullptr)
+    return path;
+  return std::string(working_folder) + '/' + path;
+#endif
+}
+
+// the folders a file at path goes into
+void CreateFolders(const std::string& path) {
+  for (size_t i = 1; i < path.size(); ++i) {
+    if (path[i] != '/' && path[i] != '\\')
+      continue;
+    const std::string kFolder = path.substr(0, i);
+#ifdef _WIN32
+    _mkdir(kFolder.c_str());
+#else
+    mkdir(kFolder.c_str(), 0755);
+#endif
+  }
+}
+
+bool IsNativeFile(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr)
+    return false;
+  fclose(file);
+  return true;
+}
+}  // namespace
+
+SceneCooker::SceneCooker(const SceneCookDesc& desc) : desc_(desc),
+  failures_count_(0) {
+  desc_.data_folder_path = AddSeparator(desc_.data_folder_path);
+  desc_.shader_folder_path = AddSeparator(desc_.shader_folder_path);
+  desc_.output_folder_path =
+    AddSeparator(GetAbsolutePath(desc_.output_folder_path));
+}
+
+bool SceneCooker::Run() {
+  // sources are read the way the runtime reads them
+  core::FileSystem::UnmountAll();
+  core::FileSystem::MountFolder("", desc_.data_folder_path);
+  if (!desc_.shader_folder_path.empty())
+    core::FileSystem::MountFolder(kShaderFolder, desc_.shader_folder_path);
+  CreateFolders(desc_.output_folder_path);
+
+  std::vector<std::string> mesh_names;
+  if (!CompileScene(&mesh_names)) {
+    core::FileSystem::UnmountAll();
+    return false;
+  }
+
+  // jobs load the meshes and textures, each on its own thread
+  const bool kOwnsTaskManager = !core::TaskManager::Exist();
+  if (kOwnsTaskManager) {
+    core::TaskManager::Initialize();
+    core::TaskManager::GetInstance()->BeginThreads(desc_.threads_count > 0 ?
+      desc_.threads_count :
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+  }
+  CookAssets(mesh_names);
+  if (kOwnsTaskManager)
+    core::TaskManager::Terminate();
+
+  CollectShaders();
+  const bool kWritten = WriteArchive();
+  files_.clear();
+  core::FileSystem::UnmountAll();
+
+  printf("%d meshes, %d files packed, %d failures\n",
+    static_cast<int>(mesh_names.size()),
+    static_cast<int>(manifest_.GetFiles().size()), failures_count_);
+  return kWritten && failures_count_ == 0;
+}
+
+bool SceneCooker::CompileScene(std::vector<std::string>* mesh_names) {
+  core::FileView file;
+  scene::CompiledScene compiled;
+  if (!core::FileSystem::Open(desc_.scene_path, &file) ||
+    !compiled.Compile(file.GetData(), file.GetSize())) {
+    fprintf(stderr, "can't compile %s\n", desc_.scene_path.c_str());
+    return false;
+  }
+  for (uint32_t i = 0; i < compiled.GetMeshesCount(); ++i)
+    mesh_names->push_back(compiled.GetString(compiled.GetMesh(i)));
+
+  // the runtime maps the compiled scene, the xml is not packed
+  scene::CookManifest::Asset asset;
+  asset.source = desc_.scene_path;
+  asset.source_key = scene::CompiledScene::ComputeSourceKey(file.GetData(),
+    file.GetSize());
+  asset.cache = desc_.scene_path + scene::kCompiledSceneExtension;
+  for (const std::string& name : *mesh_names)
+    asset.dependencies.push_back(kMeshFolder + name);
+  CreateFolders(GetOutputPath(asset.cache));
+  if (!compiled.Write(GetOutputPath(asset.cache), asset.source_key) ||
+    !AddOutputFile(asset.cache, false)) {
+    fprintf(stderr, "failed to write %s\n", asset.cache.c_str());
+    return false;
+  }
+  manifest_.AddAsset(asset);
+  return true;
+}
+
+void SceneCooker::CookAssets(const std::vector<std::string>& mesh_names) {
+  scene::AssetLoaderDesc loader_desc;
+  loader_desc.mesh_folder_path = kMeshFolder;
+  loader_desc.texture_folder_path = kTextureFolder;
+  loader_desc.mesh_cache_folder_path = GetOutputPath(kMeshFolder);
+  loader_desc.texture_cache_folder_path = GetOutputPath(kTextureFolder);
+  loader_desc.texture_cook = desc_.texture_cook;
+  for (const std::string& name : mesh_names)
+    CreateFolders(GetOutputPath(kMeshFolder + name));
+  CreateFolders(GetOutputPath(kTextureFolder));
+
+  scene::AssetLoader loader(loader_desc);
+  for (const std::string& name : mesh_names)
+    loader.RequestMesh(name);
+  loader.Run([](const scene::LoadProgress& progress) {
+    printf("\rcooking %d/%d assets", progress.assets_loaded,
+      progress.assets_count);
+    fflush(stdout);
+  });
+  printf("\n");
+
+  // meshes, with the material libraries they name in first use order
+  std::vector<std::string> library_names;
+  for (const std::string& name : mesh_names) {
+    scene::CookManifest::Asset asset;
+    asset.source = kMeshFolder + name;
+    const scene::MeshCacheData* mesh_data = loader.GetMeshData(name);
+    core::FileView source;
+    if (mesh_data == nullptr ||
+      !core::FileSystem::Open(asset.source, &source)) {
+      fprintf(stderr, "failed to load %s\n", asset.source.c_str());
+      ++failures_count_;
+      continue;
+    }
+    for (const std::string& library : mesh_data->material_libraries) {
+      asset.dependencies.push_back(kMeshFolder + library);
+      if (std::find(library_names.begin(), library_names.end(), library) ==
+        library_names.end()) {
+        library_names.push_back(library);
+      }
+    }
+
+    // the cache AssetLoader read or wrote, checked as the runtime would.
+    // without one the obj is packed and parsed at load.
+    const uint64_t kSourceKey = scene::MeshCache::ComputeSourceKey(
+      source.GetData(), source.GetSize());
+    const std::string kCache = asset.source + ".mcache";
+    scene::MeshCacheData cached;
+    if (scene::MeshCache::Read(GetOutputPath(kCache), kSourceKey, &cached) &&
+      AddOutputFile(kCache, desc_.compress_caches)) {
+      asset.source_key = kSourceKey;
+      asset.cache = kCache;
+    }
+    else {
+      fprintf(stderr, "no cache for %s, packed as it is\n",
+        asset.source.c_str());
+      AddFile(asset.source, true);
+    }
+    manifest_.AddAsset(asset);
+  }
+
+  for (const std::string& name : library_names) {
+    scene::CookManifest::Asset asset;
+    asset.source = kMeshFolder + name;
+    const std::vector<scene::MtlMaterial>* materials =
+      loader.GetMaterialLibrary(name);
+    if (materials == nullptr || !AddFile(asset.source, true)) {
+      fprintf(stderr, "failed to load %s\n", asset.source.c_str());
+      ++failures_count_;
+      continue;
+    }
+    for (const scene::MtlMaterial& material : *materials) {
+      if (!material.texture_name.empty())
+        asset.dependencies.push_back(kTextureFolder + material.texture_name);
+    }
+    manifest_.AddAsset(asset);
+  }
+
+  // by name, the runtime lights the scene with the first sky in that order
+  std::vector<std::shared_ptr<render::Texture>> textures =
+    loader.GetTextures();
+  std::sort(textures.begin(), textures.end(),
+    [](const std::shared_ptr<render::Texture>& a,
+      const std::shared_ptr<render::Texture>& b) {
+    return a->GetName() < b->GetName();
+  });
+  bool environment_cooked = false;
+  for (const std::shared_ptr<render::Texture>& texture : textures) {
+    CookTexture(texture.get());
+    if (!environment_cooked && texture->GetDataBufferPtr() != nullptr &&
+      scene::ShProjector::CanProject(*texture)) {
+      CookEnvironment(*texture);
+      environment_cooked = true;
+    }
+  }
+}
+
+void SceneCooker::CookTexture(render::Texture* texture) {
+  scene::CookManifest::Asset asset;
+  asset.source = kTextureFolder + texture->GetName();
+  core::FileView source;
+  if (texture->GetDataBufferPtr() == nullptr ||
+    !core::FileSystem::Open(asset.source, &source)) {
+    fprintf(stderr, "failed to load %s\n", asset.source.c_str());
+    ++failures_count_;
+    return;
+  }
+
+  // names with folders miss them in the output folder the first time, the
+  // texture is cooked again once they exist. it is cooked as AssetLoader
+  // creates it, by name only.
+  render::Texture cooked(texture->GetName());
+  const uint64_t kSourceKey = scene::TextureCache::ComputeSourceKey(
+    source.GetData(), source.GetSize(), desc_.texture_cook, cooked);
+  const std::string kCache = asset.source + ".tcache";
+  const std::string kCachePath = GetOutputPath(kCache);
+  render::Texture cached(texture->GetName());
+  bool has_cache = scene::TextureCache::Read(kCachePath, kSourceKey, &cached);
+  if (!has_cache) {
+    CreateFolders(kCachePath);
+    has_cache = scene::TextureLoader::LoadCooked(kTextureFolder,
+      desc_.texture_cook, kCachePath, &cooked) &&
+      scene::TextureCache::Read(kCachePath, kSourceKey, &cached);
+  }
+
+  if (has_cache && AddOutputFile(kCache, desc_.compress_caches)) {
+    asset.source_key = kSourceKey;
+    asset.cache = kCache;
+  }
+  else {
+    AddFile(asset.source, false);
+  }
+  manifest_.AddAsset(asset);
+}
+
+void SceneCooker::CookEnvironment(const render::Texture& sky) {
+  // the names SceneManager reads them under
+  const std::string kSpecular =
+    kTextureFolder + sky.GetName() + ".specular.tcache";
+  const std::string kLut = std::string(kTextureFolder) + "brdf_lut.tcache";
+
+  scene::IblBakeDesc ibl_desc;
+  ibl_desc.srgb = desc_.texture_cook.srgb;
+  render::Texture specular(sky.GetName() + "_specular");
+  render::Texture lut("brdf_lut");
+  if (!scene::IblBaker::BakeSpecularCached(ibl_desc, sky,
+    GetOutputPath(kSpecular), &specular) ||
+    !scene::IblBaker::BakeBrdfLutCached(ibl_desc, GetOutputPath(kLut), &lut) ||
+    !AddOutputFile(kSpecular, desc_.compress_caches) ||
+    !AddOutputFile(kLut, desc_.compress_caches)) {
+    fprintf(stderr, "failed to bake the environment of %s\n",
+      sky.GetName().c_str());
+    ++failures_count_;
+  }
+}
+
+void SceneCooker::CollectShaders() {
+  if (desc_.shader_folder_path.empty())
+    return;
+
+  for (const std::string& name : desc_.shader_names) {
+    // programs have some of the stages
+    bool found = false;
+    for (const char* extension : kShaderExtensions)
+      found = AddFile(kShaderFolder + name + extension, false) || found;
+    if (!found) {
+      fprintf(stderr, "can't find shader %s\n", name.c_str());
+      ++failures_count_;
+    }
+  }
+}
+
+bool SceneCooker::WriteArchive() {
+  for (const auto& it : files_) {
+    scene::CookManifest::File file;
+    file.name = it.first;
+    // seeded with how the file is stored, switching --compress rewrites
+    // the archive
+    file.content_hash = core::Hash64(it.second.file.GetData(),
+      it.second.file.GetSize(), it.second.compress ? 1 : 0);
+    file.size = it.second.file.GetSize();
+    manifest_.AddFile(file);
+  }
+
+  const std::string kManifestPath = GetOutputPath(scene::kCookManifestName);
+  const std::string kArchivePath = GetOutputPath(desc_.archive_name);
+  scene::CookManifest previous;
+  const bool kUpToDate = previous.Read(kManifestPath) &&
+    previous.HasSameFiles(manifest_) && IsNativeFile(kArchivePath);
+  if (!manifest_.Write(kManifestPath)) {
+    fprintf(stderr, "failed to write %s\n", kManifestPath.c_str());
+    return false;
+  }
+  if (kUpToDate) {
+    printf("%s is up to date\n", kArchivePath.c_str());
+    return true;
+  }
+
+  core::PackWriter writer;
+  for (const auto& it : files_) {
+    writer.AddFile(it.first, it.second.file.GetData(),
+      it.second.file.GetSize(), it.second.compress);
+  }
+  if (!writer.AddFileFromDisk(scene::kCookManifestName, kManifestPath, true) ||
+    !writer.Write(kArchivePath)) {
+    fprintf(stderr, "failed to write %s\n", kArchivePath.c_str());
+    return false;
+  }
+  printf("wrote %s\n", kArchivePath.c_str());
+  return true;
+}
+
+bool SceneCooker::AddFile(const std::string& name, bool compress) {
+  PackedFile packed;
+  if (!core::FileSystem::Open(name, &packed.file))
+    return false;
+  packed.compress = compress;
+  files_[core::PackArchive::NormalizeName(name)] = packed;
+  return true;
+}
+
+bool SceneCooker::AddOutputFile(const std::string& name, bool compress) {
+  PackedFile packed;
+  if (!core::FileSystem::Open(GetOutputPath(name), &packed.file))
+    return false;
+  packed.compress = compress;
+  files_[core::PackArchive::NormalizeName(name)] = packed;
+  return true;
+}
+
+std::string SceneCooker::GetOutputPath(const std::string& name) const {
+  return desc_.output_folder_path + name;
+}
+}  // namespace cook
+}  // namespace magnet
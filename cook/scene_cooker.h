@@ -0,0 +1,77 @@
+#ifndef MAGNET_COOK_SCENE_COOKER_H_
+#define MAGNET_COOK_SCENE_COOKER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "core/file_system.h"
+#include "scene/cook_manifest.h"
+#include "scene/texture_cooker.h"
+
+namespace magnet {
+namespace render {
+class Texture;
+}  // namespace render
+
+namespace cook {
+struct SceneCookDesc {
+  SceneCookDesc() : archive_name("data.mpak"), threads_count(0),
+    compress_caches(false) {}
+  std::string scene_path;           // relative to the data folder
+  std::string data_folder_path;     // holds mesh/ and texture/
+  std::string shader_folder_path;   // shaders are not packed if empty
+  std::vector<std::string> shader_names;
+  std::string output_folder_path;   // caches, manifest and archive
+  std::string archive_name;
+  scene::TextureCookDesc texture_cook;
+  int threads_count;                // TaskManager threads, 0 for all cores
+  bool compress_caches;             // lz in the archive, no zero copy reads
+};
+
+// cooks a scene file and everything it references into the formats the
+// runtime reads in place and packs them into one archive, with the
+// material libraries, shaders and a CookManifest.
+//
+// meshes and textures are loaded by an AssetLoader on TaskManager threads,
+// which writes their caches to the output folder the way the runtime
+// would. the caches are keyed on the source bytes, so a second run only
+// hashes the sources and re-cooks what changed. the sky gets its
+// prefiltered specular cube map and the brdf lut baked as well. the
+// archive is rewritten only if a packed file differs from the last run.
+class SceneCooker {
+ public:
+  explicit SceneCooker(const SceneCookDesc& desc);
+
+  // false if the scene could not be read or an asset failed, what could
+  // be cooked is packed anyway
+  bool Run();
+
+ private:
+  struct PackedFile {
+    core::FileView file;
+    bool compress;
+  };
+
+  bool CompileScene(std::vector<std::string>* mesh_names);
+  void CookAssets(const std::vector<std::string>& mesh_names);
+  void CookTexture(render::Texture* texture);
+  void CookEnvironment(const render::Texture& sky);
+  void CollectShaders();
+  bool WriteArchive();
+
+  // packs the file at a virtual path under the same name
+  bool AddFile(const std::string& name, bool compress);
+  // packs a file of the output folder
+  bool AddOutputFile(const std::string& name, bool compress);
+
+  std::string GetOutputPath(const std::string& name) const;
+
+  SceneCookDesc desc_;
+  scene::CookManifest manifest_;
+  std::map<std::string, PackedFile> files_;   // by name, packed in order
+  int failures_count_;
+};
+}  // namespace cook
+}  // namespace magnet
+#endif  // MAGNET_COOK_SCENE_COOKER_H_
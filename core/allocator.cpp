@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include "allocator.h"
+
+namespace magnet {
+namespace core {
+namespace {
+// the size, tag and offset from the malloc block are stored in front of
+// every heap allocation, the user pointer stays aligned to kDefaultAlignment
+struct HeapHeader {
+  uint64_t size;
+  uint32_t tag;
+  uint32_t offset;
+};
+static_assert(sizeof(HeapHeader) == kDefaultAlignment,
+  "heap header breaks the default alignment");
+
+static const char* const kTagNames[MEMORY_TAG_COUNT] = {
+  "mesh",
+  "texture",
+  "shader",
+  "render_frame",
+  "scene"
+};
+
+struct TagCounters {
+  std::atomic<int64_t> allocations_count;
+  std::atomic<int64_t> live_allocations_count;
+  std::atomic<int64_t> live_bytes;
+  std::atomic<int64_t> peak_live_bytes;
+};
+
+TagCounters g_tag_counters[MEMORY_TAG_COUNT];
+
+size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+}  // namespace
+
+void* TaggedHeap::Allocate(MemoryTag tag, size_t size, size_t alignment) {
+  if (alignment < kDefaultAlignment)
+    alignment = kDefaultAlignment;
+  char* block =
+    static_cast<char*>(malloc(size + sizeof(HeapHeader) + alignment - 1));
+  if (block == nullptr)
+    return nullptr;
+  char* memory = reinterpret_cast<char*>(AlignUp(
+    reinterpret_cast<uintptr_t>(block) + sizeof(HeapHeader), alignment));
+  HeapHeader* header = reinterpret_cast<HeapHeader*>(memory) - 1;
+  header->size = size;
+  header->tag = tag;
+  header->offset = static_cast<uint32_t>(memory - block);
+
+  TagCounters& counters = g_tag_counters[tag];
+  counters.allocations_count.fetch_add(1, std::memory_order_relaxed);
+  counters.live_allocations_count.fetch_add(1, std::memory_order_relaxed);
+  const int64_t kLive = counters.live_bytes.fetch_add(
+    static_cast<int64_t>(size), std::memory_order_relaxed) +
+    static_cast<int64_t>(size);
+  int64_t peak = counters.peak_live_bytes.load(std::memory_order_relaxed);
+  while (kLive > peak &&
+    !counters.peak_live_bytes.compare_exchange_weak(peak, kLive,
+      std::memory_order_relaxed)) {
+  }
+  return memory;
+}
+
+void TaggedHeap::Free(void* memory) {
+  if (memory == nullptr)
+    return;
+  const HeapHeader* header = static_cast<const HeapHeader*>(memory) - 1;
+  TagCounters& counters = g_tag_counters[header->tag];
+  counters.live_allocations_count.fetch_sub(1, std::memory_order_relaxed);
+  counters.live_bytes.fetch_sub(static_cast<int64_t>(header->size),
+    std::memory_order_relaxed);
+  free(static_cast<char*>(memory) - header->offset);
+}
+
+MemoryTagStats TaggedHeap::GetStats(MemoryTag tag) {
+  const TagCounters& counters = g_tag_counters[tag];
+  MemoryTagStats stats;
+  stats.allocations_count = counters.allocations_count.load();
+  stats.live_allocations_count = counters.live_allocations_count.load();
+  stats.live_bytes = counters.live_bytes.load();
+  stats.peak_live_bytes = counters.peak_live_bytes.load();
+  return stats;
+}
+
+const char* TaggedHeap::GetTagName(MemoryTag tag) {
+  return tag < MEMORY_TAG_COUNT ? kTagNames[tag] : "unknown";
+}
+
+HeapAllocator::HeapAllocator(MemoryTag tag) : tag_(tag) {
+}
+
+void* HeapAllocator::Allocate(size_t size, size_t alignment) {
+  return TaggedHeap::Allocate(tag_, size, alignment);
+}
+
+void HeapAllocator::Free(void* memory) {
+  TaggedHeap::Free(memory);
+}
+
+LinearArena::LinearArena(MemoryTag tag, size_t block_size) : tag_(tag),
+  block_size_(block_size > 0 ? block_size : 1),
+  offset_(0),
+  used_bytes_(0) {
+}
+
+LinearArena::~LinearArena() {
+  for (const Block& block : blocks_)
+    TaggedHeap::Free(block.memory);
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment) {
+  if (!blocks_.empty()) {
+    const Block& kBlock = blocks_.back();
+    const size_t kOffset = AlignUp(reinterpret_cast<uintptr_t>(kBlock.memory) +
+      offset_, alignment) - reinterpret_cast<uintptr_t>(kBlock.memory);
+    if (kOffset + size <= kBlock.size) {
+      offset_ = kOffset + size;
+      return kBlock.memory + kOffset;
+    }
+  }
+
+  // the heap aligns the start of a block to the alignment asked for
+  Block block;
+  block.size = size > block_size_ ? size : block_size_;
+  block.memory = static_cast<char*>(
+    TaggedHeap::Allocate(tag_, block.size, alignment));
+  if (block.memory == nullptr)
+    return nullptr;
+  used_bytes_ += offset_;
+  blocks_.push_back(block);
+  offset_ = size;
+  return block.memory;
+}
+
+void LinearArena::Free(void* /*memory*/) {
+}
+
+void LinearArena::Reset() {
+  for (size_t i = 1; i < blocks_.size(); ++i)
+    TaggedHeap::Free(blocks_[i].memory);
+  if (blocks_.size() > 1)
+    blocks_.resize(1);
+  offset_ = 0;
+  used_bytes_ = 0;
+}
+
+size_t LinearArena::GetUsedBytes() const {
+  return used_bytes_ + offset_;
+}
+
+size_t LinearArena::GetReservedBytes() const {
+  size_t reserved_bytes = 0;
+  for (const Block& block : blocks_)
+    reserved_bytes += block.size;
+  return reserved_bytes;
+}
+
+FixedPool::FixedPool(MemoryTag tag, size_t block_size, size_t alignment,
+  uint32_t slab_size) : tag_(tag),
+  alignment_(alignment > alignof(FreeBlock) ? alignment : alignof(FreeBlock)),
+  block_size_(AlignUp(block_size > sizeof(FreeBlock) ?
+    block_size : sizeof(FreeBlock), alignment_)),
+  slab_size_(slab_size > 0 ? slab_size : 1),
+  free_blocks_(nullptr),
+  free_blocks_count_(0),
+  blocks_count_(0) {
+}
+
+FixedPool::~FixedPool() {
+  for (const Slab& slab : slabs_)
+    TaggedHeap::Free(slab.blocks);
+}
+
+void* FixedPool::Allocate(size_t size, size_t alignment) {
+  if (size > block_size_ || alignment > alignment_)
+    return nullptr;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_blocks_ == nullptr && !AddSlab(slab_size_))
+    return nullptr;
+  FreeBlock* block = free_blocks_;
+  free_blocks_ = block->next;
+  --free_blocks_count_;
+  ++blocks_count_;
+  return block;
+}
+
+void FixedPool::Free(void* memory) {
+  if (memory == nullptr)
+    return;
+  FreeBlock* block = static_cast<FreeBlock*>(memory);
+  std::lock_guard<std::mutex> lock(mutex_);
+  block->next = free_blocks_;
+  free_blocks_ = block;
+  ++free_blocks_count_;
+  --blocks_count_;
+}
+
+void FixedPool::Reserve(uint32_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (count > free_blocks_count_)
+    AddSlab(count - free_blocks_count_);
+}
+
+void FixedPool::Trim() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<uint32_t> free_counts;
+  CountFreeBlocks(&free_counts);
+
+  // the free list keeps its order without the blocks of freed slabs
+  std::vector<Slab> kept_slabs;
+  for (size_t i = 0; i < slabs_.size(); ++i) {
+    if (free_counts[i] < slabs_[i].capacity)
+      kept_slabs.push_back(slabs_[i]);
+  }
+  if (kept_slabs.size() == slabs_.size())
+    return;
+  FreeBlock** link = &free_blocks_;
+  for (FreeBlock* block = free_blocks_; block != nullptr;
+    block = block->next) {
+    const char* kBlock = reinterpret_cast<const char*>(block);
+    bool kept = false;
+    for (const Slab& slab : kept_slabs) {
+      if (kBlock >= slab.blocks &&
+        kBlock < slab.blocks + slab.capacity * block_size_) {
+        kept = true;
+        break;
+      }
+    }
+    if (kept) {
+      *link = block;
+      link = &block->next;
+    }
+    else {
+      --free_blocks_count_;
+    }
+  }
+  *link = nullptr;
+
+  for (size_t i = 0; i < slabs_.size(); ++i) {
+    if (free_counts[i] == slabs_[i].capacity)
+      TaggedHeap::Free(slabs_[i].blocks);
+  }
+  slabs_.swap(kept_slabs);
+}
+
+size_t FixedPool::GetBlockSize() const {
+  return block_size_;
+}
+
+uint32_t FixedPool::GetBlocksCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return blocks_count_;
+}
+
+uint32_t FixedPool::GetCapacity() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return blocks_count_ + free_blocks_count_;
+}
+
+FixedPoolStats FixedPool::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<uint32_t> free_counts;
+  CountFreeBlocks(&free_counts);
+
+  FixedPoolStats stats;
+  stats.blocks_count = blocks_count_;
+  stats.capacity = blocks_count_ + free_blocks_count_;
+  stats.slabs_count = static_cast<uint32_t>(slabs_.size());
+  stats.empty_slabs_count = 0;
+  stats.block_size = block_size_;
+  stats.reserved_bytes = 0;
+  uint32_t used_capacity = 0;
+  uint32_t used_free_count = 0;
+  for (size_t i = 0; i < slabs_.size(); ++i) {
+    stats.reserved_bytes += slabs_[i].capacity * block_size_;
+    if (free_counts[i] == slabs_[i].capacity) {
+      ++stats.empty_slabs_count;
+    }
+    else {
+      used_capacity += slabs_[i].capacity;
+      used_free_count += free_counts[i];
+    }
+  }
+  stats.fragmentation = used_capacity > 0 ?
+    static_cast<float>(used_free_count) / used_capacity : 0.f;
+  return stats;
+}
+
+bool FixedPool::AddSlab(uint32_t capacity) {
+  Slab slab;
+  slab.blocks = static_cast<char*>(
+    TaggedHeap::Allocate(tag_, capacity * block_size_, alignment_));
+  if (slab.blocks == nullptr)
+    return false;
+  slab.capacity = capacity;
+  slabs_.push_back(slab);
+
+  // the first block of the slab is the next one allocated
+  for (uint32_t i = capacity; i > 0; --i) {
+    FreeBlock* block =
+      reinterpret_cast<FreeBlock*>(slab.blocks + (i - 1) * block_size_);
+    block->next = free_blocks_;
+    free_blocks_ = block;
+  }
+  free_blocks_count_ += capacity;
+  return true;
+}
+
+void FixedPool::CountFreeBlocks(std::vector<uint32_t>* free_counts) const {
+  // slabs by address, a block is in the last slab starting before it
+  std::vector<std::pair<const char*, size_t>> starts;
+  for (size_t i = 0; i < slabs_.size(); ++i)
+    starts.push_back(std::make_pair(slabs_[i].blocks, i));
+  std::sort(starts.begin(), starts.end());
+
+  free_counts->assign(slabs_.size(), 0);
+  for (const FreeBlock* block = free_blocks_; block != nullptr;
+    block = block->next) {
+    const char* kBlock = reinterpret_cast<const char*>(block);
+    auto it = std::upper_bound(starts.begin(), starts.end(),
+      std::make_pair(kBlock, slabs_.size()));
+    ++(*free_counts)[(it - 1)->second];
+  }
+}
+
+}  // namespace core
+}  // namespace magnet
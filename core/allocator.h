@@ -0,0 +1,177 @@
+#ifndef MAGNET_CORE_ALLOCATOR_H_
+#define MAGNET_CORE_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+namespace magnet {
+namespace core {
+// what engine memory is used for, the heap keeps its bytes per tag
+enum MemoryTag {
+  MEMORY_TAG_MESH = 0,
+  MEMORY_TAG_TEXTURE,
+  MEMORY_TAG_SHADER,
+  MEMORY_TAG_RENDER_FRAME,
+  MEMORY_TAG_SCENE,
+  MEMORY_TAG_COUNT
+};
+
+struct MemoryTagStats {
+  MemoryTagStats() : allocations_count(0), live_allocations_count(0),
+    live_bytes(0), peak_live_bytes(0) {}
+
+  int64_t allocations_count;          // since the start
+  int64_t live_allocations_count;
+  int64_t live_bytes;
+  int64_t peak_live_bytes;
+};
+
+// what a fixed size pool holds, see FixedPool::GetStats
+struct FixedPoolStats {
+  uint32_t blocks_count;              // allocated
+  uint32_t capacity;                  // blocks of all slabs
+  uint32_t slabs_count;
+  uint32_t empty_slabs_count;         // what Trim frees
+  size_t block_size;
+  size_t reserved_bytes;
+  // the free blocks of slabs holding allocations over the blocks of those
+  // slabs, 0 when the allocations fill the slabs they are in
+  float fragmentation;
+};
+
+static const size_t kDefaultAlignment = 16;
+
+class Allocator {
+ public:
+  Allocator() = default;
+  Allocator(const Allocator&) = delete;
+  Allocator& operator=(const Allocator&) = delete;
+  virtual ~Allocator() = default;
+
+  // alignment a power of two, null if out of memory
+  virtual void* Allocate(size_t size,
+    size_t alignment = kDefaultAlignment) = 0;
+  // memory Allocate returned or null
+  virtual void Free(void* memory) = 0;
+};
+
+// malloc with the tag and size in front of every block. thread safe, the
+// counters are atomic.
+class TaggedHeap {
+ public:
+  static void* Allocate(MemoryTag tag, size_t size,
+    size_t alignment = kDefaultAlignment);
+  // memory Allocate returned or null, the tag is read from its header
+  static void Free(void* memory);
+
+  static MemoryTagStats GetStats(MemoryTag tag);
+  // lower case, for reports
+  static const char* GetTagName(MemoryTag tag);
+};
+
+// the tagged heap as an allocator
+class HeapAllocator : public Allocator {
+ public:
+  explicit HeapAllocator(MemoryTag tag);
+
+  void* Allocate(size_t size, size_t alignment = kDefaultAlignment) final;
+  void Free(void* memory) final;
+
+ private:
+  MemoryTag tag_;
+};
+
+// hands out memory by moving an offset through blocks of the heap, for
+// scratch data of a load. Free does nothing, Reset frees everything at
+// once. not thread safe.
+//
+//   LinearArena arena(MEMORY_TAG_MESH, 1 << 20);
+//   Vertex* vertices = static_cast<Vertex*>(arena.Allocate(size));
+//   ...
+//   arena.Reset();            // vertices and everything else are gone
+class LinearArena : public Allocator {
+ public:
+  LinearArena(MemoryTag tag, size_t block_size);
+  ~LinearArena();
+
+  // larger allocations than the block size get a block of their own
+  void* Allocate(size_t size, size_t alignment = kDefaultAlignment) final;
+  void Free(void* memory) final;
+  // keeps the first block for the next allocations
+  void Reset();
+
+  size_t GetUsedBytes() const;
+  size_t GetReservedBytes() const;
+
+ private:
+  struct Block {
+    char* memory;
+    size_t size;
+  };
+
+  MemoryTag tag_;
+  size_t block_size_;
+  std::vector<Block> blocks_;
+  size_t offset_;                     // in the last block
+  size_t used_bytes_;                 // of the blocks before the last one
+};
+
+// blocks of one size in slabs of the heap, a freed block goes on a free
+// list and is the next one allocated. allocating and freeing is O(1) and
+// only allocates from the heap when every slab is full. the slabs are kept
+// until Trim or the pool is destroyed. thread safe.
+class FixedPool : public Allocator {
+ public:
+  // block_size is rounded up to alignment, a power of two that every block
+  // and slab starts on
+  FixedPool(MemoryTag tag, size_t block_size,
+    size_t alignment = kDefaultAlignment, uint32_t slab_size = 64);
+  ~FixedPool();
+
+  // null for a size above the block size or an alignment above the pool's
+  void* Allocate(size_t size, size_t alignment = kDefaultAlignment) final;
+  // a block of this pool
+  void Free(void* memory) final;
+
+  // one slab with room for count blocks more than there are free, for
+  // allocating many blocks at once
+  void Reserve(uint32_t count);
+  // frees the slabs without allocated blocks
+  void Trim();
+
+  size_t GetBlockSize() const;
+  uint32_t GetBlocksCount() const;
+  uint32_t GetCapacity() const;
+  FixedPoolStats GetStats() const;
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  struct Slab {
+    char* blocks;
+    uint32_t capacity;
+  };
+
+  // the rest of the functions expect mutex_ to be held
+  bool AddSlab(uint32_t capacity);
+  // the free blocks of each slab
+  void CountFreeBlocks(std::vector<uint32_t>* free_counts) const;
+
+  MemoryTag tag_;
+  size_t alignment_;
+  size_t block_size_;
+  uint32_t slab_size_;
+  mutable std::mutex mutex_;
+  std::vector<Slab> slabs_;
+  FreeBlock* free_blocks_;
+  uint32_t free_blocks_count_;
+  uint32_t blocks_count_;
+};
+
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_ALLOCATOR_H_
@@ -0,0 +1,508 @@
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "async_reader.h"
+
+namespace magnet {
+namespace core {
+namespace {
+// reads queued before Submit is called for them
+static const size_t kBatchSize = 32;
+// like archive entries, more than the caches need
+static const size_t kBufferAlignment = 64;
+
+// an uninitialized buffer, the view owns it
+FileView CreateBuffer(size_t size, char** data) {
+  std::shared_ptr<char> buffer(new char[size + kBufferAlignment],
+    std::default_delete<char[]>());
+  const uintptr_t kAddress = reinterpret_cast<uintptr_t>(buffer.get());
+  *data = buffer.get() + ((kBufferAlignment - kAddress % kBufferAlignment) %
+    kBufferAlignment);
+  return FileView(*data, size, std::move(buffer));
+}
+
+bool ReadNative(const std::string& path, FileView* view) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr)
+    return false;
+
+#ifdef _WIN32
+  struct _stat64 status;
+  const bool kHasSize = _fstat64(_fileno(file), &status) == 0;
+#else
+  struct stat status;
+  const bool kHasSize = fstat(fileno(file), &status) == 0;
+#endif
+  bool succeeded = false;
+  if (kHasSize && status.st_size >= 0) {
+    const size_t kSize = static_cast<size_t>(status.st_size);
+    char* data;
+    *view = CreateBuffer(kSize, &data);
+    succeeded = fread(data, 1, kSize, file) == kSize;
+  }
+  fclose(file);
+  if (!succeeded)
+    view->Close();
+  return succeeded;
+}
+}  // namespace
+
+class AsyncReader::Backend {
+ public:
+  virtual ~Backend() {}
+  // takes the requests, requests is left empty
+  virtual void Submit(std::vector<Request>* requests) = 0;
+  virtual void Wait() = 0;
+  virtual bool IsUsingIoUring() const = 0;
+};
+
+namespace {
+// blocking reads on a few threads, enough to keep a disk queue busy
+class ThreadPoolBackend : public AsyncReader::Backend {
+ public:
+  ThreadPoolBackend() : outstanding_(0), stopping_(false) {
+    const int kThreadsCount = std::max(2,
+      std::min(4, static_cast<int>(std::thread::hardware_concurrency())));
+    for (int i = 0; i < kThreadsCount; ++i)
+      threads_.push_back(std::thread(&ThreadPoolBackend::Run, this));
+  }
+
+  ~ThreadPoolBackend() override {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      stopping_ = true;
+    }
+    work_.notify_all();
+    for (std::thread& thread : threads_)
+      thread.join();
+  }
+
+  void Submit(std::vector<AsyncReader::Request>* requests) override {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      for (AsyncReader::Request& request : *requests)
+        queue_.push_back(std::move(request));
+      outstanding_ += requests->size();
+    }
+    requests->clear();
+    work_.notify_all();
+  }
+
+  void Wait() override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return outstanding_ == 0; });
+  }
+
+  bool IsUsingIoUring() const override {
+    return false;
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      work_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      if (queue_.empty())
+        return;
+      AsyncReader::Request request = std::move(queue_.front());
+      queue_.pop_front();
+      lock.unlock();
+
+      FileView file;
+      std::string native_path;
+      bool succeeded = FileSystem::Locate(request.path, &file, &native_path);
+      if (succeeded && !native_path.empty())
+        succeeded = ReadNative(native_path, &file);
+      request.callback(succeeded, file);
+
+      lock.lock();
+      if (--outstanding_ == 0)
+        idle_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable work_;
+  std::condition_variable idle_;
+  std::deque<AsyncReader::Request> queue_;
+  size_t outstanding_;          // queued or being read
+  bool stopping_;
+  std::vector<std::thread> threads_;
+};
+
+#ifdef __linux__
+static const unsigned kEntries = 64;
+// every read in flight has at most one sqe, so the ring never overflows
+static const size_t kMaxInFlight = kEntries;
+// linux transfers at most about 2gb per read
+static const size_t kMaxReadSize = 1 << 30;
+
+// one io_uring driven by raw syscalls, no liburing. the caller thread and
+// the completion thread both fill the submission queue under mutex_, the
+// completion thread alone reaps completions and runs the callbacks.
+//
+// a file is opened and located when it gets a slot in flight, not when it
+// is submitted, so thousands of queued reads do not hold descriptors.
+// archived files and failures go through the ring as a nop, which keeps
+// every callback on the completion thread.
+class UringBackend : public AsyncReader::Backend {
+ public:
+  UringBackend() : ring_fd_(-1), sq_ring_(MAP_FAILED), sq_ring_size_(0),
+    cq_ring_(MAP_FAILED), cq_ring_size_(0), sqes_(MAP_FAILED),
+    sqes_size_(0), in_flight_(0), outstanding_(0) {
+  }
+
+  ~UringBackend() override {
+    if (thread_.joinable()) {
+      Wait();
+      {
+        // user_data 0 stops the completion thread
+        std::lock_guard<std::mutex> guard(mutex_);
+        io_uring_sqe* sqe = GetSqe();
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 0;
+        Flush();
+      }
+      thread_.join();
+    }
+    if (sqes_ != MAP_FAILED)
+      munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+      munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED)
+      munmap(sq_ring_, sq_ring_size_);
+    if (ring_fd_ >= 0)
+      close(ring_fd_);
+  }
+
+  // false if the kernel is too old or io_uring is not permitted, as in
+  // many containers
+  bool Initialize() {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = static_cast<int>(
+      syscall(__NR_io_uring_setup, kEntries, &params));
+    // plain reads need 5.6, which added IORING_FEAT_RW_CUR_POS as well
+    if (ring_fd_ < 0 || (params.features & IORING_FEAT_RW_CUR_POS) == 0)
+      return false;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes +
+      params.cq_entries * sizeof(io_uring_cqe);
+    const bool kSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (kSingleMap)
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED)
+      return false;
+    cq_ring_ = kSingleMap ? sq_ring_ : mmap(nullptr, cq_ring_size_,
+      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+      IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (cq_ring_ == MAP_FAILED || sqes_ == MAP_FAILED)
+      return false;
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    to_submit_ = 0;
+
+    thread_ = std::thread(&UringBackend::Run, this);
+    return true;
+  }
+
+  void Submit(std::vector<AsyncReader::Request>* requests) override {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (AsyncReader::Request& request : *requests)
+      queue_.push_back(std::move(request));
+    outstanding_ += requests->size();
+    requests->clear();
+    Refill();
+  }
+
+  void Wait() override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return outstanding_ == 0; });
+  }
+
+  bool IsUsingIoUring() const override {
+    return true;
+  }
+
+ private:
+  struct Read {
+    AsyncReader::Request request;
+    int fd;
+    char* data;
+    size_t offset;
+    FileView file;
+    bool succeeded;
+  };
+
+  // expects mutex_ to be locked, flushes the queue if it is full
+  io_uring_sqe* GetSqe() {
+    const unsigned kTail = *sq_tail_;
+    if (kTail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+      Flush();
+    const unsigned kIndex = kTail & sq_mask_;
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes_) + kIndex;
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array_[kIndex] = kIndex;
+    __atomic_store_n(sq_tail_, kTail + 1, __ATOMIC_RELEASE);
+    ++to_submit_;
+    return sqe;
+  }
+
+  // expects mutex_ to be locked. hands the new sqes to the kernel.
+  void Flush() {
+    while (to_submit_ > 0) {
+      const int kResult = static_cast<int>(syscall(__NR_io_uring_enter,
+        ring_fd_, to_submit_, 0, 0, nullptr, 0));
+      if (kResult >= 0)
+        to_submit_ -= static_cast<unsigned>(kResult);
+      else if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        return;
+    }
+  }
+
+  void WaitForCompletion() {
+    while (syscall(__NR_io_uring_enter, ring_fd_, 0, 1,
+      IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno == EINTR) {
+    }
+  }
+
+  // expects mutex_ to be locked
+  void PrepareRead(Read* read) {
+    io_uring_sqe* sqe = GetSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = read->fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(read->data + read->offset);
+    sqe->len = static_cast<unsigned>(
+      std::min(read->file.GetSize() - read->offset, kMaxReadSize));
+    sqe->off = read->offset;
+    sqe->user_data = reinterpret_cast<uintptr_t>(read);
+  }
+
+  // expects mutex_ to be locked. starts queued reads while there are
+  // slots in flight.
+  void Refill() {
+    while (in_flight_ < kMaxInFlight && !queue_.empty()) {
+      Read* read = new Read();
+      read->request = std::move(queue_.front());
+      queue_.pop_front();
+      read->fd = -1;
+      read->data = nullptr;
+      read->offset = 0;
+      ++in_flight_;
+
+      std::string native_path;
+      read->succeeded = FileSystem::Locate(read->request.path, &read->file,
+        &native_path);
+      if (read->succeeded && !native_path.empty())
+        read->succeeded = Open(native_path, read);
+
+      if (read->fd >= 0) {
+        PrepareRead(read);
+      }
+      else {
+        io_uring_sqe* sqe = GetSqe();
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = reinterpret_cast<uintptr_t>(read);
+      }
+    }
+    Flush();
+  }
+
+  // empty files need no read, they are left without a descriptor
+  bool Open(const std::string& path, Read* read) {
+    const int kFd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat status;
+    if (kFd < 0 || fstat(kFd, &status) != 0 || status.st_size < 0) {
+      if (kFd >= 0)
+        close(kFd);
+      return false;
+    }
+    read->file = CreateBuffer(static_cast<size_t>(status.st_size),
+      &read->data);
+    if (status.st_size > 0)
+      read->fd = kFd;
+    else
+      close(kFd);
+    return true;
+  }
+
+  void Run() {
+    std::vector<io_uring_cqe> completions;
+    std::vector<Read*> finished;
+    bool stopping = false;
+    while (!stopping) {
+      WaitForCompletion();
+
+      // the cq is only read here
+      completions.clear();
+      unsigned head = *cq_head_;
+      const unsigned kTail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      for (; head != kTail; ++head)
+        completions.push_back(cqes_[head & cq_mask_]);
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+      finished.clear();
+      std::vector<Read*> continued;
+      for (const io_uring_cqe& completion : completions) {
+        Read* read = reinterpret_cast<Read*>(
+          static_cast<uintptr_t>(completion.user_data));
+        if (read == nullptr) {
+          stopping = true;
+          continue;
+        }
+        if (read->fd >= 0) {
+          if (completion.res == -EINTR || completion.res == -EAGAIN) {
+            continued.push_back(read);
+            continue;
+          }
+          // a file shrinking while it is read fails as well
+          if (completion.res <= 0) {
+            read->succeeded = false;
+          }
+          else {
+            read->offset += static_cast<size_t>(completion.res);
+            if (read->offset < read->file.GetSize()) {
+              continued.push_back(read);
+              continue;
+            }
+          }
+          close(read->fd);
+          read->fd = -1;
+        }
+        finished.push_back(read);
+      }
+
+      if (!continued.empty() || !finished.empty()) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        in_flight_ -= finished.size();
+        for (Read* read : continued)
+          PrepareRead(read);
+        Refill();
+      }
+
+      for (Read* read : finished) {
+        if (!read->succeeded)
+          read->file.Close();
+        read->request.callback(read->succeeded, read->file);
+        delete read;
+      }
+      if (!finished.empty()) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        outstanding_ -= finished.size();
+        if (outstanding_ == 0)
+          idle_.notify_all();
+      }
+    }
+  }
+
+  int ring_fd_;
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  void* sqes_;
+  size_t sqes_size_;
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe* cqes_;
+  unsigned to_submit_;          // sqes the kernel has not taken yet
+
+  std::mutex mutex_;
+  std::condition_variable idle_;
+  std::deque<AsyncReader::Request> queue_;
+  size_t in_flight_;            // reads holding a slot
+  size_t outstanding_;          // queued, in flight or in a callback
+  std::thread thread_;
+};
+#endif
+}  // namespace
+
+AsyncReader::AsyncReader(AsyncReaderBackend backend) {
+#ifdef __linux__
+  if (backend == ASYNC_READER_DEFAULT) {
+    std::unique_ptr<UringBackend> uring(new UringBackend());
+    if (uring->Initialize())
+      backend_ = std::move(uring);
+  }
+#endif
+  if (!backend_)
+    backend_.reset(new ThreadPoolBackend());
+}
+
+AsyncReader::~AsyncReader() {
+  Wait();
+}
+
+void AsyncReader::Read(const std::string& path, const Callback& callback) {
+  Request request;
+  request.path = path;
+  request.callback = callback;
+  pending_.push_back(std::move(request));
+  if (pending_.size() >= kBatchSize)
+    Submit();
+}
+
+std::future<FileView> AsyncReader::Read(const std::string& path) {
+  std::shared_ptr<std::promise<FileView>> promise =
+    std::make_shared<std::promise<FileView>>();
+  std::future<FileView> future = promise->get_future();
+  Read(path, [promise](bool succeeded, const FileView& file) {
+    promise->set_value(succeeded ? file : FileView());
+  });
+  return future;
+}
+
+void AsyncReader::Submit() {
+  if (!pending_.empty())
+    backend_->Submit(&pending_);
+}
+
+void AsyncReader::Wait() {
+  Submit();
+  backend_->Wait();
+}
+
+bool AsyncReader::IsUsingIoUring() const {
+  return backend_->IsUsingIoUring();
+}
+}  // namespace core
+}  // namespace magnet
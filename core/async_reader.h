@@ -0,0 +1,66 @@
+#ifndef MAGNET_CORE_ASYNC_READER_H_
+#define MAGNET_CORE_ASYNC_READER_H_
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "file_system.h"
+
+namespace magnet {
+namespace core {
+enum AsyncReaderBackend {
+  ASYNC_READER_DEFAULT,       // io_uring where the kernel allows it
+  ASYNC_READER_THREAD_POOL
+};
+
+// reads whole files through the FileSystem into memory without blocking
+// the caller, so loaders keep many reads in flight instead of waiting on
+// disk latency one file at a time.
+//
+// reads are queued by Read and handed over together by Submit, or once a
+// batch is full. on linux they go to the kernel through one io_uring,
+// elsewhere, or where io_uring is not permitted, a few threads read with
+// blocking calls. archived files need no io and complete right away.
+//
+// callbacks run on a reader thread, never inside Read or Submit, so the
+// caller may hold its own locks around those. they should hand heavy work
+// on to other threads. Read and Submit are called by one thread at a time.
+class AsyncReader {
+ public:
+  // succeeded is false if the file is missing or could not be read
+  typedef std::function<void(bool succeeded, const FileView& file)> Callback;
+
+  explicit AsyncReader(AsyncReaderBackend backend = ASYNC_READER_DEFAULT);
+  // waits for the reads in flight
+  ~AsyncReader();
+  AsyncReader(const AsyncReader&) = delete;
+  AsyncReader& operator=(const AsyncReader&) = delete;
+
+  void Read(const std::string& path, const Callback& callback);
+  // the file, or a view that is not open if the read failed
+  std::future<FileView> Read(const std::string& path);
+  void Submit();
+
+  // submits and returns when every read finished and its callback ran
+  void Wait();
+
+  bool IsUsingIoUring() const;
+
+  struct Request {
+    std::string path;
+    Callback callback;
+  };
+
+  // io_uring or the thread pool, in async_reader.cpp
+  class Backend;
+
+ private:
+  std::unique_ptr<Backend> backend_;
+  std::vector<Request> pending_;
+};
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_ASYNC_READER_H_
@@ -0,0 +1,230 @@
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <mutex>
+#include <vector>
+
+#include "file_system.h"
+#include "mapped_file.h"
+#include "pack_archive.h"
+
+namespace magnet {
+namespace core {
+namespace {
+struct Mount {
+  std::string point;            // normalized, ends with '/' unless empty
+  std::string folder_path;
+  std::shared_ptr<PackArchive> archive;
+};
+
+struct MountTable {
+  std::vector<Mount> mounts;
+  std::mutex mutex;
+};
+
+MountTable& GetMountTable() {
+  static MountTable table;
+  return table;
+}
+
+// a copy, so files are opened without holding the lock
+std::vector<Mount> GetMounts() {
+  MountTable& table = GetMountTable();
+  std::lock_guard<std::mutex> guard(table.mutex);
+  return table.mounts;
+}
+
+void AddMount(Mount mount) {
+  mount.point = PackArchive::NormalizeName(mount.point);
+  if (!mount.point.empty() && mount.point.back() != '/')
+    mount.point += '/';
+  MountTable& table = GetMountTable();
+  std::lock_guard<std::mutex> guard(table.mutex);
+  table.mounts.push_back(std::move(mount));
+}
+
+bool IsAbsolute(const std::string& path) {
+  return (!path.empty() && (path[0] == '/' || path[0] == '\\')) ||
+    (path.size() > 1 && path[1] == ':');
+}
+
+// the part of path below the mount point, false if it is not below it
+bool GetRelativePath(const Mount& mount, const std::string& path,
+  const std::string& normalized_path, std::string* relative_path) {
+  if (normalized_path.compare(0, mount.point.size(), mount.point) != 0)
+    return false;
+  *relative_path = path.substr(mount.point.size());
+  return true;
+}
+
+bool IsFile(const std::string& path) {
+#ifdef _WIN32
+  struct _stat64 status;
+  return _stat64(path.c_str(), &status) == 0 &&
+    (status.st_mode & _S_IFREG) != 0;
+#else
+  struct stat status;
+  return stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode);
+#endif
+}
+
+bool OpenNative(const std::string& path, const char** data, size_t* size,
+  std::shared_ptr<const void>* owner) {
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+  if (!file->Open(path))
+    return false;
+  *data = file->GetData();
+  *size = file->GetSize();
+  *owner = file;
+  return true;
+}
+
+bool OpenEntry(const std::shared_ptr<PackArchive>& archive, int index,
+  const char** data, size_t* size, std::shared_ptr<const void>* owner) {
+  *size = archive->GetEntrySize(index);
+  if (!archive->IsEntryCompressed(index)) {
+    *data = archive->GetEntryData(index);
+    *owner = archive;
+    return true;
+  }
+
+  std::shared_ptr<std::vector<char>> buffer =
+    std::make_shared<std::vector<char>>(*size);
+  if (!archive->ReadEntry(index, buffer->data()))
+    return false;
+  *data = buffer->data();
+  *owner = buffer;
+  return true;
+}
+}  // namespace
+
+FileView::FileView() : data_(nullptr), size_(0) {
+}
+
+FileView::FileView(const char* data, size_t size,
+  std::shared_ptr<const void> owner) : data_(data), size_(size),
+  owner_(std::move(owner)) {
+}
+
+bool FileView::IsOpen() const {
+  return owner_ != nullptr;
+}
+
+const char* FileView::GetData() const {
+  return data_;
+}
+
+size_t FileView::GetSize() const {
+  return size_;
+}
+
+const std::shared_ptr<const void>& FileView::GetOwner() const {
+  return owner_;
+}
+
+void FileView::Close() {
+  data_ = nullptr;
+  size_ = 0;
+  owner_.reset();
+}
+
+void FileSystem::MountFolder(const std::string& mount_point,
+  const std::string& folder_path) {
+  Mount mount;
+  mount.point = mount_point;
+  mount.folder_path = folder_path;
+  if (!folder_path.empty() && folder_path.back() != '/' &&
+    folder_path.back() != '\\') {
+    mount.folder_path += '/';
+  }
+  AddMount(std::move(mount));
+}
+
+bool FileSystem::MountArchive(const std::string& mount_point,
+  const std::string& archive_path) {
+  Mount mount;
+  mount.point = mount_point;
+  mount.archive = std::make_shared<PackArchive>();
+  if (!mount.archive->Open(archive_path))
+    return false;
+  AddMount(std::move(mount));
+  return true;
+}
+
+void FileSystem::UnmountAll() {
+  MountTable& table = GetMountTable();
+  std::lock_guard<std::mutex> guard(table.mutex);
+  table.mounts.clear();
+}
+
+bool FileSystem::Open(const std::string& path, FileView* view) {
+  view->Close();
+  if (!IsAbsolute(path)) {
+    const std::vector<Mount> kMounts = GetMounts();
+    const std::string kNormalizedPath = PackArchive::NormalizeName(path);
+    std::string relative_path;
+    for (auto mount = kMounts.rbegin(); mount != kMounts.rend(); ++mount) {
+      if (!GetRelativePath(*mount, path, kNormalizedPath, &relative_path))
+        continue;
+      if (mount->archive) {
+        const int kIndex = mount->archive->Find(relative_path);
+        if (kIndex >= 0 && OpenEntry(mount->archive, kIndex, &view->data_,
+          &view->size_, &view->owner_)) {
+          return true;
+        }
+      }
+      else if (OpenNative(mount->folder_path + relative_path, &view->data_,
+        &view->size_, &view->owner_)) {
+        return true;
+      }
+    }
+  }
+  return OpenNative(path, &view->data_, &view->size_, &view->owner_);
+}
+
+bool FileSystem::Locate(const std::string& path, FileView* archived,
+  std::string* native_path) {
+  archived->Close();
+  native_path->clear();
+  if (!IsAbsolute(path)) {
+    const std::vector<Mount> kMounts = GetMounts();
+    const std::string kNormalizedPath = PackArchive::NormalizeName(path);
+    std::string relative_path;
+    for (auto mount = kMounts.rbegin(); mount != kMounts.rend(); ++mount) {
+      if (!GetRelativePath(*mount, path, kNormalizedPath, &relative_path))
+        continue;
+      if (mount->archive) {
+        const int kIndex = mount->archive->Find(relative_path);
+        if (kIndex >= 0 && OpenEntry(mount->archive, kIndex,
+          &archived->data_, &archived->size_, &archived->owner_)) {
+          return true;
+        }
+      }
+      else if (IsFile(mount->folder_path + relative_path)) {
+        *native_path = mount->folder_path + relative_path;
+        return true;
+      }
+    }
+  }
+  if (!IsFile(path))
+    return false;
+  *native_path = path;
+  return true;
+}
+
+std::string FileSystem::GetNativePath(const std::string& path) {
+  if (IsAbsolute(path))
+    return path;
+
+  const std::vector<Mount> kMounts = GetMounts();
+  const std::string kNormalizedPath = PackArchive::NormalizeName(path);
+  std::string relative_path;
+  for (auto mount = kMounts.rbegin(); mount != kMounts.rend(); ++mount) {
+    if (!mount->archive &&
+      GetRelativePath(*mount, path, kNormalizedPath, &relative_path)) {
+      return mount->folder_path + relative_path;
+    }
+  }
+  return path;
+}
+}  // namespace core
+}  // namespace magnet
@@ -0,0 +1,65 @@
+#ifndef MAGNET_CORE_FILE_SYSTEM_H_
+#define MAGNET_CORE_FILE_SYSTEM_H_
+
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+namespace magnet {
+namespace core {
+// read only bytes of a file, wherever they live: a mapped loose file, an
+// entry inside a mapped archive or a buffer it was decompressed into.
+// copies share the bytes, which stay valid as long as one copy or the
+// owner handed to a texture or mesh exists.
+class FileView {
+ public:
+  FileView();
+  // bytes read elsewhere, e.g. by AsyncReader, alive as long as owner
+  FileView(const char* data, size_t size, std::shared_ptr<const void> owner);
+
+  bool IsOpen() const;
+  const char* GetData() const;
+  size_t GetSize() const;
+  const std::shared_ptr<const void>& GetOwner() const;
+  void Close();
+
+ private:
+  friend class FileSystem;
+
+  const char* data_;
+  size_t size_;
+  std::shared_ptr<const void> owner_;
+};
+
+// the virtual file system assets are read through. folders and packed
+// archives are mounted at virtual paths like "mesh/", the last mount
+// covering a path is searched first and the earlier ones after it, so an
+// archive mounted over the data folder wins but loose files still fill
+// in. absolute paths and paths no mount knows are opened from disk, so
+// tools and benchmarks work without mounting anything.
+//
+// mounts are meant to be set up before loading starts, opens may run on
+// any thread.
+class FileSystem {
+ public:
+  static void MountFolder(const std::string& mount_point,
+    const std::string& folder_path);
+  // fails if the archive is missing or damaged
+  static bool MountArchive(const std::string& mount_point,
+    const std::string& archive_path);
+  static void UnmountAll();
+
+  static bool Open(const std::string& path, FileView* view);
+  // like Open, except loose files are only found, not opened: archived
+  // files come back in archived, loose ones as a native_path to read.
+  // false if neither exists.
+  static bool Locate(const std::string& path, FileView* archived,
+    std::string* native_path);
+
+  // where a file at path is written, in the last mounted folder covering
+  // it. archives are read only.
+  static std::string GetNativePath(const std::string& path);
+};
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_FILE_SYSTEM_H_
@@ -0,0 +1,192 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "half.h"
+#include "simd.h"
+
+#ifdef MAGNET_SSE2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif  // MAGNET_SSE2
+
+namespace magnet {
+namespace core {
+namespace {
+static const float kMaxRgb9e5 = 65408.f;    // 511 / 512 * 2^16
+
+inline uint32_t GetBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline float GetFloat(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+#ifdef MAGNET_SSE2
+bool DetectF16c() {
+  unsigned int registers[4] = { 0, 0, 0, 0 };
+#ifdef _MSC_VER
+  __cpuid(reinterpret_cast<int*>(registers), 1);
+#else
+  if (!__get_cpuid(1, &registers[0], &registers[1], &registers[2],
+    &registers[3])) {
+    return false;
+  }
+#endif
+  const unsigned int kF16c = 1u << 29;
+  const unsigned int kOsxsave = 1u << 27;
+  if ((registers[2] & kF16c) == 0 || (registers[2] & kOsxsave) == 0)
+    return false;
+
+  // f16c is vex encoded, the os has to save the avx registers
+#ifdef _MSC_VER
+  const unsigned long long kXcr0 = _xgetbv(0);
+#else
+  unsigned int low;
+  unsigned int high;
+  __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+  const unsigned long long kXcr0 = low;
+#endif
+  return (kXcr0 & 6) == 6;
+}
+
+MAGNET_TARGET("f16c")
+void FloatToHalfF16c(const float* values, size_t count, uint16_t* halves) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i kLow = _mm_cvtps_ph(_mm_loadu_ps(values + i),
+      _MM_FROUND_TO_NEAREST_INT);
+    const __m128i kHigh = _mm_cvtps_ph(_mm_loadu_ps(values + i + 4),
+      _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(halves + i),
+      _mm_unpacklo_epi64(kLow, kHigh));
+  }
+  for (; i < count; ++i)
+    halves[i] = FloatToHalf(values[i]);
+}
+
+MAGNET_TARGET("f16c")
+void HalfToFloatF16c(const uint16_t* halves, size_t count, float* values) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i kHalves =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(halves + i));
+    _mm_storeu_ps(values + i, _mm_cvtph_ps(kHalves));
+    _mm_storeu_ps(values + i + 4, _mm_cvtph_ps(_mm_srli_si128(kHalves, 8)));
+  }
+  for (; i < count; ++i)
+    values[i] = HalfToFloat(halves[i]);
+}
+#endif  // MAGNET_SSE2
+}  // namespace
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits = GetBits(value);
+  const uint32_t kSign = (bits >> 16) & 0x8000;
+  bits &= 0x7fffffff;
+
+  uint32_t half;
+  if (bits >= 0x47800000) {
+    // 65536 and up, infinity or nan
+    half = bits > 0x7f800000 ? 0x7e00 : 0x7c00;
+  }
+  else if (bits < 0x38800000) {
+    // subnormal or zero, adding 0.5 lines the mantissa up with the half
+    // subnormal one and the fpu rounds it
+    half = GetBits(GetFloat(bits) + 0.5f) - 0x3f000000;
+  }
+  else {
+    // rebias the exponent and round the dropped 13 bits to nearest even,
+    // a carry into the exponent is right and gives infinity past 65504
+    bits += 0xc8000fff + ((bits >> 13) & 1);
+    half = bits >> 13;
+  }
+  return static_cast<uint16_t>(half | kSign);
+}
+
+float HalfToFloat(uint16_t half) {
+  const uint32_t kShiftedExponent = 0x7c00 << 13;
+  uint32_t bits = (half & 0x7fff) << 13;
+  const uint32_t kExponent = bits & kShiftedExponent;
+  bits += (127 - 15) << 23;
+  if (kExponent == kShiftedExponent) {
+    bits += (128 - 16) << 23;
+  }
+  else if (kExponent == 0) {
+    // subnormal, renormalized by the fpu
+    bits = GetBits(GetFloat(bits + (1 << 23)) - GetFloat(113 << 23));
+  }
+  return GetFloat(bits | (static_cast<uint32_t>(half & 0x8000) << 16));
+}
+
+void FloatToHalf(const float* values, size_t count, uint16_t* halves) {
+#ifdef MAGNET_SSE2
+  if (HasF16c()) {
+    FloatToHalfF16c(values, count, halves);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < count; ++i)
+    halves[i] = FloatToHalf(values[i]);
+}
+
+void HalfToFloat(const uint16_t* halves, size_t count, float* values) {
+#ifdef MAGNET_SSE2
+  if (HasF16c()) {
+    HalfToFloatF16c(halves, count, values);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < count; ++i)
+    values[i] = HalfToFloat(halves[i]);
+}
+
+uint32_t FloatToRgb9e5(float red, float green, float blue) {
+  // written as > so nans fail it
+  const float kRed = red > 0.f ? std::min(red, kMaxRgb9e5) : 0.f;
+  const float kGreen = green > 0.f ? std::min(green, kMaxRgb9e5) : 0.f;
+  const float kBlue = blue > 0.f ? std::min(blue, kMaxRgb9e5) : 0.f;
+  const float kMax = std::max(kRed, std::max(kGreen, kBlue));
+
+  // the shared exponent fits the largest channel in 9 bits, one more if
+  // its mantissa rounds up to 512
+  const int kFloorLog2 = static_cast<int>((GetBits(kMax) >> 23) & 0xff) - 127;
+  int exponent = std::max(-16, kFloorLog2) + 1 + 15;
+  float scale = ldexpf(1.f, 9 + 15 - exponent);
+  if (static_cast<int>(kMax * scale + 0.5f) == 512) {
+    scale *= 0.5f;
+    ++exponent;
+  }
+
+  const uint32_t kRedMantissa = static_cast<uint32_t>(kRed * scale + 0.5f);
+  const uint32_t kGreenMantissa =
+    static_cast<uint32_t>(kGreen * scale + 0.5f);
+  const uint32_t kBlueMantissa = static_cast<uint32_t>(kBlue * scale + 0.5f);
+  return kRedMantissa | (kGreenMantissa << 9) | (kBlueMantissa << 18) |
+    (static_cast<uint32_t>(exponent) << 27);
+}
+
+void FloatToRgb9e5(const float* texels, size_t count, uint32_t* packed) {
+  for (size_t i = 0; i < count; ++i, texels += 4)
+    packed[i] = FloatToRgb9e5(texels[0], texels[1], texels[2]);
+}
+
+bool HasF16c() {
+#ifdef MAGNET_SSE2
+  static const bool kHasF16c = DetectF16c();
+  return kHasF16c;
+#else
+  return false;
+#endif
+}
+}  // namespace core
+}  // namespace magnet
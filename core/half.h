@@ -0,0 +1,28 @@
+#ifndef MAGNET_CORE_HALF_H_
+#define MAGNET_CORE_HALF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace magnet {
+namespace core {
+// ieee 754 half floats. rounding is to nearest even like the gpu and the
+// f16c instructions, values past 65504 become infinity and nans stay nans.
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t half);
+
+// count values at once. uses f16c where the cpu has it, checked once, and
+// a scalar loop with the same results elsewhere.
+void FloatToHalf(const float* values, size_t count, uint16_t* halves);
+void HalfToFloat(const uint16_t* halves, size_t count, float* values);
+
+// r9g9b9e5_sharedexp, three 9 bit mantissas with a shared 5 bit exponent.
+// negative values and nans become 0, values past 65408 are clamped.
+uint32_t FloatToRgb9e5(float red, float green, float blue);
+// rgba texels, the alpha is dropped
+void FloatToRgb9e5(const float* texels, size_t count, uint32_t* packed);
+
+bool HasF16c();
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_HALF_H_
@@ -0,0 +1,59 @@
+#include "handle_allocator.h"
+
+namespace magnet {
+namespace core {
+HandleAllocator::HandleAllocator() : count_(0) {
+}
+
+Handle HandleAllocator::Allocate() {
+  uint32_t index;
+  if (!free_indices_.empty()) {
+    index = free_indices_.back();
+    free_indices_.pop_back();
+  }
+  else {
+    // kMaxHandlesCount itself is the index of kInvalidHandle
+    if (generations_.size() >= kMaxHandlesCount)
+      return kInvalidHandle;
+    index = static_cast<uint32_t>(generations_.size());
+    generations_.push_back(0);
+    used_.push_back(0);
+  }
+  used_[index] = 1;
+  ++count_;
+  return (generations_[index] << kHandleIndexBits) | index;
+}
+
+bool HandleAllocator::Free(Handle handle) {
+  if (!IsValid(handle))
+    return false;
+  const uint32_t kIndex = GetIndex(handle);
+  used_[kIndex] = 0;
+  --count_;
+  if (++generations_[kIndex] < kGenerationsCount)
+    free_indices_.push_back(kIndex);
+  return true;
+}
+
+bool HandleAllocator::IsValid(Handle handle) const {
+  const uint32_t kIndex = GetIndex(handle);
+  return kIndex < generations_.size() && used_[kIndex] &&
+    generations_[kIndex] == handle >> kHandleIndexBits;
+}
+
+void HandleAllocator::Clear() {
+  for (uint32_t index = 0; index < generations_.size(); ++index) {
+    if (used_[index])
+      Free((generations_[index] << kHandleIndexBits) | index);
+  }
+}
+
+uint32_t HandleAllocator::GetSlotsCount() const {
+  return static_cast<uint32_t>(generations_.size());
+}
+
+uint32_t HandleAllocator::GetCount() const {
+  return count_;
+}
+}  // namespace core
+}  // namespace magnet
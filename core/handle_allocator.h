@@ -0,0 +1,51 @@
+#ifndef MAGNET_CORE_HANDLE_ALLOCATOR_H_
+#define MAGNET_CORE_HANDLE_ALLOCATOR_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace magnet {
+namespace core {
+// the low kHandleIndexBits of a handle index a slot, the bits above are the
+// generation of the slot, counted up every time it is freed. a handle kept
+// past Free no longer matches its slot and is found stale.
+typedef uint32_t Handle;
+static const Handle kInvalidHandle = 0xffffffff;
+static const int kHandleIndexBits = 20;
+static const uint32_t kMaxHandlesCount = (1u << kHandleIndexBits) - 1;
+
+// hands out handles in O(1), freed slots are reused last in first out. a
+// slot whose generation would wrap around is not reused again, so a stale
+// handle never becomes valid.
+class HandleAllocator {
+ public:
+  HandleAllocator();
+
+  // kInvalidHandle once kMaxHandlesCount slots are in use
+  Handle Allocate();
+  // false for a stale or invalid handle
+  bool Free(Handle handle);
+  bool IsValid(Handle handle) const;
+  // frees every handle
+  void Clear();
+
+  static uint32_t GetIndex(Handle handle);
+  // slots ever used, every index is below it
+  uint32_t GetSlotsCount() const;
+  uint32_t GetCount() const;
+
+ private:
+  static const uint32_t kGenerationsCount = 1u << (32 - kHandleIndexBits);
+
+  std::vector<uint32_t> generations_;
+  std::vector<uint8_t> used_;
+  std::vector<uint32_t> free_indices_;
+  uint32_t count_;
+};
+
+inline uint32_t HandleAllocator::GetIndex(Handle handle) {
+  return handle & kMaxHandlesCount;
+}
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_HANDLE_ALLOCATOR_H_
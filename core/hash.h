@@ -0,0 +1,14 @@
+#ifndef MAGNET_CORE_HASH_H_
+#define MAGNET_CORE_HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace magnet {
+namespace core {
+// 64 bit xxhash of a byte range, fast enough to key caches on whole source
+// files. the result does not depend on the platform.
+uint64_t Hash64(const void* data, size_t size, uint64_t seed = 0);
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_HASH_H_
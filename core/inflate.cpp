@@ -0,0 +1,399 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "inflate.h"
+
+namespace magnet {
+namespace core {
+namespace {
+static const int kMaxBits = 15;
+static const int kFastBits = 10;
+static const int kLiteralLengthCodes = 288;
+static const int kDistanceCodes = 32;
+static const int kCodeLengthCodes = 19;
+
+static const uint16_t kLengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t kLengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t kDistanceBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+  8193, 12289, 16385, 24577 };
+static const uint8_t kDistanceExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const uint8_t kCodeLengthOrder[kCodeLengthCodes] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// canonical huffman code. codes up to kFastBits long are found with one
+// lookup of the next input bits, longer ones are decoded bit by bit.
+struct Huffman {
+  uint16_t fast[1 << kFastBits];    // symbol << 4 | length, 0 if longer
+  uint16_t counts[kMaxBits + 1];
+  uint16_t symbols[kLiteralLengthCodes];
+};
+
+// lsb first bit buffer over the input. reading past the end yields zeros,
+// overread counts them so a truncated stream is detected.
+class BitReader {
+ public:
+  BitReader(const uint8_t* data, size_t size)
+    : p_(data), end_(data + size), bits_(0), count_(0), overread_(0) {}
+
+  void Refill() {
+    if (end_ - p_ >= 8) {
+      uint64_t word;
+      memcpy(&word, p_, sizeof(word));
+      bits_ |= word << count_;
+      p_ += (63 - count_) >> 3;
+      count_ |= 56;
+      return;
+    }
+    while (count_ <= 56) {
+      if (p_ < end_)
+        bits_ |= static_cast<uint64_t>(*p_++) << count_;
+      else
+        ++overread_;
+      count_ += 8;
+    }
+  }
+
+  // n <= 32, the buffer has to hold n bits
+  uint32_t Peek(int n) const {
+    return static_cast<uint32_t>(bits_ & ((static_cast<uint64_t>(1) << n) - 1));
+  }
+
+  void Consume(int n) {
+    bits_ >>= n;
+    count_ -= n;
+  }
+
+  uint32_t Read(int n) {
+    if (count_ < n)
+      Refill();
+    const uint32_t value = Peek(n);
+    Consume(n);
+    return value;
+  }
+
+  void AlignToByte() {
+    Consume(count_ & 7);
+  }
+
+  // stored blocks, the buffer is drained before reading from the input
+  bool CopyBytes(uint8_t* output, size_t size) {
+    while (size > 0 && count_ >= 8) {
+      *output++ = static_cast<uint8_t>(bits_);
+      Consume(8);
+      --size;
+    }
+    if (IsOverrun())
+      return false;
+    if (size > 0) {
+      // buffered bits past count_ belong to the input at p_
+      bits_ = 0;
+      count_ = 0;
+      if (overread_ > 0 || static_cast<size_t>(end_ - p_) < size)
+        return false;
+      memcpy(output, p_, size);
+      p_ += size;
+    }
+    return true;
+  }
+
+  // true if bits past the end of the input were consumed
+  bool IsOverrun() const {
+    return overread_ * 8 > count_;
+  }
+
+  int GetCount() const { return count_; }
+
+ private:
+  const uint8_t* p_;
+  const uint8_t* end_;
+  uint64_t bits_;
+  int count_;
+  int overread_;
+};
+
+uint32_t ReverseBits(uint32_t code, int length) {
+  uint32_t reversed = 0;
+  for (int i = 0; i < length; ++i) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  return reversed;
+}
+
+// incomplete codes are allowed as deflate encoders write them for a single
+// used distance, over subscribed ones are not
+bool BuildHuffman(const uint8_t* lengths, int count, Huffman* huffman) {
+  memset(huffman->counts, 0, sizeof(huffman->counts));
+  for (int i = 0; i < count; ++i)
+    ++huffman->counts[lengths[i]];
+  huffman->counts[0] = 0;
+
+  int left = 1;
+  for (int length = 1; length <= kMaxBits; ++length) {
+    left = (left << 1) - huffman->counts[length];
+    if (left < 0)
+      return false;
+  }
+
+  uint16_t offsets[kMaxBits + 2];
+  offsets[1] = 0;
+  for (int length = 1; length <= kMaxBits; ++length)
+    offsets[length + 1] = offsets[length] + huffman->counts[length];
+  for (int i = 0; i < count; ++i) {
+    if (lengths[i] != 0)
+      huffman->symbols[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+  }
+
+  // canonical codes in symbol order, reversed as the stream is lsb first
+  memset(huffman->fast, 0, sizeof(huffman->fast));
+  uint32_t next_code[kMaxBits + 1];
+  uint32_t code = 0;
+  next_code[0] = 0;
+  for (int length = 1; length <= kMaxBits; ++length) {
+    code = (code + huffman->counts[length - 1]) << 1;
+    next_code[length] = code;
+  }
+  for (int i = 0; i < count; ++i) {
+    const int length = lengths[i];
+    if (length == 0)
+      continue;
+    const uint32_t symbol_code = next_code[length]++;
+    if (length > kFastBits)
+      continue;
+    const uint16_t entry = static_cast<uint16_t>((i << 4) | length);
+    for (uint32_t j = ReverseBits(symbol_code, length); j < (1u << kFastBits);
+      j += 1u << length) {
+      huffman->fast[j] = entry;
+    }
+  }
+  return true;
+}
+
+int DecodeSlow(BitReader* reader, const Huffman& huffman) {
+  int code = 0;
+  int first = 0;
+  int index = 0;
+  for (int length = 1; length <= kMaxBits; ++length) {
+    code |= reader->Read(1);
+    const int count = huffman.counts[length];
+    if (code - count < first)
+      return huffman.symbols[index + (code - first)];
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+inline int Decode(BitReader* reader, const Huffman& huffman) {
+  if (reader->GetCount() < kMaxBits)
+    reader->Refill();
+  const uint16_t entry = huffman.fast[reader->Peek(kFastBits)];
+  if (entry != 0) {
+    reader->Consume(entry & 15);
+    return entry >> 4;
+  }
+  return DecodeSlow(reader, huffman);
+}
+
+bool BuildFixedHuffman(Huffman* literal_length, Huffman* distance) {
+  uint8_t lengths[kLiteralLengthCodes];
+  int i = 0;
+  for (; i < 144; ++i) lengths[i] = 8;
+  for (; i < 256; ++i) lengths[i] = 9;
+  for (; i < 280; ++i) lengths[i] = 7;
+  for (; i < kLiteralLengthCodes; ++i) lengths[i] = 8;
+  if (!BuildHuffman(lengths, kLiteralLengthCodes, literal_length))
+    return false;
+
+  for (i = 0; i < kDistanceCodes; ++i) lengths[i] = 5;
+  return BuildHuffman(lengths, kDistanceCodes, distance);
+}
+
+bool ReadDynamicHuffman(BitReader* reader, Huffman* literal_length,
+  Huffman* distance) {
+  const int kLiteralLengthCount = reader->Read(5) + 257;
+  const int kDistanceCount = reader->Read(5) + 1;
+  const int kCodeLengthCount = reader->Read(4) + 4;
+  if (kLiteralLengthCount > 286 || kDistanceCount > 30)
+    return false;
+
+  uint8_t lengths[kLiteralLengthCodes + kDistanceCodes];
+  memset(lengths, 0, kCodeLengthCodes);
+  for (int i = 0; i < kCodeLengthCount; ++i)
+    lengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(reader->Read(3));
+
+  Huffman code_length;
+  if (!BuildHuffman(lengths, kCodeLengthCodes, &code_length))
+    return false;
+
+  const int kLengthsCount = kLiteralLengthCount + kDistanceCount;
+  int index = 0;
+  while (index < kLengthsCount) {
+    const int symbol = Decode(reader, code_length);
+    if (symbol < 0)
+      return false;
+    if (symbol < 16) {
+      lengths[index++] = static_cast<uint8_t>(symbol);
+      continue;
+    }
+
+    uint8_t value = 0;
+    int repeat;
+    if (symbol == 16) {
+      if (index == 0)
+        return false;
+      value = lengths[index - 1];
+      repeat = 3 + reader->Read(2);
+    }
+    else if (symbol == 17) {
+      repeat = 3 + reader->Read(3);
+    }
+    else {
+      repeat = 11 + reader->Read(7);
+    }
+    if (index + repeat > kLengthsCount)
+      return false;
+    memset(lengths + index, value, repeat);
+    index += repeat;
+  }
+
+  // a block without an end of block code can not end
+  if (lengths[256] == 0)
+    return false;
+
+  return BuildHuffman(lengths, kLiteralLengthCount, literal_length) &&
+    BuildHuffman(lengths + kLiteralLengthCount, kDistanceCount, distance);
+}
+
+bool InflateBlock(BitReader* reader, const Huffman& literal_length,
+  const Huffman& distance, uint8_t* output, size_t output_size,
+  size_t* position) {
+  size_t out = *position;
+  while (true) {
+    const int symbol = Decode(reader, literal_length);
+    if (symbol < 256) {
+      if (symbol < 0 || out >= output_size)
+        return false;
+      output[out++] = static_cast<uint8_t>(symbol);
+      continue;
+    }
+    if (symbol == 256)
+      break;
+
+    const int kLengthIndex = symbol - 257;
+    if (kLengthIndex >= 29)
+      return false;
+    if (reader->GetCount() < 32)
+      reader->Refill();
+    const size_t kLength = kLengthBase[kLengthIndex] +
+      reader->Read(kLengthExtra[kLengthIndex]);
+
+    const int kDistanceIndex = Decode(reader, distance);
+    if (kDistanceIndex < 0 || kDistanceIndex >= 30)
+      return false;
+    const size_t kDistance = kDistanceBase[kDistanceIndex] +
+      reader->Read(kDistanceExtra[kDistanceIndex]);
+
+    if (kDistance > out || kLength > output_size - out)
+      return false;
+
+    uint8_t* target = output + out;
+    const uint8_t* source = target - kDistance;
+    size_t left = kLength;
+    if (kDistance >= 8) {
+      // chunks never overlap their own source
+      while (left >= 8) {
+        memcpy(target, source, 8);
+        target += 8;
+        source += 8;
+        left -= 8;
+      }
+    }
+    while (left-- > 0)
+      *target++ = *source++;
+    out += kLength;
+  }
+
+  *position = out;
+  return !reader->IsOverrun();
+}
+}  // namespace
+
+bool Inflate(const void* data, size_t size, void* output, size_t output_size,
+  size_t* written) {
+  BitReader reader(static_cast<const uint8_t*>(data), size);
+  uint8_t* out = static_cast<uint8_t*>(output);
+  size_t position = 0;
+
+  Huffman literal_length;
+  Huffman distance;
+  bool last = false;
+  while (!last) {
+    last = reader.Read(1) != 0;
+    const uint32_t kType = reader.Read(2);
+
+    if (kType == 0) {
+      reader.AlignToByte();
+      const uint32_t kLength = reader.Read(16);
+      const uint32_t kLengthComplement = reader.Read(16);
+      if ((kLength ^ 0xffff) != kLengthComplement ||
+        kLength > output_size - position ||
+        !reader.CopyBytes(out + position, kLength)) {
+        return false;
+      }
+      position += kLength;
+      continue;
+    }
+
+    if (kType == 1) {
+      if (!BuildFixedHuffman(&literal_length, &distance))
+        return false;
+    }
+    else if (kType == 2) {
+      if (!ReadDynamicHuffman(&reader, &literal_length, &distance))
+        return false;
+    }
+    else {
+      return false;
+    }
+
+    if (!InflateBlock(&reader, literal_length, distance, out, output_size,
+      &position)) {
+      return false;
+    }
+  }
+
+  if (reader.IsOverrun())
+    return false;
+  if (written != nullptr)
+    *written = position;
+  return true;
+}
+
+bool InflateZlib(const void* data, size_t size, void* output,
+  size_t output_size, size_t* written) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  if (size < 2)
+    return false;
+
+  // deflate with at most a 32k window, no preset dictionary
+  const uint32_t kMethod = bytes[0];
+  const uint32_t kFlags = bytes[1];
+  if ((kMethod & 15) != 8 || (kMethod >> 4) > 7 ||
+    ((kMethod << 8) | kFlags) % 31 != 0 || (kFlags & 0x20) != 0) {
+    return false;
+  }
+  return Inflate(bytes + 2, size - 2, output, output_size, written);
+}
+}  // namespace core
+}  // namespace magnet
@@ -0,0 +1,20 @@
+#ifndef MAGNET_CORE_INFLATE_H_
+#define MAGNET_CORE_INFLATE_H_
+
+#include <stddef.h>
+
+namespace magnet {
+namespace core {
+// decodes a raw deflate stream (rfc 1951) into a buffer the caller sized
+// for the whole output, as image and mesh formats know it up front. fails
+// on damaged input and if the output does not fit. reentrant.
+bool Inflate(const void* data, size_t size, void* output, size_t output_size,
+  size_t* written);
+
+// the same for a deflate stream in a zlib wrapper (rfc 1950) as png uses.
+// the adler32 checksum at the end is not verified.
+bool InflateZlib(const void* data, size_t size, void* output,
+  size_t output_size, size_t* written);
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_INFLATE_H_
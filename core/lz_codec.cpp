@@ -0,0 +1,208 @@
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "lz_codec.h"
+
+namespace magnet {
+namespace core {
+namespace {
+static const size_t kMinMatch = 4;
+static const size_t kMaxOffset = 65535;
+
+// the format ends with literals: the last match starts 12 bytes before
+// the end at the latest and leaves the last 5 bytes as literals
+static const size_t kMatchStartLimit = 12;
+static const size_t kLastLiterals = 5;
+
+static const int kHashBits = 14;
+
+// after 64 misses in a row the step grows, incompressible data is skipped
+// through quickly
+static const int kSkipShift = 6;
+
+inline uint32_t Read32(const uint8_t* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint32_t Hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+// 15 in the token nibble, then bytes of 255 until the rest
+inline uint8_t* WriteLength(size_t length, uint8_t* output) {
+  for (length -= 15; length >= 255; length -= 255)
+    *output++ = 255;
+  *output++ = static_cast<uint8_t>(length);
+  return output;
+}
+
+inline bool ReadLength(const uint8_t** input, const uint8_t* end,
+  size_t* length) {
+  uint8_t byte;
+  do {
+    if (*input >= end)
+      return false;
+    byte = *(*input)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+// token, literals and, unless it is the last sequence, the match
+uint8_t* WriteSequence(const uint8_t* literals, size_t literals_count,
+  size_t offset, size_t match_length, uint8_t* output,
+  const uint8_t* output_end) {
+  const size_t kMatchCode = match_length ? match_length - kMinMatch : 0;
+  const size_t kNeeded = 1 + (literals_count >= 15 ?
+    (literals_count - 15) / 255 + 1 : 0) + literals_count +
+    (match_length ? 2 + (kMatchCode >= 15 ? (kMatchCode - 15) / 255 + 1 : 0) :
+    0);
+  if (kNeeded > static_cast<size_t>(output_end - output))
+    return nullptr;
+
+  uint8_t* token = output++;
+  *token = static_cast<uint8_t>(
+    (literals_count < 15 ? literals_count : 15) << 4);
+  if (literals_count >= 15)
+    output = WriteLength(literals_count, output);
+  if (literals_count)
+    memcpy(output, literals, literals_count);
+  output += literals_count;
+  if (match_length == 0)
+    return output;
+
+  *output++ = static_cast<uint8_t>(offset);
+  *output++ = static_cast<uint8_t>(offset >> 8);
+  *token |= static_cast<uint8_t>(kMatchCode < 15 ? kMatchCode : 15);
+  if (kMatchCode >= 15)
+    output = WriteLength(kMatchCode, output);
+  return output;
+}
+}  // namespace
+
+size_t GetLzCompressBound(size_t size) {
+  return size + size / 255 + 16;
+}
+
+uint64_t GetLzDecompressBound(uint64_t size) {
+  return size * 255;
+}
+
+size_t LzCompress(const void* data, size_t size, void* output,
+  size_t capacity) {
+  const uint8_t* input = static_cast<const uint8_t*>(data);
+  const uint8_t* kInputEnd = input + size;
+  uint8_t* out = static_cast<uint8_t*>(output);
+  const uint8_t* kOutputEnd = out + capacity;
+  const uint8_t* anchor = input;
+
+  if (size > kMatchStartLimit) {
+    // positions + 1 of the last sequence seen with each hash, 0 for none
+    std::vector<uint32_t> table(static_cast<size_t>(1) << kHashBits, 0);
+    const uint8_t* kMatchStartEnd = kInputEnd - kMatchStartLimit;
+    const uint8_t* kMatchEnd = kInputEnd - kLastLiterals;
+    const uint8_t* position = input;
+    int misses = 0;
+    while (position < kMatchStartEnd) {
+      const uint32_t kSequence = Read32(position);
+      uint32_t& entry = table[Hash(kSequence)];
+      const uint8_t* match = entry ? input + entry - 1 : nullptr;
+      entry = static_cast<uint32_t>(position - input + 1);
+      if (match == nullptr ||
+        static_cast<size_t>(position - match) > kMaxOffset ||
+        Read32(match) != kSequence) {
+        position += 1 + (misses++ >> kSkipShift);
+        continue;
+      }
+      misses = 0;
+
+      // the hash table only finds the start, grow the match both ways
+      while (position > anchor && match > input &&
+        position[-1] == match[-1]) {
+        --position;
+        --match;
+      }
+      size_t length = kMinMatch;
+      while (position + length < kMatchEnd &&
+        position[length] == match[length]) {
+        ++length;
+      }
+
+      out = WriteSequence(anchor, position - anchor, position - match,
+        length, out, kOutputEnd);
+      if (out == nullptr)
+        return 0;
+      position += length;
+      anchor = position;
+      if (position < kMatchStartEnd) {
+        table[Hash(Read32(position - 2))] =
+          static_cast<uint32_t>(position - 2 - input + 1);
+      }
+    }
+  }
+
+  out = WriteSequence(anchor, kInputEnd - anchor, 0, 0, out, kOutputEnd);
+  if (out == nullptr)
+    return 0;
+  return out - static_cast<uint8_t*>(output);
+}
+
+bool LzDecompress(const void* data, size_t size, void* output,
+  size_t output_size) {
+  const uint8_t* input = static_cast<const uint8_t*>(data);
+  const uint8_t* kInputEnd = input + size;
+  uint8_t* out = static_cast<uint8_t*>(output);
+  uint8_t* const kOutputBegin = out;
+  const uint8_t* kOutputEnd = out + output_size;
+
+  while (input < kInputEnd) {
+    const uint8_t kToken = *input++;
+    size_t literals_count = kToken >> 4;
+    if (literals_count == 15 &&
+      !ReadLength(&input, kInputEnd, &literals_count)) {
+      return false;
+    }
+    if (literals_count > static_cast<size_t>(kInputEnd - input) ||
+      literals_count > static_cast<size_t>(kOutputEnd - out)) {
+      return false;
+    }
+    if (literals_count)
+      memcpy(out, input, literals_count);
+    out += literals_count;
+    input += literals_count;
+
+    // the last sequence has no match
+    if (input == kInputEnd)
+      break;
+
+    if (kInputEnd - input < 2)
+      return false;
+    const size_t kOffset = input[0] | (static_cast<size_t>(input[1]) << 8);
+    input += 2;
+    size_t length = kToken & 15;
+    if (length == 15 && !ReadLength(&input, kInputEnd, &length))
+      return false;
+    length += kMinMatch;
+    if (kOffset == 0 || kOffset > static_cast<size_t>(out - kOutputBegin) ||
+      length > static_cast<size_t>(kOutputEnd - out)) {
+      return false;
+    }
+
+    // overlapping matches repeat the last kOffset bytes
+    const uint8_t* match = out - kOffset;
+    if (kOffset >= length) {
+      memcpy(out, match, length);
+      out += length;
+    }
+    else {
+      for (size_t i = 0; i < length; ++i)
+        *out++ = match[i];
+    }
+  }
+  return out == kOutputEnd;
+}
+}  // namespace core
+}  // namespace magnet
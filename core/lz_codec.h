@@ -0,0 +1,29 @@
+#ifndef MAGNET_CORE_LZ_CODEC_H_
+#define MAGNET_CORE_LZ_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace magnet {
+namespace core {
+// fast byte oriented lz77 with lz4 style blocks: sequences of a token,
+// literals and a 16 bit offset, no entropy coding. decoding is a few
+// copies per sequence and runs at memory speed, which is what loading
+// needs, the compressor is a single pass over a hash table.
+
+// output bytes LzCompress may need for size input bytes
+size_t GetLzCompressBound(size_t size);
+// the most bytes size compressed bytes can decode to, a byte of a length
+// adds at most 255 of output
+uint64_t GetLzDecompressBound(uint64_t size);
+
+// returns the compressed size, 0 if it does not fit into capacity
+size_t LzCompress(const void* data, size_t size, void* output,
+  size_t capacity);
+
+// fails unless the data decodes to exactly output_size bytes
+bool LzDecompress(const void* data, size_t size, void* output,
+  size_t output_size);
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_LZ_CODEC_H_
@@ -0,0 +1,157 @@
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+namespace magnet {
+namespace core {
+#ifdef _WIN32
+MappedFile::MappedFile() : data_(nullptr), size_(0), is_open_(false),
+  copy_on_write_(false), file_handle_(INVALID_HANDLE_VALUE), mapping_handle_(nullptr) {
+}
+#else
+MappedFile::MappedFile() : data_(nullptr), size_(0), is_open_(false),
+  copy_on_write_(false), file_descriptor_(-1) {
+}
+#endif
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+bool MappedFile::Open(const std::string& path) {
+  return Map(path, false);
+}
+
+bool MappedFile::OpenCopyOnWrite(const std::string& path) {
+  return Map(path, true);
+}
+
+#ifdef _WIN32
+bool MappedFile::Map(const std::string& path, bool copy_on_write) {
+  Close();
+
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+    nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    return false;
+  }
+
+  file_handle_ = file;
+  size_ = static_cast<size_t>(size.QuadPart);
+  is_open_ = true;
+  copy_on_write_ = copy_on_write;
+
+  // empty files can not be mapped
+  if (size_ == 0)
+    return true;
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr,
+    copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    Close();
+    return false;
+  }
+  mapping_handle_ = mapping;
+
+  data_ = static_cast<char*>(MapViewOfFile(mapping,
+    copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+  if (data_ == nullptr) {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_)
+    UnmapViewOfFile(data_);
+  if (mapping_handle_)
+    CloseHandle(mapping_handle_);
+  if (file_handle_ != INVALID_HANDLE_VALUE)
+    CloseHandle(file_handle_);
+
+  data_ = nullptr;
+  size_ = 0;
+  is_open_ = false;
+  copy_on_write_ = false;
+  mapping_handle_ = nullptr;
+  file_handle_ = INVALID_HANDLE_VALUE;
+}
+#else
+bool MappedFile::Map(const std::string& path, bool copy_on_write) {
+  Close();
+
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0)
+    return false;
+
+  struct stat file_stat;
+  if (fstat(file, &file_stat) != 0) {
+    close(file);
+    return false;
+  }
+
+  file_descriptor_ = file;
+  size_ = static_cast<size_t>(file_stat.st_size);
+  is_open_ = true;
+  copy_on_write_ = copy_on_write;
+
+  if (size_ == 0)
+    return true;
+
+  const int kProtection = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+  void* data = mmap(nullptr, size_, kProtection, MAP_PRIVATE, file, 0);
+  if (data == MAP_FAILED) {
+    Close();
+    return false;
+  }
+  madvise(data, size_, MADV_SEQUENTIAL);
+  data_ = static_cast<char*>(data);
+
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_)
+    munmap(data_, size_);
+  if (file_descriptor_ >= 0)
+    close(file_descriptor_);
+
+  data_ = nullptr;
+  size_ = 0;
+  is_open_ = false;
+  copy_on_write_ = false;
+  file_descriptor_ = -1;
+}
+#endif
+
+bool MappedFile::IsOpen() const {
+  return is_open_;
+}
+
+const char* MappedFile::GetData() const {
+  return data_;
+}
+
+char* MappedFile::GetWritableData() const {
+  return copy_on_write_ ? data_ : nullptr;
+}
+
+size_t MappedFile::GetSize() const {
+  return size_;
+}
+}  // namespace core
+}  // namespace magnet
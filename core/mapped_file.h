@@ -0,0 +1,46 @@
+#ifndef MAGNET_CORE_MAPPED_FILE_H_
+#define MAGNET_CORE_MAPPED_FILE_H_
+
+#include <stddef.h>
+#include <string>
+
+namespace magnet {
+namespace core {
+// view of a whole file mapped into the address space, pages are loaded by
+// the os on first access. read only, or copy on write where writes go to
+// pages private to the process and never reach the file.
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool Open(const std::string& path);
+  bool OpenCopyOnWrite(const std::string& path);
+  void Close();
+
+  bool IsOpen() const;
+  const char* GetData() const;
+  // null unless opened copy on write
+  char* GetWritableData() const;
+  size_t GetSize() const;
+
+ private:
+  bool Map(const std::string& path, bool copy_on_write);
+
+  char* data_;
+  size_t size_;
+  bool is_open_;
+  bool copy_on_write_;
+
+#ifdef _WIN32
+  void* file_handle_;
+  void* mapping_handle_;
+#else
+  int file_descriptor_;
+#endif
+};
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_MAPPED_FILE_H_
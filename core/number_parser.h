@@ -0,0 +1,131 @@
+#ifndef MAGNET_CORE_NUMBER_PARSER_H_
+#define MAGNET_CORE_NUMBER_PARSER_H_
+
+#include <math.h>
+#include <stdint.h>
+
+namespace magnet {
+namespace core {
+// locale independent number parsing on [begin, end) ranges that are not
+// null terminated. every function returns the position after the number,
+// or begin if there is no number, and never reads past end.
+
+inline const char* ParseInt(const char* begin, const char* end, int* value) {
+  const char* p = begin;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+
+  const char* digits_begin = p;
+  int result = 0;
+  while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+    result = result * 10 + (*p - '0');
+    ++p;
+  }
+  if (p == digits_begin)
+    return begin;
+
+  *value = negative ? -result : result;
+  return p;
+}
+
+// decimal and scientific notation. up to 19 significant digits are kept in
+// an integer mantissa which is scaled with an exact power of ten when the
+// exponent allows it, which covers everything exporters write.
+inline const char* ParseFloat(const char* begin, const char* end,
+  float* value) {
+  static const double kPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  static const int kMaxDigits = 19;
+
+  const char* p = begin;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+
+  uint64_t mantissa = 0;
+  int digits_count = 0;
+  int exponent = 0;
+  bool has_digits = false;
+
+  while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+    if (digits_count < kMaxDigits) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa)
+        ++digits_count;
+    }
+    else {
+      ++exponent;
+    }
+    has_digits = true;
+    ++p;
+  }
+
+  if (p < end && *p == '.') {
+    ++p;
+    while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+      if (digits_count < kMaxDigits) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa)
+          ++digits_count;
+        --exponent;
+      }
+      has_digits = true;
+      ++p;
+    }
+  }
+
+  if (!has_digits)
+    return begin;
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    int exponent_value = 0;
+    const char* exponent_end = ParseInt(p + 1, end, &exponent_value);
+    if (exponent_end != p + 1) {
+      exponent += exponent_value;
+      p = exponent_end;
+    }
+  }
+
+  double result = static_cast<double>(mantissa);
+  if (mantissa == 0) {
+    result = 0.0;
+  }
+  else if (exponent >= 0 && exponent <= 22) {
+    result *= kPowersOfTen[exponent];
+  }
+  else if (exponent < 0 && exponent >= -22) {
+    result /= kPowersOfTen[-exponent];
+  }
+  else {
+    result *= pow(10.0, exponent);
+  }
+
+  *value = static_cast<float>(negative ? -result : result);
+  return p;
+}
+
+// up to count floats separated by white space, like sscanf with "%f %f %f".
+// returns how many were read, the others stay untouched.
+inline int ParseFloats(const char* begin, const char* end, float* values,
+  int count) {
+  const char* p = begin;
+  for (int i = 0; i < count; ++i) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+      ++p;
+    const char* next = ParseFloat(p, end, values + i);
+    if (next == p)
+      return i;
+    p = next;
+  }
+  return count;
+}
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_NUMBER_PARSER_H_
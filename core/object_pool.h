@@ -0,0 +1,97 @@
+#ifndef MAGNET_CORE_OBJECT_POOL_H_
+#define MAGNET_CORE_OBJECT_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+#include <utility>
+
+#include "allocator.h"
+
+namespace magnet {
+namespace core {
+static const size_t kCacheLineSize = 64;
+
+// objects of one type in the blocks of a FixedPool. creating and destroying
+// is O(1) and allocates only when every slab is full. blocks are whole
+// cache lines and slabs start on one, objects on different threads never
+// share a line. objects alive when the pool is destroyed are not destroyed.
+template <typename T>
+class ObjectPool {
+ public:
+  explicit ObjectPool(MemoryTag tag, uint32_t slab_size = 64);
+  ObjectPool(const ObjectPool&) = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+
+  template <typename... Args>
+  T* Create(Args&&... args);
+  // an object of this pool
+  void Destroy(T* object);
+
+  // one slab with room for count objects more than there are free blocks,
+  // for creating many objects at once
+  void Reserve(uint32_t count);
+  // frees the slabs without objects
+  void Trim();
+
+  uint32_t GetObjectsCount() const;
+  uint32_t GetCapacity() const;
+  FixedPoolStats GetStats() const;
+
+ private:
+  static const size_t kBlockAlignment =
+    alignof(T) > kCacheLineSize ? alignof(T) : kCacheLineSize;
+
+  FixedPool pool_;
+};
+
+template <typename T>
+inline ObjectPool<T>::ObjectPool(MemoryTag tag, uint32_t slab_size) :
+  pool_(tag, sizeof(T), kBlockAlignment, slab_size) {
+}
+
+template <typename T>
+template <typename... Args>
+inline T* ObjectPool<T>::Create(Args&&... args) {
+  void* block = pool_.Allocate(sizeof(T), kBlockAlignment);
+  if (block == nullptr)
+    abort();
+  return new (block) T(std::forward<Args>(args)...);
+}
+
+template <typename T>
+inline void ObjectPool<T>::Destroy(T* object) {
+  if (object == nullptr)
+    return;
+  object->~T();
+  pool_.Free(object);
+}
+
+template <typename T>
+inline void ObjectPool<T>::Reserve(uint32_t count) {
+  pool_.Reserve(count);
+}
+
+template <typename T>
+inline void ObjectPool<T>::Trim() {
+  pool_.Trim();
+}
+
+template <typename T>
+inline uint32_t ObjectPool<T>::GetObjectsCount() const {
+  return pool_.GetBlocksCount();
+}
+
+template <typename T>
+inline uint32_t ObjectPool<T>::GetCapacity() const {
+  return pool_.GetCapacity();
+}
+
+template <typename T>
+inline FixedPoolStats ObjectPool<T>::GetStats() const {
+  return pool_.GetStats();
+}
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_OBJECT_POOL_H_
@@ -0,0 +1,275 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+
+#include "hash.h"
+#include "lz_codec.h"
+#include "pack_archive.h"
+
+namespace magnet {
+namespace core {
+namespace {
+static const char kMagic[4] = { 'M', 'P', 'A', 'K' };
+
+// bump when the layout below changes
+static const uint32_t kFormatVersion = 1;
+
+// a cache line, more than any typed data inside an entry needs
+static const uint64_t kEntryAlignment = 64;
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t entries_count;
+  uint32_t names_size;
+  uint64_t toc_offset;        // entries, then names
+  uint64_t file_size;
+};
+
+inline uint64_t Align(uint64_t offset) {
+  return (offset + kEntryAlignment - 1) & ~(kEntryAlignment - 1);
+}
+
+inline bool IsInside(uint64_t offset, uint64_t size, uint64_t file_size) {
+  return offset <= file_size && size <= file_size - offset;
+}
+}  // namespace
+
+struct PackArchive::Entry {
+  uint64_t name_hash;
+  uint64_t offset;
+  uint64_t size;
+  uint64_t stored_size;       // less than size when compressed
+  uint32_t name_offset;
+  uint32_t name_size;
+};
+
+PackArchive::PackArchive() : entries_(nullptr), names_(nullptr),
+  entries_count_(0), names_size_(0) {
+}
+
+bool PackArchive::Open(const std::string& path) {
+  Close();
+  if (!file_.Open(path))
+    return false;
+
+  const char* base = file_.GetData();
+  const uint64_t kFileSize = file_.GetSize();
+  FileHeader header;
+  if (kFileSize < sizeof(header)) {
+    Close();
+    return false;
+  }
+  memcpy(&header, base, sizeof(header));
+  const uint64_t kEntriesSize =
+    static_cast<uint64_t>(header.entries_count) * sizeof(Entry);
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+    header.version != kFormatVersion ||
+    header.file_size != kFileSize ||
+    header.toc_offset % sizeof(uint64_t) != 0 ||
+    !IsInside(header.toc_offset, kEntriesSize + header.names_size,
+      kFileSize)) {
+    Close();
+    return false;
+  }
+
+  // checked once here, the lookups trust the table. a compressed entry
+  // cannot decode to more than the codec allows for its stored bytes, a
+  // damaged size must fail here and not in the allocation for it.
+  const Entry* entries =
+    reinterpret_cast<const Entry*>(base + header.toc_offset);
+  for (uint32_t i = 0; i < header.entries_count; ++i) {
+    const Entry& entry = entries[i];
+    if (!IsInside(entry.offset, entry.stored_size, kFileSize) ||
+      entry.stored_size > entry.size ||
+      entry.size > GetLzDecompressBound(entry.stored_size) ||
+      entry.size > std::numeric_limits<size_t>::max() ||
+      !IsInside(entry.name_offset, entry.name_size, header.names_size) ||
+      (i > 0 && entries[i - 1].name_hash > entry.name_hash)) {
+      Close();
+      return false;
+    }
+  }
+
+  entries_ = entries;
+  names_ = base + header.toc_offset + kEntriesSize;
+  entries_count_ = header.entries_count;
+  names_size_ = header.names_size;
+  return true;
+}
+
+void PackArchive::Close() {
+  file_.Close();
+  entries_ = nullptr;
+  names_ = nullptr;
+  entries_count_ = 0;
+  names_size_ = 0;
+}
+
+bool PackArchive::IsOpen() const {
+  return file_.IsOpen();
+}
+
+int PackArchive::GetEntriesCount() const {
+  return static_cast<int>(entries_count_);
+}
+
+std::string PackArchive::GetEntryName(int index) const {
+  const Entry& entry = entries_[index];
+  return std::string(names_ + entry.name_offset, entry.name_size);
+}
+
+int PackArchive::Find(const std::string& name) const {
+  const std::string kName = NormalizeName(name);
+  const uint64_t kHash = Hash64(kName.data(), kName.size());
+  const Entry* end = entries_ + entries_count_;
+  const Entry* entry = std::lower_bound(entries_, end, kHash,
+    [](const Entry& a, uint64_t hash) { return a.name_hash < hash; });
+  for (; entry != end && entry->name_hash == kHash; ++entry) {
+    if (entry->name_size == kName.size() &&
+      memcmp(names_ + entry->name_offset, kName.data(), kName.size()) == 0) {
+      return static_cast<int>(entry - entries_);
+    }
+  }
+  return -1;
+}
+
+size_t PackArchive::GetEntrySize(int index) const {
+  return static_cast<size_t>(entries_[index].size);
+}
+
+bool PackArchive::IsEntryCompressed(int index) const {
+  return entries_[index].stored_size < entries_[index].size;
+}
+
+const char* PackArchive::GetEntryData(int index) const {
+  return IsEntryCompressed(index) ? nullptr :
+    file_.GetData() + entries_[index].offset;
+}
+
+bool PackArchive::ReadEntry(int index, void* output) const {
+  const Entry& entry = entries_[index];
+  const char* data = file_.GetData() + entry.offset;
+  if (!IsEntryCompressed(index)) {
+    memcpy(output, data, static_cast<size_t>(entry.size));
+    return true;
+  }
+  return LzDecompress(data, static_cast<size_t>(entry.stored_size), output,
+    static_cast<size_t>(entry.size));
+}
+
+std::string PackArchive::NormalizeName(const std::string& name) {
+  std::string normalized(name);
+  for (char& c : normalized) {
+    c = c == '\\' ? '/' :
+      static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  }
+  return normalized;
+}
+
+void PackWriter::AddFile(const std::string& name, const void* data,
+  size_t size, bool compress) {
+  PendingFile file;
+  file.name = PackArchive::NormalizeName(name);
+  file.size = size;
+  if (compress && size > 0) {
+    file.stored.resize(GetLzCompressBound(size));
+    const size_t kCompressedSize = LzCompress(data, size, file.stored.data(),
+      file.stored.size());
+    if (kCompressedSize > 0 && kCompressedSize < size - size / 16)
+      file.stored.resize(kCompressedSize);
+    else
+      file.stored.clear();
+  }
+  if (file.stored.empty() && size > 0) {
+    const char* bytes = static_cast<const char*>(data);
+    file.stored.assign(bytes, bytes + size);
+  }
+
+  for (PendingFile& pending : files_) {
+    if (pending.name == file.name) {
+      pending = std::move(file);
+      return;
+    }
+  }
+  files_.push_back(std::move(file));
+}
+
+bool PackWriter::AddFileFromDisk(const std::string& name,
+  const std::string& path, bool compress) {
+  MappedFile file;
+  if (!file.Open(path))
+    return false;
+  AddFile(name, file.GetData(), file.GetSize(), compress);
+  return true;
+}
+
+bool PackWriter::Write(const std::string& path) const {
+  std::vector<PackArchive::Entry> entries(files_.size());
+  std::string names;
+  uint64_t offset = Align(sizeof(FileHeader));
+  for (size_t i = 0; i < files_.size(); ++i) {
+    const PendingFile& file = files_[i];
+    PackArchive::Entry& entry = entries[i];
+    entry.name_hash = Hash64(file.name.data(), file.name.size());
+    entry.offset = offset;
+    entry.size = file.size;
+    entry.stored_size = file.stored.size();
+    entry.name_offset = static_cast<uint32_t>(names.size());
+    entry.name_size = static_cast<uint32_t>(file.name.size());
+    names += file.name;
+    offset = Align(offset + entry.stored_size);
+  }
+  std::sort(entries.begin(), entries.end(),
+    [](const PackArchive::Entry& a, const PackArchive::Entry& b) {
+    return a.name_hash < b.name_hash;
+  });
+
+  FileHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kFormatVersion;
+  header.entries_count = static_cast<uint32_t>(entries.size());
+  header.names_size = static_cast<uint32_t>(names.size());
+  header.toc_offset = offset;
+  header.file_size = offset + entries.size() * sizeof(PackArchive::Entry) +
+    names.size();
+
+  const std::string temp_path = path + ".tmp";
+  FILE* output = fopen(temp_path.c_str(), "wb");
+  if (output == nullptr)
+    return false;
+
+  static const char kPadding[kEntryAlignment] = {};
+  uint64_t written_size = 0;
+  auto write = [&](const void* data, size_t size) {
+    if (size == 0)
+      return true;
+    written_size += size;
+    return fwrite(data, 1, size, output) == size;
+  };
+  auto pad = [&]() {
+    return write(kPadding, static_cast<size_t>(Align(written_size) -
+      written_size));
+  };
+
+  bool written = write(&header, sizeof(header));
+  for (size_t i = 0; written && i < files_.size(); ++i) {
+    written = pad() && write(files_[i].stored.data(), files_[i].stored.size());
+  }
+  written = written && pad() &&
+    write(entries.data(), entries.size() * sizeof(PackArchive::Entry)) &&
+    write(names.data(), names.size());
+
+  written = fclose(output) == 0 && written;
+  if (written) {
+    remove(path.c_str());
+    written = rename(temp_path.c_str(), path.c_str()) == 0;
+  }
+  if (!written)
+    remove(temp_path.c_str());
+  return written;
+}
+}  // namespace core
+}  // namespace magnet
@@ -0,0 +1,82 @@
+#ifndef MAGNET_CORE_PACK_ARCHIVE_H_
+#define MAGNET_CORE_PACK_ARCHIVE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+namespace magnet {
+namespace core {
+// many files in one, read through a single mapping. the file data comes
+// first, each entry aligned so typed data can be used in place, then the
+// table of contents sorted by name hash and the names. entries are stored
+// as they are or lz compressed when that saves enough.
+//
+// names are relative paths, compared with forward slashes and in lower
+// case, as windows file names are.
+class PackArchive {
+ public:
+  PackArchive();
+  PackArchive(const PackArchive&) = delete;
+  PackArchive& operator=(const PackArchive&) = delete;
+
+  // fails if the file is missing or its table of contents is damaged
+  bool Open(const std::string& path);
+  void Close();
+  bool IsOpen() const;
+
+  int GetEntriesCount() const;
+  std::string GetEntryName(int index) const;
+  // index of the entry, -1 if there is none
+  int Find(const std::string& name) const;
+
+  // bytes of the file once read
+  size_t GetEntrySize(int index) const;
+  bool IsEntryCompressed(int index) const;
+  // the file bytes inside the mapping, only for entries not compressed
+  const char* GetEntryData(int index) const;
+  // copies or decompresses the entry into GetEntrySize bytes of output
+  bool ReadEntry(int index, void* output) const;
+
+  static std::string NormalizeName(const std::string& name);
+
+ private:
+  friend class PackWriter;
+  struct Entry;
+
+  MappedFile file_;
+  const Entry* entries_;
+  const char* names_;
+  uint32_t entries_count_;
+  uint32_t names_size_;
+};
+
+// collects files in memory and writes them as one archive
+class PackWriter {
+ public:
+  // compressed entries are kept only if they save more than 1/16, the
+  // rest stay in place for zero copy reads. a name added again replaces
+  // the earlier file.
+  void AddFile(const std::string& name, const void* data, size_t size,
+    bool compress);
+  bool AddFileFromDisk(const std::string& name, const std::string& path,
+    bool compress);
+
+  // written next to path and renamed, like the caches
+  bool Write(const std::string& path) const;
+
+ private:
+  struct PendingFile {
+    std::string name;
+    size_t size;
+    std::vector<char> stored;
+  };
+
+  std::vector<PendingFile> files_;
+};
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_PACK_ARCHIVE_H_
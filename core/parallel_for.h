@@ -0,0 +1,47 @@
+#ifndef MAGNET_CORE_PARALLEL_FOR_H_
+#define MAGNET_CORE_PARALLEL_FOR_H_
+
+#include <stddef.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace magnet {
+namespace core {
+// threads worth starting for work_size units of work, at least
+// min_work_per_thread each. 0 threads_count means all cores.
+inline int GetParallelThreadsCount(size_t work_size,
+  size_t min_work_per_thread, int threads_count) {
+  if (threads_count <= 0) {
+    threads_count = static_cast<int>(std::thread::hardware_concurrency());
+    if (threads_count <= 0)
+      threads_count = 1;
+  }
+  const size_t kMaxThreadsCount =
+    std::max<size_t>(1, work_size / std::max<size_t>(1, min_work_per_thread));
+  return static_cast<int>(std::min<size_t>(threads_count, kMaxThreadsCount));
+}
+
+// runs function(begin, end) on threads_count contiguous bands of
+// [0, count), the calling thread blocks until all are done. meant for
+// splitting one large piece of work, not for many small ones, which
+// belong in TaskManager tasks.
+template <typename Function>
+void ParallelFor(int count, int threads_count, const Function& function) {
+  threads_count = std::min(threads_count, count);
+  if (threads_count <= 1) {
+    function(0, count);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threads_count; ++i) {
+    threads.emplace_back(function, count * i / threads_count,
+      count * (i + 1) / threads_count);
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+}
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_PARALLEL_FOR_H_
@@ -0,0 +1,21 @@
+#ifndef MAGNET_CORE_SIMD_H_
+#define MAGNET_CORE_SIMD_H_
+
+// MAGNET_SSE2 is defined where sse2 can be used without a cpu check, that
+// is every x64 build and x86 builds targeting sse2. code using it keeps a
+// scalar path for other targets.
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAGNET_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// marks a function that uses instructions past sse2, callers check the cpu
+// first. msvc compiles any intrinsic without it.
+#if defined(__GNUC__)
+#define MAGNET_TARGET(isa) __attribute__((target(isa)))
+#else
+#define MAGNET_TARGET(isa)
+#endif
+
+#endif  // MAGNET_CORE_SIMD_H_
@@ -2,6 +2,8 @@
 #include <iostream>
 #include "task_manager.h"
 
+namespace magnet {
+namespace core {
 TaskManager* TaskManager::instance_ = nullptr;
 
 TaskManager::TaskManager() : thread_count_(0), terminate_(false) {
@@ -11,6 +13,7 @@ TaskManager::~TaskManager() {
 }
 
 void TaskManager::EnqueueTask(const Task& task) {
+  std::lock_guard<std::mutex> guard(queue_mutex_);
   task_queue_.push(task);
 }
 
@@ -54,6 +57,7 @@ void TaskManager::Initialize() {
 void TaskManager::Terminate() {
   instance_->EndThreads();
   delete instance_;
+  instance_ = nullptr;
 }
 
 void TaskManager::BeginThreads(int thread_count) {
@@ -68,10 +72,23 @@ bool TaskManager::HasTasks() {
   return !task_queue_.empty();
 }
 
+bool TaskManager::ExecuteTask() {
+  Task task;
+  if (!DequeueTask(task))
+    return false;
+  task.Execute();
+  return true;
+}
+
+int TaskManager::GetThreadsCount() const {
+  return thread_count_;
+}
+
 void TaskManager::EndThreads() {
   terminate_ = true;
   for (int i = 0; i < thread_count_; ++i) {
     threads_[i].join();
   }
 }
-
+}  // namespace core
+}  // namespace magnet
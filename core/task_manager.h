@@ -1,9 +1,16 @@
+#ifndef MAGNET_CORE_TASK_MANAGER_H_
+#define MAGNET_CORE_TASK_MANAGER_H_
+
+#include <atomic>
 #include <thread>
 #include <string>
 #include <mutex>
 #include <queue>
 #include <functional>
+#include <vector>
 
+namespace magnet {
+namespace core {
 struct Task {
   Task() {}
   std::function<void()> func;
@@ -30,7 +37,13 @@ public:
 
   void BeginThreads(int thread_count);
 
-  bool HasTasks();  
+  bool HasTasks();
+
+  // runs one queued task on the calling thread, false if the queue was
+  // empty. lets a thread that waits on tasks help instead of blocking.
+  bool ExecuteTask();
+
+  int GetThreadsCount() const;
 
 private:
   void EndThreads();
@@ -40,9 +53,12 @@ private:
   static TaskManager* instance_;
 
   int thread_count_;
-  bool terminate_;
+  std::atomic<bool> terminate_;
   std::queue<Task> task_queue_;
   std::mutex queue_mutex_;
   std::vector<std::thread> threads_;
 
-};
\ No newline at end of file
+};
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_TASK_MANAGER_H_
@@ -0,0 +1,57 @@
+#include <algorithm>
+
+#include "vertex_weld_map.h"
+
+namespace magnet {
+namespace core {
+namespace {
+static const size_t kMinCapacity = 16;
+}  // namespace
+
+VertexWeldMap::VertexWeldMap(size_t expected_count) : mask_(0), size_(0),
+  max_size_(0) {
+  Reset(expected_count);
+}
+
+void VertexWeldMap::Reset(size_t expected_count) {
+  // at most half full, a power of two so probing can mask
+  size_t capacity = kMinCapacity;
+  while (capacity < expected_count * 2)
+    capacity *= 2;
+
+  Slot empty_slot = { 0, 0, 0, kInvalidValue };
+  if (capacity == slots_.size()) {
+    std::fill(slots_.begin(), slots_.end(), empty_slot);
+  }
+  else {
+    slots_.assign(capacity, empty_slot);
+  }
+
+  mask_ = capacity - 1;
+  size_ = 0;
+  max_size_ = capacity / 2;
+}
+
+void VertexWeldMap::Grow() {
+  std::vector<Slot> old_slots;
+  old_slots.swap(slots_);
+
+  Reset(old_slots.size());
+  for (const Slot& slot : old_slots) {
+    if (slot.value == kInvalidValue)
+      continue;
+
+    bool inserted;
+    FindOrInsert(slot.position, slot.uv, slot.normal, slot.value, &inserted);
+  }
+}
+
+size_t VertexWeldMap::GetSize() const {
+  return size_;
+}
+
+size_t VertexWeldMap::GetCapacity() const {
+  return slots_.size();
+}
+}  // namespace core
+}  // namespace magnet
@@ -0,0 +1,86 @@
+#ifndef MAGNET_CORE_VERTEX_WELD_MAP_H_
+#define MAGNET_CORE_VERTEX_WELD_MAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace magnet {
+namespace core {
+// maps (position, uv, normal) index triples to welded vertex indices.
+// open addressing with linear probing in one flat array, sized up front
+// from the expected number of keys so loading a mesh does not rehash.
+class VertexWeldMap {
+ public:
+  static const uint32_t kInvalidValue = 0xffffffff;
+
+  explicit VertexWeldMap(size_t expected_count = 0);
+
+  // drops all keys and makes room for expected_count keys
+  void Reset(size_t expected_count);
+
+  // returns the value stored for the key, or stores value and returns it
+  // when the key is new. value must not be kInvalidValue.
+  inline uint32_t FindOrInsert(int position, int uv, int normal,
+    uint32_t value, bool* inserted);
+
+  size_t GetSize() const;
+  size_t GetCapacity() const;
+
+ private:
+  struct Slot {
+    int position;
+    int uv;
+    int normal;
+    uint32_t value;   // kInvalidValue marks an empty slot
+  };
+
+  static inline uint32_t Hash(int position, int uv, int normal);
+  void Grow();
+
+  std::vector<Slot> slots_;
+  size_t mask_;
+  size_t size_;
+  size_t max_size_;   // keys before the table grows, half the capacity
+};
+
+inline uint32_t VertexWeldMap::Hash(int position, int uv, int normal) {
+  uint32_t hash = static_cast<uint32_t>(position) * 0x9e3779b1u;
+  hash ^= static_cast<uint32_t>(uv) * 0x85ebca77u;
+  hash ^= static_cast<uint32_t>(normal) * 0xc2b2ae3du;
+  // murmur3 finalizer, neighbouring triples end up far apart
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+inline uint32_t VertexWeldMap::FindOrInsert(int position, int uv, int normal,
+  uint32_t value, bool* inserted) {
+  if (size_ >= max_size_)
+    Grow();
+
+  size_t index = Hash(position, uv, normal) & mask_;
+  while (true) {
+    Slot& slot = slots_[index];
+    if (slot.value == kInvalidValue) {
+      slot.position = position;
+      slot.uv = uv;
+      slot.normal = normal;
+      slot.value = value;
+      ++size_;
+      *inserted = true;
+      return value;
+    }
+    if (slot.position == position && slot.uv == uv && slot.normal == normal) {
+      *inserted = false;
+      return slot.value;
+    }
+    index = (index + 1) & mask_;
+  }
+}
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_VERTEX_WELD_MAP_H_
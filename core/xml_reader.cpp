@@ -0,0 +1,336 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "xml_reader.h"
+
+namespace magnet {
+namespace core {
+namespace {
+inline bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline bool IsNameEnd(char c) {
+  return IsSpace(c) || c == '/' || c == '>' || c == '=';
+}
+
+inline const char* SkipSpaces(const char* p, const char* end) {
+  while (p < end && IsSpace(*p))
+    ++p;
+  return p;
+}
+
+inline bool StartsWith(const char* p, const char* end, const char* prefix,
+  size_t length) {
+  return static_cast<size_t>(end - p) >= length &&
+    memcmp(p, prefix, length) == 0;
+}
+
+void AppendUtf8(uint32_t code, std::string* value) {
+  if (code < 0x80) {
+    value->push_back(static_cast<char>(code));
+  }
+  else if (code < 0x800) {
+    value->push_back(static_cast<char>(0xc0 | (code >> 6)));
+    value->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+  }
+  else if (code < 0x10000) {
+    value->push_back(static_cast<char>(0xe0 | (code >> 12)));
+    value->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+    value->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+  }
+  else if (code < 0x110000) {
+    value->push_back(static_cast<char>(0xf0 | (code >> 18)));
+    value->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+    value->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+    value->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+  }
+}
+
+// the entity at p, which is after its '&', up to its ';'. false leaves the
+// '&' as it is.
+bool DecodeEntity(const char* p, const char* end, std::string* value) {
+  static const struct {
+    const char* name;
+    char value;
+  } kEntities[] = {
+    { "lt", '<' }, { "gt", '>' }, { "amp", '&' }, { "quot", '"' },
+    { "apos", '\'' }
+  };
+
+  for (const auto& entity : kEntities) {
+    const size_t kLength = strlen(entity.name);
+    if (p + kLength < end && memcmp(p, entity.name, kLength) == 0 &&
+      p[kLength] == ';') {
+      value->push_back(entity.value);
+      return true;
+    }
+  }
+
+  if (p >= end || *p != '#')
+    return false;
+  const bool kHex = p + 1 < end && p[1] == 'x';
+  const char* kDigits = p + (kHex ? 2 : 1);
+  uint32_t code = 0;
+  for (const char* q = kDigits; q < end && code < 0x110000; ++q) {
+    const char kChar = *q;
+    uint32_t digit;
+    if (kChar == ';') {
+      if (q == kDigits)
+        return false;
+      AppendUtf8(code, value);
+      return true;
+    }
+    else if (kChar >= '0' && kChar <= '9') {
+      digit = kChar - '0';
+    }
+    else if (kHex && (kChar | 0x20) >= 'a' && (kChar | 0x20) <= 'f') {
+      digit = (kChar | 0x20) - 'a' + 10;
+    }
+    else {
+      return false;
+    }
+    code = code * (kHex ? 16 : 10) + digit;
+  }
+  return false;
+}
+}  // namespace
+
+bool XmlView::Equals(const char* value) const {
+  const size_t kLength = strlen(value);
+  return static_cast<size_t>(end - begin) == kLength &&
+    memcmp(begin, value, kLength) == 0;
+}
+
+void XmlView::AppendDecoded(std::string* value) const {
+  const char* p = begin;
+  while (p < end) {
+    const char* amp = static_cast<const char*>(memchr(p, '&', end - p));
+    if (amp == nullptr) {
+      value->append(p, end);
+      return;
+    }
+    value->append(p, amp);
+    const size_t kSize = value->size();
+    if (DecodeEntity(amp + 1, end, value)) {
+      p = static_cast<const char*>(memchr(amp, ';', end - amp)) + 1;
+    }
+    else {
+      value->resize(kSize);
+      value->push_back('&');
+      p = amp + 1;
+    }
+  }
+}
+
+std::string XmlView::ToString() const {
+  std::string value;
+  AppendDecoded(&value);
+  return value;
+}
+
+XmlReader::XmlReader(const char* data, size_t size) : p_(data),
+  end_(data + size),
+  self_closed_(false),
+  error_(false) {
+  // a utf-8 byte order mark
+  if (StartsWith(p_, end_, "\xef\xbb\xbf", 3))
+    p_ += 3;
+}
+
+bool XmlReader::NextChild() {
+  if (error_)
+    return false;
+  // <name/> has no children
+  if (self_closed_) {
+    self_closed_ = false;
+    open_names_.pop_back();
+    return false;
+  }
+
+  while (true) {
+    // text between children is not kept
+    const char* tag = p_ < end_ ?
+      static_cast<const char*>(memchr(p_, '<', end_ - p_)) : nullptr;
+    if (tag == nullptr) {
+      p_ = end_;
+      if (!open_names_.empty())
+        SetError();
+      return false;
+    }
+    p_ = tag;
+
+    if (StartsWith(p_, end_, "<!--", 4)) {
+      if (!SkipPast("-->"))
+        return false;
+    }
+    else if (StartsWith(p_, end_, "<![CDATA[", 9)) {
+      if (!SkipPast("]]>"))
+        return false;
+    }
+    else if (StartsWith(p_, end_, "<?", 2) || StartsWith(p_, end_, "<!", 2)) {
+      if (!SkipPast(">"))
+        return false;
+    }
+    else if (StartsWith(p_, end_, "</", 2)) {
+      ReadEndTag();
+      return false;
+    }
+    else {
+      return ReadStartTag();
+    }
+  }
+}
+
+void XmlReader::SkipElement() {
+  const size_t kDepth = open_names_.size();
+  while (!error_ && open_names_.size() >= kDepth && kDepth > 0)
+    NextChild();
+}
+
+const XmlView& XmlReader::GetName() const {
+  return name_;
+}
+
+const XmlView& XmlReader::GetText() const {
+  return text_;
+}
+
+bool XmlReader::FindAttribute(const char* name, XmlView* value) const {
+  for (const Attribute& attribute : attributes_) {
+    if (attribute.name.Equals(name)) {
+      *value = attribute.value;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool XmlReader::HasError() const {
+  return error_;
+}
+
+int XmlReader::GetDepth() const {
+  return static_cast<int>(open_names_.size());
+}
+
+bool XmlReader::ReadStartTag() {
+  const char* p = p_ + 1;
+  const char* name_begin = p;
+  while (p < end_ && !IsNameEnd(*p))
+    ++p;
+  if (p == name_begin) {
+    SetError();
+    return false;
+  }
+  name_ = XmlView(name_begin, p);
+
+  // name="value" or name='value' pairs up to > or />
+  attributes_.clear();
+  while (true) {
+    p = SkipSpaces(p, end_);
+    if (p >= end_) {
+      SetError();
+      return false;
+    }
+    if (*p == '>' || (*p == '/' && p + 1 < end_ && p[1] == '>'))
+      break;
+
+    Attribute attribute;
+    const char* attribute_begin = p;
+    while (p < end_ && !IsNameEnd(*p))
+      ++p;
+    attribute.name = XmlView(attribute_begin, p);
+    p = SkipSpaces(p, end_);
+    if (attribute.name.IsEmpty() || p >= end_ || *p != '=') {
+      SetError();
+      return false;
+    }
+    p = SkipSpaces(p + 1, end_);
+    if (p >= end_ || (*p != '"' && *p != '\'')) {
+      SetError();
+      return false;
+    }
+    const char* kValueEnd =
+      static_cast<const char*>(memchr(p + 1, *p, end_ - p - 1));
+    if (kValueEnd == nullptr) {
+      SetError();
+      return false;
+    }
+    attribute.value = XmlView(p + 1, kValueEnd);
+    attributes_.push_back(attribute);
+    p = kValueEnd + 1;
+  }
+
+  open_names_.push_back(name_);
+  text_ = XmlView();
+  if (*p == '/') {
+    self_closed_ = true;
+    p_ = p + 2;
+    return true;
+  }
+  p_ = p + 1;
+
+  // the text up to the first child or the end tag, white space alone is
+  // no text. a cdata section right away is the text.
+  if (StartsWith(p_, end_, "<![CDATA[", 9)) {
+    const char* kBegin = p_ + 9;
+    if (!SkipPast("]]>"))
+      return false;
+    text_ = XmlView(kBegin, p_ - 3);
+    return true;
+  }
+  const char* text_end = static_cast<const char*>(memchr(p_, '<', end_ - p_));
+  if (text_end == nullptr)
+    text_end = end_;
+  if (SkipSpaces(p_, text_end) != text_end)
+    text_ = XmlView(p_, text_end);
+  p_ = text_end;
+  return true;
+}
+
+bool XmlReader::ReadEndTag() {
+  const char* p = p_ + 2;
+  const char* name_begin = p;
+  while (p < end_ && !IsNameEnd(*p))
+    ++p;
+  const XmlView kName(name_begin, p);
+  p = SkipSpaces(p, end_);
+  if (p >= end_ || *p != '>' || open_names_.empty()) {
+    SetError();
+    return false;
+  }
+  const XmlView& open_name = open_names_.back();
+  if (kName.end - kName.begin != open_name.end - open_name.begin ||
+    memcmp(kName.begin, open_name.begin, kName.end - kName.begin) != 0) {
+    SetError();
+    return false;
+  }
+  open_names_.pop_back();
+  p_ = p + 1;
+  return true;
+}
+
+bool XmlReader::SkipPast(const char* terminator) {
+  const size_t kLength = strlen(terminator);
+  const char* p = p_;
+  while (p < end_) {
+    p = static_cast<const char*>(memchr(p, *terminator, end_ - p));
+    if (p == nullptr)
+      break;
+    if (StartsWith(p, end_, terminator, kLength)) {
+      p_ = p + kLength;
+      return true;
+    }
+    ++p;
+  }
+  SetError();
+  return false;
+}
+
+void XmlReader::SetError() {
+  error_ = true;
+  p_ = end_;
+}
+}  // namespace core
+}  // namespace magnet
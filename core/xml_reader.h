@@ -0,0 +1,83 @@
+#ifndef MAGNET_CORE_XML_READER_H_
+#define MAGNET_CORE_XML_READER_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace magnet {
+namespace core {
+// a range of the document, entities are not decoded
+struct XmlView {
+  XmlView() : begin(nullptr), end(nullptr) {}
+  XmlView(const char* begin, const char* end) : begin(begin), end(end) {}
+
+  bool IsEmpty() const { return begin == end; }
+  bool Equals(const char* value) const;
+  // with &lt; &gt; &amp; &quot; &apos; and character references decoded
+  void AppendDecoded(std::string* value) const;
+  std::string ToString() const;
+
+  const char* begin;
+  const char* end;
+};
+
+// pulls the elements of an xml document one at a time from a buffer that
+// is not null terminated, without building a tree or copying the text.
+// the reader is always inside an element, the document at first:
+//
+//   while (reader.NextChild()) {
+//     if (reader.GetName().Equals("entity"))
+//       ReadEntity(&reader);    // reads or skips the children itself
+//     else
+//       reader.SkipElement();
+//   }
+//
+// comments, processing instructions and the doctype are skipped. the text
+// of an element is what comes before its first child, like tinyxml2's
+// GetText. memory stays at the deepest nesting and most attributes seen.
+class XmlReader {
+ public:
+  XmlReader(const char* data, size_t size);
+
+  // enters the next child of the current element. false once the current
+  // element ends, the reader is then back in its parent.
+  bool NextChild();
+  // leaves the current element, with all of its children
+  void SkipElement();
+
+  // of the element entered last
+  const XmlView& GetName() const;
+  // empty if the element starts with a child or has only white space
+  const XmlView& GetText() const;
+  bool FindAttribute(const char* name, XmlView* value) const;
+
+  // malformed markup, mismatched tags or an end of data inside an element.
+  // NextChild returns false from then on.
+  bool HasError() const;
+  int GetDepth() const;
+
+ private:
+  struct Attribute {
+    XmlView name;
+    XmlView value;
+  };
+
+  bool ReadStartTag();
+  bool ReadEndTag();
+  // past the next occurrence of terminator, false if there is none
+  bool SkipPast(const char* terminator);
+  void SetError();
+
+  const char* p_;
+  const char* end_;
+  XmlView name_;
+  XmlView text_;
+  std::vector<Attribute> attributes_;
+  std::vector<XmlView> open_names_;
+  bool self_closed_;
+  bool error_;
+};
+}  // namespace core
+}  // namespace magnet
+#endif  // MAGNET_CORE_XML_READER_H_
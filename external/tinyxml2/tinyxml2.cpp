@@ -1688,6 +1688,34 @@ XMLError XMLDocument::Parse( const char* p, size_t len )
 }
 
 
+XMLError XMLDocument::ParseInPlace( char* xml, size_t len )
+{
+    Clear();
+
+    if ( !xml || !len || !*xml ) {
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+    if ( len != (size_t)(-1) ) {
+        if ( !XMLUtil::IsWhiteSpace( xml[len-1] ) ) {
+            return Parse( xml, len );
+        }
+        xml[len-1] = 0;
+    }
+
+    const char* p = xml;
+    p = XMLUtil::SkipWhiteSpace( p );
+    p = XMLUtil::ReadBOM( p, &_writeBOM );
+    if ( !p || !*p ) {
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+
+    ParseDeep( xml + (p-xml), 0 );
+    return _errorID;
+}
+
+
 void XMLDocument::Print( XMLPrinter* streamer )
 {
     XMLPrinter stdStreamer( stdout );
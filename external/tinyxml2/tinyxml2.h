@@ -1436,6 +1436,25 @@ public:
     */
     XMLError Parse( const char* xml, size_t nBytes=(size_t)(-1) );
 
+    /**
+    	Parse an XML document in place, without copying it. Names, values
+    	and text are decoded within 'xml' and the nodes point into it, so
+    	it must be writable and outlive the parse, until the document is
+    	cleared, parses again or is deleted. A copy on write mapping of the
+    	file works well.
+
+    	Without 'nBytes' the buffer must be null terminated. If 'nBytes'
+    	is given it need not be: the terminator is written over the last
+    	byte when that is white space, as the end of a file usually is.
+    	When it is not, the buffer is copied and left alone, as Parse()
+    	does.
+
+    	Parsing again, in place or not, reuses the node pools of the
+    	document, so one document kept for many files only allocates when
+    	a file has more nodes than any before it.
+    */
+    XMLError ParseInPlace( char* xml, size_t nBytes=(size_t)(-1) );
+
     /**
     	Load an XML file from disk.
     	Returns XML_NO_ERROR (0) on success, or
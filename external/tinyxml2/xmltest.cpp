@@ -264,6 +264,39 @@ bool example_4()
 */
 
 
+// Average milli-seconds to parse 'count' copies of 'xml', either with Parse()
+// into new documents or in place into one reused document. The copies are
+// made before timing, in place parsing writes to them.
+static double ParseTime( const char* xml, size_t size, bool inPlace, int count )
+{
+	char** copies = new char*[count];
+	for( int i=0; i<count; ++i ) {
+		copies[i] = new char[size];
+		memcpy( copies[i], xml, size );
+	}
+
+	XMLDocument reused;
+	clock_t cstart = clock();
+	for( int i=0; i<count; ++i ) {
+		if ( inPlace ) {
+			reused.ParseInPlace( copies[i], size );
+		}
+		else {
+			XMLDocument doc;
+			doc.Parse( copies[i], size );
+		}
+	}
+	reused.Clear();
+	clock_t cend = clock();
+
+	for( int i=0; i<count; ++i ) {
+		delete [] copies[i];
+	}
+	delete [] copies;
+	return 1000.0 * (double)(cend - cstart) / ( (double)CLOCKS_PER_SEC * (double)count );
+}
+
+
 int main( int argc, const char ** argv )
 {
 	#if defined( _MSC_VER ) && defined( DEBUG )
@@ -1165,6 +1198,64 @@ int main( int argc, const char ** argv )
 	}
 
 
+	// ----------- In place parsing --------------
+	{
+		const char* xml = "<?xml version=\"1.0\"?>\n"
+						  "<scene>\n"
+						  "  <entity type=\"normal\" name=\"a &amp; b\">\n"
+						  "    <mesh type=\"obj\">box&#x2e;obj</mesh>\n"
+						  "  </entity>\n"
+						  "</scene>\n";
+		const size_t size = strlen( xml );
+
+		// No null terminator, the last newline becomes one.
+		char* mem = new char[size];
+		memcpy( mem, xml, size );
+
+		XMLDocument doc;
+		doc.ParseInPlace( mem, size );
+		XMLTest( "In place: error", XML_NO_ERROR, doc.ErrorID() );
+		const XMLElement* entity = doc.FirstChildElement( "scene" )->FirstChildElement( "entity" );
+		XMLTest( "In place: attribute", "a & b", entity->Attribute( "name" ) );
+		XMLTest( "In place: text", "box.obj", entity->FirstChildElement( "mesh" )->GetText() );
+		XMLTest( "In place: points into the buffer", true,
+				 entity->Attribute( "type" ) >= mem && entity->Attribute( "type" ) < mem + size );
+
+		// The same document again, its nodes come back from the pools.
+		const char* other = "<scene><entity type='camera'/></scene>\n";
+		char* mem2 = new char[strlen( other )];
+		memcpy( mem2, other, strlen( other ) );
+		doc.ParseInPlace( mem2, strlen( other ) );
+		XMLTest( "In place: reused document", "camera",
+				 doc.FirstChildElement( "scene" )->FirstChildElement( "entity" )->Attribute( "type" ) );
+		XMLTest( "In place: reused document", true,
+				 doc.FirstChildElement( "scene" )->FirstChildElement( "entity" )->NextSiblingElement() == 0 );
+
+		// Without trailing white space the buffer is copied and left alone.
+		const char* tight = "<a b='1'/>";
+		char* mem3 = new char[strlen( tight )];
+		memcpy( mem3, tight, strlen( tight ) );
+		doc.ParseInPlace( mem3, strlen( tight ) );
+		XMLTest( "In place: copied", 1, doc.FirstChildElement( "a" )->IntAttribute( "b" ) );
+		XMLTest( "In place: copied", true, memcmp( mem3, tight, strlen( tight ) ) == 0 );
+
+		doc.ParseInPlace( mem2, 0 );
+		XMLTest( "In place: empty", XML_ERROR_EMPTY_DOCUMENT, doc.ErrorID() );
+
+		// Null terminated, the same as Parse.
+		char bad[] = "<a><b></a>";
+		doc.ParseInPlace( bad );
+		XMLDocument copied;
+		copied.Parse( "<a><b></a>" );
+		XMLTest( "In place: error as Parse", copied.ErrorID(), doc.ErrorID() );
+
+		doc.Clear();
+		delete [] mem;
+		delete [] mem2;
+		delete [] mem3;
+	}
+
+
 	// ----------- Performance tracking --------------
 	{
 #if defined( _MSC_VER )
@@ -1214,6 +1305,55 @@ int main( int argc, const char ** argv )
 #endif
 	}
 
+	// In place into a reused document, against a copy into a new one each time,
+	// for dream.xml and a large generated scene file.
+	{
+		FILE* fp  = fopen( "resources/dream.xml", "rb" );
+		if ( fp ) {
+			fseek( fp, 0, SEEK_END );
+			long size = ftell( fp );
+			fseek( fp, 0, SEEK_SET );
+			char* mem = new char[size];
+			if ( fread( mem, size, 1, fp ) == 1 ) {
+				printf( "Parsing dream.xml: copy %.3f, in place %.3f milli-seconds\n",
+						ParseTime( mem, size, false, 10 ), ParseTime( mem, size, true, 10 ) );
+			}
+			fclose( fp );
+			delete [] mem;
+		}
+		else {
+			printf( "Error opening test file 'dream.xml', in place timing skipped.\n" );
+		}
+
+		static const int ENTITIES = 20000;
+		static const char* entity =
+			"  <entity type=\"normal\" name=\"entity\">\n"
+			"    <transform>\n"
+			"      <translate>1.5 -2.25 3</translate>\n"
+			"      <rotate>0 90 0</rotate>\n"
+			"      <scale>1 1 1</scale>\n"
+			"    </transform>\n"
+			"    <component type=\"mesh\" name=\"mesh\">\n"
+			"      <mesh type=\"obj\">sponza.obj</mesh>\n"
+			"    </component>\n"
+			"  </entity>\n";
+		const size_t entitySize = strlen( entity );
+		const size_t sceneSize = 8 + ENTITIES*entitySize + 9;
+		char* scene = new char[sceneSize];
+		char* q = scene;
+		memcpy( q, "<scene>\n", 8 );
+		q += 8;
+		for( int i=0; i<ENTITIES; ++i ) {
+			memcpy( q, entity, entitySize );
+			q += entitySize;
+		}
+		memcpy( q, "</scene>\n", 9 );
+
+		printf( "Parsing a %dk scene: copy %.3f, in place %.3f milli-seconds\n", (int)(sceneSize/1024),
+				ParseTime( scene, sceneSize, false, 10 ), ParseTime( scene, sceneSize, true, 10 ) );
+		delete [] scene;
+	}
+
 	#if defined( _MSC_VER ) &&  defined( DEBUG )
 		_CrtMemCheckpoint( &endMemState );
 		//_CrtMemDumpStatistics( &endMemState );
@@ -5,10 +5,19 @@
 #include "scene\input_manager.h"
 #include "scene\scene_manager.h"
 #include "scene\ientity.h"
+#include "core/file_system.h"
+#include "core/task_manager.h"
 
 #include "application.h"
 #include "render_window.h"
-#include "task_manager.h"
+
+namespace {
+static const char DATA_PATH[256] = "C:\\DDrive\\projects\\magnet\\data\\";
+static const char SHADER_PATH[256] = "C:\\Projects\\GitHub\\LightBaker\\data\\shader\\";
+
+// packed by the cooker next to the loose data, searched before it
+static const char DATA_ARCHIVE_NAME[] = "data.mpak";
+}  // namespace
 
 Application* Application::instance_ = nullptr;
 
@@ -61,20 +70,22 @@ void Application::DestoryWindow() {
 
 void Application::InitializeSystem(bool console) {
   enable_console_ = console;
+  MountFileSystem();
   InitializeSingletons();
 
-  TaskManager::GetInstance()->BeginThreads(3);
+  magnet::core::TaskManager::GetInstance()->BeginThreads(3);
 
   // a dedicated thread for rendering
-  Task task;
+  magnet::core::Task task;
   task.func = std::bind(&magnet::render::RenderManager::Render, magnet::render::RenderManager::GetInstance());
-  TaskManager::GetInstance()->EnqueueTask(task);
+  magnet::core::TaskManager::GetInstance()->EnqueueTask(task);
 
   DistributeTasks();
 }
 
 void Application::DestroySystem() {
   TerminateSingletons();
+  magnet::core::FileSystem::UnmountAll();
 }
 
 void Application::Terminate() {
@@ -93,7 +104,7 @@ void Application::Update() {
 
   auto render_manager = magnet::render::RenderManager::GetInstance();
 
-  if (!TaskManager::GetInstance()->HasTasks()) {
+  if (!magnet::core::TaskManager::GetInstance()->HasTasks()) {
     // distribute update tasks for the next frame
     // TODO: not all tasks might be finished
     
@@ -126,9 +137,7 @@ void Application::Update() {
   }
   else {
     // help other game threads do some work
-    Task task;
-    TaskManager::GetInstance()->DequeueTask(task);
-    task.Execute();
+    magnet::core::TaskManager::GetInstance()->ExecuteTask();
     return;
   }
 
@@ -137,13 +146,8 @@ void Application::Update() {
 }
 
 void Application::DistributeTasks() {
-  std::vector<magnet::scene::IEntity*> * entities =
-    magnet::scene::SceneManager::GetInstance()->GetEntities();
-  for (auto entity : *entities) {
-    Task task;
-    task.func = std::bind(&magnet::scene::IEntity::Update, entity);
-    TaskManager::GetInstance()->EnqueueTask(task);
-  }
+  // the scene manager splits the update into tasks and helps run them
+  magnet::scene::SceneManager::GetInstance()->UpdateEntities();
 }
 
 void Application::OnButtonDown(char button) {  
@@ -200,6 +204,13 @@ void Application::OnMouseWheel(WPARAM wparam) {
   instance->SetWheelDelta(delta);
 }
 
+void Application::MountFileSystem() {
+  magnet::core::FileSystem::MountFolder("", DATA_PATH);
+  magnet::core::FileSystem::MountFolder("shader/", SHADER_PATH);
+  magnet::core::FileSystem::MountArchive("",
+    std::string(DATA_PATH) + DATA_ARCHIVE_NAME);
+}
+
 void Application::InitializeSingletons() {
   magnet::scene::SceneManager::Initialize();
   magnet::scene::InputManager::Initialize();
@@ -207,12 +218,12 @@ void Application::InitializeSingletons() {
   magnet::render::RenderManager::Initialize(render_window_->GetWidth(),
     render_window_->GetHeight(), render_window_->GetHandle());
 
-  TaskManager::Initialize();
+  magnet::core::TaskManager::Initialize();
 }
 
 void Application::TerminateSingletons() {
 
-  TaskManager::Terminate();
+  magnet::core::TaskManager::Terminate();
 
   magnet::render::RenderManager::Terminate();
   magnet::render::ResourceManager::Terminate();
@@ -39,6 +39,8 @@ class Application {
   void OnMouseWheel(WPARAM wParam);
 
  private:
+  // the data folders and archive assets are read from
+  void MountFileSystem();
   void InitializeSingletons();
   void TerminateSingletons();
 
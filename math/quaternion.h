@@ -1,10 +1,14 @@
 #ifndef MAGNET_MATH_QUATERNION_H_
 #define MAGNET_MATH_QUATERNION_H_
 
+#include <cmath>
+
 #include "Matrix4.h"
 
 namespace magnet {
 namespace math {
+// w_ is the real part, the identity rotation is (0, 0, 0, 1). a * b
+// rotates by b first, then by a.
 template <typename T>
 class Quaternion {
  public:
@@ -29,6 +33,8 @@ class Quaternion {
   Quaternion<T> operator * (T t) const;
   Quaternion<T> operator / (T t) const;
 
+  // angle in radians about axis, which need not be normalized. a zero axis
+  // is no rotation.
   static Quaternion<T> FromAxisAndAngle(T angle, const Vector3<T>& axis);
 
  public:
@@ -56,7 +62,7 @@ inline Quaternion<T>::Quaternion(const Quaternion<T>& q) :
 }
 
 template <typename T>
-inline Quaternion<T>::Quaternion(T t) : x_(t), y_(t), z_(t), w(t) {
+inline Quaternion<T>::Quaternion(T t) : x_(t), y_(t), z_(t), w_(t) {
 }
 
 template <typename T>
@@ -71,7 +77,7 @@ inline Quaternion<T>& Quaternion<T>::operator = (const Quaternion<T>& q) {
 template <typename T>
 inline Quaternion<T> Quaternion<T>::operator - () const
 {
-  return Quaternion<T>(-x, -y, -z, -w);
+  return Quaternion<T>(-x_, -y_, -z_, -w_);
 }
 
 template <typename T>
@@ -94,10 +100,7 @@ inline Quaternion<T>& Quaternion<T>::operator -= (const Quaternion<T>& q) {
 
 template <typename T>
 inline Quaternion<T>& Quaternion<T>::operator *= (const Quaternion<T>& q) {
-  x_ = x_ * q.x_ - y_ * q.y_ - z_ * q.z_ - w_ * q.w_;
-  y_ = x_ * q.y_ + y_ * q.x_ + z_ * q.w_ - w_ * q.z_;
-  z_ = x_ * q.z_ - y_ * q.w_ + z_ * q.x_ + w_ * q.y_;
-  w_ = x_ * q.w_ + y_ * q.y_ - z_ * q.y_ + w_ * q.x_;
+  *this = *this * q;
   return *this;
 }
 
@@ -132,10 +135,10 @@ inline Quaternion<T> Quaternion<T>::operator - (const Quaternion<T>& q) const {
 
 template <typename T>
 inline Quaternion<T> Quaternion<T>::operator * (const Quaternion<T>& q) const {
-  return Quaternion<T>(x_ * q.x_ - y_ * q.y_ - z_ * q.z_ - w_ * q.w_,
-    x_ * q.y_ + y_ * q.x_ + z_ * q.w_ - w_ * q.z_,
-    x_ * q.z_ - y_ * q.w_ + z_ * q.x_ + w_ * q.y_,
-    x_ * q.w_ + y_ * q.y_ - z_ * q.y_ + w_ * q.x_);
+  return Quaternion<T>(w_ * q.x_ + x_ * q.w_ + y_ * q.z_ - z_ * q.y_,
+    w_ * q.y_ - x_ * q.z_ + y_ * q.w_ + z_ * q.x_,
+    w_ * q.z_ + x_ * q.y_ - y_ * q.x_ + z_ * q.w_,
+    w_ * q.w_ - x_ * q.x_ - y_ * q.y_ - z_ * q.z_);
 }
 
 template <typename T>
@@ -149,6 +152,7 @@ inline Quaternion<T> Quaternion<T>::operator / (T t) const {
   return Quaternion<T>(x_ * inv, y_ * inv, z_ * inv, w_ * inv);
 }
 
+// the rotation matrix of q, for column vectors
 template <typename T>
 inline Matrix4<T> ToMatrix(const Quaternion<T>& q) {
   Matrix4<T> m;
@@ -164,26 +168,31 @@ inline Matrix4<T> ToMatrix(const Quaternion<T>& q) {
   m.m2_[1][1] = (-sqx + sqy - sqz + sqw) * invs;
   m.m2_[2][2] = (-sqx - sqy + sqz + sqw) * invs;
 
-  T tmp1 = q.x * q.y;
-  T tmp2 = q.z * q.w;
+  T tmp1 = q.x_ * q.y_;
+  T tmp2 = q.z_ * q.w_;
   m.m2_[1][0] = 2.0 * (tmp1 + tmp2) * invs;
   m.m2_[0][1] = 2.0 * (tmp1 - tmp2) * invs;
 
-  tmp1 = q.x * q.z;
-  tmp2 = q.y * q.w;
+  tmp1 = q.x_ * q.z_;
+  tmp2 = q.y_ * q.w_;
   m.m2_[2][0] = 2.0 * (tmp1 - tmp2) * invs;
   m.m2_[0][2] = 2.0 * (tmp1 + tmp2) * invs;
 
-  tmp1 = q.y * q.z;
-  tmp2 = q.x * q.w;
+  tmp1 = q.y_ * q.z_;
+  tmp2 = q.x_ * q.w_;
   m.m2_[2][1] = 2.0 * (tmp1 + tmp2) * invs;
   m.m2_[1][2] = 2.0 * (tmp1 - tmp2) * invs;
+  return m;
 }
 
 template <typename T>
 Quaternion<T> Quaternion<T>::FromAxisAndAngle(T angle, const Vector3<T>& axis) {
-  //TODO
-  return Quaternion<T>();
+  const T kLength = axis.Length();
+  if (kLength <= T(0))
+    return Quaternion<T>(0.0, 0.0, 0.0, 1.0);
+  const T kSin = std::sin(angle * T(0.5)) / kLength;
+  return Quaternion<T>(axis.x_ * kSin, axis.y_ * kSin, axis.z_ * kSin,
+    std::cos(angle * T(0.5)));
 }
 
 }  // namespace math
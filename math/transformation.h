@@ -7,6 +7,7 @@
 
 namespace magnet {
 namespace math {
+// scale, then rotation, then translation
 template <typename T>
 class Transformation {
  public:
@@ -18,6 +19,7 @@ class Transformation {
   void Scale(T x, T y, T z);
   void Scale(T scale);
   void Rotate(const Quaternion<T>& rotation);
+  // angle in radians, the rotation is applied after the current one
   void Rotate(T angle, const Vector3<T>& axis);
   void Rotate(T angle, T x, T y, T z);
 
@@ -29,6 +31,7 @@ class Transformation {
   void SetScale(const Vector3<T>& scale);
   void SetRotation(const Quaternion<T>& rotation);
 
+  // translation * rotation * scale, for column vectors
   Matrix4<T> ToMatrix();
 
  private:
@@ -48,7 +51,7 @@ template <typename T>
 inline Transformation<T>::Transformation()
     : translation_(0.0, 0.0, 0.0),
       scale_(1.0, 1.0, 1.0),
-      rotation_(1.0, 0.0, 0.0, 0.0),
+      rotation_(0.0, 0.0, 0.0, 1.0),
       m_(),
       is_dirty_(false) {
 }
@@ -92,13 +95,13 @@ inline void Transformation<T>::Rotate(const Quaternion<T>& rotation) {
 template <typename T>
 inline void Transformation<T>::Rotate(T angle, const Vector3<T>& axis) {
   is_dirty_ = true;
-  Rotate(Quaternion<T>::FromAxisAndAngle(axis, angle));
+  Rotate(Quaternion<T>::FromAxisAndAngle(angle, axis));
 }
 
 template <typename T>
 inline void Transformation<T>::Rotate(T angle, T x, T y, T z) {
   is_dirty_ = true;
-  Rotate(Quaternion<T>::FromAxisAndAngle(angle, Vector3f(x, y, z)));
+  Rotate(Quaternion<T>::FromAxisAndAngle(angle, Vector3<T>(x, y, z)));
 }
 
 template <typename T>
@@ -137,10 +140,15 @@ inline Matrix4<T> Transformation<T>::ToMatrix() {
   if (is_dirty_) {
     is_dirty_ = false;
 
-    m_.SetToIdentity();
-    //m_.Translate(translation_);
-    //m_.rotate(rotation_);
-    //m_.scale(scale_);
+    m_ = math::ToMatrix(rotation_);
+    const T kScale[3] = { scale_.x_, scale_.y_, scale_.z_ };
+    const T kTranslation[3] = {
+      translation_.x_, translation_.y_, translation_.z_ };
+    for (int row = 0; row < 3; ++row) {
+      for (int column = 0; column < 3; ++column)
+        m_.m2_[row][column] *= kScale[column];
+      m_.m2_[row][3] = kTranslation[row];
+    }
   }
 
   return m_;
@@ -5,6 +5,7 @@
 #include "math\vector4.h"
 
 #define MAX_CASCADE_COUNT 4
+#define SH_COEFFICIENTS_COUNT 9
 
 namespace magnet {
 namespace render {
@@ -33,6 +34,9 @@ struct CBufferLights {
 
   math::Vector4f v4PointLightPosition[3];
   math::Vector4f v4PointLightColor[3];
+
+  // order 3 spherical harmonics of the sky radiance, rgb in xyz
+  math::Vector4f sky_sh[SH_COEFFICIENTS_COUNT];
 };
 
 struct CBufferToneMapping {
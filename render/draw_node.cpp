@@ -1,4 +1,4 @@
-#include <stdlib.h>
+#include "core/allocator.h"
 
 #include "draw_node.h"
 
@@ -15,6 +15,8 @@ DrawNode::DrawNode() : samplers_count(0), srvs_count(0),
   for (int i = 0; i < MAX_NUMBER_BUFFERS; ++i) {
     vs_cbuffer_data[i] = nullptr;
     ps_cbuffer_data[i] = nullptr;
+    vs_cbuffer_sizes[i] = 0;
+    ps_cbuffer_sizes[i] = 0;
   }
 }
 
@@ -64,25 +66,55 @@ void DrawNode::CreateCBufferData(int size, ShaderType type)
   void* pBuffer = 0;
 
   if (type == VERTEX_SHADER) {
-    pBuffer = malloc(size);
+    pBuffer = core::TaggedHeap::Allocate(core::MEMORY_TAG_RENDER_FRAME, size);
+    vs_cbuffer_sizes[vs_cbuffers_count] = size;
     vs_cbuffer_data[vs_cbuffers_count++] = pBuffer;
   } else if (type == PIXEL_SHADER) {
-    pBuffer = malloc(size);
+    pBuffer = core::TaggedHeap::Allocate(core::MEMORY_TAG_RENDER_FRAME, size);
+    ps_cbuffer_sizes[ps_cbuffers_count] = size;
     ps_cbuffer_data[ps_cbuffers_count++] = pBuffer;
   }
 }
 
+void DrawNode::CloneCBufferLayout(const DrawNode& draw_node) {
+  for (int i = 0; i < draw_node.vs_cbuffers_count; ++i) {
+    CreateCBufferData(draw_node.vs_cbuffer_sizes[i], VERTEX_SHADER);
+  }
+  for (int i = 0; i < draw_node.ps_cbuffers_count; ++i) {
+    CreateCBufferData(draw_node.ps_cbuffer_sizes[i], PIXEL_SHADER);
+  }
+}
+
+void DrawNode::DestroyCBuffers() {
+  for (int i = 0; i < vs_cbuffers_count; ++i) {
+    DestroyCBufferData(vs_cbuffer_data[i]);
+    vs_cbuffer_data[i] = nullptr;
+  }
+  for (int i = 0; i < ps_cbuffers_count; ++i) {
+    DestroyCBufferData(ps_cbuffer_data[i]);
+    ps_cbuffer_data[i] = nullptr;
+  }
+  vs_cbuffers_count = 0;
+  ps_cbuffers_count = 0;
+}
+
+void DrawNode::ResetBindings() {
+  srvs_count = 0;
+  samplers_count = 0;
+}
+
 void* DrawNode::GetCBufferData(int index, ShaderType type) {
   if (type == VERTEX_SHADER) {
     return vs_cbuffer_data[index];
   } else if (type == PIXEL_SHADER) {
     return ps_cbuffer_data[index];
   }
+  return nullptr;
 }
 
 void DrawNode::DestroyCBufferData(void* pBuffer)
 {
-  free(pBuffer);
+  core::TaggedHeap::Free(pBuffer);
 }
 
 } // namespace Renderer
@@ -25,6 +25,13 @@ struct DrawNode {
   void* GetCBufferData(int index, ShaderType type);
   void DestroyCBufferData(void* data);
 
+  // allocate the same const buffers layout as the given draw node
+  void CloneCBufferLayout(const DrawNode& draw_node);
+  void DestroyCBuffers();
+
+  // reset per frame bindings when the node gets reused
+  void ResetBindings();
+
   // geometry
   ID3D11Buffer* vertex_buffer;
   ID3D11Buffer* index_buffer;
@@ -32,6 +39,8 @@ struct DrawNode {
   // c buffers
   void* vs_cbuffer_data[MAX_NUMBER_BUFFERS];
   void* ps_cbuffer_data[MAX_NUMBER_BUFFERS];
+  int vs_cbuffer_sizes[MAX_NUMBER_BUFFERS];
+  int ps_cbuffer_sizes[MAX_NUMBER_BUFFERS];
 
   // textures
   ID3D11ShaderResourceView* srvs[MAX_NUMBER_SRVS];
@@ -10,7 +10,7 @@ namespace magnet {
 namespace render {
 struct MeshResource {
   MeshResource() : elements_count(0), primitives_count(0), stride(0),
-    vertex_buffer(nullptr), index_buffer(nullptr)
+    units_per_uv(0.f), vertex_buffer(nullptr), index_buffer(nullptr)
   {}
 
   // semantic:
@@ -43,6 +43,7 @@ struct MeshResource {
   int elements_count;
   int primitives_count;
   int stride;
+  float units_per_uv;   // mesh units one uv unit spans, 0 without uvs
 
   char input_layout_str[64];
 
@@ -53,7 +54,8 @@ struct MeshResource {
 };
 
 struct TextureResource {
-  TextureResource() : label(""), texture(nullptr), sampler(nullptr) {
+  TextureResource() : label(""), texture(nullptr), srv(nullptr),
+    sampler(nullptr) {
   }
 
   std::string label;
@@ -30,10 +30,10 @@ enum MaterialTech {
 
 class Material {
  public:
-   Material() {}
-  explicit Material(unsigned char tech) {
-    //tech_ = 
-  }
+  Material() : textures_count_(0), exponent_(0.f), tech_char_(0),
+    tech_(static_cast<MaterialTech>(0)) {}
+  explicit Material(unsigned char tech) : textures_count_(0), exponent_(0.f),
+    tech_char_(tech), tech_(static_cast<MaterialTech>(tech)) {}
 
   void SetAmbient(const math::Vector4f& ambient);
   void SetDiffuse(const math::Vector4f& diffuse);
@@ -1,4 +1,7 @@
 #include <string>
+#include <utility>
+
+#include "core/allocator.h"
 
 #include "mesh.h"
 
@@ -12,9 +15,16 @@ namespace render {
     faces_count_(0),
     is_loaded_(false),
     stride_(0),
-    decls_count_(0) {}
+    decls_count_(0),
+    owns_vertex_data_(false),
+    owns_index_data_(false) {}
 
-Mesh::~Mesh() {}
+Mesh::~Mesh() {
+  if (owns_vertex_data_)
+    core::TaggedHeap::Free(vertex_data_);
+  if (owns_index_data_)
+    core::TaggedHeap::Free(index_data_);
+}
 
 void Mesh::SetVertsCount(int verts_count) {
   verts_count_ = verts_count;
@@ -69,21 +79,56 @@ void Mesh::SetLoaded(bool loaded) {
 
 float* Mesh::CreateVertexDataBuffer(int iNumVertices, int iNumFloats) {
   stride_ = iNumFloats;
-  vertex_data_ = malloc(iNumVertices * iNumFloats * sizeof(float));
+  if (owns_vertex_data_)
+    core::TaggedHeap::Free(vertex_data_);
+  vertex_data_ = core::TaggedHeap::Allocate(core::MEMORY_TAG_MESH,
+    iNumVertices * iNumFloats * sizeof(float));
+  owns_vertex_data_ = true;
+  // the owner stays while the other buffer is external
+  if (owns_index_data_)
+    data_owner_.reset();
   return static_cast<float*>(vertex_data_);
 }
 
 unsigned int* Mesh::CreateIndexDataBuffer(int iNumFaces) {
-  index_data_ = malloc(iNumFaces * 3 * sizeof(unsigned int));
+  if (owns_index_data_)
+    core::TaggedHeap::Free(index_data_);
+  index_data_ = core::TaggedHeap::Allocate(core::MEMORY_TAG_MESH,
+    iNumFaces * 3 * sizeof(unsigned int));
+  owns_index_data_ = true;
+  if (owns_vertex_data_)
+    data_owner_.reset();
   return static_cast<unsigned int*>(index_data_);
 }
 
+bool Mesh::SetExternalData(int stride, const void* vertex_data,
+  const void* index_data, std::shared_ptr<const void> owner) {
+  if (!owner)
+    return false;
+  if (owns_vertex_data_)
+    core::TaggedHeap::Free(vertex_data_);
+  if (owns_index_data_)
+    core::TaggedHeap::Free(index_data_);
+
+  stride_ = stride;
+  vertex_data_ = const_cast<void*>(vertex_data);
+  index_data_ = const_cast<void*>(index_data);
+  owns_vertex_data_ = false;
+  owns_index_data_ = false;
+  data_owner_ = std::move(owner);
+  return true;
+}
+
+void Mesh::SetBBox(const math::AABBf& bbox) {
+  bbox_ = bbox;
+}
+
 void Mesh::AddVertexDecl(VertexDecl decl) {
   vertex_decls_[decls_count_++] = decl;
 }
 
 void Mesh::GetVetexDecls(int* decls_count, VertexDecl* pDecls) const {
-  //TODO
+  GetDecls(decls_count, pDecls);
 }
 }  // namespace scene
 }  // namespace magnet
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef MAGNET_RENDER_MESH_H_
 #define MAGNET_RENDER_MESH_H_
 
+#include <memory>
 #include <string>
 
 #include "math\vector3.h"
@@ -47,6 +48,13 @@ class Mesh {
   float* CreateVertexDataBuffer(int iNumVertices, int iNumFloats);
   unsigned int* CreateIndexDataBuffer(int iNumFaces);
 
+  // uses vertex and index data owned by someone else, e.g. a mapped cache
+  // file. owner is kept alive as long as the mesh, false and nothing
+  // changes without one.
+  bool SetExternalData(int stride, const void* vertex_data,
+    const void* index_data, std::shared_ptr<const void> owner);
+  void SetBBox(const math::AABBf& bbox);
+
  protected:
   std::string name_;
   void* vertex_data_;
@@ -62,6 +70,11 @@ class Mesh {
   VertexDecl vertex_decls_[MAX_DESC_COUNT];
 
   math::AABBf bbox_;
+
+  // whether the buffers are from the heap, external data is not freed
+  bool owns_vertex_data_;
+  bool owns_index_data_;
+  std::shared_ptr<const void> data_owner_;
 };
 }  // namespace render
 }  //namespace magnet
@@ -1,3 +1,4 @@
+#include <algorithm>
 
 #include "render_pass.h"
 #include "render_manager.h"
@@ -11,6 +12,7 @@
 #include "mesh.h"
 #include "texture.h"
 #include "material.h"
+#include "resource_manager.h"
 
 namespace magnet {
 namespace render {
@@ -23,6 +25,13 @@ RenderManager::RenderManager() {
   update_frame_count_ = 0;
   render_ = false;
   stop_render_ = false;
+  update_index_ = 0;
+  render_index_ = 1;
+  swap_chain_ = nullptr;
+  window_handle_ = nullptr;
+  device_ = nullptr;
+  device_context_immediate_ = nullptr;
+  frame_buffer_ = nullptr;
 }
 
 RenderManager::~RenderManager() {
@@ -43,7 +52,7 @@ void RenderManager::Initialize(int width, int height, void* window_handle) {
   instance_->render_passes_.emplace_back(new RenderPassOpaque());
 }
 
-void RenderManager::InitializeDXSystem() {
+bool RenderManager::CreateDevice() {
   HRESULT hr = S_OK;
 
   UINT createDeviceFlags = 0;
@@ -52,41 +61,85 @@ void RenderManager::InitializeDXSystem() {
   createDeviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
 #endif
 
-  D3D_DRIVER_TYPE driverType = D3D_DRIVER_TYPE_HARDWARE;
-
   D3D_FEATURE_LEVEL featureLevels[] =
   {
     D3D_FEATURE_LEVEL_11_0
   };
   UINT numFeatureLevels = ARRAYSIZE(featureLevels);
 
-  DXGI_SWAP_CHAIN_DESC sd;
-  ZeroMemory(&sd, sizeof(sd));
-  sd.BufferCount = 1;
-  sd.BufferDesc.Width = width_;
-  sd.BufferDesc.Height = height_;
-  sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-  sd.BufferDesc.RefreshRate.Numerator = 60;
-  sd.BufferDesc.RefreshRate.Denominator = 1;
-  sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT | DXGI_USAGE_UNORDERED_ACCESS;
-  sd.OutputWindow = static_cast<HWND>(window_handle_);
-  sd.SampleDesc.Count = 1;
-  sd.SampleDesc.Quality = 0;
-  sd.Windowed = TRUE;
-
-  driver_type_ = D3D_DRIVER_TYPE_HARDWARE;
-  hr = D3D11CreateDeviceAndSwapChain(NULL, driver_type_, NULL,
-    createDeviceFlags, featureLevels, numFeatureLevels,
-    D3D11_SDK_VERSION, &sd, &swap_chain_, &device_,
-    &feature_level_, &device_context_immediate_);
+  if (window_handle_) {
+    DXGI_SWAP_CHAIN_DESC sd;
+    ZeroMemory(&sd, sizeof(sd));
+    sd.BufferCount = 1;
+    sd.BufferDesc.Width = width_;
+    sd.BufferDesc.Height = height_;
+    sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    sd.BufferDesc.RefreshRate.Numerator = 60;
+    sd.BufferDesc.RefreshRate.Denominator = 1;
+    sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT | DXGI_USAGE_UNORDERED_ACCESS;
+    sd.OutputWindow = static_cast<HWND>(window_handle_);
+    sd.SampleDesc.Count = 1;
+    sd.SampleDesc.Quality = 0;
+    sd.Windowed = TRUE;
+
+    driver_type_ = D3D_DRIVER_TYPE_HARDWARE;
+    hr = D3D11CreateDeviceAndSwapChain(NULL, driver_type_, NULL,
+      createDeviceFlags, featureLevels, numFeatureLevels,
+      D3D11_SDK_VERSION, &sd, &swap_chain_, &device_,
+      &feature_level_, &device_context_immediate_);
+
+    if (FAILED(hr)) {
+      printf("Failed to create DirectX 11 system.");
+      return false;
+    }
+
+    // final render target
+    hr = swap_chain_->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)& frame_buffer_);
+    return SUCCEEDED(hr);
+  }
+
+  // headless, no swap chain. fall back to the null driver when there is no
+  // hardware device, so the cpu side of the pipeline can still be measured
+  D3D_DRIVER_TYPE driver_types[] = {
+    D3D_DRIVER_TYPE_HARDWARE,
+    D3D_DRIVER_TYPE_NULL
+  };
+  for (D3D_DRIVER_TYPE driver_type : driver_types) {
+    driver_type_ = driver_type;
+    hr = D3D11CreateDevice(NULL, driver_type_, NULL, createDeviceFlags,
+      featureLevels, numFeatureLevels, D3D11_SDK_VERSION, &device_,
+      &feature_level_, &device_context_immediate_);
+    if (SUCCEEDED(hr))
+      break;
+  }
 
   if (FAILED(hr)) {
-    printf("Failed to create DirectX 11 system.");
-    return;
+    printf("Failed to create headless DirectX 11 device.");
+    return false;
   }
 
+  // offscreen frame buffer
+  D3D11_TEXTURE2D_DESC desc;
+  desc.Width = width_;
+  desc.Height = height_;
+  desc.ArraySize = 1;
+  desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+  desc.Usage = D3D11_USAGE_DEFAULT;
+  desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+  desc.MipLevels = 1;
+  desc.CPUAccessFlags = 0;
+  desc.MiscFlags = 0;
+  desc.SampleDesc.Count = 1;
+  desc.SampleDesc.Quality = 0;
+  hr = device_->CreateTexture2D(&desc, 0, &frame_buffer_);
+  return SUCCEEDED(hr);
+}
+
+void RenderManager::InitializeDXSystem() {
+  if (!CreateDevice())
+    return;
+
   // final render target
-  hr = swap_chain_->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)& frame_buffer_);
   D3D11_RENDER_TARGET_VIEW_DESC rtv_desc;
   rtv_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
   rtv_desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
@@ -274,17 +327,56 @@ void RenderManager::SetCameraData(const math::Matrix4f& view, const math::Matrix
   projection_[update_index_] = projection;
 }
 
+void RenderManager::SetMajorLightData(const math::Vector3f& direction,
+  const math::Vector3f& color) {
+  std::lock_guard<std::mutex> guard(lights_mutex_);
+  lights_.directional_light_dir =
+    math::Vector4f(direction.x_, direction.y_, direction.z_, 0.f);
+  lights_.directional_light_color =
+    math::Vector4f(color.x_, color.y_, color.z_, 1.f);
+}
+
+void RenderManager::SetSkyLighting(const math::Vector4f* coefficients,
+  int count) {
+  std::lock_guard<std::mutex> guard(lights_mutex_);
+  for (int i = 0; i < SH_COEFFICIENTS_COUNT; ++i) {
+    lights_.sky_sh[i] = i < count ? coefficients[i] :
+      math::Vector4f(0.f, 0.f, 0.f, 0.f);
+  }
+}
+
+void RenderManager::GetSHCubemap(math::Vector4f shCoeffs[], int iNumCoeffs) {
+  std::lock_guard<std::mutex> guard(lights_mutex_);
+  for (int i = 0; i < iNumCoeffs; ++i) {
+    shCoeffs[i] = i < SH_COEFFICIENTS_COUNT ? lights_.sky_sh[i] :
+      math::Vector4f(0.f, 0.f, 0.f, 0.f);
+  }
+}
+
+void RenderManager::GetLights(CBufferLights* lights) {
+  std::lock_guard<std::mutex> guard(lights_mutex_);
+  *lights = lights_;
+}
+
+void RenderManager::SetSpecularEnvironment(const std::string& specular_name,
+  const std::string& brdf_lut_name) {
+  std::lock_guard<std::mutex> guard(lights_mutex_);
+  specular_environment_name_ = specular_name;
+  brdf_lut_name_ = brdf_lut_name;
+}
+
+void RenderManager::GetSpecularEnvironment(std::string* specular_name,
+  std::string* brdf_lut_name) {
+  std::lock_guard<std::mutex> guard(lights_mutex_);
+  *specular_name = specular_environment_name_;
+  *brdf_lut_name = brdf_lut_name_;
+}
+
 void RenderManager::Render() {
   while (true) {
     std::lock_guard<std::mutex> guard(render_mutex_);
     if (render_) {
-      // render one frame, iterate render passes
-      for (RenderPass* render_pass : render_passes_) {
-        render_pass->Render(device_context_immediate_, view_port_, frame_buffer_rtv_,
-          frame_buffer_rtv_hdr_, frame_buffer_dsv_, rasterizer_state_,
-          depth_stencil_enabled_, depth_stencil_disabled_);
-      }
-      swap_chain_->Present(0, 0);
+      RenderFrame();
 
       // wait till next frame update finishes
       {
@@ -306,6 +398,34 @@ void RenderManager::Render() {
   }
 }
 
+void RenderManager::RenderFrame() {
+  // render one frame, iterate render passes
+  for (RenderPass* render_pass : render_passes_) {
+    render_pass->Render(device_context_immediate_, view_port_, frame_buffer_rtv_,
+      frame_buffer_rtv_hdr_, frame_buffer_dsv_, rasterizer_state_,
+      depth_stencil_enabled_, depth_stencil_disabled_);
+  }
+
+  if (swap_chain_)
+    swap_chain_->Present(0, 0);
+}
+
+RenderStats RenderManager::GetRenderStats() const {
+  RenderStats stats;
+  for (RenderPass* render_pass : render_passes_) {
+    const RenderStats& pass_stats = render_pass->GetRenderStats();
+    stats.surfaces_count += pass_stats.surfaces_count;
+    stats.draw_calls_count += pass_stats.draw_calls_count;
+    stats.primitives_count += pass_stats.primitives_count;
+    stats.shader_nodes_count += pass_stats.shader_nodes_count;
+  }
+  return stats;
+}
+
+bool RenderManager::IsHeadless() const {
+  return swap_chain_ == nullptr;
+}
+
 void RenderManager::StopRendering() {
   std::lock_guard<std::mutex> guard(render_mutex_);
   render_ = false;
@@ -334,6 +454,32 @@ void RenderManager::IncreaseUpdateFrameCount() {
 }
 
 void RenderManager::Update(Surface* surface) {
+  // the closest point of the bounding sphere of the surface decides how
+  // large its texels get on screen
+  const math::Matrix4f& view = view_[update_index_];
+  const math::Matrix4f& projection = projection_[update_index_];
+  const math::Matrix4f kWorld = surface->GetWorld();
+  const math::AABBf& bbox = surface->GetMesh()->GetBBox();
+  const math::Vector3f kCenter = bbox.GetCenter();
+  float scale = 0.f;
+  float world_center[3];
+  for (int i = 0; i < 3; ++i) {
+    const math::Vector3f kAxis(kWorld.m2_[0][i], kWorld.m2_[1][i],
+      kWorld.m2_[2][i]);
+    scale = std::max(scale, kAxis.Length());
+    world_center[i] = kWorld.m2_[i][0] * kCenter.x_ +
+      kWorld.m2_[i][1] * kCenter.y_ + kWorld.m2_[i][2] * kCenter.z_ +
+      kWorld.m2_[i][3];
+  }
+  const float kRadius =
+    (bbox.GetMaxPoint() - bbox.GetMinPoint()).Length() * 0.5f * scale;
+  const float kDepth = view.m2_[2][0] * world_center[0] +
+    view.m2_[2][1] * world_center[1] + view.m2_[2][2] * world_center[2] +
+    view.m2_[2][3] - kRadius;
+  static const float kMinDepth = 0.1f;
+  surface->SetScreenScale(projection.m2_[1][1] * height_ * 0.5f * scale /
+    std::max(kDepth, kMinDepth));
+
   for (RenderPass* render_pass : render_passes_) {
     render_pass->Update(device_, surface);
   }
@@ -342,6 +488,10 @@ void RenderManager::Update(Surface* surface) {
 void RenderManager::SwapDoubleBuffers() {
   std::swap(render_index_, update_index_);
 
+  // the requests of the frame just updated
+  if (ResourceManager::Exist())
+    ResourceManager::GetInstance()->GetTextureStreamer()->Update(device_);
+
   for (RenderPass* render_pass : render_passes_) {
     render_pass->SwapDoubleBuffers();
   }
@@ -3,8 +3,10 @@
 
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 #include <d3d11.h>
+#include "cbuffer_desc.h"
 #include "render_pass.h"
 #include "math\vector4.h"
 #include "math\vector3.h"
@@ -26,6 +28,8 @@ class RenderManager {
 
 public:
   static RenderManager* GetInstance();
+  // window_handle can be null, the render manager is headless then: there
+  // is no swap chain and frames are rendered into an offscreen frame buffer
   static void Initialize(int width, int height, void* window_handle);
   static bool Exist();
   static void Terminate();
@@ -47,6 +51,10 @@ public:
 
   // executed by render thread
   void Render();
+  // render passes for one frame, presents if there is a swap chain
+  void RenderFrame();
+  RenderStats GetRenderStats() const;
+  bool IsHeadless() const;
   void BeginRendering();
   void StopRendering();
 
@@ -66,10 +74,22 @@ public:
 
   void SetCameraData(const math::Matrix4f& view, const math::Matrix4f& projection);
 
+  // sky lighting as spherical harmonics coefficients, projected on the cpu
+  // from the environment cube map. missing ones are 0.
+  void SetSkyLighting(const math::Vector4f* coefficients, int count);
   void GetSHCubemap(math::Vector4f shCoeffs[], int iNumCoeffs);
+  // the lights surfaces submitted now are drawn with
+  void GetLights(CBufferLights* lights);
+  // textures of the prefiltered sky and its brdf lut, bound after the
+  // material textures of opaque surfaces
+  void SetSpecularEnvironment(const std::string& specular_name,
+    const std::string& brdf_lut_name);
+  void GetSpecularEnvironment(std::string* specular_name,
+    std::string* brdf_lut_name);
 
 private:
   void InitializeDXSystem();
+  bool CreateDevice();
   void CopyShadowParameters();
 
 private:
@@ -132,6 +152,11 @@ private:
   int render_frame_count_;
   std::mutex update_frame_count_mutex_;
 
+  CBufferLights lights_;
+  std::string specular_environment_name_;
+  std::string brdf_lut_name_;
+  std::mutex lights_mutex_;
+
   bool render_;
   bool stop_render_;
   std::mutex render_mutex_;
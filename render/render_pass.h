@@ -10,6 +10,17 @@ class IRenderObject;
 class ShaderNode;
 class Surface;
 
+// counters of one rendered frame, used for profiling
+struct RenderStats {
+  RenderStats() : surfaces_count(0), draw_calls_count(0),
+    primitives_count(0), shader_nodes_count(0) {}
+
+  int surfaces_count;
+  int draw_calls_count;
+  int primitives_count;
+  int shader_nodes_count;
+};
+
 enum PassType {
   PASS_DEPTH,
   PASS_SKY,
@@ -39,6 +50,9 @@ class RenderPass {
   virtual void Update(ID3D11Device* device, Surface* surface) = 0;
 
   virtual void SwapDoubleBuffers() = 0;
+
+  // statistics of the last frame rendered by this pass
+  virtual const RenderStats& GetRenderStats() const = 0;
 };
 }  // namespace render
 }  // namespace magnet
@@ -4,6 +4,7 @@
 #include "render_pass_opaque.h"
 #include "shader_node.h"
 #include "cbuffer_desc.h"
+#include "render_manager.h"
 #include "resource_manager.h"
 
 namespace magnet {
@@ -14,6 +15,10 @@ static const int kMaxDrawNodesCount = 30;
 
 RenderPassOpaque::RenderPassOpaque() {
   shadow_srv_ = nullptr;
+  update_index_ = 0;
+  render_index_ = 1;
+  surfaces_count_[0] = 0;
+  surfaces_count_[1] = 0;
 }
 
 RenderPassOpaque::~RenderPassOpaque() {
@@ -41,9 +46,13 @@ void RenderPassOpaque::Render(ID3D11DeviceContext* device_context,
 
   device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+  render_stats_ = RenderStats();
+  render_stats_.surfaces_count = surfaces_count_[render_index_];
+  render_stats_.shader_nodes_count = static_cast<int>(shader_nodes_.size());
+
   ShaderNode::BeginEvent("RenderPassOpaque");
   for (auto it : shader_nodes_) {
-    it.second->Draw(device_context);
+    it.second->Draw(device_context, &render_stats_);
   }
   ShaderNode::EndEvent();
 
@@ -58,6 +67,7 @@ PassType RenderPassOpaque::GetType() {
 
 void RenderPassOpaque::Update(ID3D11Device* device, Surface* surface) {
   std::lock_guard<std::mutex> guard(shader_nodes_mutex_);
+  surfaces_count_[update_index_]++;
 
   std::shared_ptr<Material> material = surface->GetMaterial();
   std::string shader_name;
@@ -84,6 +94,10 @@ void RenderPassOpaque::Update(ID3D11Device* device, Surface* surface) {
     desc.ByteWidth = sizeof(CBufferMaterialNormal);
     shader_node->CreateConstantBuffer(desc, device, PIXEL_SHADER);
 
+    // lights buffer, with the sky lighting
+    desc.ByteWidth = sizeof(CBufferLights);
+    shader_node->CreateConstantBuffer(desc, device, PIXEL_SHADER);
+
     // input layout, it requires v shader byte code, and input elements from mesh
     const std::string& mesh_name = surface->GetMesh()->GetName();
     ResourceManager* resource_manager = ResourceManager::GetInstance();
@@ -126,25 +140,54 @@ void RenderPassOpaque::Update(ID3D11Device* device, Surface* surface) {
   material->GetSpecular(&material_buffer->specular);
   material_buffer->specular.w_ = material->GetExponent();
 
-  // textures
+  CBufferLights* lights_buffer = static_cast<CBufferLights*>(
+    draw_node.GetCBufferData(1, render::PIXEL_SHADER));
+  RenderManager::GetInstance()->GetLights(lights_buffer);
+
+  // textures, streamed ones are asked for the levels this surface needs
+  // and bound with the levels they have now
+  TextureStreamer* texture_streamer = resource_manager->GetTextureStreamer();
   int textures_count = material->GetTexturesCount();
   for (int i = 0; i < textures_count; ++i) {
     const render::Texture* texture = material->GetTexture(i);
     std::string texName(texture->GetName());
     TextureResource& texture_resource = resource_manager->GetTextureResource(texName);
-    draw_node.AddSRV(texture_resource.srv);
+    ID3D11ShaderResourceView* srv = texture_streamer->Request(texName,
+      TextureStreamer::GetRequiredMip(*texture, meshResource.units_per_uv,
+        surface->GetScreenScale()));
+    draw_node.AddSRV(srv != nullptr ? srv : texture_resource.srv);
     draw_node.AddSampler(texture_resource.sampler);
   }
 
+  // then the prefiltered sky and the brdf lut, if they were baked
+  std::string specular_name;
+  std::string brdf_lut_name;
+  RenderManager::GetInstance()->GetSpecularEnvironment(&specular_name,
+    &brdf_lut_name);
+  if (!specular_name.empty()) {
+    for (const std::string& name : { specular_name, brdf_lut_name }) {
+      TextureResource& texture_resource =
+        resource_manager->GetTextureResource(name);
+      draw_node.AddSRV(texture_resource.srv);
+      draw_node.AddSampler(texture_resource.sampler);
+    }
+  }
+
   shader_node->IncreaseDrawNodeIndex();
 }
 
 void RenderPassOpaque::SwapDoubleBuffers() {
+  std::lock_guard<std::mutex> guard(shader_nodes_mutex_);
   std::swap(render_index_, update_index_);
+  surfaces_count_[update_index_] = 0;
   for (auto shader_node : shader_nodes_) {
-    
+    shader_node.second->SwapDoubleBuffers();
   }
- }
+}
+
+const RenderStats& RenderPassOpaque::GetRenderStats() const {
+  return render_stats_;
+}
 
 void RenderPassOpaque::SetShadowParameters(math::Matrix4f* shadow_view,
   math::Matrix4f* projection, ID3D11ShaderResourceView** shadow_srv,
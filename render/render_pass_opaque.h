@@ -37,6 +37,8 @@ class RenderPassOpaque : public RenderPass {
 
   void SwapDoubleBuffers() override;
 
+  const RenderStats& GetRenderStats() const override;
+
  private:
   // used by multiple threads(including render thread):
   // create new shader node, create gpu resource, update it's drawnodes 
@@ -50,6 +52,11 @@ class RenderPassOpaque : public RenderPass {
   int render_index_;
   int update_index_;
 
+  // surfaces submitted for the frame being updated, and the stats of the
+  // last rendered frame
+  int surfaces_count_[2];
+  RenderStats render_stats_;
+
   math::Matrix4f shadow_view_;
   math::Matrix4f shadow_projection_[MAX_CASCADE_COUNT];
   D3D11_VIEWPORT shadow_view_ports_[MAX_CASCADE_COUNT];
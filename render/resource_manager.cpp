@@ -1,8 +1,97 @@
+#include <math.h>
+
 #include "resource_manager.h"
 #include "mesh.h"
 
 namespace magnet {
 namespace render {
+namespace {
+// mesh units one uv unit spans, from the areas the triangles cover in both
+float GetUnitsPerUv(const Mesh& mesh) {
+  int decls_count = 0;
+  VertexDecl decls[MAX_DESC_COUNT];
+  mesh.GetDecls(&decls_count, decls);
+  int offset = 0;
+  int position_offset = -1;
+  int uv_offset = -1;
+  for (int i = 0; i < decls_count; ++i) {
+    switch (decls[i]) {
+    case POSITION:
+      position_offset = offset;
+      offset += 3;
+      break;
+    case NORMAL:
+      offset += 3;
+      break;
+    case UV:
+      uv_offset = offset;
+      offset += 2;
+      break;
+    default:
+      return 0.f;
+    }
+  }
+  if (position_offset < 0 || uv_offset < 0)
+    return 0.f;
+
+  const int kStride = mesh.GetStride();
+  const float* vertices = static_cast<const float*>(mesh.GetVertexDataPtr());
+  const unsigned int* indices =
+    static_cast<const unsigned int*>(mesh.GetIndexDataPtr());
+  double area = 0.0;
+  double uv_area = 0.0;
+  for (int face = 0; face < mesh.GetFacesCount(); ++face) {
+    const float* v[3];
+    for (int corner = 0; corner < 3; ++corner)
+      v[corner] = vertices + indices[face * 3 + corner] * kStride;
+
+    const float* p0 = v[0] + position_offset;
+    const float* p1 = v[1] + position_offset;
+    const float* p2 = v[2] + position_offset;
+    const math::Vector3f kEdge0(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]);
+    const math::Vector3f kEdge1(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]);
+    area += math::Cross3(kEdge0, kEdge1).Length() * 0.5;
+
+    const float* t0 = v[0] + uv_offset;
+    const float* t1 = v[1] + uv_offset;
+    const float* t2 = v[2] + uv_offset;
+    uv_area += fabs((t1[0] - t0[0]) * (t2[1] - t0[1]) -
+      (t2[0] - t0[0]) * (t1[1] - t0[1])) * 0.5;
+  }
+  return uv_area > 0.0 ? static_cast<float>(sqrt(area / uv_area)) : 0.f;
+}
+}  // namespace
+
+DXGI_FORMAT GetDxgiFormat(TextureFormat format) {
+  switch (format) {
+  case TEXTURE_FORMAT_R8G8B8A8_UINT: return DXGI_FORMAT_R8G8B8A8_UINT;
+  case TEXTURE_FORMAT_R8G8B8A8_UNORM: return DXGI_FORMAT_R8G8B8A8_UNORM;
+  case TEXTURE_FORMAT_R32G32B32A32_FLOAT:
+    return DXGI_FORMAT_R32G32B32A32_FLOAT;
+  case TEXTURE_FORMAT_R8G8B8A8_UNORM_SRGB:
+    return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+  case TEXTURE_FORMAT_B8G8R8A8_UNORM: return DXGI_FORMAT_B8G8R8A8_UNORM;
+  case TEXTURE_FORMAT_R16G16B16A16_FLOAT:
+    return DXGI_FORMAT_R16G16B16A16_FLOAT;
+  case TEXTURE_FORMAT_R9G9B9E5_SHAREDEXP:
+    return DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+  case TEXTURE_FORMAT_BC1_UNORM: return DXGI_FORMAT_BC1_UNORM;
+  case TEXTURE_FORMAT_BC1_UNORM_SRGB: return DXGI_FORMAT_BC1_UNORM_SRGB;
+  case TEXTURE_FORMAT_BC2_UNORM: return DXGI_FORMAT_BC2_UNORM;
+  case TEXTURE_FORMAT_BC2_UNORM_SRGB: return DXGI_FORMAT_BC2_UNORM_SRGB;
+  case TEXTURE_FORMAT_BC3_UNORM: return DXGI_FORMAT_BC3_UNORM;
+  case TEXTURE_FORMAT_BC3_UNORM_SRGB: return DXGI_FORMAT_BC3_UNORM_SRGB;
+  case TEXTURE_FORMAT_BC4_UNORM: return DXGI_FORMAT_BC4_UNORM;
+  case TEXTURE_FORMAT_BC4_SNORM: return DXGI_FORMAT_BC4_SNORM;
+  case TEXTURE_FORMAT_BC5_UNORM: return DXGI_FORMAT_BC5_UNORM;
+  case TEXTURE_FORMAT_BC5_SNORM: return DXGI_FORMAT_BC5_SNORM;
+  case TEXTURE_FORMAT_BC6H_UF16: return DXGI_FORMAT_BC6H_UF16;
+  case TEXTURE_FORMAT_BC6H_SF16: return DXGI_FORMAT_BC6H_SF16;
+  case TEXTURE_FORMAT_BC7_UNORM: return DXGI_FORMAT_BC7_UNORM;
+  case TEXTURE_FORMAT_BC7_UNORM_SRGB: return DXGI_FORMAT_BC7_UNORM_SRGB;
+  default: return DXGI_FORMAT_UNKNOWN;
+  }
+}
 
 ResourceManager* ResourceManager::instance_ = nullptr;
 
@@ -23,11 +112,12 @@ void ResourceManager::Initialize() {
 }
 
 bool ResourceManager::Exist() {
-  return instance_ = nullptr;
+  return instance_ != nullptr;
 }
 
 void ResourceManager::Terminate() {
   delete instance_;
+  instance_ = nullptr;
 }
 
 void ResourceManager::CreateMeshResource(const Mesh* mesh,
@@ -59,9 +149,10 @@ void ResourceManager::CreateMeshResource(const Mesh* mesh,
     D3D11_BUFFER_DESC desc;
     desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
     desc.ByteWidth = mesh_resource.stride * mesh->GetVertsCount();
-    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    desc.CPUAccessFlags = 0;
     desc.Usage = D3D11_USAGE_DEFAULT;
-    //desc.miscFlags
+    desc.MiscFlags = 0;
+    desc.StructureByteStride = 0;
     D3D11_SUBRESOURCE_DATA data;
     data.pSysMem = mesh->GetVertexDataPtr();
     device->CreateBuffer(&desc, &data, &mesh_resource.vertex_buffer);
@@ -69,12 +160,13 @@ void ResourceManager::CreateMeshResource(const Mesh* mesh,
     // index buffer
     desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
     desc.ByteWidth = sizeof(unsigned int) * 3 * mesh->GetFacesCount();
-    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    desc.CPUAccessFlags = 0;
     desc.Usage = D3D11_USAGE_DEFAULT;
     data.pSysMem = mesh->GetIndexDataPtr();
     device->CreateBuffer(&desc, &data, &mesh_resource.index_buffer);
 
     mesh_resource.primitives_count = mesh->GetFacesCount();
+    mesh_resource.units_per_uv = GetUnitsPerUv(*mesh);
 
     mesh_map_.insert(std::pair<const std::string&, MeshResource>(name, mesh_resource));
   }
@@ -88,84 +180,6 @@ void ResourceManager::CreateTextureResource(const Texture* texture,
 
   auto it = texture_map_.find(name);
   if (it == texture_map_.end()) {
-    if (texture->GetType() == TEXTURE_TYPE_2D) {
-      D3D11_TEXTURE2D_DESC desc;
-      desc.Width = texture->GetWidth();
-      desc.Height = texture->GetHeight();
-
-      desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-
-      D3D11_SUBRESOURCE_DATA data;
-      data.pSysMem = texture->GetDataBufferPtr();
-      switch (texture->GetFormat()) {
-      case TEXTURE_FORMAT_R8G8B8A8_UINT:
-        data.SysMemPitch = 4 * texture->GetWidth();
-        desc.Format = DXGI_FORMAT_R8G8B8A8_UINT;
-        break;
-      case TEXTURE_FORMAT_R8G8B8A8_UNORM:
-        data.SysMemPitch = 4 * texture->GetWidth();
-        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        break;
-      }
-
-      device->CreateTexture2D(&desc, &data, &texture_resource.texture);
-
-      D3D11_SHADER_RESOURCE_VIEW_DESC desc_srv;
-      desc_srv.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-      desc_srv.Texture2D.MostDetailedMip = 0;
-      desc_srv.Texture2D.MipLevels = desc.MipLevels;
-      desc_srv.Format = desc.Format;
-      device->CreateShaderResourceView(texture_resource.texture, &desc_srv,
-        &texture_resource.srv);
-    }
-    else if (texture->GetType() == TEXTURE_TYPE_CUBE) {
-/*      D3D11_TEXTURE2D_DESC texDesc;
-      texDesc.width = pTexture->GetWidth();
-      texDesc.height = pTexture->GetHeight();
-      texDesc.arraySize = 6;
-      texDesc.miscFlags = HALgfx::MISC_TEXTURECUBE;
-      texDesc.bindFlags = HALgfx::BIND_SHADER_RESOURCE;
-      texDesc.mipLevels = 1; // this has to be set for cubemap, it can't be 9
-
-      HALgfx::SubResourceData data[6];
-
-      void* pDataPtr = const_cast<void*>(pTexture->GetDataBufferPtr());
-      for (int i = 0; i < 6; ++i)
-      {
-        switch (pTexture->GetFormat())
-        {
-        case Scene::TEXTURE_FORMAT_R8G8B8A8_UINT:
-          data[i].uMemPitch = 4 * pTexture->GetWidth();
-          data[i].uMemSlicePitch = 0;
-          texDesc.format = HALgfx::FORMAT_R8G8B8A8_UINT;
-          data[i].pMem = static_cast<unsigned char*>(pDataPtr) + i * 4 * pTexture->GetWidth() * pTexture->GetHeight();
-          break;
-        case Scene::TEXTURE_FORMAT_R8G8B8A8_UNORM:
-          data[i].uMemPitch = 4 * pTexture->GetWidth();
-          data[i].uMemSlicePitch = 0;
-          texDesc.format = HALgfx::FORMAT_R8G8B8A8_UNORM;
-          data[i].pMem = static_cast<unsigned char*>(pDataPtr) + i * 4 * pTexture->GetWidth() * pTexture->GetHeight();
-          break;
-        case Scene::TEXTURE_FORMAT_R32G32B32A32_FLOAT:
-          data[i].uMemPitch = 16 * pTexture->GetWidth();
-          data[i].uMemSlicePitch = 0;
-          texDesc.format = HALgfx::FORMAT_R32G32B32A32_FLOAT;
-          data[i].pMem = static_cast<float*>(pDataPtr) + i * 4 * pTexture->GetWidth() * pTexture->GetHeight();
-          break;
-        }
-      }
-
-      textureResource.m_pTexture = pDevice->CreateTexture2d(texDesc, data);
-
-      HALgfx::ShaderResourceViewDesc desc;
-      desc.viewDimension = HALgfx::SRV_DIMENSION_TEXTURECUBE;
-      desc.texSRV.mostDetailedMip = 0;
-      desc.texSRV.mipLevels = texDesc.mipLevels;
-      desc.format = texDesc.format;
-      textureResource.m_pShaderResourceView = pDevice->CreateShaderResourceView(textureResource.m_pTexture, desc);
-      */
-    }
-
     // set label name
     switch (texture->GetLabel())
     {
@@ -195,7 +209,65 @@ void ResourceManager::CreateTextureResource(const Texture* texture,
     CreateSamplerState(texture->GetSamplerMode(), device);
     texture_resource.sampler = GetSamplerState(texture->GetSamplerMode(), device);
 
-    texture_map_[name] = texture_resource;
+    // the streamer keeps the gpu texture of the entry up to date, the map
+    // does not move its elements
+    TextureResource& stored = texture_map_[name] = texture_resource;
+    if (texture_streamer_.GetBudget() > 0 &&
+      TextureStreamer::CanStream(*texture)) {
+      texture_streamer_.AddTexture(texture, device, &stored);
+      return;
+    }
+
+    const bool kCube = texture->GetType() == TEXTURE_TYPE_CUBE;
+    const int kFacesCount = kCube ? 6 : 1;
+    const int kMipLevels = texture->GetMipLevels();
+
+    D3D11_TEXTURE2D_DESC desc;
+    desc.Width = texture->GetWidth();
+    desc.Height = texture->GetHeight();
+    desc.MipLevels = kMipLevels;
+    desc.ArraySize = kFacesCount;
+    desc.Format = GetDxgiFormat(texture->GetFormat());
+    desc.SampleDesc.Count = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Usage = D3D11_USAGE_IMMUTABLE;
+    desc.CPUAccessFlags = 0;
+    desc.MiscFlags = kCube ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    // one subresource per face and mip level, pointing into the data
+    // buffer, which may be a mapped dds file, without copying it
+    D3D11_SUBRESOURCE_DATA data[6 * D3D11_REQ_MIP_LEVELS];
+    const unsigned char* face =
+      static_cast<const unsigned char*>(texture->GetDataBufferPtr());
+    for (int i = 0; i < kFacesCount; ++i) {
+      for (int level = 0; level < kMipLevels; ++level) {
+        D3D11_SUBRESOURCE_DATA& subresource = data[i * kMipLevels + level];
+        subresource.pSysMem = face + texture->GetMipOffset(level);
+        subresource.SysMemPitch =
+          static_cast<UINT>(texture->GetRowPitch(level));
+        subresource.SysMemSlicePitch = 0;
+      }
+      face += texture->GetFaceSize();
+    }
+
+    device->CreateTexture2D(&desc, data, &stored.texture);
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC desc_srv;
+    desc_srv.Format = desc.Format;
+    if (kCube) {
+      desc_srv.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+      desc_srv.TextureCube.MostDetailedMip = 0;
+      desc_srv.TextureCube.MipLevels = desc.MipLevels;
+    }
+    else {
+      desc_srv.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+      desc_srv.Texture2D.MostDetailedMip = 0;
+      desc_srv.Texture2D.MipLevels = desc.MipLevels;
+    }
+    device->CreateShaderResourceView(stored.texture, &desc_srv,
+      &stored.srv);
   }
 }
 
@@ -215,7 +287,7 @@ void ResourceManager::CreateSamplerState(const SamplerMode mode, ID3D11Device* d
       desc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
       desc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
       desc.MaxAnisotropy = 1;
-      desc.MaxLOD = 0;
+      desc.MaxLOD = D3D11_FLOAT32_MAX;
       desc.MinLOD = 0;
       desc.MipLODBias = 0.f;
       ID3D11SamplerState* sampler_state;
@@ -260,5 +332,9 @@ TextureResource& ResourceManager::GetTextureResource(const std::string& name) {
 ID3D11SamplerState* ResourceManager::GetSamplerState(int sampler, ID3D11Device* device) {
   return sampler_map_[sampler];
 }
+
+TextureStreamer* ResourceManager::GetTextureStreamer() {
+  return &texture_streamer_;
+}
 }  // namespace render
 }  // namespace magnet
\ No newline at end of file
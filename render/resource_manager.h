@@ -6,11 +6,15 @@
 #include <d3d11.h>
 #include "gpu_resource.h"
 #include "texture.h"
+#include "texture_streamer.h"
 
 namespace magnet {
 namespace render {
 class Mesh;
 class Texture;
+
+DXGI_FORMAT GetDxgiFormat(TextureFormat format);
+
 class ResourceManager {
  private:
    ResourceManager();
@@ -36,10 +40,14 @@ class ResourceManager {
   TextureResource& GetTextureResource(const std::string& name);
   ID3D11SamplerState* GetSamplerState(int samplerMode, ID3D11Device* device);
 
+  // 2d textures with mips created while its budget is not 0 are streamed
+  TextureStreamer* GetTextureStreamer();
+
 private:
   std::map<std::string, MeshResource> mesh_map_;
   std::map<std::string, TextureResource> texture_map_;
   std::map<int, ID3D11SamplerState*> sampler_map_;
+  TextureStreamer texture_streamer_;
 };
 
 }  // namespace render
@@ -1,10 +1,16 @@
+#include <string.h>
 #include <iostream>
+
+#include "core/allocator.h"
+#include "core/file_system.h"
+
 #include "shader.h"
 
 namespace magnet {
 namespace render {
 namespace {
-static const char SHADER_PATH[256] = "C:\\Projects\\GitHub\\LightBaker\\data\\shader\\";
+// a virtual path, the application mounts the shader folder
+static const char SHADER_PATH[256] = "shader/";
 }
 
 void VertexShader::Create(const void* source, int size,
@@ -58,7 +64,7 @@ ShaderProgram::ShaderProgram(const std::string& name) {
 ShaderProgram::~ShaderProgram() {
   for (int i = 0; i < MAX_SHADER_NUM; ++i) {
     if (sources_[i]) {
-      free(sources_[i]);
+      core::TaggedHeap::Free(sources_[i]);
       sources_[i] = nullptr;
     }
 
@@ -70,71 +76,27 @@ ShaderProgram::~ShaderProgram() {
 }
 
 void ShaderProgram::LoadShader(ShaderType type) {
+  const char* extension = nullptr;
   if (type == VERTEX_SHADER) {
-    // load vertex shader
-    const std::string path = SHADER_PATH + name_ + ".v";
-
-    FILE* file = fopen(path.c_str(), "r+b");
-    if (file == 0) {
-      std::cout << "can't find shader; " << path << std::endl;
-      return;
-    }
-
-    fseek(file, 0, SEEK_END);
-    int file_size = ftell(file);
-    rewind(file);
-
-    void* file_data = CreateBuffer(file_size, VERTEX_SHADER);
-    int iResult = fread(file_data, 1, file_size, file);
-    if (iResult != file_size) {
-      std::cout << "Error reading shader file:" << path << std::endl;
-      return;
-    }
-
-    fclose(file);
+    extension = ".v";
   } else if (type == PIXEL_SHADER) {
-    const std::string path = SHADER_PATH + name_ + ".p";
-
-    FILE* file = fopen(path.c_str(), "r+b");
-    if (file == 0) {
-      std::cout << "can't find shader; " << path << std::endl;
-      return;
-    }
-
-    fseek(file, 0, SEEK_END);
-    int file_size = ftell(file);
-    rewind(file);
-
-    void* file_data = CreateBuffer(file_size, PIXEL_SHADER);
-    int iResult = fread(file_data, 1, file_size, file);
-    if (iResult != file_size) {
-      std::cout << "Error reading shader file:" << path << std::endl;
-      return;
-    }
-
-    fclose(file);
+    extension = ".p";
   } else if (type == COMPUTE_SHADER) {
-    const std::string path = SHADER_PATH + name_ + ".c";
-
-    FILE* file = fopen(path.c_str(), "r+b");
-    if (file == 0) {
-      std::cout << "can't find shader; " << path << std::endl;
-      return;
-    }
-
-    fseek(file, 0, SEEK_END);
-    int file_size = ftell(file);
-    rewind(file);
-
-    void* file_data = CreateBuffer(file_size, COMPUTE_SHADER);
-    int iResult = fread(file_data, 1, file_size, file);
-    if (iResult != file_size) {
-      std::cout << "Error reading shader file:" << path << std::endl;
-      return;
-    }
+    extension = ".c";
+  } else {
+    return;
+  }
 
-    fclose(file);
+  const std::string path = SHADER_PATH + name_ + extension;
+  core::FileView file;
+  if (!core::FileSystem::Open(path, &file)) {
+    std::cout << "can't find shader; " << path << std::endl;
+    return;
   }
+
+  // the bytecode is copied, the view only lives while loading
+  void* file_data = CreateBuffer(static_cast<int>(file.GetSize()), type);
+  memcpy(file_data, file.GetData(), file.GetSize());
 }
 
 void ShaderProgram::CreateShaders(ID3D11Device* device) {
@@ -163,7 +125,8 @@ void ShaderProgram::ClearShaders(ID3D11DeviceContext* device_context) {
 }
 
 void* ShaderProgram::CreateBuffer(int size, ShaderType type) {
-  sources_[type] = malloc(size);
+  core::TaggedHeap::Free(sources_[type]);
+  sources_[type] = core::TaggedHeap::Allocate(core::MEMORY_TAG_SHADER, size);
   sizes_[type] = size;
   return sources_[type];
 }
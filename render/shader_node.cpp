@@ -32,10 +32,11 @@ ShaderNode::ShaderNode(const std::string& name, int draw_nodes_capacity) {
 
   draw_nodes_capacity_ = draw_nodes_capacity;
   draw_nodes_index_ = 0;
+  draw_nodes_count_[0] = 0;
+  draw_nodes_count_[1] = 0;
 
   update_index_ = 0;
-  render_index_ = 0;
-
+  render_index_ = 1;
 }
 
 ShaderNode::~ShaderNode() {
@@ -48,6 +49,12 @@ ShaderNode::~ShaderNode() {
     input_layout_ = nullptr;
   }
 
+  for (int i = 0; i < 2; ++i) {
+    for (DrawNode& draw_node : draw_nodes_[i]) {
+      draw_node.DestroyCBuffers();
+    }
+  }
+
   for (int i = 0; i < MAX_NUMBER_BUFFERS; ++i) {
     /*if (vs_cbuffers_[i]) {
       delete vs_cbuffers_[i];
@@ -73,7 +80,20 @@ void ShaderNode::Create(const MeshResource& mesh_resource,
 }
 
 DrawNode& ShaderNode::GetCurrentDrawNode() {
-  return draw_nodes_[update_index_][draw_nodes_index_];
+  std::vector<DrawNode>& draw_nodes = draw_nodes_[update_index_];
+
+  // run out of pooled draw nodes, grow the pool with the same cbuffer layout
+  if (draw_nodes_index_ == static_cast<int>(draw_nodes.size())) {
+    DrawNode draw_node;
+    if (!draw_nodes.empty()) {
+      draw_node.CloneCBufferLayout(draw_nodes.front());
+    }
+    draw_nodes.push_back(draw_node);
+  }
+
+  DrawNode& draw_node = draw_nodes[draw_nodes_index_];
+  draw_node.ResetBindings();
+  return draw_node;
 }
 
 void ShaderNode::BindDrawNodeResource(ID3D11DeviceContext* device_context, DrawNode* drawNode) {
@@ -128,14 +148,18 @@ void ShaderNode::UnbindDrawNodeResource(ID3D11DeviceContext* device_context,
   device_context->PSSetShaderResources(0, drawNode->srvs_count, srvs);
 }
 
-void ShaderNode::Draw(ID3D11DeviceContext* device_context) {
+void ShaderNode::Draw(ID3D11DeviceContext* device_context,
+  RenderStats* stats) {
   BeginEvent(shader_program_->GetName().c_str());
 
   shader_program_->SetShaders(texture_labels_count_, texture_labels_, device_context);
 
   device_context->IASetInputLayout(input_layout_);
 
-  for (DrawNode& draw_node :draw_nodes_[render_index_]) {
+  std::vector<DrawNode>& draw_nodes = draw_nodes_[render_index_];
+  const int draw_nodes_count = draw_nodes_count_[render_index_];
+  for (int i = 0; i < draw_nodes_count; ++i) {
+    DrawNode& draw_node = draw_nodes[i];
     BeginEvent(draw_node.name.c_str());
 
     BindDrawNodeResource(device_context, &draw_node);
@@ -143,6 +167,11 @@ void ShaderNode::Draw(ID3D11DeviceContext* device_context) {
     UnbindDrawNodeResource(device_context, &draw_node);
 
     EndEvent();
+
+    if (stats) {
+      stats->draw_calls_count++;
+      stats->primitives_count += draw_node.primitives_count;
+    }
   }
 
   device_context->IASetInputLayout(0);
@@ -151,22 +180,18 @@ void ShaderNode::Draw(ID3D11DeviceContext* device_context) {
 }
 
 void ShaderNode::ClearDrawNodes() {
-  for (auto& draw_node : draw_nodes_[render_index_]) {
-    for (int i = 0; i < draw_node.vs_cbuffers_count; ++i) {
-      draw_node.DestroyCBufferData(draw_node.vs_cbuffer_data[i]);
-    }
-
-    for (int i = 0; i < draw_node.ps_cbuffers_count; ++i) {
-      draw_node.DestroyCBufferData(draw_node.ps_cbuffer_data[i]);
-    }
-  }
-
-  draw_nodes_[render_index_].clear();
+  // keep the pooled nodes and their cbuffer data for the next frames
+  draw_nodes_count_[render_index_] = 0;
 }
 
 void ShaderNode::AddDrawNode(DrawNode& draw_node) {
   std::lock_guard<std::mutex> guard(draw_nodes_mutex_);
   draw_nodes_[update_index_].push_back(draw_node);
+
+  // the render buffer owns its own copy of the cbuffer data
+  DrawNode render_draw_node;
+  render_draw_node.CloneCBufferLayout(draw_node);
+  draw_nodes_[render_index_].push_back(render_draw_node);
 }
 
 void ShaderNode::CreateInputLayout(const MeshResource& mesh_resource,
@@ -239,6 +264,7 @@ void ShaderNode::RunCompute(ID3D11DeviceContext* device_context,
 void ShaderNode::SwapDoubleBuffers() {
   std::swap(render_index_, update_index_);
   draw_nodes_index_ = 0;
+  draw_nodes_count_[update_index_] = 0;
 }
 
 const std::string& ShaderNode::GetName() const {
@@ -252,6 +278,7 @@ void ShaderNode::BeginEvent(const char* debugInfo) {
   mbstowcs_s(&convertedChars, wcstring, newsize, debugInfo, _TRUNCATE);
 
   D3DPERF_BeginEvent(D3DCOLOR_XRGB(128, 128, 128), wcstring);
+  delete[] wcstring;
 }
 
 void ShaderNode::EndEvent() {
@@ -260,6 +287,11 @@ void ShaderNode::EndEvent() {
 
 void ShaderNode::IncreaseDrawNodeIndex() {
   draw_nodes_index_++;
+  draw_nodes_count_[update_index_] = draw_nodes_index_;
+}
+
+int ShaderNode::GetDrawNodesCount() const {
+  return draw_nodes_count_[update_index_];
 }
 
 }  // namespace render
@@ -8,6 +8,7 @@
 #include "shader.h"
 #include "draw_node.h"
 #include "gpu_resource.h"
+#include "render_pass.h"
 
 namespace magnet {
 namespace scene {
@@ -29,7 +30,7 @@ class ShaderNode {
     DrawNode* drawNode);
   void UnbindDrawNodeResource(ID3D11DeviceContext* device_context,
     DrawNode* draw_node);
-  void Draw(ID3D11DeviceContext* device_context);
+  void Draw(ID3D11DeviceContext* device_context, RenderStats* stats);
   void ClearDrawNodes();
   void AddDrawNode(DrawNode& draw_node);
   void CreateConstantBuffer(const D3D11_BUFFER_DESC& desc,
@@ -55,6 +56,7 @@ class ShaderNode {
   static void EndEvent();
 
   void IncreaseDrawNodeIndex();
+  int GetDrawNodesCount() const;
 
   // compute shader
   void RunCompute(ID3D11DeviceContext* device_context, int iSRVCount,
@@ -89,10 +91,12 @@ class ShaderNode {
   int texture_labels_[MAX_NUMBER_SRVS];
 
   // use vector so that it's easier to sort if needed
-  // double buffered for multithreading
+  // double buffered for multithreading, draw nodes are pooled and reused
+  // every frame, only the first draw_nodes_count_ of each buffer are valid
   int draw_nodes_index_;
   int draw_nodes_capacity_;
   std::vector<DrawNode> draw_nodes_[2];
+  int draw_nodes_count_[2];
   int update_index_;
   int render_index_;
 
@@ -13,29 +13,38 @@ namespace magnet {
 namespace render {
 class Surface {
  public:
-  Surface() {}
+  Surface() : screen_scale_(0.f) {}
   ~Surface() {};
 
   const math::AABBf& GetBBox() const;
   std::shared_ptr<Material> GetMaterial();
   std::shared_ptr<Mesh> GetMesh();
   math::Matrix4f GetWorld() const;
+  // pixels one mesh unit covers on screen where the surface is closest to
+  // the camera, 0 if not known. picks the mip levels textures stream in.
+  float GetScreenScale() const;
 
   void SetMaterial(std::shared_ptr<Material> material);
   void SetMesh(std::shared_ptr<Mesh> mesh);
   void SetWorld(const math::Matrix4f& world);
+  void SetScreenScale(float screen_scale);
 
 private:
   std::shared_ptr<Mesh> mesh_;
   std::shared_ptr<Material> material_;
   math::Matrix4f world_;
   math::AABBf bbox_;
+  float screen_scale_;
 };
 
 inline const math::AABBf& Surface::GetBBox() const {
   return bbox_;
 }
 
+inline float Surface::GetScreenScale() const {
+  return screen_scale_;
+}
+
 inline std::shared_ptr<Material> Surface::GetMaterial() {
   return material_;
 }
@@ -60,6 +69,10 @@ inline void Surface::SetWorld(const math::Matrix4f& world) {
   world_ = world;
 }
 
+inline void Surface::SetScreenScale(float screen_scale) {
+  screen_scale_ = screen_scale;
+}
+
 }  // namespace scene
 }  // namespace magnet
 #endif  // MAGNET_SCENE_SURFACE_H_
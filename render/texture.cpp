@@ -1,40 +1,104 @@
 #include <string>
-#include <stdlib.h>
+#include <utility>
+
+#include "core/allocator.h"
 
 #include "texture.h"
 
 namespace magnet {
 namespace render {
+bool IsBlockCompressed(TextureFormat format) {
+  return format >= TEXTURE_FORMAT_BC1_UNORM;
+}
+
+int GetFormatBytes(TextureFormat format) {
+  switch (format) {
+  case TEXTURE_FORMAT_R8G8B8A8_UINT:
+  case TEXTURE_FORMAT_R8G8B8A8_UNORM:
+  case TEXTURE_FORMAT_R8G8B8A8_UNORM_SRGB:
+  case TEXTURE_FORMAT_B8G8R8A8_UNORM:
+  case TEXTURE_FORMAT_R9G9B9E5_SHAREDEXP:
+    return 4;
+  case TEXTURE_FORMAT_R16G16B16A16_FLOAT:
+    return 8;
+  case TEXTURE_FORMAT_R32G32B32A32_FLOAT:
+    return 16;
+  case TEXTURE_FORMAT_BC1_UNORM:
+  case TEXTURE_FORMAT_BC1_UNORM_SRGB:
+  case TEXTURE_FORMAT_BC4_UNORM:
+  case TEXTURE_FORMAT_BC4_SNORM:
+    return 8;
+  case TEXTURE_FORMAT_BC2_UNORM:
+  case TEXTURE_FORMAT_BC2_UNORM_SRGB:
+  case TEXTURE_FORMAT_BC3_UNORM:
+  case TEXTURE_FORMAT_BC3_UNORM_SRGB:
+  case TEXTURE_FORMAT_BC5_UNORM:
+  case TEXTURE_FORMAT_BC5_SNORM:
+  case TEXTURE_FORMAT_BC6H_UF16:
+  case TEXTURE_FORMAT_BC6H_SF16:
+  case TEXTURE_FORMAT_BC7_UNORM:
+  case TEXTURE_FORMAT_BC7_UNORM_SRGB:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+size_t GetSurfaceRowPitch(TextureFormat format, int width) {
+  if (IsBlockCompressed(format))
+    width = (width + 3) / 4;
+  return static_cast<size_t>(width) * GetFormatBytes(format);
+}
+
+size_t GetSurfaceSize(TextureFormat format, int width, int height) {
+  if (IsBlockCompressed(format))
+    height = (height + 3) / 4;
+  return GetSurfaceRowPitch(format, width) * height;
+}
+
 Texture::Texture(const std::string& name) : name_(name),
+  width_(0),
+  height_(0),
+  mip_levels_(1),
+  format_(TEXTURE_FORMAT_R8G8B8A8_UNORM),
   sampler_mode_(SAMPLER_NOMIP_LINEAR_WRAP),
+  label_(TEXTURE_LABEL_COLOR_0),
   type_(TEXTURE_TYPE_2D),
   loaded_(false),
-  data_(nullptr) {}
+  data_(nullptr),
+  external_data_(nullptr) {}
 
 Texture::Texture(const std::string& name, SamplerMode sampler,
   TextureLabel label, TextureFormat format, TextureType type) :
   name_(name),
+  width_(0),
+  height_(0),
+  mip_levels_(1),
   sampler_mode_(sampler),
   label_(label),
   format_(format),
   type_(type),
   loaded_(false),
-  data_(nullptr) {}
+  data_(nullptr),
+  external_data_(nullptr) {}
 
 Texture::Texture(const std::string& name, int width, int height,
   TextureFormat format) :
   name_(name),
   width_(width),
   height_(height),
+  mip_levels_(1),
   format_(format),
   sampler_mode_(SAMPLER_NOMIP_LINEAR_WRAP),
+  label_(TEXTURE_LABEL_COLOR_0),
   type_(TEXTURE_TYPE_2D),
   loaded_(false),
-  data_(nullptr) {}
+  data_(nullptr),
+  external_data_(nullptr) {}
 
 Texture::~Texture() {
   if (data_) {
-    free(data_);
+    core::TaggedHeap::Free(data_);
     data_ = nullptr;
   }
 }
@@ -44,7 +108,18 @@ const std::string& Texture::GetName() const {
 }
 
 const void* Texture::GetDataBufferPtr() const {
-  return data_;
+  return data_ ? data_ : external_data_;
+}
+
+size_t Texture::GetMipOffset(int level) const {
+  size_t offset = 0;
+  for (int i = 0; i < level; ++i)
+    offset += GetSurfaceSize(format_, GetMipWidth(i), GetMipHeight(i));
+  return offset;
+}
+
+size_t Texture::GetFaceSize() const {
+  return GetMipOffset(mip_levels_);
 }
 
 bool Texture::IsLoaded() const {
@@ -56,27 +131,16 @@ void Texture::SetLoaded(bool loaded) {
 }
 
 void* Texture::CreateDataBuffer() {
-  int bytes_per_face = 0;
-
-  switch (format_) {
-  case TEXTURE_FORMAT_R8G8B8A8_UINT:
-  case TEXTURE_FORMAT_R8G8B8A8_UNORM:
-    bytes_per_face = 4 * width_ * height_;
-    break;
-  case TEXTURE_FORMAT_R32G32B32A32_FLOAT:
-    bytes_per_face = 16 * width_ * height_;
-    break;
-  default:
-    bytes_per_face = 0;
-    break;
-  }
+  DestroyDataBuffer();
+  const size_t kFaceSize = GetFaceSize();
 
   switch (type_) {
   case TEXTURE_TYPE_2D:
-    data_ = malloc(bytes_per_face);
+    data_ = core::TaggedHeap::Allocate(core::MEMORY_TAG_TEXTURE, kFaceSize);
     break;
   case TEXTURE_TYPE_CUBE:
-    data_ = malloc(bytes_per_face * 6);
+    data_ = core::TaggedHeap::Allocate(core::MEMORY_TAG_TEXTURE,
+      kFaceSize * 6);
     break;
   default:
     data_ = nullptr;
@@ -87,7 +151,17 @@ void* Texture::CreateDataBuffer() {
 }
 
 void Texture::DestroyDataBuffer() {
-  free(data_);
+  core::TaggedHeap::Free(data_);
+  data_ = nullptr;
+  external_data_ = nullptr;
+  external_owner_.reset();
+}
+
+void Texture::SetExternalData(const void* data,
+  std::shared_ptr<const void> owner) {
+  DestroyDataBuffer();
+  external_data_ = data;
+  external_owner_ = std::move(owner);
 }
 } // namespace scene
 } // namespace magnet
\ No newline at end of file
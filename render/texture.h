@@ -1,6 +1,8 @@
 #ifndef MAGNET_RENDER_TEXTURE_H_
 #define MAGNET_RENDER_TEXTURE_H_
 
+#include <stddef.h>
+#include <memory>
 #include <string>
 
 namespace magnet {
@@ -8,9 +10,38 @@ namespace render {
 enum TextureFormat {
   TEXTURE_FORMAT_R8G8B8A8_UINT,
   TEXTURE_FORMAT_R8G8B8A8_UNORM,
-  TEXTURE_FORMAT_R32G32B32A32_FLOAT
+  TEXTURE_FORMAT_R32G32B32A32_FLOAT,
+  TEXTURE_FORMAT_R8G8B8A8_UNORM_SRGB,
+  TEXTURE_FORMAT_B8G8R8A8_UNORM,
+  // hdr, half the size of 32 bit floats
+  TEXTURE_FORMAT_R16G16B16A16_FLOAT,
+  TEXTURE_FORMAT_R9G9B9E5_SHAREDEXP,    // rgb with a shared exponent, no alpha
+  // block compressed, 4x4 texels per block
+  TEXTURE_FORMAT_BC1_UNORM,
+  TEXTURE_FORMAT_BC1_UNORM_SRGB,
+  TEXTURE_FORMAT_BC2_UNORM,
+  TEXTURE_FORMAT_BC2_UNORM_SRGB,
+  TEXTURE_FORMAT_BC3_UNORM,
+  TEXTURE_FORMAT_BC3_UNORM_SRGB,
+  TEXTURE_FORMAT_BC4_UNORM,
+  TEXTURE_FORMAT_BC4_SNORM,
+  TEXTURE_FORMAT_BC5_UNORM,
+  TEXTURE_FORMAT_BC5_SNORM,
+  TEXTURE_FORMAT_BC6H_UF16,
+  TEXTURE_FORMAT_BC6H_SF16,
+  TEXTURE_FORMAT_BC7_UNORM,
+  TEXTURE_FORMAT_BC7_UNORM_SRGB
 };
 
+bool IsBlockCompressed(TextureFormat format);
+
+// bytes of a texel, or of a 4x4 block for the bc formats
+int GetFormatBytes(TextureFormat format);
+
+// bytes between rows of texels, or of blocks, and of a whole surface
+size_t GetSurfaceRowPitch(TextureFormat format, int width);
+size_t GetSurfaceSize(TextureFormat format, int width, int height);
+
 enum TextureType {
   TEXTURE_TYPE_2D,
   TEXTURE_TYPE_CUBE
@@ -59,11 +90,25 @@ class Texture {
   int GetWidth() const;
   int GetHeight() const;
 
+  // the data buffer holds every face one after the other, each face its mip
+  // chain from the largest level down, tightly packed like dds files
+  void SetMipLevels(int mip_levels);
+  int GetMipLevels() const;
+  int GetMipWidth(int level) const;
+  int GetMipHeight(int level) const;
+  size_t GetRowPitch(int level) const;
+  size_t GetMipOffset(int level) const;
+  size_t GetFaceSize() const;
+
   void* CreateDataBuffer();
   void DestroyDataBuffer();
   const std::string& GetName() const;
   const void* GetDataBufferPtr() const;
 
+  // uses data laid out like the data buffer without copying it, owner keeps
+  // it alive until the buffer is destroyed
+  void SetExternalData(const void* data, std::shared_ptr<const void> owner);
+
   bool IsLoaded()const;
   void SetLoaded(bool loaded);
 
@@ -72,11 +117,14 @@ private:
   std::string	label_name_; // name in shader
   int width_;
   int height_;
+  int mip_levels_;
   TextureFormat format_;
   TextureType type_;
   SamplerMode sampler_mode_;
   TextureLabel label_;
   void* data_;
+  const void* external_data_;
+  std::shared_ptr<const void> external_owner_;
   bool loaded_;
 };
 
@@ -116,6 +164,26 @@ inline int Texture::GetWidth() const {
 inline int Texture::GetHeight() const {
   return height_;
 }
+
+inline void Texture::SetMipLevels(int mip_levels) {
+  mip_levels_ = mip_levels;
+}
+
+inline int Texture::GetMipLevels() const {
+  return mip_levels_;
+}
+
+inline int Texture::GetMipWidth(int level) const {
+  return width_ >> level > 0 ? width_ >> level : 1;
+}
+
+inline int Texture::GetMipHeight(int level) const {
+  return height_ >> level > 0 ? height_ >> level : 1;
+}
+
+inline size_t Texture::GetRowPitch(int level) const {
+  return GetSurfaceRowPitch(format_, GetMipWidth(level));
+}
 }  // namespace render
 }  // namespace magnet
 #endif  // MAGNET_RENDER_TEXTURE_H_
@@ -0,0 +1,288 @@
+#include <math.h>
+#include <algorithm>
+
+#include "gpu_resource.h"
+#include "resource_manager.h"
+#include "texture.h"
+#include "texture_streamer.h"
+
+namespace magnet {
+namespace render {
+namespace {
+static const size_t kDefaultBudget = static_cast<size_t>(512) << 20;
+static const size_t kDefaultMaxUploadBytes = static_cast<size_t>(32) << 20;
+
+// frames after an Update the render thread may still draw with a view
+// replaced by it, the double buffered one and the one being rendered
+static const int kReleaseDelay = 2;
+}  // namespace
+
+TextureStreamer::TextureStreamer() : budget_bytes_(kDefaultBudget),
+  max_upload_bytes_(kDefaultMaxUploadBytes),
+  frame_(0) {
+}
+
+TextureStreamer::~TextureStreamer() {
+  for (const ReleasedView& view : released_) {
+    view.srv->Release();
+    view.texture->Release();
+  }
+}
+
+void TextureStreamer::SetBudget(size_t budget_bytes) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  budget_bytes_ = budget_bytes;
+}
+
+size_t TextureStreamer::GetBudget() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return budget_bytes_;
+}
+
+void TextureStreamer::SetMaxUploadBytes(size_t upload_bytes) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  max_upload_bytes_ = upload_bytes;
+}
+
+bool TextureStreamer::CanStream(const Texture& texture) {
+  return texture.GetType() == TEXTURE_TYPE_2D &&
+    texture.GetMipLevels() > 1 && texture.GetDataBufferPtr() != nullptr;
+}
+
+void TextureStreamer::AddTexture(const Texture* texture, ID3D11Device* device,
+  TextureResource* resource) {
+  StreamedTexture streamed;
+  streamed.texture = texture;
+  streamed.resource = resource;
+  streamed.tail_mip = texture->GetMipLevels() - 1;
+  for (int level = 0; level < texture->GetMipLevels(); ++level) {
+    if (texture->GetMipWidth(level) <= kTailSize &&
+      texture->GetMipHeight(level) <= kTailSize) {
+      streamed.tail_mip = level;
+      break;
+    }
+  }
+  streamed.resident_mip = texture->GetMipLevels();
+  streamed.requested_mip = streamed.tail_mip;
+  streamed.last_used_frame = -1;
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (CreateView(device, &streamed, streamed.tail_mip))
+    textures_[texture->GetName()] = streamed;
+}
+
+int TextureStreamer::GetRequiredMip(const Texture& texture,
+  float world_per_uv, float pixels_per_world) {
+  const int kLastMip = texture.GetMipLevels() - 1;
+  // without uvs the whole surface samples one spot, without a camera the
+  // finest level is the safe guess
+  if (world_per_uv <= 0.f)
+    return kLastMip;
+  if (pixels_per_world <= 0.f)
+    return 0;
+
+  const float kTexelsPerPixel = std::max(texture.GetWidth(),
+    texture.GetHeight()) / (world_per_uv * pixels_per_world);
+  if (kTexelsPerPixel <= 1.f)
+    return 0;
+  return std::min(kLastMip, static_cast<int>(log2f(kTexelsPerPixel)));
+}
+
+ID3D11ShaderResourceView* TextureStreamer::Request(const std::string& name,
+  int mip_level) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = textures_.find(name);
+  if (it == textures_.end())
+    return nullptr;
+
+  StreamedTexture& streamed = it->second;
+  mip_level = std::max(0, std::min(mip_level, streamed.tail_mip));
+  if (streamed.last_used_frame != frame_) {
+    streamed.last_used_frame = frame_;
+    streamed.requested_mip = mip_level;
+  }
+  else {
+    streamed.requested_mip = std::min(streamed.requested_mip, mip_level);
+  }
+  return streamed.resource->srv;
+}
+
+void TextureStreamer::Update(ID3D11Device* device) {
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  size_t kept = 0;
+  for (const ReleasedView& view : released_) {
+    if (frame_ - view.frame >= kReleaseDelay) {
+      view.srv->Release();
+      view.texture->Release();
+    }
+    else {
+      released_[kept++] = view;
+    }
+  }
+  released_.resize(kept);
+
+  // plan the level of every texture first, each changed one is recreated
+  // once. most recently used first, among those the ones furthest from
+  // their request.
+  std::vector<StreamedTexture*> textures;
+  std::vector<int> targets;
+  size_t resident_bytes = 0;
+  size_t requested_bytes = 0;
+  for (auto& it : textures_) {
+    StreamedTexture& streamed = it.second;
+    textures.push_back(&streamed);
+    resident_bytes += GetResidentSize(*streamed.texture, streamed.resident_mip);
+    if (streamed.last_used_frame == frame_) {
+      requested_bytes +=
+        GetResidentSize(*streamed.texture, streamed.requested_mip);
+    }
+  }
+  std::sort(textures.begin(), textures.end(),
+    [](const StreamedTexture* a, const StreamedTexture* b) {
+    if (a->last_used_frame != b->last_used_frame)
+      return a->last_used_frame > b->last_used_frame;
+    return a->resident_mip - a->requested_mip >
+      b->resident_mip - b->requested_mip;
+  });
+  for (const StreamedTexture* streamed : textures)
+    targets.push_back(streamed->resident_mip);
+
+  // drops the finest level of the least recently used texture that can
+  // spare one. drawn textures keep the levels they asked for unless
+  // force is set.
+  size_t evicted_bytes = 0;
+  auto evict = [&](size_t keep, bool force) {
+    for (size_t i = textures.size(); i-- > 0;) {
+      const StreamedTexture* streamed = textures[i];
+      if (i == keep || targets[i] >= streamed->tail_mip)
+        continue;
+      if (!force && streamed->last_used_frame == frame_ &&
+        targets[i] >= streamed->requested_mip) {
+        continue;
+      }
+      const size_t kBytes =
+        GetResidentSize(*streamed->texture, targets[i]) -
+        GetResidentSize(*streamed->texture, targets[i] + 1);
+      resident_bytes -= kBytes;
+      evicted_bytes += kBytes;
+      ++targets[i];
+      return true;
+    }
+    return false;
+  };
+
+  size_t growth_bytes = 0;
+  for (size_t i = 0; i < textures.size(); ++i) {
+    const StreamedTexture* streamed = textures[i];
+    if (streamed->last_used_frame != frame_)
+      break;
+    while (targets[i] > streamed->requested_mip) {
+      const size_t kBytes =
+        GetResidentSize(*streamed->texture, targets[i] - 1) -
+        GetResidentSize(*streamed->texture, targets[i]);
+      if (growth_bytes > 0 && growth_bytes + kBytes > max_upload_bytes_)
+        break;
+      while (resident_bytes + kBytes > budget_bytes_ && evict(i, false)) {}
+      if (resident_bytes + kBytes > budget_bytes_)
+        break;
+      resident_bytes += kBytes;
+      growth_bytes += kBytes;
+      --targets[i];
+    }
+  }
+  // a lowered budget takes levels from drawn textures as well
+  while (resident_bytes > budget_bytes_ && evict(textures.size(), true)) {}
+
+  size_t uploaded_bytes = 0;
+  for (size_t i = 0; i < textures.size(); ++i) {
+    StreamedTexture* streamed = textures[i];
+    if (targets[i] != streamed->resident_mip &&
+      CreateView(device, streamed, targets[i])) {
+      uploaded_bytes += GetResidentSize(*streamed->texture, targets[i]);
+    }
+  }
+
+  stats_.textures_count = static_cast<int>(textures_.size());
+  stats_.budget_bytes = budget_bytes_;
+  stats_.resident_bytes = 0;
+  for (const StreamedTexture* streamed : textures) {
+    stats_.resident_bytes +=
+      GetResidentSize(*streamed->texture, streamed->resident_mip);
+  }
+  stats_.requested_bytes = requested_bytes;
+  stats_.uploaded_bytes = uploaded_bytes;
+  stats_.evicted_bytes = evicted_bytes;
+
+  ++frame_;
+}
+
+TextureStreamingStats TextureStreamer::GetStats() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return stats_;
+}
+
+size_t TextureStreamer::GetResidentSize(const Texture& texture, int mip) {
+  size_t size = 0;
+  for (int level = mip; level < texture.GetMipLevels(); ++level) {
+    size += GetSurfaceSize(texture.GetFormat(), texture.GetMipWidth(level),
+      texture.GetMipHeight(level));
+  }
+  return size;
+}
+
+bool TextureStreamer::CreateView(ID3D11Device* device,
+  StreamedTexture* streamed, int mip) {
+  const Texture& texture = *streamed->texture;
+  const int kMipLevels = texture.GetMipLevels() - mip;
+
+  D3D11_TEXTURE2D_DESC desc;
+  desc.Width = texture.GetMipWidth(mip);
+  desc.Height = texture.GetMipHeight(mip);
+  desc.MipLevels = kMipLevels;
+  desc.ArraySize = 1;
+  desc.Format = GetDxgiFormat(texture.GetFormat());
+  desc.SampleDesc.Count = 1;
+  desc.SampleDesc.Quality = 0;
+  desc.Usage = D3D11_USAGE_IMMUTABLE;
+  desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+  desc.CPUAccessFlags = 0;
+  desc.MiscFlags = 0;
+
+  D3D11_SUBRESOURCE_DATA data[D3D11_REQ_MIP_LEVELS];
+  const unsigned char* pixels =
+    static_cast<const unsigned char*>(texture.GetDataBufferPtr());
+  for (int level = 0; level < kMipLevels; ++level) {
+    data[level].pSysMem = pixels + texture.GetMipOffset(mip + level);
+    data[level].SysMemPitch =
+      static_cast<UINT>(texture.GetRowPitch(mip + level));
+    data[level].SysMemSlicePitch = 0;
+  }
+
+  ID3D11Texture2D* texture2d = nullptr;
+  if (FAILED(device->CreateTexture2D(&desc, data, &texture2d)))
+    return false;
+
+  D3D11_SHADER_RESOURCE_VIEW_DESC desc_srv;
+  desc_srv.Format = desc.Format;
+  desc_srv.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+  desc_srv.Texture2D.MostDetailedMip = 0;
+  desc_srv.Texture2D.MipLevels = kMipLevels;
+  ID3D11ShaderResourceView* srv = nullptr;
+  if (FAILED(device->CreateShaderResourceView(texture2d, &desc_srv, &srv))) {
+    texture2d->Release();
+    return false;
+  }
+
+  TextureResource* resource = streamed->resource;
+  if (resource->texture != nullptr) {
+    ReleasedView view = { resource->texture, resource->srv, frame_ };
+    released_.push_back(view);
+  }
+  resource->texture = texture2d;
+  resource->srv = srv;
+  streamed->resident_mip = mip;
+  return true;
+}
+}  // namespace render
+}  // namespace magnet
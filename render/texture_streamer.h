@@ -0,0 +1,111 @@
+#ifndef MAGNET_RENDER_TEXTURE_STREAMER_H_
+#define MAGNET_RENDER_TEXTURE_STREAMER_H_
+
+#include <stddef.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <d3d11.h>
+
+namespace magnet {
+namespace render {
+class Texture;
+struct TextureResource;
+
+// totals of the streamed textures after the last Update
+struct TextureStreamingStats {
+  TextureStreamingStats() : textures_count(0), budget_bytes(0),
+    resident_bytes(0), requested_bytes(0), uploaded_bytes(0),
+    evicted_bytes(0) {}
+
+  int textures_count;
+  size_t budget_bytes;
+  size_t resident_bytes;    // mip levels on the gpu
+  size_t requested_bytes;   // mip levels the surfaces of the frame asked for
+  size_t uploaded_bytes;    // by the last Update
+  size_t evicted_bytes;     // by the last Update
+};
+
+// keeps the mip levels of 2d textures on the gpu that the surfaces drawn
+// need, within a memory budget. a texture starts with its mip tail, the
+// levels up to kTailSize texels. surfaces request finer levels every frame
+// and Update grows the textures towards them one level at a time, dropping
+// the finest levels of the textures used least recently when the budget
+// runs out. the data of every level stays in the texture data buffer,
+// usually a mapped cache file, so levels are reloaded from it for free.
+//
+// d3d11 textures can not change their mip count, Update recreates a
+// texture with its new levels on the device, which is free threaded, and
+// releases the old one once the frames that may still draw with it are
+// done.
+class TextureStreamer {
+ public:
+  static const int kTailSize = 64;
+
+  TextureStreamer();
+  ~TextureStreamer();
+  TextureStreamer(const TextureStreamer&) = delete;
+  TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+  // 0 turns streaming off, textures added later are created whole
+  void SetBudget(size_t budget_bytes);
+  size_t GetBudget() const;
+  // upload per Update, finer levels wait for the next frames
+  void SetMaxUploadBytes(size_t upload_bytes);
+
+  static bool CanStream(const Texture& texture);
+
+  // creates the gpu texture of resource with the mip tail. the texture has
+  // to outlive the streamer.
+  void AddTexture(const Texture* texture, ID3D11Device* device,
+    TextureResource* resource);
+
+  // the finest mip level a surface needs: the texels one world unit of it
+  // covers over the pixels one world unit covers on screen. world_per_uv is
+  // the world size of one uv unit, pixels_per_world 0 if not known.
+  static int GetRequiredMip(const Texture& texture, float world_per_uv,
+    float pixels_per_world);
+
+  // records that the texture is drawn this frame down to mip_level and
+  // returns its current view, null if it is not streamed. game threads.
+  ID3D11ShaderResourceView* Request(const std::string& name, int mip_level);
+
+  // between frames, uploads and evicts mip levels for the requests since
+  // the last call
+  void Update(ID3D11Device* device);
+
+  TextureStreamingStats GetStats() const;
+
+ private:
+  struct StreamedTexture {
+    const Texture* texture;
+    TextureResource* resource;
+    int tail_mip;         // coarsest level streaming keeps
+    int resident_mip;     // finest level on the gpu
+    int requested_mip;    // finest level asked for this frame
+    int last_used_frame;
+  };
+
+  struct ReleasedView {
+    ID3D11Texture2D* texture;
+    ID3D11ShaderResourceView* srv;
+    int frame;
+  };
+
+  static size_t GetResidentSize(const Texture& texture, int mip);
+  // expects mutex_ to be locked
+  bool CreateView(ID3D11Device* device, StreamedTexture* streamed, int mip);
+
+  size_t budget_bytes_;
+  size_t max_upload_bytes_;
+  int frame_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, StreamedTexture> textures_;
+  std::vector<ReleasedView> released_;
+  TextureStreamingStats stats_;
+};
+}  // namespace render
+}  // namespace magnet
+#endif  // MAGNET_RENDER_TEXTURE_STREAMER_H_
@@ -0,0 +1,319 @@
+#include "core/async_reader.h"
+#include "core/task_manager.h"
+#include "render/texture.h"
+
+#include "asset_loader.h"
+#include "mesh_loader.h"
+#include "texture_cache.h"
+#include "texture_loader.h"
+
+namespace magnet {
+namespace scene {
+AssetLoader::AssetLoader(const AssetLoaderDesc& desc) : desc_(desc),
+  task_manager_(nullptr),
+  obj_threads_count_(0),
+  cook_threads_count_(0),
+  jobs_count_(0),
+  reader_(new core::AsyncReader()) {
+}
+
+AssetLoader::~AssetLoader() {
+}
+
+void AssetLoader::RequestMesh(const std::string& name) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  AddAsset(ASSET_MESH, name);
+}
+
+void AssetLoader::Run(const LoadProgressCallback& callback) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  if (core::TaskManager::Exist() &&
+    core::TaskManager::GetInstance()->GetThreadsCount() > 0) {
+    task_manager_ = core::TaskManager::GetInstance();
+    if (desc_.max_jobs <= 0)
+      desc_.max_jobs = task_manager_->GetThreadsCount();
+  }
+  else {
+    desc_.max_jobs = 0;
+  }
+
+  // a single obj is split over all cores by ObjParser, with several each
+  // job parses its own on one thread
+  obj_threads_count_ = asset_ids_[ASSET_MESH].size() > 1 ? 1 : 0;
+  // textures are found while loading, whether there are several is not
+  // known yet. jobs already load them side by side.
+  cook_threads_count_ = desc_.max_jobs > 1 ? 1 : 0;
+  reader_->Submit();
+  SubmitJobs();
+
+  int reported_loaded = -1;
+  while (true) {
+    if (progress_.assets_loaded != reported_loaded) {
+      reported_loaded = progress_.assets_loaded;
+      const LoadProgress kProgress = progress_;
+      lock.unlock();
+      if (callback)
+        callback(kProgress);
+      lock.lock();
+      continue;
+    }
+
+    // help the jobs instead of waiting for them
+    if (!ready_.empty()) {
+      const int kId = ready_.front();
+      ready_.pop_front();
+      Asset* asset = assets_[kId].get();
+      lock.unlock();
+
+      std::vector<std::string> dependencies;
+      Load(asset, &dependencies);
+
+      lock.lock();
+      Finish(kId, dependencies);
+      continue;
+    }
+
+    if (progress_.assets_loaded == progress_.assets_count && jobs_count_ == 0)
+      break;
+    changed_.wait(lock);
+  }
+}
+
+void AssetLoader::RunJob() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!ready_.empty()) {
+    const int kId = ready_.front();
+    ready_.pop_front();
+    Asset* asset = assets_[kId].get();
+    lock.unlock();
+
+    std::vector<std::string> dependencies;
+    Load(asset, &dependencies);
+
+    lock.lock();
+    Finish(kId, dependencies);
+  }
+
+  --jobs_count_;
+  changed_.notify_all();
+}
+
+void AssetLoader::Load(Asset* asset,
+  std::vector<std::string>* dependencies) const {
+  const core::FileView kNoFile;
+  const core::FileView& source = asset->files[0];
+  const core::FileView& cache = asset->files.size() > 1 ?
+    asset->files[1] : kNoFile;
+  const CookManifest::Asset* cooked =
+    source.IsOpen() ? nullptr : FindCookedAsset(*asset);
+  switch (asset->type) {
+  case ASSET_MESH:
+    if (cooked != nullptr) {
+      asset->loaded = cache.IsOpen() ?
+        MeshCache::Read(cache, cooked->source_key, &asset->mesh_data) :
+        MeshCache::Read(cooked->cache, cooked->source_key, &asset->mesh_data);
+    }
+    else {
+      asset->loaded = MeshLoader::LoadObj(source, cache, asset->name,
+        GetCachePath(*asset), obj_threads_count_, &asset->mesh_data);
+    }
+    if (asset->loaded)
+      *dependencies = asset->mesh_data.material_libraries;
+    break;
+  case ASSET_MATERIAL_LIBRARY:
+    asset->loaded = source.IsOpen();
+    if (asset->loaded)
+      MtlParser::Parse(source.GetData(), source.GetSize(), &asset->materials);
+    for (const MtlMaterial& material : asset->materials) {
+      if (!material.texture_name.empty())
+        dependencies->push_back(material.texture_name);
+    }
+    break;
+  case ASSET_TEXTURE: {
+    TextureCookDesc cook_desc = desc_.texture_cook;
+    cook_desc.threads_count = cook_threads_count_;
+    asset->texture = std::make_shared<render::Texture>(asset->name);
+    if (cooked != nullptr) {
+      asset->loaded = cache.IsOpen() ?
+        TextureCache::Read(cache, cooked->source_key, asset->texture.get()) :
+        TextureCache::Read(cooked->cache, cooked->source_key,
+          asset->texture.get());
+    }
+    else {
+      asset->loaded = TextureLoader::LoadCooked(desc_.texture_folder_path,
+        cook_desc, source, cache, GetCachePath(*asset), asset->texture.get());
+    }
+    break;
+  }
+  default:
+    break;
+  }
+
+  // what was taken from the cache keeps its file alive by itself
+  asset->files.clear();
+}
+
+void AssetLoader::Finish(int id, const std::vector<std::string>& dependencies) {
+  Asset* asset = assets_[id].get();
+  const AssetType kDependencyType = asset->type == ASSET_MESH ?
+    ASSET_MATERIAL_LIBRARY : ASSET_TEXTURE;
+  for (const std::string& dependency : dependencies)
+    asset->dependencies.push_back(AddAsset(kDependencyType, dependency));
+  reader_->Submit();
+
+  ++progress_.assets_loaded;
+  switch (asset->type) {
+  case ASSET_MESH:
+    ++progress_.meshes_loaded;
+    break;
+  case ASSET_MATERIAL_LIBRARY:
+    ++progress_.material_libraries_loaded;
+    break;
+  case ASSET_TEXTURE:
+    ++progress_.textures_loaded;
+    break;
+  default:
+    break;
+  }
+
+  SubmitJobs();
+  changed_.notify_all();
+}
+
+int AssetLoader::AddAsset(AssetType type, const std::string& name) {
+  auto it = asset_ids_[type].find(name);
+  if (it != asset_ids_[type].end())
+    return it->second;
+
+  const int kId = static_cast<int>(assets_.size());
+  std::unique_ptr<Asset> asset(new Asset());
+  asset->type = type;
+  asset->name = name;
+  asset->loaded = false;
+  asset->pending_reads = 0;
+  assets_.push_back(std::move(asset));
+  asset_ids_[type].insert(std::make_pair(name, kId));
+
+  ++progress_.assets_count;
+  ReadFiles(kId);
+  return kId;
+}
+
+void AssetLoader::ReadFiles(int id) {
+  Asset* asset = assets_[id].get();
+  std::vector<std::string> paths(1, GetSourcePath(*asset));
+  const std::string kCachePath = GetCachePath(*asset);
+  if (!kCachePath.empty())
+    paths.push_back(kCachePath);
+
+  asset->files.resize(paths.size());
+  asset->pending_reads = static_cast<int>(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i) {
+    const int kIndex = static_cast<int>(i);
+    reader_->Read(paths[i], [this, id, kIndex](bool,
+      const core::FileView& file) {
+      OnRead(id, kIndex, file);
+    });
+  }
+}
+
+void AssetLoader::OnRead(int id, int file_index, const core::FileView& file) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  Asset* asset = assets_[id].get();
+  // a file that failed stays closed, the loaders treat it as missing
+  asset->files[file_index] = file;
+  if (--asset->pending_reads > 0)
+    return;
+
+  ready_.push_back(id);
+  SubmitJobs();
+  changed_.notify_all();
+}
+
+void AssetLoader::SubmitJobs() {
+  // a job loads ready assets until there are none left, one job per ready
+  // asset is enough. reads finishing before Run wait for it.
+  while (task_manager_ != nullptr && jobs_count_ < desc_.max_jobs &&
+    jobs_count_ < static_cast<int>(ready_.size())) {
+    ++jobs_count_;
+    core::Task task;
+    task.func = std::bind(&AssetLoader::RunJob, this);
+    task_manager_->EnqueueTask(task);
+  }
+}
+
+std::string AssetLoader::GetSourcePath(const Asset& asset) const {
+  return (asset.type == ASSET_TEXTURE ? desc_.texture_folder_path :
+    desc_.mesh_folder_path) + asset.name;
+}
+
+std::string AssetLoader::GetCachePath(const Asset& asset) const {
+  switch (asset.type) {
+  case ASSET_MESH:
+    if (!desc_.mesh_cache_enabled)
+      return std::string();
+    return (desc_.mesh_cache_folder_path.empty() ? desc_.mesh_folder_path :
+      desc_.mesh_cache_folder_path) + asset.name + ".mcache";
+  case ASSET_TEXTURE:
+    if (!desc_.texture_cache_enabled)
+      return std::string();
+    return (desc_.texture_cache_folder_path.empty() ?
+      desc_.texture_folder_path : desc_.texture_cache_folder_path) +
+      asset.name + ".tcache";
+  default:
+    return std::string();
+  }
+}
+
+const CookManifest::Asset* AssetLoader::FindCookedAsset(
+  const Asset& asset) const {
+  if (desc_.cook_manifest == nullptr)
+    return nullptr;
+  const CookManifest::Asset* cooked =
+    desc_.cook_manifest->FindAsset(GetSourcePath(asset));
+  return cooked != nullptr && !cooked->cache.empty() ? cooked : nullptr;
+}
+
+const AssetLoader::Asset* AssetLoader::FindAsset(AssetType type,
+  const std::string& name) const {
+  auto it = asset_ids_[type].find(name);
+  return it != asset_ids_[type].end() ? assets_[it->second].get() : nullptr;
+}
+
+const MeshCacheData* AssetLoader::GetMeshData(const std::string& name) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  const Asset* asset = FindAsset(ASSET_MESH, name);
+  return asset != nullptr && asset->loaded ? &asset->mesh_data : nullptr;
+}
+
+const std::vector<MtlMaterial>* AssetLoader::GetMaterialLibrary(
+  const std::string& name) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  const Asset* asset = FindAsset(ASSET_MATERIAL_LIBRARY, name);
+  return asset != nullptr && asset->loaded ? &asset->materials : nullptr;
+}
+
+std::shared_ptr<render::Texture> AssetLoader::GetTexture(
+  const std::string& name) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  const Asset* asset = FindAsset(ASSET_TEXTURE, name);
+  return asset != nullptr ? asset->texture : nullptr;
+}
+
+std::vector<std::shared_ptr<render::Texture>> AssetLoader::GetTextures() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  std::vector<std::shared_ptr<render::Texture>> textures;
+  for (const std::unique_ptr<Asset>& asset : assets_) {
+    if (asset->type == ASSET_TEXTURE && asset->texture)
+      textures.push_back(asset->texture);
+  }
+  return textures;
+}
+
+LoadProgress AssetLoader::GetProgress() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return progress_;
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,154 @@
+#ifndef MAGNET_SCENE_ASSET_LOADER_H_
+#define MAGNET_SCENE_ASSET_LOADER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/file_system.h"
+
+#include "cook_manifest.h"
+#include "mesh_cache.h"
+#include "mtl_parser.h"
+#include "texture_cooker.h"
+
+namespace magnet {
+namespace core {
+class AsyncReader;
+class TaskManager;
+}  // namespace core
+
+namespace render {
+class Texture;
+}  // namespace render
+
+namespace scene {
+// assets of a scene loaded or failed so far. assets_count grows while jobs
+// find the material libraries and textures of the meshes.
+struct LoadProgress {
+  LoadProgress() : assets_count(0), assets_loaded(0), meshes_loaded(0),
+    material_libraries_loaded(0), textures_loaded(0) {}
+  int assets_count;
+  int assets_loaded;
+  int meshes_loaded;
+  int material_libraries_loaded;
+  int textures_loaded;
+};
+
+typedef std::function<void(const LoadProgress&)> LoadProgressCallback;
+
+struct AssetLoaderDesc {
+  AssetLoaderDesc() : mesh_cache_enabled(true),
+    texture_cache_enabled(true), max_jobs(0), cook_manifest(nullptr) {}
+  std::string mesh_folder_path;
+  std::string texture_folder_path;
+  std::string mesh_cache_folder_path;     // the mesh folder if empty
+  bool mesh_cache_enabled;
+  std::string texture_cache_folder_path;  // the texture folder if empty
+  bool texture_cache_enabled;
+  TextureCookDesc texture_cook;           // threads_count is set per job
+  int max_jobs;                           // 0 for one per TaskManager thread
+  // of a packed build, caches whose source is missing are trusted if it
+  // lists them. may be null.
+  const CookManifest* cook_manifest;
+};
+
+// loads what a scene references as a graph, meshes name material
+// libraries and those name textures. every asset is loaded once by a job,
+// finishing a job adds the assets it named. jobs go to the TaskManager,
+// at most max_jobs at a time so the frame tasks sharing the queue are not
+// starved; Run works on the same assets until the graph is done. without
+// TaskManager threads everything is loaded on the calling thread.
+//
+// the files of an asset, its source and cache, are read by an AsyncReader
+// as soon as the asset is known, and it is ready for a job once they are
+// in memory. jobs only parse and decode, many reads stay in flight while
+// they do.
+class AssetLoader {
+ public:
+  explicit AssetLoader(const AssetLoaderDesc& desc);
+  ~AssetLoader();
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+
+  // an obj file in the mesh folder, requesting it again does nothing
+  void RequestMesh(const std::string& name);
+
+  // returns when every requested asset and its dependencies are loaded or
+  // failed. the callback is called on the calling thread.
+  void Run(const LoadProgressCallback& callback);
+
+  // results, valid after Run. null if the asset was not requested or failed
+  const MeshCacheData* GetMeshData(const std::string& name) const;
+  const std::vector<MtlMaterial>* GetMaterialLibrary(
+    const std::string& name) const;
+  // textures are returned even if decoding failed, without data
+  std::shared_ptr<render::Texture> GetTexture(const std::string& name) const;
+  std::vector<std::shared_ptr<render::Texture>> GetTextures() const;
+
+  LoadProgress GetProgress() const;
+
+ private:
+  enum AssetType {
+    ASSET_MESH,
+    ASSET_MATERIAL_LIBRARY,
+    ASSET_TEXTURE,
+    ASSET_TYPE_COUNT
+  };
+
+  struct Asset {
+    AssetType type;
+    std::string name;
+    bool loaded;
+    std::vector<int> dependencies;
+    // source and cache file, read before the asset is ready
+    std::vector<core::FileView> files;
+    int pending_reads;
+
+    // only the job of the asset writes these
+    MeshCacheData mesh_data;
+    std::vector<MtlMaterial> materials;
+    std::shared_ptr<render::Texture> texture;
+  };
+
+  // these expect mutex_ to be locked
+  int AddAsset(AssetType type, const std::string& name);
+  void ReadFiles(int id);
+  void SubmitJobs();
+  const Asset* FindAsset(AssetType type, const std::string& name) const;
+
+  void RunJob();
+  void Load(Asset* asset, std::vector<std::string>* dependencies) const;
+  void Finish(int id, const std::vector<std::string>& dependencies);
+  void OnRead(int id, int file_index, const core::FileView& file);
+
+  std::string GetSourcePath(const Asset& asset) const;
+  // the cooked cache of an asset whose source is missing, null if there is
+  // none
+  const CookManifest::Asset* FindCookedAsset(const Asset& asset) const;
+  // empty if the asset type has no cache or it is disabled
+  std::string GetCachePath(const Asset& asset) const;
+
+  AssetLoaderDesc desc_;
+  core::TaskManager* task_manager_;
+  int obj_threads_count_;       // ObjParser threads per mesh job
+  int cook_threads_count_;      // TextureCooker threads per texture job
+
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::vector<std::unique_ptr<Asset>> assets_;
+  std::unordered_map<std::string, int> asset_ids_[ASSET_TYPE_COUNT];
+  std::deque<int> ready_;       // assets read that no job has taken yet
+  int jobs_count_;              // jobs in the TaskManager queue or running
+  LoadProgress progress_;
+  // last, its callbacks lock mutex_ until it is destroyed
+  std::unique_ptr<core::AsyncReader> reader_;
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_ASSET_LOADER_H_
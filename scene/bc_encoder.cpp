@@ -0,0 +1,872 @@
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "core/parallel_for.h"
+#include "core/simd.h"
+
+#include "bc_encoder.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+// a row of blocks of a small mip is not worth a thread
+static const size_t kMinBlocksPerThread = 256;
+
+// bc7 interpolation weights out of 64
+static const int kWeights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const int kWeights4[16] = {
+  0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// bc7 two subset partitions, bit i is the subset of texel i, and the
+// texel whose index drops its top bit in the second subset
+static const uint16_t kPartitions2[64] = {
+  0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+  0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+  0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+  0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+  0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+  0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+  0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+  0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22 };
+static const uint8_t kAnchors2[64] = {
+  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+  15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+  15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+  6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15 };
+
+// partitions fully encoded at high quality, picked by their line fit
+static const int kPartitionCandidates = 4;
+
+struct Block {
+  int16_t texels[16][4];
+};
+
+void LoadBlock(const uint8_t* texels, bool keep_alpha, Block* block) {
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 4; ++c)
+      block->texels[i][c] = texels[i * 4 + c];
+    if (!keep_alpha)
+      block->texels[i][3] = 0;
+  }
+}
+
+// nearest palette entry of every texel by squared rgba distance, returns
+// the summed error. errors gets the error of every texel if not null.
+int SelectIndices(const Block& block, const int16_t (*palette)[4],
+  int palette_size, uint8_t* indices, int* errors) {
+  int texel_errors[16];
+#ifdef MAGNET_SSE2
+  __m128i texels[8];
+  __m128i best_errors[8];
+  __m128i best_indices[8];
+  for (int k = 0; k < 8; ++k) {
+    texels[k] = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(block.texels[k * 2]));
+    best_errors[k] = _mm_set1_epi32(INT_MAX);
+    best_indices[k] = _mm_setzero_si128();
+  }
+  for (int e = 0; e < palette_size; ++e) {
+    const int16_t* color = palette[e];
+    const __m128i kColor = _mm_set_epi16(color[3], color[2], color[1],
+      color[0], color[3], color[2], color[1], color[0]);
+    const __m128i kIndex = _mm_set1_epi32(e);
+    for (int k = 0; k < 8; ++k) {
+      const __m128i kDifference = _mm_sub_epi16(texels[k], kColor);
+      const __m128i kSquares = _mm_madd_epi16(kDifference, kDifference);
+      // both halves of a texel summed into lanes 0 and 2
+      const __m128i kError = _mm_add_epi32(kSquares,
+        _mm_shuffle_epi32(kSquares, _MM_SHUFFLE(2, 3, 0, 1)));
+      const __m128i kLess = _mm_cmplt_epi32(kError, best_errors[k]);
+      best_errors[k] = _mm_or_si128(_mm_and_si128(kLess, kError),
+        _mm_andnot_si128(kLess, best_errors[k]));
+      best_indices[k] = _mm_or_si128(_mm_and_si128(kLess, kIndex),
+        _mm_andnot_si128(kLess, best_indices[k]));
+    }
+  }
+  for (int k = 0; k < 8; ++k) {
+    int32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), best_errors[k]);
+    texel_errors[k * 2] = lanes[0];
+    texel_errors[k * 2 + 1] = lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), best_indices[k]);
+    indices[k * 2] = static_cast<uint8_t>(lanes[0]);
+    indices[k * 2 + 1] = static_cast<uint8_t>(lanes[2]);
+  }
+#else
+  for (int i = 0; i < 16; ++i) {
+    texel_errors[i] = INT_MAX;
+    for (int e = 0; e < palette_size; ++e) {
+      int error = 0;
+      for (int c = 0; c < 4; ++c) {
+        const int kDifference = block.texels[i][c] - palette[e][c];
+        error += kDifference * kDifference;
+      }
+      if (error < texel_errors[i]) {
+        texel_errors[i] = error;
+        indices[i] = static_cast<uint8_t>(e);
+      }
+    }
+  }
+#endif  // MAGNET_SSE2
+
+  int total = 0;
+  for (int i = 0; i < 16; ++i)
+    total += texel_errors[i];
+  if (errors != nullptr)
+    memcpy(errors, texel_errors, sizeof(texel_errors));
+  return total;
+}
+
+// principal axis of the texels of one subset through their mean by power
+// iteration. returns the squared distance of the texels to that line.
+float FitLine(const Block& block, uint16_t mask, int channels_count,
+  float mean[4], float axis[4], float* t_min, float* t_max) {
+  int count = 0;
+  for (int c = 0; c < 4; ++c)
+    mean[c] = 0.f;
+  for (int i = 0; i < 16; ++i) {
+    if (!(mask >> i & 1))
+      continue;
+    ++count;
+    for (int c = 0; c < channels_count; ++c)
+      mean[c] += block.texels[i][c];
+  }
+  for (int c = 0; c < channels_count; ++c)
+    mean[c] /= count;
+
+  float covariance[4][4] = { { 0.f } };
+  float variance = 0.f;
+  for (int i = 0; i < 16; ++i) {
+    if (!(mask >> i & 1))
+      continue;
+    float d[4];
+    for (int c = 0; c < channels_count; ++c)
+      d[c] = block.texels[i][c] - mean[c];
+    for (int a = 0; a < channels_count; ++a) {
+      variance += d[a] * d[a];
+      for (int b = 0; b < channels_count; ++b)
+        covariance[a][b] += d[a] * d[b];
+    }
+  }
+
+  // start from the channel that varies most
+  int start = 0;
+  for (int c = 1; c < channels_count; ++c) {
+    if (covariance[c][c] > covariance[start][start])
+      start = c;
+  }
+  for (int c = 0; c < 4; ++c)
+    axis[c] = c < channels_count ? covariance[start][c] : 0.f;
+  for (int iteration = 0; iteration < 8; ++iteration) {
+    float next[4] = { 0.f, 0.f, 0.f, 0.f };
+    float length = 0.f;
+    for (int a = 0; a < channels_count; ++a) {
+      for (int b = 0; b < channels_count; ++b)
+        next[a] += covariance[a][b] * axis[b];
+      length += next[a] * next[a];
+    }
+    if (length < 1e-12f)
+      break;
+    length = 1.f / sqrtf(length);
+    for (int c = 0; c < channels_count; ++c)
+      axis[c] = next[c] * length;
+  }
+  float length = 0.f;
+  for (int c = 0; c < channels_count; ++c)
+    length += axis[c] * axis[c];
+  if (length < 1e-12f) {
+    for (int c = 0; c < 4; ++c)
+      axis[c] = 0.f;
+  }
+
+  *t_min = 0.f;
+  *t_max = 0.f;
+  float along = 0.f;
+  for (int i = 0; i < 16; ++i) {
+    if (!(mask >> i & 1))
+      continue;
+    float t = 0.f;
+    for (int c = 0; c < channels_count; ++c)
+      t += (block.texels[i][c] - mean[c]) * axis[c];
+    *t_min = std::min(*t_min, t);
+    *t_max = std::max(*t_max, t);
+    along += t * t;
+  }
+  return std::max(0.f, variance - along);
+}
+
+void GetLineEndpoints(const Block& block, uint16_t mask, int channels_count,
+  float endpoints[2][4]) {
+  float mean[4];
+  float axis[4];
+  float t_min;
+  float t_max;
+  FitLine(block, mask, channels_count, mean, axis, &t_min, &t_max);
+  for (int c = 0; c < 4; ++c) {
+    endpoints[0][c] = std::min(255.f, std::max(0.f, mean[c] + axis[c] * t_min));
+    endpoints[1][c] = std::min(255.f, std::max(0.f, mean[c] + axis[c] * t_max));
+  }
+}
+
+// endpoints minimizing the squared error of the texels of a subset when
+// texel i is weights[i] of the way from the first to the second
+bool SolveEndpoints(const Block& block, uint16_t mask, const float* weights,
+  int channels_count, float endpoints[2][4]) {
+  float aa = 0.f;
+  float ab = 0.f;
+  float bb = 0.f;
+  float ax[4] = { 0.f, 0.f, 0.f, 0.f };
+  float bx[4] = { 0.f, 0.f, 0.f, 0.f };
+  for (int i = 0; i < 16; ++i) {
+    if (!(mask >> i & 1))
+      continue;
+    const float kB = weights[i];
+    const float kA = 1.f - kB;
+    aa += kA * kA;
+    ab += kA * kB;
+    bb += kB * kB;
+    for (int c = 0; c < channels_count; ++c) {
+      ax[c] += kA * block.texels[i][c];
+      bx[c] += kB * block.texels[i][c];
+    }
+  }
+  const float kDeterminant = aa * bb - ab * ab;
+  if (fabsf(kDeterminant) < 1e-6f)
+    return false;
+  const float kInverse = 1.f / kDeterminant;
+  for (int c = 0; c < channels_count; ++c) {
+    endpoints[0][c] = std::min(255.f, std::max(0.f,
+      (ax[c] * bb - bx[c] * ab) * kInverse));
+    endpoints[1][c] = std::min(255.f, std::max(0.f,
+      (bx[c] * aa - ax[c] * ab) * kInverse));
+  }
+  return true;
+}
+
+inline int Clamp(int value, int low, int high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+// bc1
+
+struct Bc1Result {
+  uint16_t colors[2];
+  uint8_t indices[16];
+  int error;
+};
+
+inline uint16_t To565(const float color[4]) {
+  const int kRed = Clamp(static_cast<int>(color[0] * 31.f / 255.f + 0.5f),
+    0, 31);
+  const int kGreen = Clamp(static_cast<int>(color[1] * 63.f / 255.f + 0.5f),
+    0, 63);
+  const int kBlue = Clamp(static_cast<int>(color[2] * 31.f / 255.f + 0.5f),
+    0, 31);
+  return static_cast<uint16_t>((kRed << 11) | (kGreen << 5) | kBlue);
+}
+
+inline void From565(uint16_t value, int16_t color[4]) {
+  const int kRed = value >> 11;
+  const int kGreen = (value >> 5) & 63;
+  const int kBlue = value & 31;
+  color[0] = static_cast<int16_t>((kRed << 3) | (kRed >> 2));
+  color[1] = static_cast<int16_t>((kGreen << 2) | (kGreen >> 4));
+  color[2] = static_cast<int16_t>((kBlue << 3) | (kBlue >> 2));
+  color[3] = 0;
+}
+
+// four color mode, the first color has to be the larger one
+void EvaluateBc1(const Block& block, uint16_t color0, uint16_t color1,
+  Bc1Result* result) {
+  if (color0 < color1)
+    std::swap(color0, color1);
+  result->colors[0] = color0;
+  result->colors[1] = color1;
+
+  int16_t palette[4][4];
+  From565(color0, palette[0]);
+  From565(color1, palette[1]);
+  for (int c = 0; c < 4; ++c) {
+    palette[2][c] = static_cast<int16_t>(
+      (2 * palette[0][c] + palette[1][c] + 1) / 3);
+    palette[3][c] = static_cast<int16_t>(
+      (palette[0][c] + 2 * palette[1][c] + 1) / 3);
+  }
+  // equal colors select the three color mode, every index 0 is right there
+  result->error = SelectIndices(block, palette, color0 == color1 ? 1 : 4,
+    result->indices, nullptr);
+}
+
+void RefineBc1(const Block& block, Bc1Result* result) {
+  static const float kIndexWeights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+  float weights[16];
+  for (int i = 0; i < 16; ++i)
+    weights[i] = kIndexWeights[result->indices[i]];
+
+  float endpoints[2][4];
+  if (!SolveEndpoints(block, 0xffff, weights, 3, endpoints))
+    return;
+
+  Bc1Result refined;
+  EvaluateBc1(block, To565(endpoints[0]), To565(endpoints[1]), &refined);
+  if (refined.error < result->error)
+    *result = refined;
+}
+
+// moves every 565 component of both colors by one step while that helps
+void SearchBc1(const Block& block, Bc1Result* result) {
+  static const int kShifts[3] = { 11, 5, 0 };
+  static const int kMasks[3] = { 31, 63, 31 };
+  for (int pass = 0; pass < 4; ++pass) {
+    bool improved = false;
+    for (int endpoint = 0; endpoint < 2; ++endpoint) {
+      for (int channel = 0; channel < 3; ++channel) {
+        for (int step = -1; step <= 1; step += 2) {
+          uint16_t colors[2] = { result->colors[0], result->colors[1] };
+          const int kValue =
+            (colors[endpoint] >> kShifts[channel]) & kMasks[channel];
+          if (kValue + step < 0 || kValue + step > kMasks[channel])
+            continue;
+          colors[endpoint] = static_cast<uint16_t>(
+            (colors[endpoint] & ~(kMasks[channel] << kShifts[channel])) |
+            ((kValue + step) << kShifts[channel]));
+          Bc1Result candidate;
+          EvaluateBc1(block, colors[0], colors[1], &candidate);
+          if (candidate.error < result->error) {
+            *result = candidate;
+            improved = true;
+          }
+        }
+      }
+    }
+    if (!improved)
+      break;
+  }
+}
+
+void EncodeColorBlock(const uint8_t* texels, BcQuality quality,
+  uint8_t* output) {
+  Block block;
+  LoadBlock(texels, false, &block);
+
+  float endpoints[2][4];
+  GetLineEndpoints(block, 0xffff, 3, endpoints);
+
+  Bc1Result result;
+  EvaluateBc1(block, To565(endpoints[0]), To565(endpoints[1]), &result);
+  const int kRefinements = quality == BC_QUALITY_HIGH ? 3 :
+    (quality == BC_QUALITY_NORMAL ? 1 : 0);
+  for (int i = 0; i < kRefinements; ++i)
+    RefineBc1(block, &result);
+  if (quality == BC_QUALITY_HIGH)
+    SearchBc1(block, &result);
+
+  output[0] = static_cast<uint8_t>(result.colors[0]);
+  output[1] = static_cast<uint8_t>(result.colors[0] >> 8);
+  output[2] = static_cast<uint8_t>(result.colors[1]);
+  output[3] = static_cast<uint8_t>(result.colors[1] >> 8);
+  uint32_t indices = 0;
+  for (int i = 0; i < 16; ++i)
+    indices |= static_cast<uint32_t>(result.indices[i]) << (i * 2);
+  for (int i = 0; i < 4; ++i)
+    output[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+}
+
+// bc4
+
+void GetBc4Palette(int value0, int value1, int palette[8]) {
+  palette[0] = value0;
+  palette[1] = value1;
+  if (value0 > value1) {
+    for (int i = 1; i < 7; ++i)
+      palette[i + 1] = ((7 - i) * value0 + i * value1 + 3) / 7;
+  }
+  else {
+    for (int i = 1; i < 5; ++i)
+      palette[i + 1] = ((5 - i) * value0 + i * value1 + 2) / 5;
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+int EvaluateBc4(const int values[16], int value0, int value1,
+  uint8_t indices[16]) {
+  int palette[8];
+  GetBc4Palette(value0, value1, palette);
+  int total = 0;
+  for (int i = 0; i < 16; ++i) {
+    int best = INT_MAX;
+    for (int e = 0; e < 8; ++e) {
+      const int kError = (values[i] - palette[e]) * (values[i] - palette[e]);
+      if (kError < best) {
+        best = kError;
+        indices[i] = static_cast<uint8_t>(e);
+      }
+    }
+    total += best;
+  }
+  return total;
+}
+
+void EncodeChannelBlock(const uint8_t* texels, int channel, BcQuality quality,
+  uint8_t* output) {
+  int values[16];
+  int low = 255;
+  int high = 0;
+  int inner_low = 255;    // without the 0 and 255 the six value mode has
+  int inner_high = 0;
+  for (int i = 0; i < 16; ++i) {
+    values[i] = texels[i * 4 + channel];
+    low = std::min(low, values[i]);
+    high = std::max(high, values[i]);
+    if (values[i] != 0 && values[i] != 255) {
+      inner_low = std::min(inner_low, values[i]);
+      inner_high = std::max(inner_high, values[i]);
+    }
+  }
+
+  int value0 = high;
+  int value1 = low;
+  uint8_t indices[16];
+  int error = EvaluateBc4(values, value0, value1, indices);
+  if (quality != BC_QUALITY_FAST && error > 0) {
+    if (inner_low <= inner_high) {
+      uint8_t candidate_indices[16];
+      const int kError = EvaluateBc4(values, inner_low, inner_high,
+        candidate_indices);
+      if (kError < error) {
+        error = kError;
+        value0 = inner_low;
+        value1 = inner_high;
+        memcpy(indices, candidate_indices, sizeof(indices));
+      }
+    }
+    // insetting the ends trades their error for the middle values
+    const int kRange = quality == BC_QUALITY_HIGH ? 4 : 1;
+    for (int inset0 = 0; inset0 <= kRange; ++inset0) {
+      for (int inset1 = 0; inset1 <= kRange; ++inset1) {
+        const int kValue0 = high - inset0;
+        const int kValue1 = low + inset1;
+        if (kValue0 <= kValue1)
+          continue;
+        uint8_t candidate_indices[16];
+        const int kError = EvaluateBc4(values, kValue0, kValue1,
+          candidate_indices);
+        if (kError < error) {
+          error = kError;
+          value0 = kValue0;
+          value1 = kValue1;
+          memcpy(indices, candidate_indices, sizeof(indices));
+        }
+      }
+    }
+  }
+
+  output[0] = static_cast<uint8_t>(value0);
+  output[1] = static_cast<uint8_t>(value1);
+  uint64_t bits = 0;
+  for (int i = 0; i < 16; ++i)
+    bits |= static_cast<uint64_t>(indices[i]) << (i * 3);
+  for (int i = 0; i < 6; ++i)
+    output[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+}
+
+// bc7
+
+class BlockWriter {
+ public:
+  explicit BlockWriter(uint8_t* block) : block_(block), position_(0) {
+    memset(block_, 0, 16);
+  }
+
+  void Write(uint32_t value, int count) {
+    for (int i = 0; i < count; ++i, ++position_) {
+      if (value >> i & 1)
+        block_[position_ >> 3] |= static_cast<uint8_t>(1 << (position_ & 7));
+    }
+  }
+
+ private:
+  uint8_t* block_;
+  int position_;
+};
+
+struct Mode6Result {
+  int endpoints[2][4];    // 7 bits
+  int p_bits[2];
+  uint8_t indices[16];
+  int error;
+};
+
+// an endpoint to 7 bits per channel and its own p bit, the one closer
+void QuantizeMode6(const float endpoint[4], int quantized[4], int* p_bit) {
+  int best_error = INT_MAX;
+  for (int p = 0; p < 2; ++p) {
+    int values[4];
+    int error = 0;
+    for (int c = 0; c < 4; ++c) {
+      values[c] = Clamp(static_cast<int>((endpoint[c] - p) * 0.5f + 0.5f),
+        0, 127);
+      const float kDifference = values[c] * 2 + p - endpoint[c];
+      error += static_cast<int>(kDifference * kDifference);
+    }
+    if (error < best_error) {
+      best_error = error;
+      memcpy(quantized, values, sizeof(values));
+      *p_bit = p;
+    }
+  }
+}
+
+void EvaluateMode6(const Block& block, const float endpoints[2][4],
+  Mode6Result* result) {
+  int16_t colors[2][4];
+  for (int e = 0; e < 2; ++e) {
+    QuantizeMode6(endpoints[e], result->endpoints[e], &result->p_bits[e]);
+    for (int c = 0; c < 4; ++c) {
+      colors[e][c] = static_cast<int16_t>(
+        result->endpoints[e][c] * 2 + result->p_bits[e]);
+    }
+  }
+
+  int16_t palette[16][4];
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      palette[i][c] = static_cast<int16_t>(((64 - kWeights4[i]) *
+        colors[0][c] + kWeights4[i] * colors[1][c] + 32) >> 6);
+    }
+  }
+  result->error = SelectIndices(block, palette, 16, result->indices, nullptr);
+}
+
+int EncodeMode6(const Block& block, BcQuality quality, uint8_t* output) {
+  float endpoints[2][4];
+  GetLineEndpoints(block, 0xffff, 4, endpoints);
+  Mode6Result result;
+  EvaluateMode6(block, endpoints, &result);
+
+  const int kRefinements = quality == BC_QUALITY_HIGH ? 2 :
+    (quality == BC_QUALITY_NORMAL ? 1 : 0);
+  for (int iteration = 0; iteration < kRefinements; ++iteration) {
+    float weights[16];
+    for (int i = 0; i < 16; ++i)
+      weights[i] = kWeights4[result.indices[i]] / 64.f;
+    if (!SolveEndpoints(block, 0xffff, weights, 4, endpoints))
+      break;
+    Mode6Result refined;
+    EvaluateMode6(block, endpoints, &refined);
+    if (refined.error >= result.error)
+      break;
+    result = refined;
+  }
+
+  // the top bit of the first index is implied zero
+  if (result.indices[0] & 8) {
+    std::swap(result.endpoints[0], result.endpoints[1]);
+    std::swap(result.p_bits[0], result.p_bits[1]);
+    for (int i = 0; i < 16; ++i)
+      result.indices[i] = static_cast<uint8_t>(15 - result.indices[i]);
+  }
+
+  BlockWriter writer(output);
+  writer.Write(1 << 6, 7);
+  for (int c = 0; c < 4; ++c) {
+    writer.Write(result.endpoints[0][c], 7);
+    writer.Write(result.endpoints[1][c], 7);
+  }
+  writer.Write(result.p_bits[0], 1);
+  writer.Write(result.p_bits[1], 1);
+  for (int i = 0; i < 16; ++i)
+    writer.Write(result.indices[i], i == 0 ? 3 : 4);
+  return result.error;
+}
+
+struct Mode1Result {
+  int endpoints[2][2][3];   // subset, endpoint, 6 bits per channel
+  int p_bits[2];            // shared by the endpoints of a subset
+  uint8_t indices[16];
+  int error;
+};
+
+inline int ExpandMode1(int value, int p_bit) {
+  const int kValue7 = (value << 1) | p_bit;
+  return (kValue7 << 1) | (kValue7 >> 6);
+}
+
+void EvaluateMode1(const Block& block, int partition,
+  const float endpoints[2][2][4], Mode1Result* result) {
+  int texel_errors[2][16];
+  uint8_t subset_indices[2][16];
+  for (int s = 0; s < 2; ++s) {
+    // the p bit both endpoints of the subset fit best with
+    int best_error = INT_MAX;
+    for (int p = 0; p < 2; ++p) {
+      int quantized[2][3];
+      int error = 0;
+      for (int e = 0; e < 2; ++e) {
+        for (int c = 0; c < 3; ++c) {
+          const float kTarget = endpoints[s][e][c];
+          const int kGuess = static_cast<int>(kTarget / 4.f);
+          int best_value = 0;
+          int best_difference = INT_MAX;
+          for (int value = std::max(0, kGuess - 1);
+            value <= std::min(63, kGuess + 1); ++value) {
+            const int kDifference = static_cast<int>(fabsf(
+              ExpandMode1(value, p) - kTarget) + 0.5f);
+            if (kDifference < best_difference) {
+              best_difference = kDifference;
+              best_value = value;
+            }
+          }
+          quantized[e][c] = best_value;
+          error += best_difference * best_difference;
+        }
+      }
+      if (error < best_error) {
+        best_error = error;
+        memcpy(result->endpoints[s], quantized, sizeof(quantized));
+        result->p_bits[s] = p;
+      }
+    }
+
+    int16_t colors[2][4];
+    for (int e = 0; e < 2; ++e) {
+      for (int c = 0; c < 3; ++c) {
+        colors[e][c] = static_cast<int16_t>(
+          ExpandMode1(result->endpoints[s][e][c], result->p_bits[s]));
+      }
+      colors[e][3] = 255;
+    }
+    int16_t palette[8][4];
+    for (int i = 0; i < 8; ++i) {
+      for (int c = 0; c < 4; ++c) {
+        palette[i][c] = static_cast<int16_t>(((64 - kWeights3[i]) *
+          colors[0][c] + kWeights3[i] * colors[1][c] + 32) >> 6);
+      }
+    }
+    SelectIndices(block, palette, 8, subset_indices[s], texel_errors[s]);
+  }
+
+  result->error = 0;
+  for (int i = 0; i < 16; ++i) {
+    const int kSubset = kPartitions2[partition] >> i & 1;
+    result->indices[i] = subset_indices[kSubset][i];
+    result->error += texel_errors[kSubset][i];
+  }
+}
+
+int EncodeMode1(const Block& block, int partition, BcQuality quality,
+  uint8_t* output) {
+  const uint16_t kMasks[2] = { static_cast<uint16_t>(~kPartitions2[partition]),
+    kPartitions2[partition] };
+  float endpoints[2][2][4];
+  for (int s = 0; s < 2; ++s)
+    GetLineEndpoints(block, kMasks[s], 3, endpoints[s]);
+  Mode1Result result;
+  EvaluateMode1(block, partition, endpoints, &result);
+
+  const int kRefinements = quality == BC_QUALITY_HIGH ? 2 : 1;
+  for (int iteration = 0; iteration < kRefinements; ++iteration) {
+    float weights[16];
+    for (int i = 0; i < 16; ++i)
+      weights[i] = kWeights3[result.indices[i]] / 64.f;
+    bool solved = true;
+    for (int s = 0; s < 2; ++s)
+      solved = solved && SolveEndpoints(block, kMasks[s], weights, 3,
+        endpoints[s]);
+    if (!solved)
+      break;
+    Mode1Result refined;
+    EvaluateMode1(block, partition, endpoints, &refined);
+    if (refined.error >= result.error)
+      break;
+    result = refined;
+  }
+
+  // the anchor texel of each subset drops the top bit of its index
+  const int kAnchors[2] = { 0, kAnchors2[partition] };
+  for (int s = 0; s < 2; ++s) {
+    if (!(result.indices[kAnchors[s]] & 4))
+      continue;
+    std::swap(result.endpoints[s][0], result.endpoints[s][1]);
+    for (int i = 0; i < 16; ++i) {
+      if ((kPartitions2[partition] >> i & 1) == s)
+        result.indices[i] = static_cast<uint8_t>(7 - result.indices[i]);
+    }
+  }
+
+  BlockWriter writer(output);
+  writer.Write(2, 2);
+  writer.Write(partition, 6);
+  for (int c = 0; c < 3; ++c) {
+    for (int s = 0; s < 2; ++s) {
+      writer.Write(result.endpoints[s][0][c], 6);
+      writer.Write(result.endpoints[s][1][c], 6);
+    }
+  }
+  writer.Write(result.p_bits[0], 1);
+  writer.Write(result.p_bits[1], 1);
+  for (int i = 0; i < 16; ++i)
+    writer.Write(result.indices[i], i == 0 || i == kAnchors[1] ? 2 : 3);
+  return result.error;
+}
+
+void EncodeBlock(render::TextureFormat format, BcQuality quality,
+  const uint8_t* texels, uint8_t* output) {
+  switch (format) {
+  case render::TEXTURE_FORMAT_BC1_UNORM:
+  case render::TEXTURE_FORMAT_BC1_UNORM_SRGB:
+    BcEncoder::EncodeBc1(texels, quality, output);
+    break;
+  case render::TEXTURE_FORMAT_BC3_UNORM:
+  case render::TEXTURE_FORMAT_BC3_UNORM_SRGB:
+    BcEncoder::EncodeBc3(texels, quality, output);
+    break;
+  case render::TEXTURE_FORMAT_BC4_UNORM:
+    BcEncoder::EncodeBc4(texels, 0, quality, output);
+    break;
+  case render::TEXTURE_FORMAT_BC5_UNORM:
+    BcEncoder::EncodeBc5(texels, quality, output);
+    break;
+  case render::TEXTURE_FORMAT_BC7_UNORM:
+  case render::TEXTURE_FORMAT_BC7_UNORM_SRGB:
+    BcEncoder::EncodeBc7(texels, quality, output);
+    break;
+  default:
+    break;
+  }
+}
+}  // namespace
+
+bool BcEncoder::CanEncode(render::TextureFormat format) {
+  switch (format) {
+  case render::TEXTURE_FORMAT_BC1_UNORM:
+  case render::TEXTURE_FORMAT_BC1_UNORM_SRGB:
+  case render::TEXTURE_FORMAT_BC3_UNORM:
+  case render::TEXTURE_FORMAT_BC3_UNORM_SRGB:
+  case render::TEXTURE_FORMAT_BC4_UNORM:
+  case render::TEXTURE_FORMAT_BC5_UNORM:
+  case render::TEXTURE_FORMAT_BC7_UNORM:
+  case render::TEXTURE_FORMAT_BC7_UNORM_SRGB:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void BcEncoder::EncodeBc1(const uint8_t* texels, BcQuality quality,
+  uint8_t* block) {
+  EncodeColorBlock(texels, quality, block);
+}
+
+void BcEncoder::EncodeBc3(const uint8_t* texels, BcQuality quality,
+  uint8_t* block) {
+  EncodeChannelBlock(texels, 3, quality, block);
+  EncodeColorBlock(texels, quality, block + 8);
+}
+
+void BcEncoder::EncodeBc4(const uint8_t* texels, int channel,
+  BcQuality quality, uint8_t* block) {
+  EncodeChannelBlock(texels, channel, quality, block);
+}
+
+void BcEncoder::EncodeBc5(const uint8_t* texels, BcQuality quality,
+  uint8_t* block) {
+  EncodeChannelBlock(texels, 0, quality, block);
+  EncodeChannelBlock(texels, 1, quality, block + 8);
+}
+
+void BcEncoder::EncodeBc7(const uint8_t* texels, BcQuality quality,
+  uint8_t* block) {
+  Block loaded;
+  LoadBlock(texels, true, &loaded);
+  const int kMode6Error = EncodeMode6(loaded, quality, block);
+  if (quality != BC_QUALITY_HIGH || kMode6Error == 0)
+    return;
+
+  bool opaque = true;
+  for (int i = 0; i < 16 && opaque; ++i)
+    opaque = loaded.texels[i][3] == 255;
+  if (!opaque)
+    return;
+
+  // the partitions whose subsets lie closest to lines get encoded
+  int candidates[kPartitionCandidates];
+  float candidate_errors[kPartitionCandidates];
+  for (int i = 0; i < kPartitionCandidates; ++i) {
+    candidates[i] = -1;
+    candidate_errors[i] = 1e30f;
+  }
+  for (int partition = 0; partition < 64; ++partition) {
+    float error = 0.f;
+    const uint16_t kMasks[2] = {
+      static_cast<uint16_t>(~kPartitions2[partition]),
+      kPartitions2[partition] };
+    for (int s = 0; s < 2; ++s) {
+      float mean[4];
+      float axis[4];
+      float t_min;
+      float t_max;
+      error += FitLine(loaded, kMasks[s], 3, mean, axis, &t_min, &t_max);
+    }
+    for (int i = 0; i < kPartitionCandidates; ++i) {
+      if (error < candidate_errors[i]) {
+        for (int j = kPartitionCandidates - 1; j > i; --j) {
+          candidates[j] = candidates[j - 1];
+          candidate_errors[j] = candidate_errors[j - 1];
+        }
+        candidates[i] = partition;
+        candidate_errors[i] = error;
+        break;
+      }
+    }
+  }
+
+  int best_error = kMode6Error;
+  for (int i = 0; i < kPartitionCandidates; ++i) {
+    uint8_t candidate[16];
+    const int kError = EncodeMode1(loaded, candidates[i], quality, candidate);
+    if (kError < best_error) {
+      best_error = kError;
+      memcpy(block, candidate, sizeof(candidate));
+    }
+  }
+}
+
+bool BcEncoder::EncodeSurface(render::TextureFormat format,
+  BcQuality quality, const uint8_t* texels, int width, int height,
+  size_t pitch, int threads_count, uint8_t* blocks) {
+  if (!CanEncode(format) || width <= 0 || height <= 0)
+    return false;
+
+  const int kBlocksWide = (width + 3) / 4;
+  const int kBlocksHigh = (height + 3) / 4;
+  const int kBlockBytes = render::GetFormatBytes(format);
+  threads_count = core::GetParallelThreadsCount(
+    static_cast<size_t>(kBlocksWide) * kBlocksHigh, kMinBlocksPerThread,
+    threads_count);
+  core::ParallelFor(kBlocksHigh, threads_count, [&](int begin, int end) {
+    uint8_t block_texels[64];
+    for (int by = begin; by < end; ++by) {
+      uint8_t* output = blocks +
+        static_cast<size_t>(by) * kBlocksWide * kBlockBytes;
+      for (int bx = 0; bx < kBlocksWide; ++bx) {
+        for (int y = 0; y < 4; ++y) {
+          const int kY = std::min(by * 4 + y, height - 1);
+          for (int x = 0; x < 4; ++x) {
+            const int kX = std::min(bx * 4 + x, width - 1);
+            memcpy(block_texels + (y * 4 + x) * 4,
+              texels + kY * pitch + kX * 4, 4);
+          }
+        }
+        EncodeBlock(format, quality, block_texels,
+          output + bx * kBlockBytes);
+      }
+    }
+  });
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
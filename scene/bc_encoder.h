@@ -0,0 +1,51 @@
+#ifndef MAGNET_SCENE_BC_ENCODER_H_
+#define MAGNET_SCENE_BC_ENCODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "render/texture.h"
+
+namespace magnet {
+namespace scene {
+enum BcQuality {
+  BC_QUALITY_FAST,      // one endpoint fit per block
+  BC_QUALITY_NORMAL,    // refined by least squares
+  BC_QUALITY_HIGH       // more refinement, bc7 also tries two subsets
+};
+
+// compresses 8 bit rgba texels to block formats. a block is 4x4 texels,
+// row major, 16 bytes apart per row. index selection runs on sse2.
+// reentrant, nothing is shared between calls.
+class BcEncoder {
+ public:
+  static bool CanEncode(render::TextureFormat format);
+
+  // rgb, alpha is ignored. 8 bytes.
+  static void EncodeBc1(const uint8_t* texels, BcQuality quality,
+    uint8_t* block);
+  // rgb and alpha. 16 bytes.
+  static void EncodeBc3(const uint8_t* texels, BcQuality quality,
+    uint8_t* block);
+  // one channel, 0 to 3. 8 bytes.
+  static void EncodeBc4(const uint8_t* texels, int channel, BcQuality quality,
+    uint8_t* block);
+  // red and green, for normal maps. 16 bytes.
+  static void EncodeBc5(const uint8_t* texels, BcQuality quality,
+    uint8_t* block);
+  // rgba, single subset mode 6 and, at high quality, two subset mode 1
+  // for opaque blocks. 16 bytes.
+  static void EncodeBc7(const uint8_t* texels, BcQuality quality,
+    uint8_t* block);
+
+  // a whole surface to one of the formats CanEncode accepts, srgb ones
+  // are encoded like the others. texels outside the surface repeat its
+  // last row and column. rows of blocks are split over threads_count
+  // threads, 0 for all cores.
+  static bool EncodeSurface(render::TextureFormat format, BcQuality quality,
+    const uint8_t* texels, int width, int height, size_t pitch,
+    int threads_count, uint8_t* blocks);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_BC_ENCODER_H_
@@ -0,0 +1,648 @@
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+#include "core/hash.h"
+#include "core/number_parser.h"
+#include "core/xml_reader.h"
+#include "math/transformation.h"
+
+#include "compiled_scene.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+static const char kMagic[4] = { 'M', 'S', 'C', 'N' };
+
+// bump kFormatVersion when the layout below or what Compile makes of a
+// scene file changes
+static const uint32_t kFormatVersion = 2;
+
+static const size_t kBlobAlignment = 16;
+static const float kDegreesToRadians = 3.14159265f / 180.f;
+static const uint32_t kCameraTypesCount = 6;
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t source_key;
+  uint64_t file_size;
+  uint32_t entities_count;
+  uint32_t components_count;
+  uint32_t cameras_count;
+  uint32_t transforms_count;
+  uint32_t meshes_count;
+  uint32_t mesh_references_count;
+  uint32_t chars_size;
+  uint32_t reserved;
+  uint64_t entities_offset;
+  uint64_t components_offset;
+  uint64_t cameras_offset;
+  uint64_t translations_offset;
+  uint64_t rotations_offset;
+  uint64_t scales_offset;
+  uint64_t meshes_offset;
+  uint64_t mesh_references_offset;
+  uint64_t chars_offset;
+};
+
+// the names of CameraComponent::CameraType in order
+static const char* const kCameraTypeNames[kCameraTypesCount] = {
+  "free", "firstperson", "thirdperson", "thirdpersonfixed", "topview",
+  "topviewfixed"
+};
+
+inline uint64_t Align(uint64_t offset) {
+  return (offset + kBlobAlignment - 1) & ~static_cast<uint64_t>(kBlobAlignment - 1);
+}
+
+bool IsInside(uint64_t offset, uint64_t size, uint64_t file_size) {
+  return offset <= file_size && size <= file_size - offset;
+}
+
+bool IsBlobInside(uint64_t offset, uint64_t size, uint64_t file_size) {
+  return offset % kBlobAlignment == 0 && IsInside(offset, size, file_size);
+}
+
+bool IsIndex(int32_t index, uint32_t count) {
+  return index == -1 || (index >= 0 && static_cast<uint32_t>(index) < count);
+}
+
+bool WritePadding(FILE* file, uint64_t* offset) {
+  static const char kZeros[kBlobAlignment] = { 0 };
+  const uint64_t aligned = Align(*offset);
+  const size_t padding = static_cast<size_t>(aligned - *offset);
+  *offset = aligned;
+  return padding == 0 || fwrite(kZeros, 1, padding, file) == padding;
+}
+
+bool WriteBlob(FILE* file, const void* data, size_t size, uint64_t* offset) {
+  *offset += size;
+  return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+// collects the tables while reading the xml, each element is handled as
+// it is reached and left with all of its children
+class SceneCompiler {
+ public:
+  explicit SceneCompiler(core::XmlReader* reader) : reader_(reader) {}
+
+  void CompileEntity();
+
+  std::vector<SceneEntityRecord> entities;
+  std::vector<SceneComponentRecord> components;
+  std::vector<SceneCameraRecord> cameras;
+  std::vector<float> translations;
+  std::vector<float> rotations;
+  std::vector<float> scales;
+  std::vector<SceneString> meshes;
+  std::vector<uint32_t> mesh_references;
+  std::string chars;
+
+ private:
+  void CompileComponent(int32_t parent);
+  void CompileCamera(SceneCameraRecord* camera);
+  void CompileTransformation(math::Transformationf* transformation);
+  int32_t AddTransform(const math::Transformationf& transformation);
+  uint32_t AddMesh(const core::XmlView& name);
+  SceneString AddString(const core::XmlView& value);
+  SceneString AddAttribute(const char* name);
+
+  core::XmlReader* reader_;
+  std::unordered_map<std::string, uint32_t> mesh_indices_;
+  std::vector<uint32_t> references_;
+  std::string name_;
+};
+
+void SceneCompiler::CompileEntity() {
+  core::XmlView type;
+  reader_->FindAttribute("type", &type);
+  SceneEntityRecord record;
+  if (type.Equals("normal")) {
+    record.type = SCENE_ENTITY_NORMAL;
+  }
+  else if (type.Equals("camera")) {
+    record.type = SCENE_ENTITY_CAMERA;
+  }
+  else {
+    reader_->SkipElement();
+    return;
+  }
+
+  const size_t kIndex = entities.size();
+  record.name = AddAttribute("name");
+  record.transform = -1;
+  record.first_component = static_cast<uint32_t>(components.size());
+  record.components_count = 0;
+  entities.push_back(record);
+
+  math::Transformationf transformation;
+  bool has_transformation = false;
+  while (reader_->NextChild()) {
+    const core::XmlView& kName = reader_->GetName();
+    if (kName.Equals("transform")) {
+      CompileTransformation(&transformation);
+      has_transformation = true;
+    }
+    else if (kName.Equals("component")) {
+      CompileComponent(-1);
+    }
+    else {
+      reader_->SkipElement();
+    }
+  }
+
+  SceneEntityRecord& entity = entities[kIndex];
+  if (has_transformation)
+    entity.transform = AddTransform(transformation);
+  entity.components_count =
+    static_cast<uint32_t>(components.size()) - entity.first_component;
+}
+
+void SceneCompiler::CompileComponent(int32_t parent) {
+  core::XmlView type;
+  reader_->FindAttribute("type", &type);
+  SceneComponentRecord record;
+  if (type.Equals("camera")) {
+    record.type = SCENE_COMPONENT_CAMERA;
+  }
+  else if (type.Equals("mesh")) {
+    record.type = SCENE_COMPONENT_MESH;
+  }
+  else {
+    reader_->SkipElement();
+    return;
+  }
+
+  const int32_t kIndex = static_cast<int32_t>(components.size());
+  record.name = AddAttribute("name");
+  record.parent = parent;
+  record.transform = -1;
+  record.camera = -1;
+  record.first_mesh = 0;
+  record.meshes_count = 0;
+  components.push_back(record);
+
+  math::Transformationf transformation;
+  bool has_transformation = false;
+  SceneCameraRecord camera;
+  memset(&camera, 0, sizeof(camera));
+  bool has_camera = false;
+  // the references of a component stay together, those of its children
+  // are added while reading them
+  const size_t kFirstReference = references_.size();
+  while (reader_->NextChild()) {
+    const core::XmlView& kName = reader_->GetName();
+    if (kName.Equals("transform")) {
+      CompileTransformation(&transformation);
+      has_transformation = true;
+    }
+    else if (kName.Equals("camera") && record.type == SCENE_COMPONENT_CAMERA) {
+      CompileCamera(&camera);
+      has_camera = true;
+    }
+    else if (kName.Equals("mesh") && record.type == SCENE_COMPONENT_MESH) {
+      core::XmlView mesh_type;
+      const core::XmlView& kMeshName = reader_->GetText();
+      if (reader_->FindAttribute("type", &mesh_type) &&
+        mesh_type.Equals("obj") && !kMeshName.IsEmpty()) {
+        references_.push_back(AddMesh(kMeshName));
+      }
+      reader_->SkipElement();
+    }
+    else if (kName.Equals("component")) {
+      CompileComponent(kIndex);
+    }
+    else {
+      reader_->SkipElement();
+    }
+  }
+
+  SceneComponentRecord& component = components[kIndex];
+  if (has_transformation)
+    component.transform = AddTransform(transformation);
+  if (has_camera) {
+    component.camera = static_cast<int32_t>(cameras.size());
+    cameras.push_back(camera);
+  }
+  component.first_mesh = static_cast<uint32_t>(mesh_references.size());
+  component.meshes_count =
+    static_cast<uint32_t>(references_.size() - kFirstReference);
+  mesh_references.insert(mesh_references.end(),
+    references_.begin() + kFirstReference, references_.end());
+  references_.resize(kFirstReference);
+}
+
+void SceneCompiler::CompileCamera(SceneCameraRecord* camera) {
+  core::XmlView type;
+  reader_->FindAttribute("type", &type);
+  for (uint32_t i = 0; i < kCameraTypesCount; ++i) {
+    if (type.Equals(kCameraTypeNames[i])) {
+      camera->type = i;
+      camera->fields |= SCENE_CAMERA_TYPE;
+    }
+  }
+
+  while (reader_->NextChild()) {
+    const core::XmlView& kName = reader_->GetName();
+    const core::XmlView& kText = reader_->GetText();
+    if (kName.Equals("lookat") && !kText.IsEmpty()) {
+      core::ParseFloats(kText.begin, kText.end, camera->lookat, 3);
+      camera->fields |= SCENE_CAMERA_LOOKAT;
+    }
+    else if (kName.Equals("fov")) {
+      if (core::ParseFloats(kText.begin, kText.end, &camera->fov, 1) == 1)
+        camera->fields |= SCENE_CAMERA_FOV;
+    }
+    else if (kName.Equals("aspectratio")) {
+      if (core::ParseFloats(kText.begin, kText.end, &camera->aspect_ratio,
+        1) == 1) {
+        camera->fields |= SCENE_CAMERA_ASPECT_RATIO;
+      }
+    }
+    else if (kName.Equals("up") && !kText.IsEmpty()) {
+      core::ParseFloats(kText.begin, kText.end, camera->up, 3);
+      camera->fields |= SCENE_CAMERA_UP;
+    }
+    reader_->SkipElement();
+  }
+}
+
+// the transforms of an element fold into one, later values replace earlier
+// ones and rotations add up. rotate holds degrees about x, y and z.
+void SceneCompiler::CompileTransformation(
+  math::Transformationf* transformation) {
+  while (reader_->NextChild()) {
+    const core::XmlView& kName = reader_->GetName();
+    const core::XmlView& kText = reader_->GetText();
+    float value[3] = { 0.f, 0.f, 0.f };
+    core::ParseFloats(kText.begin, kText.end, value, 3);
+
+    if (kName.Equals("translate")) {
+      transformation->SetTranslation(
+        math::Vector3f(value[0], value[1], value[2]));
+    }
+    else if (kName.Equals("scale")) {
+      transformation->SetScale(math::Vector3f(value[0], value[1], value[2]));
+    }
+    else if (kName.Equals("rotate")) {
+      transformation->Rotate(value[0] * kDegreesToRadians, 1.f, 0.f, 0.f);
+      transformation->Rotate(value[1] * kDegreesToRadians, 0.f, 1.f, 0.f);
+      transformation->Rotate(value[2] * kDegreesToRadians, 0.f, 0.f, 1.f);
+    }
+    reader_->SkipElement();
+  }
+}
+
+int32_t SceneCompiler::AddTransform(
+  const math::Transformationf& transformation) {
+  const math::Vector3f& kTranslation = transformation.GetTranslation();
+  const math::Quaternionf& kRotation = transformation.GetRotation();
+  const math::Vector3f& kScale = transformation.GetScale();
+  const float kTranslationValues[3] = {
+    kTranslation.x_, kTranslation.y_, kTranslation.z_ };
+  const float kRotationValues[4] = {
+    kRotation.x_, kRotation.y_, kRotation.z_, kRotation.w_ };
+  const float kScaleValues[3] = { kScale.x_, kScale.y_, kScale.z_ };
+  translations.insert(translations.end(), kTranslationValues,
+    kTranslationValues + 3);
+  rotations.insert(rotations.end(), kRotationValues, kRotationValues + 4);
+  scales.insert(scales.end(), kScaleValues, kScaleValues + 3);
+  return static_cast<int32_t>(scales.size() / 3 - 1);
+}
+
+uint32_t SceneCompiler::AddMesh(const core::XmlView& name) {
+  name_.clear();
+  name.AppendDecoded(&name_);
+  auto it = mesh_indices_.find(name_);
+  if (it != mesh_indices_.end())
+    return it->second;
+  const uint32_t kIndex = static_cast<uint32_t>(meshes.size());
+  SceneString record;
+  record.offset = static_cast<uint32_t>(chars.size());
+  record.length = static_cast<uint32_t>(name_.size());
+  chars += name_;
+  meshes.push_back(record);
+  mesh_indices_.insert(std::make_pair(name_, kIndex));
+  return kIndex;
+}
+
+SceneString SceneCompiler::AddString(const core::XmlView& value) {
+  SceneString record;
+  record.offset = static_cast<uint32_t>(chars.size());
+  value.AppendDecoded(&chars);
+  record.length = static_cast<uint32_t>(chars.size()) - record.offset;
+  return record;
+}
+
+SceneString SceneCompiler::AddAttribute(const char* name) {
+  core::XmlView value;
+  reader_->FindAttribute(name, &value);
+  return AddString(value);
+}
+}  // namespace
+
+CompiledScene::CompiledScene() {
+  SetTables();
+}
+
+uint64_t CompiledScene::ComputeSourceKey(const void* source, size_t size) {
+  return core::Hash64(source, size, kFormatVersion);
+}
+
+bool CompiledScene::Compile(const char* data, size_t size) {
+  // the bytes are read in place, one element at a time
+  core::XmlReader reader(data, size);
+  if (!reader.NextChild() || !reader.GetName().Equals("scene"))
+    return false;
+
+  SceneCompiler compiler(&reader);
+  while (reader.NextChild()) {
+    if (reader.GetName().Equals("entity"))
+      compiler.CompileEntity();
+    else
+      reader.SkipElement();
+  }
+  if (reader.HasError())
+    return false;
+
+  entities_ = std::move(compiler.entities);
+  components_ = std::move(compiler.components);
+  cameras_ = std::move(compiler.cameras);
+  translations_ = std::move(compiler.translations);
+  rotations_ = std::move(compiler.rotations);
+  scales_ = std::move(compiler.scales);
+  meshes_ = std::move(compiler.meshes);
+  mesh_references_ = std::move(compiler.mesh_references);
+  chars_ = std::move(compiler.chars);
+  file_.Close();
+  SetTables();
+  return true;
+}
+
+bool CompiledScene::Write(const std::string& path, uint64_t source_key) const {
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kFormatVersion;
+  header.source_key = source_key;
+  header.entities_count = tables_.entities_count;
+  header.components_count = tables_.components_count;
+  header.cameras_count = tables_.cameras_count;
+  header.transforms_count = tables_.transforms_count;
+  header.meshes_count = tables_.meshes_count;
+  header.mesh_references_count = tables_.mesh_references_count;
+  header.chars_size = tables_.chars_size;
+
+  // every table starts aligned, in the order of the header
+  const size_t kSizes[] = {
+    tables_.entities_count * sizeof(SceneEntityRecord),
+    tables_.components_count * sizeof(SceneComponentRecord),
+    tables_.cameras_count * sizeof(SceneCameraRecord),
+    tables_.transforms_count * 3 * sizeof(float),
+    tables_.transforms_count * 4 * sizeof(float),
+    tables_.transforms_count * 3 * sizeof(float),
+    tables_.meshes_count * sizeof(SceneString),
+    tables_.mesh_references_count * sizeof(uint32_t),
+    tables_.chars_size
+  };
+  const void* const kBlobs[] = {
+    tables_.entities, tables_.components, tables_.cameras,
+    tables_.translations, tables_.rotations, tables_.scales, tables_.meshes,
+    tables_.mesh_references, tables_.chars
+  };
+  uint64_t* const kOffsets[] = {
+    &header.entities_offset, &header.components_offset,
+    &header.cameras_offset, &header.translations_offset,
+    &header.rotations_offset, &header.scales_offset, &header.meshes_offset,
+    &header.mesh_references_offset, &header.chars_offset
+  };
+  const size_t kBlobsCount = sizeof(kSizes) / sizeof(kSizes[0]);
+
+  uint64_t offset = sizeof(FileHeader);
+  for (size_t i = 0; i < kBlobsCount; ++i) {
+    offset = Align(offset);
+    *kOffsets[i] = offset;
+    offset += kSizes[i];
+  }
+  header.file_size = offset;
+
+  // written next to the final file and renamed, a reader never sees a
+  // partially written scene
+  const std::string native_path = core::FileSystem::GetNativePath(path);
+  const std::string temp_path = native_path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr)
+    return false;
+
+  offset = 0;
+  bool written = WriteBlob(file, &header, sizeof(header), &offset);
+  for (size_t i = 0; written && i < kBlobsCount; ++i) {
+    written = WritePadding(file, &offset) &&
+      WriteBlob(file, kBlobs[i], kSizes[i], &offset);
+  }
+
+  written = fclose(file) == 0 && written;
+  if (written) {
+    remove(native_path.c_str());
+    written = rename(temp_path.c_str(), native_path.c_str()) == 0;
+  }
+  if (!written)
+    remove(temp_path.c_str());
+
+  return written;
+}
+
+bool CompiledScene::Read(const std::string& path, uint64_t source_key) {
+  core::FileView file;
+  if (!core::FileSystem::Open(path, &file))
+    return false;
+  return Read(file, source_key);
+}
+
+bool CompiledScene::Read(const core::FileView& file, uint64_t source_key) {
+  if (!file.IsOpen())
+    return false;
+
+  const char* base = file.GetData();
+  const uint64_t file_size = file.GetSize();
+  if (file_size < sizeof(FileHeader))
+    return false;
+
+  FileHeader header;
+  memcpy(&header, base, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+    header.version != kFormatVersion ||
+    header.source_key != source_key ||
+    header.file_size != file_size) {
+    return false;
+  }
+
+  const uint64_t kTransformsCount = header.transforms_count;
+  if (!IsBlobInside(header.entities_offset,
+    header.entities_count * sizeof(SceneEntityRecord), file_size) ||
+    !IsBlobInside(header.components_offset,
+      header.components_count * sizeof(SceneComponentRecord), file_size) ||
+    !IsBlobInside(header.cameras_offset,
+      header.cameras_count * sizeof(SceneCameraRecord), file_size) ||
+    !IsBlobInside(header.translations_offset,
+      kTransformsCount * 3 * sizeof(float), file_size) ||
+    !IsBlobInside(header.rotations_offset,
+      kTransformsCount * 4 * sizeof(float), file_size) ||
+    !IsBlobInside(header.scales_offset,
+      kTransformsCount * 3 * sizeof(float), file_size) ||
+    !IsBlobInside(header.meshes_offset,
+      header.meshes_count * sizeof(SceneString), file_size) ||
+    !IsBlobInside(header.mesh_references_offset,
+      header.mesh_references_count * sizeof(uint32_t), file_size) ||
+    !IsInside(header.chars_offset, header.chars_size, file_size)) {
+    return false;
+  }
+
+  Tables tables;
+  tables.entities =
+    reinterpret_cast<const SceneEntityRecord*>(base + header.entities_offset);
+  tables.components = reinterpret_cast<const SceneComponentRecord*>(
+    base + header.components_offset);
+  tables.cameras =
+    reinterpret_cast<const SceneCameraRecord*>(base + header.cameras_offset);
+  tables.translations =
+    reinterpret_cast<const float*>(base + header.translations_offset);
+  tables.rotations =
+    reinterpret_cast<const float*>(base + header.rotations_offset);
+  tables.scales = reinterpret_cast<const float*>(base + header.scales_offset);
+  tables.meshes =
+    reinterpret_cast<const SceneString*>(base + header.meshes_offset);
+  tables.mesh_references = reinterpret_cast<const uint32_t*>(
+    base + header.mesh_references_offset);
+  tables.chars = base + header.chars_offset;
+  tables.entities_count = header.entities_count;
+  tables.components_count = header.components_count;
+  tables.cameras_count = header.cameras_count;
+  tables.transforms_count = header.transforms_count;
+  tables.meshes_count = header.meshes_count;
+  tables.mesh_references_count = header.mesh_references_count;
+  tables.chars_size = header.chars_size;
+
+  // every index is checked once here, the getters trust them
+  auto is_string = [&tables](const SceneString& string) {
+    return IsInside(string.offset, string.length, tables.chars_size);
+  };
+  for (uint32_t i = 0; i < tables.meshes_count; ++i) {
+    if (!is_string(tables.meshes[i]))
+      return false;
+  }
+  for (uint32_t i = 0; i < tables.mesh_references_count; ++i) {
+    if (tables.mesh_references[i] >= tables.meshes_count)
+      return false;
+  }
+  for (uint32_t i = 0; i < tables.cameras_count; ++i) {
+    if (tables.cameras[i].type >= kCameraTypesCount)
+      return false;
+  }
+  for (uint32_t i = 0; i < tables.entities_count; ++i) {
+    const SceneEntityRecord& entity = tables.entities[i];
+    if (entity.type > SCENE_ENTITY_CAMERA || !is_string(entity.name) ||
+      !IsIndex(entity.transform, tables.transforms_count) ||
+      !IsInside(entity.first_component, entity.components_count,
+        tables.components_count)) {
+      return false;
+    }
+
+    // parents come first and belong to the same entity
+    const uint32_t kEnd = entity.first_component + entity.components_count;
+    for (uint32_t j = entity.first_component; j < kEnd; ++j) {
+      const SceneComponentRecord& component = tables.components[j];
+      if (component.type > SCENE_COMPONENT_CAMERA ||
+        !is_string(component.name) ||
+        !(component.parent == -1 ||
+          (component.parent >= static_cast<int32_t>(entity.first_component) &&
+          component.parent < static_cast<int32_t>(j))) ||
+        !IsIndex(component.transform, tables.transforms_count) ||
+        !IsIndex(component.camera, tables.cameras_count) ||
+        !IsInside(component.first_mesh, component.meshes_count,
+          tables.mesh_references_count)) {
+        return false;
+      }
+    }
+  }
+
+  entities_.clear();
+  components_.clear();
+  cameras_.clear();
+  translations_.clear();
+  rotations_.clear();
+  scales_.clear();
+  meshes_.clear();
+  mesh_references_.clear();
+  chars_.clear();
+  file_ = file;
+  tables_ = tables;
+  return true;
+}
+
+void CompiledScene::SetTables() {
+  tables_.entities = entities_.data();
+  tables_.components = components_.data();
+  tables_.cameras = cameras_.data();
+  tables_.translations = translations_.data();
+  tables_.rotations = rotations_.data();
+  tables_.scales = scales_.data();
+  tables_.meshes = meshes_.data();
+  tables_.mesh_references = mesh_references_.data();
+  tables_.chars = chars_.data();
+  tables_.entities_count = static_cast<uint32_t>(entities_.size());
+  tables_.components_count = static_cast<uint32_t>(components_.size());
+  tables_.cameras_count = static_cast<uint32_t>(cameras_.size());
+  tables_.transforms_count = static_cast<uint32_t>(scales_.size() / 3);
+  tables_.meshes_count = static_cast<uint32_t>(meshes_.size());
+  tables_.mesh_references_count =
+    static_cast<uint32_t>(mesh_references_.size());
+  tables_.chars_size = static_cast<uint32_t>(chars_.size());
+}
+
+uint32_t CompiledScene::GetEntitiesCount() const {
+  return tables_.entities_count;
+}
+
+const SceneEntityRecord& CompiledScene::GetEntity(uint32_t index) const {
+  return tables_.entities[index];
+}
+
+const SceneComponentRecord& CompiledScene::GetComponent(uint32_t index) const {
+  return tables_.components[index];
+}
+
+const SceneCameraRecord& CompiledScene::GetCamera(uint32_t index) const {
+  return tables_.cameras[index];
+}
+
+const float* CompiledScene::GetTranslation(uint32_t transform) const {
+  return tables_.translations + transform * 3;
+}
+
+const float* CompiledScene::GetRotation(uint32_t transform) const {
+  return tables_.rotations + transform * 4;
+}
+
+const float* CompiledScene::GetScale(uint32_t transform) const {
+  return tables_.scales + transform * 3;
+}
+
+const SceneString& CompiledScene::GetMeshReference(uint32_t index) const {
+  return tables_.meshes[tables_.mesh_references[index]];
+}
+
+uint32_t CompiledScene::GetMeshesCount() const {
+  return tables_.meshes_count;
+}
+
+const SceneString& CompiledScene::GetMesh(uint32_t index) const {
+  return tables_.meshes[index];
+}
+
+std::string CompiledScene::GetString(const SceneString& string) const {
+  return std::string(tables_.chars + string.offset, string.length);
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,150 @@
+#ifndef MAGNET_SCENE_COMPILED_SCENE_H_
+#define MAGNET_SCENE_COMPILED_SCENE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "core/file_system.h"
+
+namespace magnet {
+namespace scene {
+// compiled scenes are written next to the scene file with this appended
+static const char kCompiledSceneExtension[] = ".mscene";
+
+enum SceneEntityType {
+  SCENE_ENTITY_NORMAL,
+  SCENE_ENTITY_CAMERA
+};
+
+enum SceneComponentType {
+  SCENE_COMPONENT_MESH,
+  SCENE_COMPONENT_CAMERA
+};
+
+// the camera values a scene file sets, the rest keep their defaults
+enum SceneCameraField {
+  SCENE_CAMERA_TYPE = 1 << 0,
+  SCENE_CAMERA_LOOKAT = 1 << 1,
+  SCENE_CAMERA_UP = 1 << 2,
+  SCENE_CAMERA_FOV = 1 << 3,
+  SCENE_CAMERA_ASPECT_RATIO = 1 << 4
+};
+
+struct SceneString {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct SceneEntityRecord {
+  SceneString name;
+  uint32_t type;                // SceneEntityType
+  int32_t transform;            // -1 if the entity has none
+  uint32_t first_component;     // its component tree, in pre-order
+  uint32_t components_count;
+};
+
+struct SceneComponentRecord {
+  SceneString name;
+  uint32_t type;                // SceneComponentType
+  int32_t parent;               // earlier component, -1 for the entity
+  int32_t transform;            // -1 if the component has none
+  int32_t camera;               // -1 if the component has none
+  uint32_t first_mesh;          // into the mesh references
+  uint32_t meshes_count;
+};
+
+struct SceneCameraRecord {
+  uint32_t fields;              // SceneCameraField bits
+  uint32_t type;                // CameraComponent::CameraType
+  float lookat[3];
+  float up[3];
+  float fov;
+  float aspect_ratio;
+};
+
+// a scene file compiled into flat tables: entities, their component trees
+// in pre-order, transforms as arrays of translations, rotations and
+// scales, cameras, and the obj files meshes reference by index into a
+// table of unique names. strings are offsets into one character block.
+//
+// the binary file is the tables as they are in memory, 16 byte aligned,
+// after a header with the key of the scene file bytes it was compiled
+// from. reading maps the file and points the tables into it, nothing is
+// parsed or copied.
+class CompiledScene {
+ public:
+  CompiledScene();
+  // the tables may point into the object itself
+  CompiledScene(const CompiledScene&) = delete;
+  CompiledScene& operator=(const CompiledScene&) = delete;
+
+  // hash of the scene file bytes, seeded with the format version
+  static uint64_t ComputeSourceKey(const void* source, size_t size);
+
+  // the xml scene format. entities and components of unknown types are
+  // skipped with everything below them.
+  bool Compile(const char* data, size_t size);
+
+  bool Write(const std::string& path, uint64_t source_key) const;
+  // fails if the file is missing, damaged or was compiled from other
+  // scene file bytes or by another format version
+  bool Read(const std::string& path, uint64_t source_key);
+  // the same for a file already read, the tables keep it alive
+  bool Read(const core::FileView& file, uint64_t source_key);
+
+  uint32_t GetEntitiesCount() const;
+  const SceneEntityRecord& GetEntity(uint32_t index) const;
+  const SceneComponentRecord& GetComponent(uint32_t index) const;
+  const SceneCameraRecord& GetCamera(uint32_t index) const;
+  // 3 floats per transform
+  const float* GetTranslation(uint32_t transform) const;
+  // 4 floats per transform, x y z w
+  const float* GetRotation(uint32_t transform) const;
+  // 3 floats per transform
+  const float* GetScale(uint32_t transform) const;
+  // the obj file of a mesh reference
+  const SceneString& GetMeshReference(uint32_t index) const;
+  uint32_t GetMeshesCount() const;
+  const SceneString& GetMesh(uint32_t index) const;
+  std::string GetString(const SceneString& string) const;
+
+ private:
+  // where the tables are, in the vectors below or in a read file
+  struct Tables {
+    const SceneEntityRecord* entities;
+    const SceneComponentRecord* components;
+    const SceneCameraRecord* cameras;
+    const float* translations;
+    const float* rotations;
+    const float* scales;
+    const SceneString* meshes;
+    const uint32_t* mesh_references;
+    const char* chars;
+    uint32_t entities_count;
+    uint32_t components_count;
+    uint32_t cameras_count;
+    uint32_t transforms_count;
+    uint32_t meshes_count;
+    uint32_t mesh_references_count;
+    uint32_t chars_size;
+  };
+
+  void SetTables();
+
+  std::vector<SceneEntityRecord> entities_;
+  std::vector<SceneComponentRecord> components_;
+  std::vector<SceneCameraRecord> cameras_;
+  std::vector<float> translations_;
+  std::vector<float> rotations_;
+  std::vector<float> scales_;
+  std::vector<SceneString> meshes_;
+  std::vector<uint32_t> mesh_references_;
+  std::string chars_;
+  core::FileView file_;
+  Tables tables_;
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_COMPILED_SCENE_H_
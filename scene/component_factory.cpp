@@ -3,6 +3,12 @@
 namespace magnet {
 namespace scene {
 
+// the children of a component are made by the factory as well
+IComponent::~IComponent() {
+  for (auto component : child_components_)
+    ComponentFactory::GetInstance()->DestroyComponent(component);
+}
+
 bool ComponentFactory::RegisterComponent(std::string type,
   ComponentCreator* creator) {
   if (type_to_creator_.count(type) > 0) {
@@ -19,10 +25,42 @@ IComponent* ComponentFactory::CreateComponent(const std::string& type,
     return nullptr;
   }
   else {
-    return iter->second->Create(name);
+    IComponent* component = iter->second->Create(name);
+    component->creator_ = iter->second;
+    return component;
   }
 }
 
+void ComponentFactory::DestroyComponent(IComponent* component) {
+  if (component == nullptr)
+    return;
+  if (component->creator_ != nullptr)
+    component->creator_->Destroy(component);
+  else
+    delete component;
+}
+
+bool ComponentFactory::ReserveComponents(const std::string& type,
+  uint32_t count) {
+  auto iter = type_to_creator_.find(type);
+  if (iter == type_to_creator_.end())
+    return false;
+  iter->second->Reserve(count);
+  return true;
+}
+
+void ComponentFactory::ReleaseUnusedComponents() {
+  for (auto& type_creator : type_to_creator_)
+    type_creator.second->Trim();
+}
+
+void ComponentFactory::GetPoolStats(
+  std::map<std::string, core::FixedPoolStats>* stats) const {
+  stats->clear();
+  for (const auto& type_creator : type_to_creator_)
+    (*stats)[type_creator.first] = type_creator.second->GetStats();
+}
+
 ComponentFactory* ComponentFactory::GetInstance() {
   static ComponentFactory factory;
   return &factory;
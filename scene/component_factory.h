@@ -2,12 +2,15 @@
 // Authors:
 //    Hong Yuan (hong.yuan@inceptioglobal.ai)
 
-#ifndef UI_RENDER_COMPONENT_FACTORY_H_
-#define UI_RENDER_COMPONENT_FACTORY_H_
+#ifndef MAGNET_SCENE_COMPONENT_FACTORY_H_
+#define MAGNET_SCENE_COMPONENT_FACTORY_H_
 
+#include <stdint.h>
 #include <map>
 #include <string>
 
+#include "core/object_pool.h"
+
 #include "icomponent.h"
 
 namespace magnet {
@@ -21,12 +24,33 @@ class ComponentCreator {
   virtual ~ComponentCreator() = default;
 
   virtual IComponent* Create(const std::string& name) = 0;
+  // a component Create returned
+  virtual void Destroy(IComponent* component) = 0;
+  // room for count more components in one slab
+  virtual void Reserve(uint32_t count) = 0;
+  // frees the slabs without components
+  virtual void Trim() = 0;
+  virtual core::FixedPoolStats GetStats() const = 0;
 };
 
+// components of each registered type come from a pool of their own, see
+// core::ObjectPool
 class ComponentFactory {
  public:
   bool RegisterComponent(std::string type, ComponentCreator* creator);
   IComponent* CreateComponent(const std::string& type, const std::string& name);
+  // gives the component back to the creator it came from, components made
+  // elsewhere are deleted
+  void DestroyComponent(IComponent* component);
+
+  // makes room for count components of the type at once, before a scene
+  // creates them. false for an unknown type.
+  bool ReserveComponents(const std::string& type, uint32_t count);
+  // frees the slabs of every type that no longer hold a component, once a
+  // scene is unloaded
+  void ReleaseUnusedComponents();
+  // the pool of every registered type
+  void GetPoolStats(std::map<std::string, core::FixedPoolStats>* stats) const;
 
   static ComponentFactory* GetInstance();
 
@@ -39,18 +63,33 @@ class ComponentFactory {
   std::map<std::string, ComponentCreator*> type_to_creator_;
 };
 
-#define REGISTER_COMPONENT(typename)                                  \
-  class typename##Creator : public magnet::scene::ComponentCreator {     \
-   public:                                                            \
-    typename##Creator() {                                             \
-      magnet::scene::ComponentFactory::GetInstance()->RegisterComponent( \
-          #typename, this);                                           \
-    }                                                                 \
-    ~typename##Creator() = default;                                   \
-    magnet::scene::IComponent* Create(const std::string& name) final {   \
-      return new typename(name);                                      \
-    }                                                                 \
-  };                                                                  \
+#define REGISTER_COMPONENT(typename)                                      \
+  class typename##Creator : public magnet::scene::ComponentCreator {         \
+   public:                                                                \
+    typename##Creator() : pool_(magnet::core::MEMORY_TAG_SCENE) {         \
+      magnet::scene::ComponentFactory::GetInstance()->RegisterComponent(     \
+          #typename, this);                                               \
+    }                                                                     \
+    ~typename##Creator() = default;                                       \
+    magnet::scene::IComponent* Create(const std::string& name) final {       \
+      return pool_.Create(name);                                          \
+    }                                                                     \
+    void Destroy(magnet::scene::IComponent* component) final {               \
+      pool_.Destroy(static_cast<typename*>(component));                   \
+    }                                                                     \
+    void Reserve(uint32_t count) final {                                  \
+      pool_.Reserve(count);                                               \
+    }                                                                     \
+    void Trim() final {                                                   \
+      pool_.Trim();                                                       \
+    }                                                                     \
+    magnet::core::FixedPoolStats GetStats() const final {                \
+      return pool_.GetStats();                                            \
+    }                                                                     \
+                                                                          \
+   private:                                                               \
+    magnet::core::ObjectPool<typename> pool_;                             \
+  };                                                                      \
   static typename##Creator typename##_creator_
 
 }  // namespace scene
@@ -0,0 +1,186 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/file_system.h"
+#include "core/pack_archive.h"
+
+#include "cook_manifest.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+static const char kHeader[] = "magnet_cook_manifest 1";
+
+// fields are separated by tabs, names may hold spaces
+std::vector<std::string> SplitFields(const std::string& line) {
+  std::vector<std::string> fields;
+  size_t begin = 0;
+  while (true) {
+    const size_t kEnd = line.find('\t', begin);
+    fields.push_back(line.substr(begin, kEnd - begin));
+    if (kEnd == std::string::npos)
+      return fields;
+    begin = kEnd + 1;
+  }
+}
+
+bool ParseHex(const std::string& text, uint64_t* value) {
+  if (text.empty() || text.size() > 16)
+    return false;
+  char* end = nullptr;
+  *value = strtoull(text.c_str(), &end, 16);
+  return *end == '\0';
+}
+
+std::string ToHex(uint64_t value) {
+  char text[17];
+  snprintf(text, sizeof(text), "%016" PRIx64, value);
+  return text;
+}
+}  // namespace
+
+bool CookManifest::Read(const std::string& path) {
+  core::FileView file;
+  return core::FileSystem::Open(path, &file) &&
+    Parse(file.GetData(), file.GetSize());
+}
+
+bool CookManifest::Parse(const char* data, size_t size) {
+  CookManifest result;
+  Asset* asset = nullptr;
+  size_t line_begin = 0;
+  bool header_found = false;
+  while (line_begin < size) {
+    size_t line_end = line_begin;
+    while (line_end < size && data[line_end] != '\n')
+      ++line_end;
+    std::string line(data + line_begin, line_end - line_begin);
+    line_begin = line_end + 1;
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.empty())
+      continue;
+
+    if (!header_found) {
+      if (line != kHeader)
+        return false;
+      header_found = true;
+      continue;
+    }
+
+    const std::vector<std::string> kFields = SplitFields(line);
+    if (kFields[0] == "asset" && kFields.size() == 4) {
+      result.assets_.push_back(Asset());
+      asset = &result.assets_.back();
+      if (!ParseHex(kFields[1], &asset->source_key))
+        return false;
+      asset->source = kFields[2];
+      asset->cache = kFields[3];
+    }
+    else if (kFields[0] == "depends" && kFields.size() == 2) {
+      // belongs to the asset above it
+      if (asset == nullptr)
+        return false;
+      asset->dependencies.push_back(kFields[1]);
+    }
+    else if (kFields[0] == "file" && kFields.size() == 4) {
+      File file;
+      if (!ParseHex(kFields[1], &file.content_hash) ||
+        !ParseHex(kFields[2], &file.size)) {
+        return false;
+      }
+      file.name = kFields[3];
+      result.files_.push_back(file);
+    }
+    else {
+      return false;
+    }
+  }
+  if (!header_found)
+    return false;
+
+  for (size_t i = 0; i < result.assets_.size(); ++i) {
+    result.asset_indices_[core::PackArchive::NormalizeName(
+      result.assets_[i].source)] = i;
+  }
+  *this = std::move(result);
+  return true;
+}
+
+bool CookManifest::Write(const std::string& path) const {
+  std::string text(kHeader);
+  text += '\n';
+  for (const Asset& asset : assets_) {
+    text += "asset\t" + ToHex(asset.source_key) + '\t' + asset.source + '\t' +
+      asset.cache + '\n';
+    for (const std::string& dependency : asset.dependencies)
+      text += "depends\t" + dependency + '\n';
+  }
+  for (const File& file : files_) {
+    text += "file\t" + ToHex(file.content_hash) + '\t' + ToHex(file.size) +
+      '\t' + file.name + '\n';
+  }
+
+  // written next to the final file and renamed, like the caches
+  const std::string kNativePath = core::FileSystem::GetNativePath(path);
+  const std::string kTempPath = kNativePath + ".tmp";
+  FILE* file = fopen(kTempPath.c_str(), "wb");
+  if (file == nullptr)
+    return false;
+  bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+  written = fclose(file) == 0 && written;
+  if (written) {
+    remove(kNativePath.c_str());
+    written = rename(kTempPath.c_str(), kNativePath.c_str()) == 0;
+  }
+  if (!written)
+    remove(kTempPath.c_str());
+  return written;
+}
+
+void CookManifest::AddAsset(const Asset& asset) {
+  const std::string kKey = core::PackArchive::NormalizeName(asset.source);
+  auto it = asset_indices_.find(kKey);
+  if (it != asset_indices_.end()) {
+    assets_[it->second] = asset;
+    return;
+  }
+  asset_indices_[kKey] = assets_.size();
+  assets_.push_back(asset);
+}
+
+void CookManifest::AddFile(const File& file) {
+  files_.push_back(file);
+}
+
+const CookManifest::Asset* CookManifest::FindAsset(
+  const std::string& source) const {
+  auto it = asset_indices_.find(core::PackArchive::NormalizeName(source));
+  return it != asset_indices_.end() ? &assets_[it->second] : nullptr;
+}
+
+const std::vector<CookManifest::Asset>& CookManifest::GetAssets() const {
+  return assets_;
+}
+
+const std::vector<CookManifest::File>& CookManifest::GetFiles() const {
+  return files_;
+}
+
+bool CookManifest::HasSameFiles(const CookManifest& other) const {
+  if (files_.size() != other.files_.size())
+    return false;
+  for (size_t i = 0; i < files_.size(); ++i) {
+    const File& file = files_[i];
+    const File& other_file = other.files_[i];
+    if (file.name != other_file.name ||
+      file.content_hash != other_file.content_hash ||
+      file.size != other_file.size) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,63 @@
+#ifndef MAGNET_SCENE_COOK_MANIFEST_H_
+#define MAGNET_SCENE_COOK_MANIFEST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace magnet {
+namespace scene {
+// where magnet_cook puts the manifest, in its output folder and archive
+static const char kCookManifestName[] = "cook_manifest.txt";
+
+// what magnet_cook built from a scene: every asset with the source key its
+// cache was written for and the assets it names, and every file of the
+// archive with a hash of its bytes.
+//
+// a packed build carries no meshes or textures to hash, the loaders take
+// the key from here instead when the source file is missing. the cooker
+// compares the files with those of its last run to skip writing an
+// archive that would not change. the file is text, one record per line.
+class CookManifest {
+ public:
+  struct Asset {
+    Asset() : source_key(0) {}
+    std::string source;           // virtual path of the source file
+    uint64_t source_key;          // 0 if there is no cache
+    std::string cache;            // virtual path, empty if there is none
+    std::vector<std::string> dependencies;    // sources it names
+  };
+
+  struct File {
+    File() : content_hash(0), size(0) {}
+    std::string name;             // entry name in the archive
+    uint64_t content_hash;
+    uint64_t size;
+  };
+
+  // reads through the FileSystem, fails if the file is missing or damaged
+  bool Read(const std::string& path);
+  bool Parse(const char* data, size_t size);
+  bool Write(const std::string& path) const;
+
+  // a source added again replaces the earlier asset
+  void AddAsset(const Asset& asset);
+  void AddFile(const File& file);
+  // null if the source is not in the manifest
+  const Asset* FindAsset(const std::string& source) const;
+
+  const std::vector<Asset>& GetAssets() const;
+  const std::vector<File>& GetFiles() const;
+  // the same names, hashes and sizes in the same order
+  bool HasSameFiles(const CookManifest& other) const;
+
+ private:
+  std::vector<Asset> assets_;
+  std::vector<File> files_;
+  std::unordered_map<std::string, size_t> asset_indices_;   // by source
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_COOK_MANIFEST_H_
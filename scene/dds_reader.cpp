@@ -0,0 +1,180 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "dds_reader.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+static const size_t kHeaderSize = 128;     // magic and DDS_HEADER
+static const size_t kHeaderDx10Size = 20;
+static const int kMaxSize = 16384;         // d3d11 texture2d limit
+
+// DDS_HEADER and DDS_PIXELFORMAT flags
+static const uint32_t kFlagMipMapCount = 0x20000;
+static const uint32_t kPixelFlagAlpha = 0x1;
+static const uint32_t kPixelFlagFourCC = 0x4;
+static const uint32_t kPixelFlagRgb = 0x40;
+static const uint32_t kCaps2Cubemap = 0x200;
+static const uint32_t kCaps2AllFaces = 0xfc00;
+static const uint32_t kCaps2Volume = 0x200000;
+
+// DDS_HEADER_DXT10
+static const uint32_t kDimensionTexture2d = 3;
+static const uint32_t kMiscTextureCube = 0x4;
+
+inline uint32_t ReadUint32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint32_t MakeFourCC(const char* code) {
+  return ReadUint32(reinterpret_cast<const uint8_t*>(code));
+}
+
+bool GetFourCCFormat(uint32_t four_cc, render::TextureFormat* format) {
+  if (four_cc == MakeFourCC("DXT1"))
+    *format = render::TEXTURE_FORMAT_BC1_UNORM;
+  else if (four_cc == MakeFourCC("DXT2") || four_cc == MakeFourCC("DXT3"))
+    *format = render::TEXTURE_FORMAT_BC2_UNORM;
+  else if (four_cc == MakeFourCC("DXT4") || four_cc == MakeFourCC("DXT5"))
+    *format = render::TEXTURE_FORMAT_BC3_UNORM;
+  else if (four_cc == MakeFourCC("ATI1") || four_cc == MakeFourCC("BC4U"))
+    *format = render::TEXTURE_FORMAT_BC4_UNORM;
+  else if (four_cc == MakeFourCC("BC4S"))
+    *format = render::TEXTURE_FORMAT_BC4_SNORM;
+  else if (four_cc == MakeFourCC("ATI2") || four_cc == MakeFourCC("BC5U"))
+    *format = render::TEXTURE_FORMAT_BC5_UNORM;
+  else if (four_cc == MakeFourCC("BC5S"))
+    *format = render::TEXTURE_FORMAT_BC5_SNORM;
+  else if (four_cc == 113)    // D3DFMT_A16B16G16R16F
+    *format = render::TEXTURE_FORMAT_R16G16B16A16_FLOAT;
+  else if (four_cc == 116)    // D3DFMT_A32B32G32R32F
+    *format = render::TEXTURE_FORMAT_R32G32B32A32_FLOAT;
+  else
+    return false;
+  return true;
+}
+
+bool GetDxgiFormat(uint32_t dxgi_format, render::TextureFormat* format) {
+  switch (dxgi_format) {
+  case 2: *format = render::TEXTURE_FORMAT_R32G32B32A32_FLOAT; break;
+  case 10: *format = render::TEXTURE_FORMAT_R16G16B16A16_FLOAT; break;
+  case 28: *format = render::TEXTURE_FORMAT_R8G8B8A8_UNORM; break;
+  case 29: *format = render::TEXTURE_FORMAT_R8G8B8A8_UNORM_SRGB; break;
+  case 30: *format = render::TEXTURE_FORMAT_R8G8B8A8_UINT; break;
+  case 67: *format = render::TEXTURE_FORMAT_R9G9B9E5_SHAREDEXP; break;
+  case 71: *format = render::TEXTURE_FORMAT_BC1_UNORM; break;
+  case 72: *format = render::TEXTURE_FORMAT_BC1_UNORM_SRGB; break;
+  case 74: *format = render::TEXTURE_FORMAT_BC2_UNORM; break;
+  case 75: *format = render::TEXTURE_FORMAT_BC2_UNORM_SRGB; break;
+  case 77: *format = render::TEXTURE_FORMAT_BC3_UNORM; break;
+  case 78: *format = render::TEXTURE_FORMAT_BC3_UNORM_SRGB; break;
+  case 80: *format = render::TEXTURE_FORMAT_BC4_UNORM; break;
+  case 81: *format = render::TEXTURE_FORMAT_BC4_SNORM; break;
+  case 83: *format = render::TEXTURE_FORMAT_BC5_UNORM; break;
+  case 84: *format = render::TEXTURE_FORMAT_BC5_SNORM; break;
+  case 87: *format = render::TEXTURE_FORMAT_B8G8R8A8_UNORM; break;
+  case 95: *format = render::TEXTURE_FORMAT_BC6H_UF16; break;
+  case 96: *format = render::TEXTURE_FORMAT_BC6H_SF16; break;
+  case 98: *format = render::TEXTURE_FORMAT_BC7_UNORM; break;
+  case 99: *format = render::TEXTURE_FORMAT_BC7_UNORM_SRGB; break;
+  default: return false;
+  }
+  return true;
+}
+
+// uncompressed legacy files describe their texels with channel masks
+bool GetMaskFormat(const uint8_t* pixel_format, render::TextureFormat* format) {
+  const uint32_t kFlags = ReadUint32(pixel_format + 4);
+  const uint32_t kBitCount = ReadUint32(pixel_format + 12);
+  const uint32_t kRedMask = ReadUint32(pixel_format + 16);
+  const uint32_t kAlphaMask = ReadUint32(pixel_format + 28);
+  if (!(kFlags & kPixelFlagRgb) || !(kFlags & kPixelFlagAlpha) ||
+    kBitCount != 32 || kAlphaMask != 0xff000000u) {
+    return false;
+  }
+
+  if (kRedMask == 0x000000ffu)
+    *format = render::TEXTURE_FORMAT_R8G8B8A8_UNORM;
+  else if (kRedMask == 0x00ff0000u)
+    *format = render::TEXTURE_FORMAT_B8G8R8A8_UNORM;
+  else
+    return false;
+  return true;
+}
+}  // namespace
+
+bool DdsReader::IsDds(const void* data, size_t size) {
+  return size >= 4 && memcmp(data, "DDS ", 4) == 0;
+}
+
+bool DdsReader::ReadInfo(const void* data, size_t size, DdsInfo* info) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  if (size < kHeaderSize || !IsDds(data, size) || ReadUint32(bytes + 4) != 124)
+    return false;
+
+  const uint32_t kFlags = ReadUint32(bytes + 8);
+  const uint32_t kHeight = ReadUint32(bytes + 12);
+  const uint32_t kWidth = ReadUint32(bytes + 16);
+  const uint32_t kMipMapCount = ReadUint32(bytes + 28);
+  const uint8_t* pixel_format = bytes + 76;
+  const uint32_t kPixelFlags = ReadUint32(pixel_format + 4);
+  const uint32_t kFourCC = ReadUint32(pixel_format + 8);
+  const uint32_t kCaps2 = ReadUint32(bytes + 112);
+  if (kWidth == 0 || kHeight == 0 || kWidth > kMaxSize || kHeight > kMaxSize ||
+    (kCaps2 & kCaps2Volume)) {
+    return false;
+  }
+
+  bool cube = (kCaps2 & kCaps2Cubemap) != 0;
+  if (cube && (kCaps2 & kCaps2AllFaces) != kCaps2AllFaces)
+    return false;
+
+  info->data_offset = kHeaderSize;
+  if ((kPixelFlags & kPixelFlagFourCC) && kFourCC == MakeFourCC("DX10")) {
+    if (size < kHeaderSize + kHeaderDx10Size)
+      return false;
+    const uint8_t* header_dx10 = bytes + kHeaderSize;
+    const uint32_t kDimension = ReadUint32(header_dx10 + 4);
+    const uint32_t kMiscFlags = ReadUint32(header_dx10 + 8);
+    const uint32_t kArraySize = ReadUint32(header_dx10 + 12);
+    if (!GetDxgiFormat(ReadUint32(header_dx10), &info->format) ||
+      kDimension != kDimensionTexture2d || kArraySize != 1) {
+      return false;
+    }
+    cube = (kMiscFlags & kMiscTextureCube) != 0;
+    info->data_offset += kHeaderDx10Size;
+  }
+  else if (kPixelFlags & kPixelFlagFourCC) {
+    if (!GetFourCCFormat(kFourCC, &info->format))
+      return false;
+  }
+  else if (!GetMaskFormat(pixel_format, &info->format)) {
+    return false;
+  }
+
+  // files with more levels than the full chain are clamped to it
+  int max_mip_levels = 1;
+  while ((kWidth | kHeight) >> max_mip_levels)
+    ++max_mip_levels;
+  info->mip_levels = (kFlags & kFlagMipMapCount) && kMipMapCount > 0 ?
+    static_cast<int>(kMipMapCount) : 1;
+  if (info->mip_levels > max_mip_levels)
+    info->mip_levels = max_mip_levels;
+
+  info->type = cube ? render::TEXTURE_TYPE_CUBE : render::TEXTURE_TYPE_2D;
+  info->width = static_cast<int>(kWidth);
+  info->height = static_cast<int>(kHeight);
+
+  size_t face_size = 0;
+  for (int level = 0; level < info->mip_levels; ++level) {
+    const int kMipWidth = info->width >> level > 0 ? info->width >> level : 1;
+    const int kMipHeight =
+      info->height >> level > 0 ? info->height >> level : 1;
+    face_size += render::GetSurfaceSize(info->format, kMipWidth, kMipHeight);
+  }
+  info->data_size = face_size * (cube ? 6 : 1);
+  return info->data_size <= size - info->data_offset;
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,31 @@
+#ifndef MAGNET_SCENE_DDS_READER_H_
+#define MAGNET_SCENE_DDS_READER_H_
+
+#include <stddef.h>
+
+#include "render/texture.h"
+
+namespace magnet {
+namespace scene {
+struct DdsInfo {
+  render::TextureFormat format;
+  render::TextureType type;
+  int width;
+  int height;
+  int mip_levels;
+  size_t data_offset;   // faces, each with its mip chain, start here
+  size_t data_size;
+};
+
+// reads the headers of dds files, legacy and dx10, with the formats
+// render::TextureFormat has. the pixels behind them are laid out like
+// render::Texture data buffers so they can be used in place. volume
+// textures, texture arrays and partial cube maps are not supported.
+class DdsReader {
+ public:
+  static bool IsDds(const void* data, size_t size);
+  static bool ReadInfo(const void* data, size_t size, DdsInfo* info);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_DDS_READER_H_
@@ -18,10 +18,21 @@ IEntity* EntityFactory::CreateEntity(const std::string& type,
     return nullptr;
   }
   else {
-    return iter->second->Create(name);
+    IEntity* entity = iter->second->Create(name);
+    entity->creator_ = iter->second;
+    return entity;
   }
 }
 
+void EntityFactory::DestroyEntity(IEntity* entity) {
+  if (entity == nullptr)
+    return;
+  if (entity->creator_ != nullptr)
+    entity->creator_->Destroy(entity);
+  else
+    delete entity;
+}
+
 EntityFactory* EntityFactory::GetInstance() {
   static EntityFactory factory;
   return &factory;
@@ -4,6 +4,8 @@
 #include <map>
 #include <string>
 
+#include "core/object_pool.h"
+
 #include "ientity.h"
 
 namespace magnet {
@@ -17,12 +19,17 @@ class EntityCreator {
   virtual ~EntityCreator() = default;
 
   virtual IEntity* Create(const std::string& name) = 0;
+  // an entity Create returned
+  virtual void Destroy(IEntity* entity) = 0;
 };
 
 class EntityFactory {
  public:
   bool RegisterEntity(std::string type, EntityCreator* creator);
   IEntity* CreateEntity(const std::string& type, const std::string& name);
+  // gives the entity back to the creator it came from, entities made
+  // elsewhere are deleted
+  void DestroyEntity(IEntity* entity);
 
   static EntityFactory* GetInstance();
 
@@ -38,14 +45,20 @@ class EntityFactory {
 #define REGISTER_ENTITY(typename)                                         \
   class typename##Creator : public magnet::scene::EntityCreator {            \
    public:                                                                \
-    typename##Creator() {                                                 \
+    typename##Creator() : pool_(magnet::core::MEMORY_TAG_SCENE) {         \
       magnet::scene::EntityFactory::GetInstance()->RegisterEntity(#typename, \
                                                                this);     \
     }                                                                     \
     ~typename##Creator() = default;                                       \
     magnet::scene::IEntity* Create(const std::string& name) final {          \
-      return new typename(name);                                          \
+      return pool_.Create(name);                                          \
+    }                                                                     \
+    void Destroy(magnet::scene::IEntity* entity) final {                     \
+      pool_.Destroy(static_cast<typename*>(entity));                      \
     }                                                                     \
+                                                                          \
+   private:                                                               \
+    magnet::core::ObjectPool<typename> pool_;                             \
   };                                                                      \
   static typename##Creator typename##_creator_
 
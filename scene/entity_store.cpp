@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+
+#include "core/allocator.h"
+
+#include "entity_store.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+// columns start on a cache line
+static const size_t kColumnAlignment = 64;
+static const uint32_t kMinCapacity = 16;
+
+std::mutex& GetRegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::vector<ComponentTypeInfo>& GetRegistry() {
+  static std::vector<ComponentTypeInfo> registry;
+  return registry;
+}
+}  // namespace
+
+EntityStore::EntityStore() {
+}
+
+EntityStore::~EntityStore() {
+  Clear();
+  for (Archetype* archetype : archetypes_) {
+    for (const Column& column : archetype->columns)
+      core::TaggedHeap::Free(column.data);
+    delete archetype;
+  }
+}
+
+int EntityStore::RegisterComponentType(const ComponentTypeInfo& info) {
+  std::lock_guard<std::mutex> lock(GetRegistryMutex());
+  std::vector<ComponentTypeInfo>& registry = GetRegistry();
+  // a 65th type would not fit a mask, it is a programming error
+  if (registry.size() >= static_cast<size_t>(kMaxComponentTypes))
+    abort();
+  registry.push_back(info);
+  return static_cast<int>(registry.size() - 1);
+}
+
+ComponentTypeInfo EntityStore::GetComponentTypeInfo(int type) {
+  std::lock_guard<std::mutex> lock(GetRegistryMutex());
+  return GetRegistry()[type];
+}
+
+EntityId EntityStore::CreateEntity() {
+  const EntityId kId = ids_.Allocate();
+  if (kId == kInvalidEntityId)
+    return kInvalidEntityId;
+  const uint32_t kIndex = core::HandleAllocator::GetIndex(kId);
+  if (kIndex >= locations_.size())
+    locations_.resize(kIndex + 1);
+
+  // every entity starts in the table without components
+  Location& location = locations_[kIndex];
+  location.archetype = FindArchetype(0);
+  Archetype* archetype = archetypes_[location.archetype];
+  location.row = static_cast<uint32_t>(archetype->entities.size());
+  archetype->entities.push_back(kId);
+  return kId;
+}
+
+void EntityStore::DestroyEntity(EntityId id) {
+  if (!IsAlive(id))
+    return;
+  Location& location = locations_[core::HandleAllocator::GetIndex(id)];
+  RemoveRow(archetypes_[location.archetype], location.row);
+  location.archetype = -1;
+  ids_.Free(id);
+}
+
+bool EntityStore::IsAlive(EntityId id) const {
+  return ids_.IsValid(id);
+}
+
+uint32_t EntityStore::GetEntitiesCount() const {
+  return ids_.GetCount();
+}
+
+void EntityStore::Clear() {
+  for (Archetype* archetype : archetypes_) {
+    for (const Column& column : archetype->columns) {
+      for (size_t row = 0; row < archetype->entities.size(); ++row)
+        column.info.destroy(column.data + row * column.info.size);
+    }
+    archetype->entities.clear();
+  }
+  for (Location& location : locations_)
+    location.archetype = -1;
+  ids_.Clear();
+}
+
+int32_t EntityStore::FindArchetype(ComponentMask mask) {
+  for (size_t i = 0; i < archetypes_.size(); ++i) {
+    if (archetypes_[i]->mask == mask)
+      return static_cast<int32_t>(i);
+  }
+
+  Archetype* archetype = new Archetype();
+  archetype->mask = mask;
+  archetype->capacity = 0;
+  memset(archetype->column_indices, -1, sizeof(archetype->column_indices));
+  for (int type = 0; type < kMaxComponentTypes; ++type) {
+    if ((mask & (ComponentMask(1) << type)) == 0)
+      continue;
+    Column column;
+    column.type = type;
+    column.info = GetComponentTypeInfo(type);
+    column.data = nullptr;
+    archetype->column_indices[type] =
+      static_cast<int8_t>(archetype->columns.size());
+    archetype->columns.push_back(column);
+  }
+  archetypes_.push_back(archetype);
+  return static_cast<int32_t>(archetypes_.size() - 1);
+}
+
+void EntityStore::Reserve(Archetype* archetype, uint32_t capacity) {
+  if (capacity <= archetype->capacity)
+    return;
+  uint32_t new_capacity = archetype->capacity < kMinCapacity ?
+    kMinCapacity : archetype->capacity;
+  while (new_capacity < capacity)
+    new_capacity *= 2;
+
+  const size_t kRowsCount = archetype->entities.size();
+  for (Column& column : archetype->columns) {
+    const ComponentTypeInfo& kInfo = column.info;
+    const size_t kAlignment = kInfo.alignment > kColumnAlignment ?
+      kInfo.alignment : kColumnAlignment;
+    char* data = static_cast<char*>(core::TaggedHeap::Allocate(
+      core::MEMORY_TAG_SCENE, new_capacity * kInfo.size, kAlignment));
+    if (data == nullptr)
+      abort();
+    for (size_t row = 0; row < kRowsCount; ++row) {
+      kInfo.move(data + row * kInfo.size, column.data + row * kInfo.size);
+      kInfo.destroy(column.data + row * kInfo.size);
+    }
+    core::TaggedHeap::Free(column.data);
+    column.data = data;
+  }
+  archetype->capacity = new_capacity;
+}
+
+uint32_t EntityStore::MoveEntity(EntityId id, ComponentMask mask) {
+  Location& location = locations_[core::HandleAllocator::GetIndex(id)];
+  const int32_t kTarget = FindArchetype(mask);
+  Archetype* source = archetypes_[location.archetype];
+  Archetype* target = archetypes_[kTarget];
+  const uint32_t kRow = static_cast<uint32_t>(target->entities.size());
+  Reserve(target, kRow + 1);
+
+  // the component the target lacks is destroyed with the source row
+  for (const Column& column : target->columns) {
+    const int kSourceColumn = source->column_indices[column.type];
+    if (kSourceColumn < 0)
+      continue;
+    const size_t kSize = column.info.size;
+    column.info.move(column.data + kRow * kSize,
+      source->columns[kSourceColumn].data + location.row * kSize);
+  }
+  target->entities.push_back(id);
+  RemoveRow(source, location.row);
+
+  location.archetype = kTarget;
+  location.row = kRow;
+  return kRow;
+}
+
+void EntityStore::RemoveRow(Archetype* archetype, uint32_t row) {
+  const uint32_t kLast =
+    static_cast<uint32_t>(archetype->entities.size() - 1);
+  for (const Column& column : archetype->columns) {
+    const ComponentTypeInfo& kInfo = column.info;
+    kInfo.destroy(column.data + row * kInfo.size);
+    if (row != kLast) {
+      kInfo.move(column.data + row * kInfo.size,
+        column.data + kLast * kInfo.size);
+      kInfo.destroy(column.data + kLast * kInfo.size);
+    }
+  }
+  if (row != kLast) {
+    const EntityId kMoved = archetype->entities[kLast];
+    archetype->entities[row] = kMoved;
+    locations_[core::HandleAllocator::GetIndex(kMoved)].row = row;
+  }
+  archetype->entities.pop_back();
+}
+
+void* EntityStore::GetComponentData(EntityId id, int type) {
+  if (!IsAlive(id))
+    return nullptr;
+  const Location& kLocation = locations_[core::HandleAllocator::GetIndex(id)];
+  const Archetype& kArchetype = *archetypes_[kLocation.archetype];
+  const int kColumn = kArchetype.column_indices[type];
+  if (kColumn < 0)
+    return nullptr;
+  const Column& kData = kArchetype.columns[kColumn];
+  return kData.data + kLocation.row * kData.info.size;
+}
+
+char* EntityStore::GetColumnData(const Archetype& archetype, int type) {
+  const int kColumn = archetype.column_indices[type];
+  return kColumn >= 0 ? archetype.columns[kColumn].data : nullptr;
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,265 @@
+#ifndef MAGNET_SCENE_ENTITY_STORE_H_
+#define MAGNET_SCENE_ENTITY_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/handle_allocator.h"
+#include "core/task_manager.h"
+
+namespace magnet {
+namespace scene {
+// a generational handle, see core::HandleAllocator
+typedef core::Handle EntityId;
+static const EntityId kInvalidEntityId = core::kInvalidHandle;
+
+// one bit per component type
+typedef uint64_t ComponentMask;
+static const int kMaxComponentTypes = 64;
+
+// how the store moves and destroys a component type it only knows by id
+struct ComponentTypeInfo {
+  size_t size;
+  size_t alignment;
+  void (*move)(void* destination, void* source);
+  void (*destroy)(void* component);
+};
+
+// entities are ids, their components live in archetype tables, one table
+// per set of component types. a table keeps each component type in its
+// own contiguous column, so a system touching two types walks two arrays
+// and never the rest.
+//
+//   EntityId id = store.CreateEntity();
+//   store.AddComponent(id, WorldTransform());
+//   store.ForEach<WorldTransform, MeshDraw>(
+//     [](EntityId id, WorldTransform& world, MeshDraw& draw) { ... });
+//
+// adding or removing a component moves the entity to another table.
+// pointers to components are valid until the next change of the store,
+// and entities are not to be created, changed or destroyed while it is
+// iterated. creating and destroying an entity is O(1), the slot of a
+// destroyed entity is reused and its old id is no longer alive.
+class EntityStore {
+ public:
+  EntityStore();
+  ~EntityStore();
+  EntityStore(const EntityStore&) = delete;
+  EntityStore& operator=(const EntityStore&) = delete;
+
+  // the same for every store, assigned on first use
+  template <typename T>
+  static int GetComponentTypeId();
+  template <typename... Ts>
+  static ComponentMask GetComponentMask();
+
+  // kInvalidEntityId once core::kMaxHandlesCount entities are alive
+  EntityId CreateEntity();
+  void DestroyEntity(EntityId id);
+  bool IsAlive(EntityId id) const;
+  uint32_t GetEntitiesCount() const;
+  // destroys every entity, the tables keep their memory
+  void Clear();
+
+  // replaces the component if the entity has one
+  template <typename T>
+  T* AddComponent(EntityId id, T component);
+  template <typename T>
+  void RemoveComponent(EntityId id);
+  // null if the entity has none
+  template <typename T>
+  T* GetComponent(EntityId id);
+  template <typename T>
+  bool HasComponent(EntityId id) const;
+
+  // function(EntityId, Ts&...) for every entity with all of Ts, table by
+  // table in row order
+  template <typename... Ts, typename Function>
+  void ForEach(const Function& function);
+  // the same as TaskManager tasks of at most rows_per_task rows, inline
+  // without worker threads. the calling thread runs tasks until all of
+  // them finished.
+  template <typename... Ts, typename Function>
+  void ParallelForEach(uint32_t rows_per_task, const Function& function);
+
+ private:
+  struct Column {
+    int type;
+    ComponentTypeInfo info;
+    char* data;                       // from the tagged heap
+  };
+
+  struct Archetype {
+    ComponentMask mask;
+    std::vector<Column> columns;
+    int8_t column_indices[kMaxComponentTypes];  // -1 if not in the table
+    std::vector<EntityId> entities;
+    uint32_t capacity;
+  };
+
+  struct Location {
+    int32_t archetype;                // -1 once destroyed
+    uint32_t row;
+  };
+
+  static int RegisterComponentType(const ComponentTypeInfo& info);
+  static ComponentTypeInfo GetComponentTypeInfo(int type);
+
+  template <typename T>
+  static void MoveComponent(void* destination, void* source);
+  template <typename T>
+  static void DestroyComponent(void* component);
+
+  template <typename Function, typename... Ts>
+  static void RunRows(const Archetype& archetype, uint32_t begin,
+    uint32_t end, const Function& function, Ts*... columns);
+
+  int32_t FindArchetype(ComponentMask mask);
+  void Reserve(Archetype* archetype, uint32_t capacity);
+  // the entity moved to the table of mask, the components both tables
+  // have are moved along. returns the row.
+  uint32_t MoveEntity(EntityId id, ComponentMask mask);
+  // destroys the row, the last row takes its place
+  void RemoveRow(Archetype* archetype, uint32_t row);
+  void* GetComponentData(EntityId id, int type);
+  static char* GetColumnData(const Archetype& archetype, int type);
+
+  std::vector<Archetype*> archetypes_;
+  core::HandleAllocator ids_;
+  std::vector<Location> locations_;   // by index of the id
+};
+
+template <typename T>
+inline int EntityStore::GetComponentTypeId() {
+  static const ComponentTypeInfo kInfo = { sizeof(T), alignof(T),
+    &MoveComponent<T>, &DestroyComponent<T> };
+  static const int kId = RegisterComponentType(kInfo);
+  return kId;
+}
+
+template <typename... Ts>
+inline ComponentMask EntityStore::GetComponentMask() {
+  ComponentMask mask = 0;
+  const int kExpand[] = { 0,
+    (mask |= ComponentMask(1) << GetComponentTypeId<Ts>(), 0)... };
+  (void)kExpand;
+  return mask;
+}
+
+template <typename T>
+inline void EntityStore::MoveComponent(void* destination, void* source) {
+  new (destination) T(std::move(*static_cast<T*>(source)));
+}
+
+template <typename T>
+inline void EntityStore::DestroyComponent(void* component) {
+  static_cast<T*>(component)->~T();
+}
+
+template <typename T>
+inline T* EntityStore::AddComponent(EntityId id, T component) {
+  const int kType = GetComponentTypeId<T>();
+  T* existing = static_cast<T*>(GetComponentData(id, kType));
+  if (existing != nullptr) {
+    *existing = std::move(component);
+    return existing;
+  }
+  if (!IsAlive(id))
+    return nullptr;
+
+  const Location& kLocation = locations_[core::HandleAllocator::GetIndex(id)];
+  const uint32_t kRow = MoveEntity(id,
+    archetypes_[kLocation.archetype]->mask | (ComponentMask(1) << kType));
+  T* added = reinterpret_cast<T*>(
+    GetColumnData(*archetypes_[kLocation.archetype], kType)) + kRow;
+  new (added) T(std::move(component));
+  return added;
+}
+
+template <typename T>
+inline void EntityStore::RemoveComponent(EntityId id) {
+  const int kType = GetComponentTypeId<T>();
+  if (!HasComponent<T>(id))
+    return;
+  const ComponentMask kMask = archetypes_[
+    locations_[core::HandleAllocator::GetIndex(id)].archetype]->mask;
+  MoveEntity(id, kMask & ~(ComponentMask(1) << kType));
+}
+
+template <typename T>
+inline T* EntityStore::GetComponent(EntityId id) {
+  return static_cast<T*>(GetComponentData(id, GetComponentTypeId<T>()));
+}
+
+template <typename T>
+inline bool EntityStore::HasComponent(EntityId id) const {
+  return IsAlive(id) && (archetypes_[
+    locations_[core::HandleAllocator::GetIndex(id)].archetype]->mask &
+    (ComponentMask(1) << GetComponentTypeId<T>())) != 0;
+}
+
+template <typename Function, typename... Ts>
+inline void EntityStore::RunRows(const Archetype& archetype, uint32_t begin,
+  uint32_t end, const Function& function, Ts*... columns) {
+  for (uint32_t row = begin; row < end; ++row)
+    function(archetype.entities[row], columns[row]...);
+}
+
+template <typename... Ts, typename Function>
+inline void EntityStore::ForEach(const Function& function) {
+  const ComponentMask kMask = GetComponentMask<Ts...>();
+  for (const Archetype* archetype : archetypes_) {
+    if ((archetype->mask & kMask) != kMask || archetype->entities.empty())
+      continue;
+    RunRows(*archetype, 0, static_cast<uint32_t>(archetype->entities.size()),
+      function, reinterpret_cast<Ts*>(
+      GetColumnData(*archetype, GetComponentTypeId<Ts>()))...);
+  }
+}
+
+template <typename... Ts, typename Function>
+inline void EntityStore::ParallelForEach(uint32_t rows_per_task,
+  const Function& function) {
+  core::TaskManager* task_manager = core::TaskManager::Exist() ?
+    core::TaskManager::GetInstance() : nullptr;
+  if (task_manager == nullptr || task_manager->GetThreadsCount() <= 0) {
+    ForEach<Ts...>(function);
+    return;
+  }
+
+  const ComponentMask kMask = GetComponentMask<Ts...>();
+  if (rows_per_task == 0)
+    rows_per_task = 1;
+  std::atomic<int> remaining(0);
+  for (const Archetype* archetype : archetypes_) {
+    if ((archetype->mask & kMask) != kMask)
+      continue;
+    const uint32_t kRowsCount =
+      static_cast<uint32_t>(archetype->entities.size());
+    for (uint32_t begin = 0; begin < kRowsCount; begin += rows_per_task) {
+      const uint32_t kEnd = kRowsCount - begin > rows_per_task ?
+        begin + rows_per_task : kRowsCount;
+      remaining.fetch_add(1);
+      core::Task task;
+      task.func = [archetype, begin, kEnd, &function, &remaining]() {
+        RunRows(*archetype, begin, kEnd, function, reinterpret_cast<Ts*>(
+          GetColumnData(*archetype, GetComponentTypeId<Ts>()))...);
+        remaining.fetch_sub(1);
+      };
+      task_manager->EnqueueTask(task);
+    }
+  }
+
+  while (remaining.load() > 0) {
+    if (!task_manager->ExecuteTask())
+      std::this_thread::yield();
+  }
+}
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_ENTITY_STORE_H_
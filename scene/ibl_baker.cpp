@@ -0,0 +1,515 @@
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "core/half.h"
+#include "core/hash.h"
+#include "core/parallel_for.h"
+#include "core/simd.h"
+#include "render/texture.h"
+
+#include "ibl_baker.h"
+#include "texel_decoder.h"
+#include "texture_cache.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+// bump when the baker makes different data from the same sky and settings
+static const uint32_t kBakerVersion = 1;
+
+// rows of levels smaller than this are not worth a thread
+static const size_t kMinSamplesPerThread = 256 * 1024;
+
+static const float kPi = 3.14159265f;
+
+// direction through texel (u, v) of a face in [-1, 1], each axis as the
+// factors of u, v and 1. d3d cube map face order and orientation.
+static const float kFaceAxes[6][3][3] = {
+  { { 0.f, 0.f, 1.f }, { 0.f, -1.f, 0.f }, { -1.f, 0.f, 0.f } },  // +x
+  { { 0.f, 0.f, -1.f }, { 0.f, -1.f, 0.f }, { 1.f, 0.f, 0.f } },  // -x
+  { { 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f } },    // +y
+  { { 1.f, 0.f, 0.f }, { 0.f, 0.f, -1.f }, { 0.f, -1.f, 0.f } },  // -y
+  { { 1.f, 0.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f } },   // +z
+  { { -1.f, 0.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, -1.f } }  // -z
+};
+
+// rgba sums, on sse2 in one register
+#ifdef MAGNET_SSE2
+typedef __m128 Rgba;
+
+inline Rgba ZeroRgba() {
+  return _mm_setzero_ps();
+}
+
+inline Rgba LoadRgba(const float* texel) {
+  return _mm_loadu_ps(texel);
+}
+
+// sum + texel * weight
+inline Rgba AddWeighted(Rgba sum, Rgba texel, float weight) {
+  return _mm_add_ps(sum, _mm_mul_ps(texel, _mm_set1_ps(weight)));
+}
+
+inline void StoreRgba(Rgba rgba, float* texel) {
+  _mm_storeu_ps(texel, rgba);
+}
+#else
+struct Rgba {
+  float values[4];
+};
+
+inline Rgba ZeroRgba() {
+  Rgba rgba = { { 0.f, 0.f, 0.f, 0.f } };
+  return rgba;
+}
+
+inline Rgba LoadRgba(const float* texel) {
+  Rgba rgba = { { texel[0], texel[1], texel[2], texel[3] } };
+  return rgba;
+}
+
+inline Rgba AddWeighted(Rgba sum, Rgba texel, float weight) {
+  for (int c = 0; c < 4; ++c)
+    sum.values[c] += texel.values[c] * weight;
+  return sum;
+}
+
+inline void StoreRgba(Rgba rgba, float* texel) {
+  for (int c = 0; c < 4; ++c)
+    texel[c] = rgba.values[c];
+}
+#endif  // MAGNET_SSE2
+
+// a mip of the sky in linear float rgba, the six faces one after the other
+struct CubeLevel {
+  int size;
+  std::vector<float> texels;
+};
+
+// a direction sampled for every texel of a prefiltered level, in the space
+// of the texel direction n, with its n.l weight and the sky mip to read
+struct GgxSample {
+  float x;
+  float y;
+  float z;
+  float weight;
+  float lod;
+};
+
+inline void Normalize(float* v) {
+  const float kInverseLength = 1.f / sqrtf(v[0] * v[0] + v[1] * v[1] +
+    v[2] * v[2]);
+  v[0] *= kInverseLength;
+  v[1] *= kInverseLength;
+  v[2] *= kInverseLength;
+}
+
+void GetTexelDirection(int face, int x, int y, int size, float* direction) {
+  const float kU = (x + 0.5f) * 2.f / size - 1.f;
+  const float kV = (y + 0.5f) * 2.f / size - 1.f;
+  for (int axis = 0; axis < 3; ++axis) {
+    direction[axis] = kFaceAxes[face][axis][0] * kU +
+      kFaceAxes[face][axis][1] * kV + kFaceAxes[face][axis][2];
+  }
+  Normalize(direction);
+}
+
+// the inverse of GetTexelDirection, s and t in [0, 1]
+void GetFaceCoordinates(const float* direction, int* face, float* s,
+  float* t) {
+  const float kX = direction[0];
+  const float kY = direction[1];
+  const float kZ = direction[2];
+  const float kAbsX = fabsf(kX);
+  const float kAbsY = fabsf(kY);
+  const float kAbsZ = fabsf(kZ);
+  float major;
+  float u;
+  float v;
+  if (kAbsX >= kAbsY && kAbsX >= kAbsZ) {
+    *face = kX > 0.f ? 0 : 1;
+    major = kAbsX;
+    u = kX > 0.f ? -kZ : kZ;
+    v = -kY;
+  }
+  else if (kAbsY >= kAbsZ) {
+    *face = kY > 0.f ? 2 : 3;
+    major = kAbsY;
+    u = kX;
+    v = kY > 0.f ? kZ : -kZ;
+  }
+  else {
+    *face = kZ > 0.f ? 4 : 5;
+    major = kAbsZ;
+    u = kZ > 0.f ? kX : -kX;
+    v = -kY;
+  }
+  *s = (u / major + 1.f) * 0.5f;
+  *t = (v / major + 1.f) * 0.5f;
+}
+
+// bilinear inside the face, clamped at its edges
+Rgba SampleFace(const CubeLevel& level, int face, float s, float t) {
+  const int kSize = level.size;
+  const float kX = std::min(std::max(s * kSize - 0.5f, 0.f), kSize - 1.f);
+  const float kY = std::min(std::max(t * kSize - 0.5f, 0.f), kSize - 1.f);
+  const int kX0 = static_cast<int>(kX);
+  const int kY0 = static_cast<int>(kY);
+  const int kX1 = std::min(kX0 + 1, kSize - 1);
+  const int kY1 = std::min(kY0 + 1, kSize - 1);
+  const float kWeightX = kX - kX0;
+  const float kWeightY = kY - kY0;
+
+  const float* texels = &level.texels[static_cast<size_t>(face) * kSize *
+    kSize * 4];
+  Rgba sum = ZeroRgba();
+  sum = AddWeighted(sum, LoadRgba(texels + (kY0 * kSize + kX0) * 4),
+    (1.f - kWeightX) * (1.f - kWeightY));
+  sum = AddWeighted(sum, LoadRgba(texels + (kY0 * kSize + kX1) * 4),
+    kWeightX * (1.f - kWeightY));
+  sum = AddWeighted(sum, LoadRgba(texels + (kY1 * kSize + kX0) * 4),
+    (1.f - kWeightX) * kWeightY);
+  sum = AddWeighted(sum, LoadRgba(texels + (kY1 * kSize + kX1) * 4),
+    kWeightX * kWeightY);
+  return sum;
+}
+
+// trilinear between the two sky mips around lod
+Rgba SampleCube(const std::vector<CubeLevel>& levels, const float* direction,
+  float lod) {
+  int face;
+  float s;
+  float t;
+  GetFaceCoordinates(direction, &face, &s, &t);
+
+  const int kLastLevel = static_cast<int>(levels.size()) - 1;
+  lod = std::min(std::max(lod, 0.f), static_cast<float>(kLastLevel));
+  const int kLevel = std::min(static_cast<int>(lod), kLastLevel);
+  const float kFraction = lod - kLevel;
+  Rgba sum = AddWeighted(ZeroRgba(), SampleFace(levels[kLevel], face, s, t),
+    1.f - kFraction);
+  if (kFraction > 0.f && kLevel < kLastLevel) {
+    sum = AddWeighted(sum, SampleFace(levels[kLevel + 1], face, s, t),
+      kFraction);
+  }
+  return sum;
+}
+
+// the top level decoded, then averaged down 2x2 to a texel a face
+bool BuildSkyLevels(const render::Texture& sky, bool srgb,
+  std::vector<CubeLevel>* levels) {
+  const int kSize = sky.GetWidth();
+  const uint8_t* data = static_cast<const uint8_t*>(sky.GetDataBufferPtr());
+  levels->resize(1);
+  CubeLevel& top = levels->front();
+  top.size = kSize;
+  top.texels.resize(static_cast<size_t>(6) * kSize * kSize * 4);
+  for (int face = 0; face < 6; ++face) {
+    for (int y = 0; y < kSize; ++y) {
+      DecodeTexels(sky.GetFormat(), srgb, data + face * sky.GetFaceSize() +
+        y * sky.GetRowPitch(0), kSize,
+        &top.texels[((static_cast<size_t>(face) * kSize + y) * kSize) * 4]);
+    }
+  }
+
+  while (levels->back().size > 1) {
+    const CubeLevel& source = levels->back();
+    CubeLevel level;
+    level.size = source.size / 2;
+    level.texels.resize(static_cast<size_t>(6) * level.size * level.size * 4);
+    for (int face = 0; face < 6; ++face) {
+      const float* input = &source.texels[static_cast<size_t>(face) *
+        source.size * source.size * 4];
+      float* output = &level.texels[static_cast<size_t>(face) * level.size *
+        level.size * 4];
+      for (int y = 0; y < level.size; ++y) {
+        for (int x = 0; x < level.size; ++x) {
+          const float* texel = input + ((2 * y) * source.size + 2 * x) * 4;
+          const float* next_row = texel + source.size * 4;
+          Rgba sum = AddWeighted(ZeroRgba(), LoadRgba(texel), 0.25f);
+          sum = AddWeighted(sum, LoadRgba(texel + 4), 0.25f);
+          sum = AddWeighted(sum, LoadRgba(next_row), 0.25f);
+          sum = AddWeighted(sum, LoadRgba(next_row + 4), 0.25f);
+          StoreRgba(sum, output + (y * level.size + x) * 4);
+        }
+      }
+    }
+    levels->push_back(std::move(level));
+  }
+  return true;
+}
+
+inline void GetHammersley(int i, int count, float* x, float* y) {
+  uint32_t bits = static_cast<uint32_t>(i);
+  bits = (bits << 16) | (bits >> 16);
+  bits = ((bits & 0x55555555u) << 1) | ((bits & 0xaaaaaaaau) >> 1);
+  bits = ((bits & 0x33333333u) << 2) | ((bits & 0xccccccccu) >> 2);
+  bits = ((bits & 0x0f0f0f0fu) << 4) | ((bits & 0xf0f0f0f0u) >> 4);
+  bits = ((bits & 0x00ff00ffu) << 8) | ((bits & 0xff00ff00u) >> 8);
+  *x = static_cast<float>(i) / count;
+  *y = bits * 2.3283064365386963e-10f;
+}
+
+// a half vector of the ggx lobe around z, alpha = roughness^2
+void SampleGgx(float x, float y, float alpha, float* half) {
+  const float kPhi = 2.f * kPi * x;
+  const float kCosTheta = sqrtf((1.f - y) / (1.f + (alpha * alpha - 1.f) * y));
+  const float kSinTheta = sqrtf(1.f - kCosTheta * kCosTheta);
+  half[0] = kSinTheta * cosf(kPhi);
+  half[1] = kSinTheta * sinf(kPhi);
+  half[2] = kCosTheta;
+}
+
+// with n = v the samples only depend on the roughness, their lod is picked
+// so a sample covers as many sky texels as its share of the lobe
+void ComputeGgxSamples(float roughness, int samples_count, int sky_size,
+  std::vector<GgxSample>* samples) {
+  const float kAlpha = roughness * roughness;
+  const float kTexelSolidAngle = 4.f * kPi / (6.f * sky_size * sky_size);
+  samples->clear();
+  for (int i = 0; i < samples_count; ++i) {
+    float x;
+    float y;
+    GetHammersley(i, samples_count, &x, &y);
+    float half[3];
+    SampleGgx(x, y, kAlpha, half);
+    const float kNDotH = half[2];
+    GgxSample sample;
+    sample.x = 2.f * kNDotH * half[0];
+    sample.y = 2.f * kNDotH * half[1];
+    sample.z = 2.f * kNDotH * kNDotH - 1.f;
+    if (sample.z <= 0.f)
+      continue;
+
+    // pdf of l is d(h) n.h / (4 v.h), n.h = v.h here
+    const float kAlpha2 = kAlpha * kAlpha;
+    const float kDenominator = kNDotH * kNDotH * (kAlpha2 - 1.f) + 1.f;
+    const float kDistribution = kAlpha2 /
+      std::max(kPi * kDenominator * kDenominator, 1e-12f);
+    const float kPdf = kDistribution * 0.25f;
+    const float kSampleSolidAngle =
+      1.f / std::max(samples_count * kPdf, 1e-12f);
+    sample.weight = sample.z;
+    sample.lod = roughness > 0.f ?
+      std::max(0.5f * log2f(kSampleSolidAngle / kTexelSolidAngle) + 1.f,
+        0.f) : 0.f;
+    samples->push_back(sample);
+  }
+}
+
+void PrefilterLevel(const std::vector<CubeLevel>& sky_levels,
+  const std::vector<GgxSample>& samples, int size, int threads_count,
+  float mirror_lod, uint8_t* data, size_t face_size, size_t level_offset) {
+  const int kRowsCount = 6 * size;
+  const size_t kWork = static_cast<size_t>(kRowsCount) * size *
+    std::max<size_t>(1, samples.size());
+  core::ParallelFor(kRowsCount, core::GetParallelThreadsCount(kWork,
+    kMinSamplesPerThread, threads_count), [&](int begin, int end) {
+    std::vector<float> row(static_cast<size_t>(size) * 4);
+    for (int row_index = begin; row_index < end; ++row_index) {
+      const int kFace = row_index / size;
+      const int kY = row_index % size;
+      for (int x = 0; x < size; ++x) {
+        float normal[3];
+        GetTexelDirection(kFace, x, kY, size, normal);
+        if (samples.empty()) {
+          StoreRgba(SampleCube(sky_levels, normal, mirror_lod), &row[x * 4]);
+          continue;
+        }
+
+        // a tangent frame around the texel direction
+        const float kUp[3] = { fabsf(normal[2]) < 0.999f ? 0.f : 1.f, 0.f,
+          fabsf(normal[2]) < 0.999f ? 1.f : 0.f };
+        float tangent[3] = { kUp[1] * normal[2] - kUp[2] * normal[1],
+          kUp[2] * normal[0] - kUp[0] * normal[2],
+          kUp[0] * normal[1] - kUp[1] * normal[0] };
+        Normalize(tangent);
+        const float kBitangent[3] = {
+          normal[1] * tangent[2] - normal[2] * tangent[1],
+          normal[2] * tangent[0] - normal[0] * tangent[2],
+          normal[0] * tangent[1] - normal[1] * tangent[0] };
+
+        Rgba sum = ZeroRgba();
+        float weight_sum = 0.f;
+        for (const GgxSample& sample : samples) {
+          float direction[3];
+          for (int axis = 0; axis < 3; ++axis) {
+            direction[axis] = tangent[axis] * sample.x +
+              kBitangent[axis] * sample.y + normal[axis] * sample.z;
+          }
+          sum = AddWeighted(sum, SampleCube(sky_levels, direction, sample.lod),
+            sample.weight);
+          weight_sum += sample.weight;
+        }
+        StoreRgba(AddWeighted(ZeroRgba(), sum, 1.f / weight_sum), &row[x * 4]);
+      }
+
+      uint8_t* output = data + kFace * face_size + level_offset +
+        static_cast<size_t>(kY) * size * 8;
+      core::FloatToHalf(row.data(), row.size(),
+        reinterpret_cast<uint16_t*>(output));
+    }
+  });
+}
+
+// schlick-ggx smith visibility with k = alpha / 2, as used for ibl
+inline float GetGeometry(float n_dot_v, float n_dot_l, float alpha) {
+  const float kK = alpha * 0.5f;
+  return n_dot_v / (n_dot_v * (1.f - kK) + kK) *
+    (n_dot_l / (n_dot_l * (1.f - kK) + kK));
+}
+
+// the texels of the sky top levels and the settings they are baked with
+uint64_t ComputeSkyKey(const IblBakeDesc& desc, const render::Texture& sky) {
+  const uint32_t kSettings[8] = { kBakerVersion,
+    static_cast<uint32_t>(sky.GetFormat()),
+    static_cast<uint32_t>(sky.GetWidth()),
+    desc.srgb ? 1u : 0u,
+    static_cast<uint32_t>(desc.face_size),
+    static_cast<uint32_t>(desc.mip_levels),
+    static_cast<uint32_t>(desc.samples_count), 0 };
+  uint64_t key = core::Hash64(kSettings, sizeof(kSettings));
+  const uint8_t* data = static_cast<const uint8_t*>(sky.GetDataBufferPtr());
+  const size_t kTopSize = sky.GetRowPitch(0) * sky.GetHeight();
+  for (int face = 0; face < 6; ++face)
+    key = core::Hash64(data + face * sky.GetFaceSize(), kTopSize, key);
+  return key;
+}
+}  // namespace
+
+bool IblBaker::CanBake(const render::Texture& sky) {
+  return sky.GetType() == render::TEXTURE_TYPE_CUBE &&
+    sky.GetDataBufferPtr() != nullptr && sky.GetWidth() > 0 &&
+    sky.GetWidth() == sky.GetHeight() && CanDecodeTexels(sky.GetFormat());
+}
+
+bool IblBaker::BakeSpecular(const IblBakeDesc& desc,
+  const render::Texture& sky, render::Texture* specular) {
+  if (!CanBake(sky) || desc.face_size <= 0 || desc.samples_count <= 0)
+    return false;
+
+  int mip_levels = 1;
+  while (desc.face_size >> mip_levels)
+    ++mip_levels;
+  if (desc.mip_levels > 0)
+    mip_levels = std::min(mip_levels, desc.mip_levels);
+
+  std::vector<CubeLevel> sky_levels;
+  BuildSkyLevels(sky, desc.srgb, &sky_levels);
+
+  specular->SetFormat(render::TEXTURE_FORMAT_R16G16B16A16_FLOAT);
+  specular->SetType(render::TEXTURE_TYPE_CUBE);
+  specular->SetDimension(desc.face_size, desc.face_size);
+  specular->SetMipLevels(mip_levels);
+  uint8_t* data = static_cast<uint8_t*>(specular->CreateDataBuffer());
+  if (data == nullptr)
+    return false;
+
+  // the top level mirrors the sky, read from the mip closest to its size
+  std::vector<GgxSample> samples;
+  for (int level = 0; level < mip_levels; ++level) {
+    const int kSize = specular->GetMipWidth(level);
+    const float kRoughness = mip_levels > 1 ?
+      static_cast<float>(level) / (mip_levels - 1) : 0.f;
+    if (level == 0)
+      samples.clear();
+    else
+      ComputeGgxSamples(kRoughness, desc.samples_count, sky.GetWidth(),
+        &samples);
+    const float kMirrorLod = std::max(0.f,
+      log2f(static_cast<float>(sky.GetWidth()) / kSize));
+    PrefilterLevel(sky_levels, samples, kSize, desc.threads_count, kMirrorLod,
+      data, specular->GetFaceSize(), specular->GetMipOffset(level));
+  }
+  return true;
+}
+
+bool IblBaker::BakeBrdfLut(const IblBakeDesc& desc, render::Texture* lut) {
+  const int kSize = desc.brdf_lut_size;
+  const int kSamplesCount = desc.brdf_samples_count;
+  if (kSize <= 0 || kSamplesCount <= 0)
+    return false;
+
+  lut->SetFormat(render::TEXTURE_FORMAT_R16G16B16A16_FLOAT);
+  lut->SetType(render::TEXTURE_TYPE_2D);
+  lut->SetDimension(kSize, kSize);
+  lut->SetMipLevels(1);
+  uint16_t* data = static_cast<uint16_t*>(lut->CreateDataBuffer());
+  if (data == nullptr)
+    return false;
+
+  const size_t kWork = static_cast<size_t>(kSize) * kSize * kSamplesCount;
+  core::ParallelFor(kSize, core::GetParallelThreadsCount(kWork,
+    kMinSamplesPerThread, desc.threads_count), [&](int begin, int end) {
+    std::vector<float> row(static_cast<size_t>(kSize) * 4);
+    for (int y = begin; y < end; ++y) {
+      const float kRoughness = (y + 0.5f) / kSize;
+      const float kAlpha = kRoughness * kRoughness;
+      for (int x = 0; x < kSize; ++x) {
+        const float kNDotV = (x + 0.5f) / kSize;
+        const float kView[3] = { sqrtf(1.f - kNDotV * kNDotV), 0.f, kNDotV };
+        float scale = 0.f;
+        float bias = 0.f;
+        for (int i = 0; i < kSamplesCount; ++i) {
+          float u;
+          float v;
+          GetHammersley(i, kSamplesCount, &u, &v);
+          float half[3];
+          SampleGgx(u, v, kAlpha, half);
+          const float kVDotH = kView[0] * half[0] + kView[2] * half[2];
+          const float kNDotL = 2.f * kVDotH * half[2] - kView[2];
+          if (kNDotL <= 0.f || kVDotH <= 0.f)
+            continue;
+
+          const float kVisibility = GetGeometry(kNDotV, kNDotL, kAlpha) *
+            kVDotH / (half[2] * kNDotV);
+          const float kFresnel = powf(1.f - kVDotH, 5.f);
+          scale += (1.f - kFresnel) * kVisibility;
+          bias += kFresnel * kVisibility;
+        }
+        float* texel = &row[x * 4];
+        texel[0] = scale / kSamplesCount;
+        texel[1] = bias / kSamplesCount;
+        texel[2] = 0.f;
+        texel[3] = 1.f;
+      }
+      core::FloatToHalf(row.data(), row.size(),
+        data + static_cast<size_t>(y) * kSize * 4);
+    }
+  });
+  return true;
+}
+
+bool IblBaker::BakeSpecularCached(const IblBakeDesc& desc,
+  const render::Texture& sky, const std::string& cache_path,
+  render::Texture* specular) {
+  if (!CanBake(sky))
+    return false;
+  const uint64_t kKey = cache_path.empty() ? 0 : ComputeSkyKey(desc, sky);
+  if (!cache_path.empty() && TextureCache::Read(cache_path, kKey, specular))
+    return true;
+  if (!BakeSpecular(desc, sky, specular))
+    return false;
+  if (!cache_path.empty())
+    TextureCache::Write(cache_path, kKey, *specular);
+  return true;
+}
+
+bool IblBaker::BakeBrdfLutCached(const IblBakeDesc& desc,
+  const std::string& cache_path, render::Texture* lut) {
+  const uint32_t kSettings[4] = { kBakerVersion,
+    static_cast<uint32_t>(desc.brdf_lut_size),
+    static_cast<uint32_t>(desc.brdf_samples_count), 0 };
+  const uint64_t kKey = core::Hash64(kSettings, sizeof(kSettings));
+  if (!cache_path.empty() && TextureCache::Read(cache_path, kKey, lut))
+    return true;
+  if (!BakeBrdfLut(desc, lut))
+    return false;
+  if (!cache_path.empty())
+    TextureCache::Write(cache_path, kKey, *lut);
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,57 @@
+#ifndef MAGNET_SCENE_IBL_BAKER_H_
+#define MAGNET_SCENE_IBL_BAKER_H_
+
+#include <stdint.h>
+#include <string>
+
+namespace magnet {
+namespace render {
+class Texture;
+}  // namespace render
+
+namespace scene {
+struct IblBakeDesc {
+  IblBakeDesc() : face_size(128), mip_levels(6), samples_count(256),
+    brdf_lut_size(128), brdf_samples_count(512), srgb(true),
+    threads_count(0) {}
+  int face_size;            // of the top level of the prefiltered cube map
+  int mip_levels;           // roughness 0 to 1, 0 for the whole chain
+  int samples_count;        // ggx samples per prefiltered texel
+  int brdf_lut_size;
+  int brdf_samples_count;   // per lut texel
+  bool srgb;                // 8 bit sky colors are srgb encoded
+  int threads_count;        // 0 for all cores
+};
+
+// image based lighting for the split sum approximation, baked on the cpu
+// from the data of a sky cube map, no gpu needed.
+//
+// the specular cube map holds the sky convolved with the ggx lobe, mip
+// level i for roughness i / (mip_levels - 1), in half floats. every texel
+// averages importance sampled directions, each read from the mip of the
+// sky whose texels are about as large as the solid angle of its sample.
+// the brdf lut holds the scale and bias of the fresnel term in red and
+// green, by n.v along x and roughness along y.
+//
+// rows are split over threads, texels are accumulated on sse2.
+class IblBaker {
+ public:
+  // cube maps with square faces of 8 bit, half and float rgba texels
+  static bool CanBake(const render::Texture& sky);
+
+  static bool BakeSpecular(const IblBakeDesc& desc, const render::Texture& sky,
+    render::Texture* specular);
+  static bool BakeBrdfLut(const IblBakeDesc& desc, render::Texture* lut);
+
+  // like the above, or read from cache_path what an earlier call baked
+  // from the same sky texels and settings. an empty cache_path bakes every
+  // time.
+  static bool BakeSpecularCached(const IblBakeDesc& desc,
+    const render::Texture& sky, const std::string& cache_path,
+    render::Texture* specular);
+  static bool BakeBrdfLutCached(const IblBakeDesc& desc,
+    const std::string& cache_path, render::Texture* lut);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_IBL_BAKER_H_
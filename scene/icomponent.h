@@ -12,6 +12,8 @@ class Surface;
 }  // namespace render
 
 namespace scene {
+class ComponentCreator;
+
 class IComponent {
  public:
   enum class ComponentType {
@@ -22,6 +24,8 @@ class IComponent {
   };
 
   IComponent();
+  // destroys the child components through the ComponentFactory, defined
+  // with it
   virtual ~IComponent();
   virtual void Initialize() = 0;
   virtual void Update(const math::Matrix4f& local_to_world) = 0;
@@ -30,17 +34,19 @@ class IComponent {
   void SetTransformation(const math::Transformationf& transformation);
   math::Transformationf GetTransformation() const;
   void AddComponent(IComponent* component);
+  const std::list<IComponent*>& GetComponents() const;
 
  protected:
   math::Transformationf transformation_;
   std::list<IComponent*> child_components_;
-};
 
-inline IComponent::IComponent() {}
+ private:
+  friend class ComponentFactory;
 
-inline IComponent::~IComponent() {
-  for (auto component : child_components_) delete component;
-}
+  ComponentCreator* creator_;         // null if not made by the factory
+};
+
+inline IComponent::IComponent() : creator_(nullptr) {}
 
 inline void IComponent::SetTransformation(const math::Transformationf& transformation) {
   transformation_ = transformation;
@@ -53,6 +59,10 @@ inline math::Transformationf IComponent::GetTransformation() const {
 inline void IComponent::AddComponent(IComponent* component) {
   child_components_.push_back(component);
 }
+
+inline const std::list<IComponent*>& IComponent::GetComponents() const {
+  return child_components_;
+}
 }  // namespace scene
 }  // namespace magnet
 #endif  // MAGNET_SCENE_ICOMPONENT_H_
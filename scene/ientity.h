@@ -8,10 +8,15 @@
 
 #include "math/transformation.h"
 
+#include "component_factory.h"
+#include "entity_store.h"
 #include "icomponent.h"
+#include "transform_hierarchy.h"
 
 namespace magnet {
 namespace scene {
+class EntityCreator;
+
 class IEntity {
  public:
   explicit IEntity(const std::string& name);
@@ -25,17 +30,42 @@ class IEntity {
   void AddComponent(IComponent* component);
   std::string GetName() const;
 
+  // an entity whose components were copied into an entity store is drawn
+  // by the systems of the store, its transformation is written through to
+  // its node of the hierarchy
+  void SetStoreEntity(EntityStore* store, EntityId id,
+    TransformHierarchy* hierarchy, TransformNode node);
+  bool IsInStore() const;
+  EntityId GetStoreEntity() const;
+  // the root of the entity's subtree of the hierarchy
+  TransformNode GetTransformNode() const;
+
  protected:
   std::string name_;
   math::Transformationf transformation_;
   std::list<IComponent*> components_;
   std::mutex render_object_mutex_; // lock when update in render thread
+  EntityStore* store_;
+  EntityId store_entity_;
+  TransformHierarchy* hierarchy_;
+  TransformNode transform_node_;
+
+ private:
+  friend class EntityFactory;
+
+  EntityCreator* creator_;            // null if not made by the factory
 };
 
-inline IEntity::IEntity(const std::string& name) : name_(name) {}
+inline IEntity::IEntity(const std::string& name) : name_(name),
+  store_(nullptr),
+  store_entity_(kInvalidEntityId),
+  hierarchy_(nullptr),
+  transform_node_(kInvalidTransformNode),
+  creator_(nullptr) {}
 
 inline IEntity::~IEntity() {
-  for (auto component : components_) delete component;
+  for (auto component : components_)
+    ComponentFactory::GetInstance()->DestroyComponent(component);
 }
 
 inline std::string IEntity::GetName() const {
@@ -44,6 +74,8 @@ inline std::string IEntity::GetName() const {
 
 inline void IEntity::SetTransformation(const math::Transformationf& transformation) {
   transformation_ = transformation;
+  if (hierarchy_ != nullptr)
+    hierarchy_->SetLocal(transform_node_, transformation);
 }
 
 inline const math::Transformationf& IEntity::GetTransformation() const {
@@ -56,6 +88,26 @@ inline void IEntity::AddComponent(IComponent* component) {
 
 inline std::list<IComponent*>& IEntity::GetComponents() { return components_; }
 
+inline void IEntity::SetStoreEntity(EntityStore* store, EntityId id,
+  TransformHierarchy* hierarchy, TransformNode node) {
+  store_ = store;
+  store_entity_ = id;
+  hierarchy_ = hierarchy;
+  transform_node_ = node;
+}
+
+inline bool IEntity::IsInStore() const {
+  return store_ != nullptr;
+}
+
+inline EntityId IEntity::GetStoreEntity() const {
+  return store_entity_;
+}
+
+inline TransformNode IEntity::GetTransformNode() const {
+  return transform_node_;
+}
+
 }  // namespace scene
 }  // namespace magnet
 #endif  // MAGNET_SCENE_IENTITY_H_
@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "core/file_system.h"
+#include "core/hash.h"
+#include "render/mesh.h"
+
+#include "mesh_cache.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+static const char kMagic[4] = { 'M', 'M', 'S', 'H' };
+
+// bump kFormatVersion when the layout below changes and kLoaderVersion when
+// MeshLoader builds different meshes from the same obj
+static const uint32_t kFormatVersion = 1;
+static const uint32_t kLoaderVersion = 1;
+
+static const uint32_t kMaxDecls = 8;
+static const size_t kBlobAlignment = 16;
+
+static_assert(render::MAX_DESC_COUNT <= kMaxDecls,
+  "mesh cache records can not hold all vertex decls");
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t source_key;
+  uint64_t file_size;
+  uint32_t meshes_count;
+  uint32_t material_libraries_count;
+  uint32_t materials_count;
+  uint32_t chars_size;
+  uint64_t meshes_offset;
+  uint64_t strings_offset;    // material libraries, then materials
+  uint64_t chars_offset;
+};
+
+struct StringRecord {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct MeshRecord {
+  StringRecord name;
+  int32_t material;
+  uint32_t decls_count;
+  uint32_t decls[kMaxDecls];
+  uint32_t stride;            // floats per vertex
+  uint32_t verts_count;
+  uint32_t faces_count;
+  uint32_t reserved;
+  float bbox_min[3];
+  float bbox_max[3];
+  uint64_t vertex_offset;
+  uint64_t index_offset;
+};
+
+inline uint64_t Align(uint64_t offset) {
+  return (offset + kBlobAlignment - 1) & ~static_cast<uint64_t>(kBlobAlignment - 1);
+}
+
+StringRecord AddString(const std::string& value, std::string* chars) {
+  StringRecord record;
+  record.offset = static_cast<uint32_t>(chars->size());
+  record.length = static_cast<uint32_t>(value.size());
+  chars->append(value);
+  return record;
+}
+
+// floats of a vertex decl MeshLoader writes, 0 for the others
+uint32_t GetDeclFloatsCount(uint32_t decl) {
+  switch (decl) {
+  case render::POSITION:
+  case render::NORMAL:
+    return 3;
+  case render::UV:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+// the decls are known and add up to the stride
+bool IsLayoutValid(const MeshRecord& record) {
+  if (record.decls_count > render::MAX_DESC_COUNT)
+    return false;
+  uint32_t stride = 0;
+  for (uint32_t decl = 0; decl < record.decls_count; ++decl) {
+    const uint32_t kFloatsCount = GetDeclFloatsCount(record.decls[decl]);
+    if (kFloatsCount == 0)
+      return false;
+    stride += kFloatsCount;
+  }
+  return stride == record.stride;
+}
+
+bool AreIndicesValid(const unsigned int* indices, uint64_t indices_count,
+  uint32_t verts_count) {
+  for (uint64_t i = 0; i < indices_count; ++i) {
+    if (indices[i] >= verts_count)
+      return false;
+  }
+  return true;
+}
+
+bool IsInside(uint64_t offset, uint64_t size, uint64_t file_size) {
+  return offset <= file_size && size <= file_size - offset;
+}
+
+bool ReadString(const StringRecord& record, const char* chars,
+  uint32_t chars_size, std::string* value) {
+  if (!IsInside(record.offset, record.length, chars_size))
+    return false;
+  value->assign(chars + record.offset, record.length);
+  return true;
+}
+
+bool WritePadding(FILE* file, uint64_t* offset) {
+  static const char kZeros[kBlobAlignment] = { 0 };
+  const uint64_t aligned = Align(*offset);
+  const size_t padding = static_cast<size_t>(aligned - *offset);
+  *offset = aligned;
+  return padding == 0 || fwrite(kZeros, 1, padding, file) == padding;
+}
+
+bool WriteBlob(FILE* file, const void* data, size_t size, uint64_t* offset) {
+  *offset += size;
+  return size == 0 || fwrite(data, 1, size, file) == size;
+}
+}  // namespace
+
+uint64_t MeshCache::ComputeSourceKey(const void* source, size_t size) {
+  return core::Hash64(source, size,
+    (static_cast<uint64_t>(kFormatVersion) << 32) | kLoaderVersion);
+}
+
+bool MeshCache::Write(const std::string& path, uint64_t source_key,
+  const MeshCacheData& data) {
+  // layout
+  std::string chars;
+  std::vector<StringRecord> strings;
+  for (const std::string& library : data.material_libraries)
+    strings.push_back(AddString(library, &chars));
+  for (const std::string& material : data.materials)
+    strings.push_back(AddString(material, &chars));
+
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kFormatVersion;
+  header.source_key = source_key;
+  header.meshes_count = static_cast<uint32_t>(data.meshes.size());
+  header.material_libraries_count =
+    static_cast<uint32_t>(data.material_libraries.size());
+  header.materials_count = static_cast<uint32_t>(data.materials.size());
+
+  std::vector<MeshRecord> records(data.meshes.size());
+  for (size_t i = 0; i < data.meshes.size(); ++i) {
+    const render::Mesh& mesh = *data.meshes[i];
+    MeshRecord& record = records[i];
+    memset(&record, 0, sizeof(record));
+
+    record.name = AddString(mesh.GetName(), &chars);
+    record.material = i < data.mesh_materials.size() ?
+      data.mesh_materials[i] : -1;
+
+    int decls_count = 0;
+    render::VertexDecl decls[render::MAX_DESC_COUNT];
+    mesh.GetDecls(&decls_count, decls);
+    record.decls_count = decls_count;
+    for (int decl = 0; decl < decls_count; ++decl)
+      record.decls[decl] = decls[decl];
+
+    record.stride = mesh.GetStride();
+    record.verts_count = mesh.GetVertsCount();
+    record.faces_count = mesh.GetFacesCount();
+
+    const math::AABBf& bbox = mesh.GetBBox();
+    record.bbox_min[0] = bbox.GetMinPoint().x_;
+    record.bbox_min[1] = bbox.GetMinPoint().y_;
+    record.bbox_min[2] = bbox.GetMinPoint().z_;
+    record.bbox_max[0] = bbox.GetMaxPoint().x_;
+    record.bbox_max[1] = bbox.GetMaxPoint().y_;
+    record.bbox_max[2] = bbox.GetMaxPoint().z_;
+  }
+  header.chars_size = static_cast<uint32_t>(chars.size());
+
+  uint64_t offset = sizeof(FileHeader);
+  header.meshes_offset = offset;
+  offset += records.size() * sizeof(MeshRecord);
+  header.strings_offset = offset;
+  offset += strings.size() * sizeof(StringRecord);
+  header.chars_offset = offset;
+  offset += chars.size();
+
+  for (MeshRecord& record : records) {
+    offset = Align(offset);
+    record.vertex_offset = offset;
+    offset += static_cast<uint64_t>(record.verts_count) * record.stride *
+      sizeof(float);
+    offset = Align(offset);
+    record.index_offset = offset;
+    offset += static_cast<uint64_t>(record.faces_count) * 3 *
+      sizeof(unsigned int);
+  }
+  header.file_size = offset;
+
+  // written next to the final file and renamed, a reader never sees a
+  // partially written cache
+  const std::string native_path = core::FileSystem::GetNativePath(path);
+  const std::string temp_path = native_path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr)
+    return false;
+
+  offset = 0;
+  bool written = WriteBlob(file, &header, sizeof(header), &offset) &&
+    WriteBlob(file, records.data(), records.size() * sizeof(MeshRecord),
+      &offset) &&
+    WriteBlob(file, strings.data(), strings.size() * sizeof(StringRecord),
+      &offset) &&
+    WriteBlob(file, chars.data(), chars.size(), &offset);
+
+  for (size_t i = 0; written && i < records.size(); ++i) {
+    const render::Mesh& mesh = *data.meshes[i];
+    const MeshRecord& record = records[i];
+    written = WritePadding(file, &offset) &&
+      WriteBlob(file, mesh.GetVertexDataPtr(), static_cast<size_t>(
+        record.verts_count) * record.stride * sizeof(float), &offset) &&
+      WritePadding(file, &offset) &&
+      WriteBlob(file, mesh.GetIndexDataPtr(), static_cast<size_t>(
+        record.faces_count) * 3 * sizeof(unsigned int), &offset);
+  }
+
+  written = fclose(file) == 0 && written;
+  if (written) {
+    remove(native_path.c_str());
+    written = rename(temp_path.c_str(), native_path.c_str()) == 0;
+  }
+  if (!written)
+    remove(temp_path.c_str());
+
+  return written;
+}
+
+bool MeshCache::Read(const std::string& path, uint64_t source_key,
+  MeshCacheData* data) {
+  core::FileView file;
+  if (!core::FileSystem::Open(path, &file))
+    return false;
+  return Read(file, source_key, data);
+}
+
+bool MeshCache::Read(const core::FileView& file, uint64_t source_key,
+  MeshCacheData* data) {
+  if (!file.IsOpen())
+    return false;
+
+  const char* base = file.GetData();
+  const uint64_t file_size = file.GetSize();
+  if (file_size < sizeof(FileHeader))
+    return false;
+
+  FileHeader header;
+  memcpy(&header, base, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+    header.version != kFormatVersion ||
+    header.source_key != source_key ||
+    header.file_size != file_size) {
+    return false;
+  }
+
+  const uint64_t strings_count = static_cast<uint64_t>(
+    header.material_libraries_count) + header.materials_count;
+  if (!IsInside(header.meshes_offset,
+    static_cast<uint64_t>(header.meshes_count) * sizeof(MeshRecord),
+    file_size) ||
+    !IsInside(header.strings_offset, strings_count * sizeof(StringRecord),
+      file_size) ||
+    !IsInside(header.chars_offset, header.chars_size, file_size)) {
+    return false;
+  }
+
+  const char* chars = base + header.chars_offset;
+  const StringRecord* strings =
+    reinterpret_cast<const StringRecord*>(base + header.strings_offset);
+
+  MeshCacheData result;
+  result.material_libraries.resize(header.material_libraries_count);
+  for (uint32_t i = 0; i < header.material_libraries_count; ++i) {
+    if (!ReadString(strings[i], chars, header.chars_size,
+      &result.material_libraries[i])) {
+      return false;
+    }
+  }
+  result.materials.resize(header.materials_count);
+  for (uint32_t i = 0; i < header.materials_count; ++i) {
+    if (!ReadString(strings[header.material_libraries_count + i], chars,
+      header.chars_size, &result.materials[i])) {
+      return false;
+    }
+  }
+
+  const MeshRecord* records =
+    reinterpret_cast<const MeshRecord*>(base + header.meshes_offset);
+  for (uint32_t i = 0; i < header.meshes_count; ++i) {
+    const MeshRecord& record = records[i];
+    const uint64_t vertex_size =
+      static_cast<uint64_t>(record.verts_count) * record.stride * sizeof(float);
+    const uint64_t index_size =
+      static_cast<uint64_t>(record.faces_count) * 3 * sizeof(unsigned int);
+
+    // a damaged record must not give a mesh whose layout disagrees with
+    // its decls or whose indices point past its vertices
+    std::string name;
+    if (!ReadString(record.name, chars, header.chars_size, &name) ||
+      !IsLayoutValid(record) ||
+      record.vertex_offset % kBlobAlignment != 0 ||
+      record.index_offset % kBlobAlignment != 0 ||
+      !IsInside(record.vertex_offset, vertex_size, file_size) ||
+      !IsInside(record.index_offset, index_size, file_size) ||
+      !AreIndicesValid(
+        reinterpret_cast<const unsigned int*>(base + record.index_offset),
+        static_cast<uint64_t>(record.faces_count) * 3, record.verts_count)) {
+      return false;
+    }
+
+    std::shared_ptr<render::Mesh> mesh = std::make_shared<render::Mesh>(name);
+    for (uint32_t decl = 0; decl < record.decls_count; ++decl)
+      mesh->AddVertexDecl(static_cast<render::VertexDecl>(record.decls[decl]));
+    mesh->SetVertsCount(record.verts_count);
+    mesh->SetFacesCount(record.faces_count);
+    mesh->SetBBox(math::AABBf(
+      math::Vector3f(record.bbox_min[0], record.bbox_min[1], record.bbox_min[2]),
+      math::Vector3f(record.bbox_max[0], record.bbox_max[1], record.bbox_max[2])));
+    if (!mesh->SetExternalData(record.stride, base + record.vertex_offset,
+      base + record.index_offset, file.GetOwner())) {
+      return false;
+    }
+
+    result.meshes.push_back(mesh);
+    result.mesh_materials.push_back(record.material);
+  }
+
+  *data = std::move(result);
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,52 @@
+#ifndef MAGNET_SCENE_MESH_CACHE_H_
+#define MAGNET_SCENE_MESH_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace magnet {
+namespace core {
+class FileView;
+}  // namespace core
+
+namespace render {
+class Mesh;
+}  // namespace render
+
+namespace scene {
+// everything MeshLoader::LoadObj takes from one obj file
+struct MeshCacheData {
+  std::vector<std::shared_ptr<render::Mesh>> meshes;
+  // index into materials of the usemtl the mesh was drawn with, -1 if none
+  std::vector<int> mesh_materials;
+  std::vector<std::string> material_libraries;   // mtllib in file order
+  std::vector<std::string> materials;            // usemtl in file order
+};
+
+// cooked binary meshes. a file holds a header, a table of meshes with
+// their vertex decls, counts, bounds and material, the string table and
+// 16 byte aligned interleaved vertex and index blobs. it is only valid for
+// the source bytes and loader version whose key is stored in the header.
+// reading maps the file, the meshes point into the mapping.
+class MeshCache {
+ public:
+  // hash of the source bytes, seeded with the loader version
+  static uint64_t ComputeSourceKey(const void* source, size_t size);
+
+  static bool Write(const std::string& path, uint64_t source_key,
+    const MeshCacheData& data);
+
+  // fails if the file is missing, damaged or was cooked from other source
+  // bytes or by another loader version
+  static bool Read(const std::string& path, uint64_t source_key,
+    MeshCacheData* data);
+  // the same for a file already read, the meshes keep it alive
+  static bool Read(const core::FileView& file, uint64_t source_key,
+    MeshCacheData* data);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_MESH_CACHE_H_
@@ -47,6 +47,16 @@ void MeshComponent::AddMaterial(std::shared_ptr<render::Material> material) {
   materials_.push_back(material);
 }
 
+const std::vector<std::shared_ptr<render::Mesh>>&
+MeshComponent::GetMeshes() const {
+  return meshes_;
+}
+
+const std::vector<std::shared_ptr<render::Material>>&
+MeshComponent::GetMaterials() const {
+  return materials_;
+}
+
 IComponent::ComponentType MeshComponent::GetType() const {
   return IComponent::ComponentType::MESH;
 }
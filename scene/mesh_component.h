@@ -26,6 +26,8 @@ class MeshComponent : public IComponent {
 
   void AddMesh(std::shared_ptr<render::Mesh> mesh);
   void AddMaterial(std::shared_ptr<render::Material> material);
+  const std::vector<std::shared_ptr<render::Mesh>>& GetMeshes() const;
+  const std::vector<std::shared_ptr<render::Material>>& GetMaterials() const;
   std::string GetName() const;
 
  private:
@@ -0,0 +1,243 @@
+#include <stdlib.h>
+#include <new>
+
+#include "core/allocator.h"
+#include "core/file_system.h"
+#include "core/vertex_weld_map.h"
+#include "render/mesh.h"
+
+#include "mesh_cache.h"
+#include "mesh_loader.h"
+#include "obj_parser.h"
+
+namespace magnet {
+namespace scene {
+bool MeshLoader::LoadObj(const std::string& path, const std::string& name,
+  const std::string& cache_path, int threads_count, MeshCacheData* mesh_data) {
+  core::FileView source;
+  if (!core::FileSystem::Open(path, &source)) {
+    return false;
+  }
+  return LoadObj(source, core::FileView(), name, cache_path, threads_count, mesh_data);
+}
+
+bool MeshLoader::LoadObj(const core::FileView& source,
+  const core::FileView& cache, const std::string& name,
+  const std::string& cache_path, int threads_count, MeshCacheData* mesh_data) {
+  if (!source.IsOpen()) {
+    return false;
+  }
+
+  // the cooked meshes are used as long as the obj bytes did not change
+  const bool kUseCache = !cache_path.empty();
+  const uint64_t kSourceKey = kUseCache ?
+    MeshCache::ComputeSourceKey(source.GetData(), source.GetSize()) : 0;
+  if (kUseCache && (cache.IsOpen() ?
+    MeshCache::Read(cache, kSourceKey, mesh_data) :
+    MeshCache::Read(cache_path, kSourceKey, mesh_data))) {
+    return true;
+  }
+
+  ObjData obj_data;
+  ObjParser::Parse(source.GetData(), source.GetSize(), threads_count,
+    &obj_data);
+  CreateMeshes(name, obj_data, mesh_data);
+
+  if (kUseCache) {
+    MeshCache::Write(cache_path, kSourceKey, *mesh_data);
+  }
+  return true;
+}
+
+std::shared_ptr<render::Mesh> MeshLoader::CreateMesh(
+  const std::string& name, bool has_normal, bool has_uv,
+  const Vertex* vertices, size_t vertices_count,
+  const unsigned int* indices, size_t indices_count) {
+  std::shared_ptr<render::Mesh> mesh = std::make_shared<render::Mesh>(name);
+
+  int floats_count = 0;
+  if (vertices_count > 0) {
+    mesh->AddVertexDecl(render::VertexDecl::POSITION);
+    floats_count += 3;
+  }
+
+  if (has_normal) {
+    mesh->AddVertexDecl(render::VertexDecl::NORMAL);
+    floats_count += 3;
+  }
+
+  if (has_uv) {
+    mesh->AddVertexDecl(render::VertexDecl::UV);
+    floats_count += 2;
+  }
+
+  math::AABBf bbox;
+  float* vertex_data_buffer =
+    mesh->CreateVertexDataBuffer(vertices_count, floats_count);
+  for (size_t i = 0; i < vertices_count; ++i) {
+    const Vertex& vertex = vertices[i];
+    bbox.Update(vertex.position);
+
+    int index = 0;
+    if (vertices_count > 0) {
+      vertex_data_buffer[i * floats_count + index] = vertex.position.x_;
+      vertex_data_buffer[i * floats_count + index + 1] = vertex.position.y_;
+      vertex_data_buffer[i * floats_count + index + 2] = vertex.position.z_;
+
+      index += 3;
+    }
+
+    if (has_normal) {
+      vertex_data_buffer[i * floats_count + index] = vertex.normal.x_;
+      vertex_data_buffer[i * floats_count + index + 1] = vertex.normal.y_;
+      vertex_data_buffer[i * floats_count + index + 2] = vertex.normal.z_;
+
+      index += 3;
+    }
+
+    if (has_uv) {
+      vertex_data_buffer[i * floats_count + index] = vertex.uv.x_;
+      vertex_data_buffer[i * floats_count + index + 1] = vertex.uv.y_;
+
+      index += 2;
+    }
+  }
+  mesh->SetBBox(bbox);
+  mesh->SetVertsCount(vertices_count);
+  mesh->SetFacesCount(indices_count / 3);
+  unsigned int* index_data_buffer =
+    mesh->CreateIndexDataBuffer(indices_count / 3);
+  for (size_t i = 0; i < indices_count; ++i) {
+    index_data_buffer[i] = indices[i];
+  }
+
+  //mesh->CreateVBO();
+  return mesh;
+}
+
+std::shared_ptr<render::Mesh> MeshLoader::CreateMesh(
+  const std::string& name, const ObjData& obj_data, size_t face_begin,
+  size_t face_end, core::Allocator* allocator) {
+  const int kPositionsCount = static_cast<int>(obj_data.positions.size());
+  const int kUvsCount = static_cast<int>(obj_data.uvs.size());
+  const int kNormalsCount = static_cast<int>(obj_data.normals.size());
+
+  // every face vertex may be unique, the weld map never has to grow
+  const size_t kFaceVerticesCount = face_end - face_begin;
+  Vertex* vertices = static_cast<Vertex*>(allocator->Allocate(
+    kFaceVerticesCount * sizeof(Vertex), alignof(Vertex)));
+  unsigned int* indices = static_cast<unsigned int*>(allocator->Allocate(
+    kFaceVerticesCount * sizeof(unsigned int), alignof(unsigned int)));
+  if (vertices == nullptr || indices == nullptr) {
+    abort();
+  }
+  size_t vertices_count = 0;
+  size_t indices_count = 0;
+  core::VertexWeldMap weld_map(kFaceVerticesCount);
+
+  for (size_t face = face_begin; face + 3 <= face_end; face += 3) {
+    const ObjIndex* triangle = &obj_data.face_vertices[face];
+
+    // faces referencing positions that do not exist are dropped
+    if (triangle[0].position < 0 || triangle[0].position >= kPositionsCount ||
+      triangle[1].position < 0 || triangle[1].position >= kPositionsCount ||
+      triangle[2].position < 0 || triangle[2].position >= kPositionsCount) {
+      continue;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+      const int index_position = triangle[i].position;
+      const int index_uv =
+        triangle[i].uv < kUvsCount ? triangle[i].uv : -1;
+      const int index_normal =
+        triangle[i].normal < kNormalsCount ? triangle[i].normal : -1;
+
+      bool inserted;
+      const unsigned int vertex_index = weld_map.FindOrInsert(index_position,
+        index_uv, index_normal, static_cast<unsigned int>(vertices_count),
+        &inserted);
+      indices[indices_count++] = vertex_index;
+
+      if (inserted) {
+        Vertex* vertex = new (&vertices[vertices_count++]) Vertex;
+        vertex->position = obj_data.positions[index_position];
+        if (index_uv >= 0)
+          vertex->uv = obj_data.uvs[index_uv];
+        if (index_normal >= 0)
+          vertex->normal = obj_data.normals[index_normal];
+      }
+    }
+  }
+
+  std::shared_ptr<render::Mesh> mesh = CreateMesh(name, kNormalsCount > 0,
+    kUvsCount > 0, vertices, vertices_count, indices, indices_count);
+  allocator->Free(indices);
+  allocator->Free(vertices);
+  return mesh;
+}
+
+void MeshLoader::CreateMeshes(const std::string& name,
+  const ObjData& obj_data, MeshCacheData* mesh_data) {
+  // a mesh is created when vertices follow faces, when the material changes
+  // after faces and at the end of the file. it is named after the object its
+  // first face belongs to, further pieces of the same object get a suffix.
+  std::string object_name(name);
+  std::string mesh_name(name);
+  int object_pieces_count = 0;
+  int material_index = -1;
+  size_t face_begin = 0;
+  // scratch of one mesh at a time, the blocks are kept for the next one
+  core::LinearArena arena(core::MEMORY_TAG_MESH, 1 << 20);
+
+  auto create_mesh = [&](size_t face_end) {
+    if (face_end <= face_begin) return;
+
+    std::string piece_name(mesh_name);
+    if (object_pieces_count > 0) {
+      piece_name += "_" + std::to_string(object_pieces_count);
+    }
+    ++object_pieces_count;
+
+    mesh_data->meshes.push_back(
+      CreateMesh(piece_name, obj_data, face_begin, face_end, &arena));
+    arena.Reset();
+    mesh_data->mesh_materials.push_back(material_index);
+
+    face_begin = face_end;
+    if (mesh_name != object_name) {
+      mesh_name = object_name;
+      object_pieces_count = 0;
+    }
+  };
+
+  for (const ObjEvent& event : obj_data.events) {
+    switch (event.type) {
+    case ObjEvent::OBJECT:
+      // an object name does not end a mesh
+      object_name = event.name;
+      if (event.face_offset == face_begin && mesh_name != object_name) {
+        mesh_name = object_name;
+        object_pieces_count = 0;
+      }
+      break;
+    case ObjEvent::GROUP:
+      break;
+    case ObjEvent::VERTICES:
+      create_mesh(event.face_offset);
+      break;
+    case ObjEvent::USE_MATERIAL:
+      create_mesh(event.face_offset);
+      material_index = static_cast<int>(mesh_data->materials.size());
+      mesh_data->materials.push_back(event.name);
+      break;
+    case ObjEvent::MATERIAL_LIBRARY:
+      mesh_data->material_libraries.push_back(event.name);
+      break;
+    }
+  }
+
+  // faces to file end
+  create_mesh(obj_data.face_vertices.size());
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,65 @@
+#ifndef MAGNET_SCENE_MESH_LOADER_H_
+#define MAGNET_SCENE_MESH_LOADER_H_
+
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "math/vector2.h"
+#include "math/vector3.h"
+
+namespace magnet {
+namespace core {
+class FileView;
+class Allocator;
+}  // namespace core
+
+namespace render {
+class Mesh;
+}  // namespace render
+
+namespace scene {
+struct MeshCacheData;
+struct ObjData;
+
+struct Vertex {
+  math::Vector3f position;
+  math::Vector3f normal;
+  math::Vector2f uv;
+};
+
+// builds render meshes from obj files. nothing here touches shared state,
+// loads of different files may run on any thread at the same time.
+class MeshLoader {
+ public:
+  // reads the cooked meshes at cache_path if they were cooked from the
+  // current bytes of the obj, otherwise parses the obj and writes them.
+  // an empty cache_path skips the cache. threads_count is passed to
+  // ObjParser.
+  static bool LoadObj(const std::string& path, const std::string& name,
+    const std::string& cache_path, int threads_count,
+    MeshCacheData* mesh_data);
+  // the same with the obj and maybe the cache file already read. a cache
+  // view that is not open is read from cache_path.
+  static bool LoadObj(const core::FileView& source, const core::FileView& cache,
+    const std::string& name, const std::string& cache_path, int threads_count,
+    MeshCacheData* mesh_data);
+
+  // splits the faces of an obj into meshes named after name and the objects
+  static void CreateMeshes(const std::string& name, const ObjData& obj_data,
+    MeshCacheData* mesh_data);
+
+  static std::shared_ptr<render::Mesh> CreateMesh(
+    const std::string& name, bool has_normal, bool has_uv,
+    const Vertex* vertices, size_t vertices_count,
+    const unsigned int* indices, size_t indices_count);
+  // the vertices and indices before welding are scratch from allocator,
+  // freed once the mesh is created. CreateMeshes passes an arena.
+  static std::shared_ptr<render::Mesh> CreateMesh(const std::string& name,
+    const ObjData& obj_data, size_t face_begin, size_t face_end,
+    core::Allocator* allocator);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_MESH_LOADER_H_
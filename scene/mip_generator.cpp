@@ -0,0 +1,333 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "core/half.h"
+#include "core/parallel_for.h"
+#include "core/simd.h"
+#include "render/texture.h"
+
+#include "mip_generator.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+// levels smaller than this are not worth a thread
+static const size_t kMinPixelsPerThread = 64 * 1024;
+
+static const float kKaiserRadius = 3.f;   // in texels of the smaller level
+static const float kKaiserAlpha = 4.f;
+
+static const int kEncodeTableSize = 65536;
+
+float g_srgb_to_linear[256];
+uint8_t g_linear_to_srgb[kEncodeTableSize];
+std::once_flag g_tables_initialized;
+
+void InitializeTables() {
+  for (int i = 0; i < 256; ++i) {
+    const float kValue = i / 255.f;
+    g_srgb_to_linear[i] = kValue <= 0.04045f ? kValue / 12.92f :
+      powf((kValue + 0.055f) / 1.055f, 2.4f);
+  }
+  for (int i = 0; i < kEncodeTableSize; ++i) {
+    const float kValue = static_cast<float>(i) / (kEncodeTableSize - 1);
+    const float kEncoded = kValue <= 0.0031308f ? kValue * 12.92f :
+      1.055f * powf(kValue, 1.f / 2.4f) - 0.055f;
+    g_linear_to_srgb[i] = static_cast<uint8_t>(kEncoded * 255.f + 0.5f);
+  }
+}
+
+enum PixelFormat {
+  PIXEL_FORMAT_UNORM8,
+  PIXEL_FORMAT_SRGB8,
+  PIXEL_FORMAT_FLOAT16,
+  PIXEL_FORMAT_FLOAT32
+};
+
+// texels of the smaller level are weighted sums of taps_count texels of the
+// larger one along an axis, indices clamped to the edge
+struct FilterTaps {
+  int taps_count;
+  std::vector<int> indices;
+  std::vector<float> weights;
+};
+
+float BesselI0(float x) {
+  float sum = 1.f;
+  float term = 1.f;
+  for (int k = 1; k < 32; ++k) {
+    term *= (x * 0.5f / k) * (x * 0.5f / k);
+    sum += term;
+    if (term < sum * 1e-7f)
+      break;
+  }
+  return sum;
+}
+
+float Kaiser(float x) {
+  const float kT = x / kKaiserRadius;
+  if (kT <= -1.f || kT >= 1.f)
+    return 0.f;
+  const float kSincX = 3.14159265f * x;
+  const float kSinc = fabsf(x) < 1e-5f ? 1.f : sinf(kSincX) / kSincX;
+  return kSinc * BesselI0(kKaiserAlpha * sqrtf(1.f - kT * kT)) /
+    BesselI0(kKaiserAlpha);
+}
+
+void ComputeTaps(MipFilter filter, int src_size, int dst_size,
+  FilterTaps* taps) {
+  const float kScale = static_cast<float>(src_size) / dst_size;
+  const float kHalfWidth = filter == MIP_FILTER_KAISER ?
+    kKaiserRadius * kScale : 0.5f * kScale;
+  taps->taps_count = static_cast<int>(ceilf(2.f * kHalfWidth)) + 1;
+  taps->indices.assign(static_cast<size_t>(dst_size) * taps->taps_count, 0);
+  taps->weights.assign(taps->indices.size(), 0.f);
+
+  for (int d = 0; d < dst_size; ++d) {
+    const float kCenter = (d + 0.5f) * kScale;
+    const int kFirst = static_cast<int>(floorf(kCenter - kHalfWidth));
+    int* indices = &taps->indices[d * taps->taps_count];
+    float* weights = &taps->weights[d * taps->taps_count];
+    float sum = 0.f;
+    for (int t = 0; t < taps->taps_count; ++t) {
+      const int kIndex = kFirst + t;
+      float weight;
+      if (filter == MIP_FILTER_KAISER) {
+        weight = Kaiser((kIndex + 0.5f - kCenter) / kScale);
+      }
+      else {
+        // how much of the source texel the box covers
+        const float kLow = std::max<float>(kIndex, kCenter - kHalfWidth);
+        const float kHigh = std::min<float>(kIndex + 1.f, kCenter + kHalfWidth);
+        weight = std::max(0.f, kHigh - kLow);
+      }
+      indices[t] = std::min(std::max(kIndex, 0), src_size - 1);
+      weights[t] = weight;
+      sum += weight;
+    }
+    for (int t = 0; t < taps->taps_count; ++t)
+      weights[t] /= sum;
+  }
+}
+
+// dst = sum of weights[t] * texel(indices[t]), texels are 4 floats
+// stride floats apart
+inline void FilterTexel(const float* src, size_t stride, const int* indices,
+  const float* weights, int taps_count, float* dst) {
+#ifdef MAGNET_SSE2
+  __m128 sum = _mm_setzero_ps();
+  for (int t = 0; t < taps_count; ++t) {
+    const __m128 kTexel = _mm_loadu_ps(src + indices[t] * stride);
+    sum = _mm_add_ps(sum, _mm_mul_ps(kTexel, _mm_set1_ps(weights[t])));
+  }
+  _mm_storeu_ps(dst, sum);
+#else
+  float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+  for (int t = 0; t < taps_count; ++t) {
+    const float* texel = src + indices[t] * stride;
+    for (int c = 0; c < 4; ++c)
+      sum[c] += texel[c] * weights[t];
+  }
+  memcpy(dst, sum, sizeof(sum));
+#endif  // MAGNET_SSE2
+}
+
+void Downsample(MipFilter filter, const std::vector<float>& src, int src_width,
+  int src_height, int dst_width, int dst_height, int threads_count,
+  std::vector<float>* dst) {
+  FilterTaps horizontal;
+  FilterTaps vertical;
+  ComputeTaps(filter, src_width, dst_width, &horizontal);
+  ComputeTaps(filter, src_height, dst_height, &vertical);
+
+  // rows first, then columns of the narrowed rows
+  std::vector<float> rows(static_cast<size_t>(dst_width) * src_height * 4);
+  core::ParallelFor(src_height, core::GetParallelThreadsCount(rows.size() / 4,
+    kMinPixelsPerThread, threads_count), [&](int begin, int end) {
+    for (int y = begin; y < end; ++y) {
+      const float* src_row = &src[static_cast<size_t>(y) * src_width * 4];
+      float* dst_row = &rows[static_cast<size_t>(y) * dst_width * 4];
+      for (int x = 0; x < dst_width; ++x) {
+        FilterTexel(src_row, 4, &horizontal.indices[x * horizontal.taps_count],
+          &horizontal.weights[x * horizontal.taps_count],
+          horizontal.taps_count, dst_row + x * 4);
+      }
+    }
+  });
+
+  dst->resize(static_cast<size_t>(dst_width) * dst_height * 4);
+  const size_t kRowStride = static_cast<size_t>(dst_width) * 4;
+  core::ParallelFor(dst_height, core::GetParallelThreadsCount(dst->size() / 4,
+    kMinPixelsPerThread, threads_count), [&](int begin, int end) {
+    for (int y = begin; y < end; ++y) {
+      const int* indices = &vertical.indices[y * vertical.taps_count];
+      const float* weights = &vertical.weights[y * vertical.taps_count];
+      float* dst_row = &(*dst)[y * kRowStride];
+      for (int x = 0; x < dst_width; ++x) {
+        FilterTexel(&rows[x * 4], kRowStride, indices, weights,
+          vertical.taps_count, dst_row + x * 4);
+      }
+    }
+  });
+}
+
+void Decode(PixelFormat format, const void* data, size_t pixels_count,
+  std::vector<float>* texels) {
+  texels->resize(pixels_count * 4);
+  if (format == PIXEL_FORMAT_FLOAT32) {
+    memcpy(texels->data(), data, pixels_count * 16);
+    return;
+  }
+  if (format == PIXEL_FORMAT_FLOAT16) {
+    core::HalfToFloat(static_cast<const uint16_t*>(data), pixels_count * 4,
+      texels->data());
+    return;
+  }
+
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  float* texel = texels->data();
+  for (size_t i = 0; i < pixels_count * 4; i += 4) {
+    for (int c = 0; c < 3; ++c) {
+      texel[i + c] = format == PIXEL_FORMAT_SRGB8 ?
+        g_srgb_to_linear[bytes[i + c]] : bytes[i + c] / 255.f;
+    }
+    texel[i + 3] = bytes[i + 3] / 255.f;
+  }
+}
+
+void Encode(PixelFormat format, const std::vector<float>& texels,
+  void* data) {
+  const size_t kCount = texels.size();
+  if (format == PIXEL_FORMAT_FLOAT32) {
+    // kaiser rings below zero next to bright texels
+    float* values = static_cast<float*>(data);
+    for (size_t i = 0; i < kCount; ++i)
+      values[i] = std::max(texels[i], 0.f);
+    return;
+  }
+  if (format == PIXEL_FORMAT_FLOAT16) {
+    std::vector<float> values(kCount);
+    for (size_t i = 0; i < kCount; ++i)
+      values[i] = std::max(texels[i], 0.f);
+    core::FloatToHalf(values.data(), kCount, static_cast<uint16_t*>(data));
+    return;
+  }
+
+  uint8_t* bytes = static_cast<uint8_t*>(data);
+  size_t i = 0;
+#ifdef MAGNET_SSE2
+  if (format == PIXEL_FORMAT_UNORM8) {
+    const __m128 kZero = _mm_setzero_ps();
+    const __m128 kOne = _mm_set1_ps(1.f);
+    const __m128 kScale = _mm_set1_ps(255.f);
+    for (; i + 16 <= kCount; i += 16) {
+      __m128i values[4];
+      for (int k = 0; k < 4; ++k) {
+        __m128 value = _mm_loadu_ps(&texels[i + k * 4]);
+        value = _mm_min_ps(_mm_max_ps(value, kZero), kOne);
+        values[k] = _mm_cvtps_epi32(_mm_mul_ps(value, kScale));
+      }
+      const __m128i kPacked = _mm_packus_epi16(
+        _mm_packs_epi32(values[0], values[1]),
+        _mm_packs_epi32(values[2], values[3]));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i), kPacked);
+    }
+  }
+#endif  // MAGNET_SSE2
+  for (; i < kCount; i += 4) {
+    for (int c = 0; c < 4; ++c) {
+      const float kValue = std::min(std::max(texels[i + c], 0.f), 1.f);
+      if (c < 3 && format == PIXEL_FORMAT_SRGB8) {
+        bytes[i + c] = g_linear_to_srgb[
+          static_cast<int>(kValue * (kEncodeTableSize - 1) + 0.5f)];
+      }
+      else {
+        bytes[i + c] = static_cast<uint8_t>(kValue * 255.f + 0.5f);
+      }
+    }
+  }
+}
+
+bool GetPixelFormat(render::TextureFormat format, bool srgb,
+  PixelFormat* pixel_format) {
+  switch (format) {
+  case render::TEXTURE_FORMAT_R8G8B8A8_UINT:
+    *pixel_format = PIXEL_FORMAT_UNORM8;
+    return true;
+  case render::TEXTURE_FORMAT_R8G8B8A8_UNORM:
+  case render::TEXTURE_FORMAT_B8G8R8A8_UNORM:
+    *pixel_format = srgb ? PIXEL_FORMAT_SRGB8 : PIXEL_FORMAT_UNORM8;
+    return true;
+  case render::TEXTURE_FORMAT_R8G8B8A8_UNORM_SRGB:
+    *pixel_format = PIXEL_FORMAT_SRGB8;
+    return true;
+  case render::TEXTURE_FORMAT_R16G16B16A16_FLOAT:
+    *pixel_format = PIXEL_FORMAT_FLOAT16;
+    return true;
+  case render::TEXTURE_FORMAT_R32G32B32A32_FLOAT:
+    *pixel_format = PIXEL_FORMAT_FLOAT32;
+    return true;
+  default:
+    return false;
+  }
+}
+}  // namespace
+
+bool MipGenerator::CanGenerate(const render::Texture& texture) {
+  PixelFormat pixel_format;
+  return texture.GetMipLevels() == 1 && texture.GetDataBufferPtr() &&
+    (texture.GetWidth() > 1 || texture.GetHeight() > 1) &&
+    GetPixelFormat(texture.GetFormat(), false, &pixel_format);
+}
+
+bool MipGenerator::Generate(const MipGeneratorDesc& desc,
+  render::Texture* texture) {
+  if (desc.filter == MIP_FILTER_NONE || !CanGenerate(*texture))
+    return false;
+
+  PixelFormat pixel_format = PIXEL_FORMAT_UNORM8;
+  GetPixelFormat(texture->GetFormat(), desc.srgb, &pixel_format);
+  std::call_once(g_tables_initialized, InitializeTables);
+
+  // the top levels move into a buffer with room for the chains
+  const int kFacesCount =
+    texture->GetType() == render::TEXTURE_TYPE_CUBE ? 6 : 1;
+  const size_t kTopSize = texture->GetFaceSize();
+  std::vector<uint8_t> top_levels(kTopSize * kFacesCount);
+  memcpy(top_levels.data(), texture->GetDataBufferPtr(), top_levels.size());
+
+  const int kWidth = texture->GetWidth();
+  const int kHeight = texture->GetHeight();
+  int mip_levels = 1;
+  while ((kWidth | kHeight) >> mip_levels)
+    ++mip_levels;
+  texture->DestroyDataBuffer();
+  texture->SetMipLevels(mip_levels);
+  uint8_t* data = static_cast<uint8_t*>(texture->CreateDataBuffer());
+  if (data == nullptr)
+    return false;
+
+  std::vector<float> level;
+  std::vector<float> next_level;
+  for (int face = 0; face < kFacesCount; ++face) {
+    uint8_t* face_data = data + face * texture->GetFaceSize();
+    memcpy(face_data, &top_levels[face * kTopSize], kTopSize);
+    Decode(pixel_format, face_data, static_cast<size_t>(kWidth) * kHeight,
+      &level);
+
+    for (int i = 1; i < mip_levels; ++i) {
+      Downsample(desc.filter, level, texture->GetMipWidth(i - 1),
+        texture->GetMipHeight(i - 1), texture->GetMipWidth(i),
+        texture->GetMipHeight(i), desc.threads_count, &next_level);
+      Encode(pixel_format, next_level, face_data + texture->GetMipOffset(i));
+      level.swap(next_level);
+    }
+  }
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
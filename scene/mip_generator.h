@@ -0,0 +1,35 @@
+#ifndef MAGNET_SCENE_MIP_GENERATOR_H_
+#define MAGNET_SCENE_MIP_GENERATOR_H_
+
+namespace magnet {
+namespace render {
+class Texture;
+}  // namespace render
+
+namespace scene {
+enum MipFilter {
+  MIP_FILTER_NONE,
+  MIP_FILTER_BOX,       // average of the texels a level texel covers
+  MIP_FILTER_KAISER     // kaiser windowed sinc, sharper, a little ringing
+};
+
+struct MipGeneratorDesc {
+  MipGeneratorDesc() : filter(MIP_FILTER_BOX), srgb(true), threads_count(0) {}
+  MipFilter filter;
+  bool srgb;            // 8 bit unorm colors are srgb, _SRGB formats always
+  int threads_count;    // 0 for all cores
+};
+
+// builds the full mip chain of uncompressed 2d and cube textures that have
+// only their top level. every level is filtered down from the previous one
+// kept in linear float, so rounding does not add up along the chain. the
+// separable filter passes run on sse2 and large levels are split in row
+// bands over threads.
+class MipGenerator {
+ public:
+  static bool CanGenerate(const render::Texture& texture);
+  static bool Generate(const MipGeneratorDesc& desc, render::Texture* texture);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_MIP_GENERATOR_H_
@@ -0,0 +1,53 @@
+#include <string.h>
+#include <sstream>
+
+#include "core/file_system.h"
+
+#include "mtl_parser.h"
+
+namespace magnet {
+namespace scene {
+bool MtlParser::ParseFile(const std::string& path,
+  std::vector<MtlMaterial>* materials) {
+  core::FileView file;
+  if (!core::FileSystem::Open(path, &file)) return false;
+  Parse(file.GetData(), file.GetSize(), materials);
+  return true;
+}
+
+void MtlParser::Parse(const char* data, size_t size,
+  std::vector<MtlMaterial>* materials) {
+  std::istringstream material_filestream(std::string(data, size));
+
+  // statements in front of the first newmtl are ignored
+  MtlMaterial* material = nullptr;
+  char word[256];
+
+  while (1) {
+    material_filestream >> word;
+
+    if (!material_filestream) break;
+
+    if (strcmp(word, "newmtl") == 0) {
+      materials->push_back(MtlMaterial());
+      material = &materials->back();
+      material_filestream >> material->name;
+    }
+    else if (material == nullptr) {
+    }
+    else if (strcmp(word, "Kd") == 0) {
+      float r, g, b;
+      material_filestream >> r >> g >> b;
+      material->base_color = math::Vector3f(r, g, b);
+      material->has_color = true;
+    }
+    else if (strcmp(word, "map_Kd") == 0) {
+      material_filestream >> word;
+      material->texture_name = std::string(word);
+    }
+
+    material_filestream.ignore(256, '\n');
+  }
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,31 @@
+#ifndef MAGNET_SCENE_MTL_PARSER_H_
+#define MAGNET_SCENE_MTL_PARSER_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "math/vector3.h"
+
+namespace magnet {
+namespace scene {
+// one newmtl block of a material library
+struct MtlMaterial {
+  MtlMaterial() : has_color(false) {}
+  std::string name;
+  math::Vector3f base_color;    // Kd
+  std::string texture_name;     // map_Kd, empty if none
+  bool has_color;
+};
+
+// reads the materials of an obj material library, in file order
+class MtlParser {
+ public:
+  static bool ParseFile(const std::string& path,
+    std::vector<MtlMaterial>* materials);
+  static void Parse(const char* data, size_t size,
+    std::vector<MtlMaterial>* materials);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_MTL_PARSER_H_
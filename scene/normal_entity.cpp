@@ -13,6 +13,10 @@ void NormalEntity::Initialize() {
 }
 
 void NormalEntity::Update() {
+  // SceneManager::UpdateEntities draws it from the store
+  if (store_ != nullptr)
+    return;
+
   std::lock_guard<std::mutex> lock(render_object_mutex_);
   for (auto component : components_)
     component->Update(transformation_.ToMatrix());
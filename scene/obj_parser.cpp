@@ -0,0 +1,329 @@
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "core/file_system.h"
+#include "core/number_parser.h"
+
+#include "obj_parser.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+// smaller inputs are not worth a thread
+static const size_t kMinChunkSize = 256 * 1024;
+
+// face vertex components that are relative to the vertex count at the start
+// of the chunk and are fixed up when the chunks are concatenated
+enum RelativeFlags {
+  RELATIVE_POSITION = 1,
+  RELATIVE_UV = 2,
+  RELATIVE_NORMAL = 4
+};
+
+struct ObjChunk {
+  std::vector<math::Vector3f> positions;
+  std::vector<math::Vector2f> uvs;
+  std::vector<math::Vector3f> normals;
+  std::vector<ObjIndex> face_vertices;
+  std::vector<ObjEvent> events;
+
+  // face vertex index and RelativeFlags
+  std::vector<std::pair<size_t, int>> relative_face_vertices;
+};
+
+inline bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* SkipSpaces(const char* p, const char* end) {
+  while (p < end && IsSpace(*p))
+    ++p;
+  return p;
+}
+
+inline const char* SkipWord(const char* p, const char* end) {
+  while (p < end && !IsSpace(*p))
+    ++p;
+  return p;
+}
+
+inline bool IsKeyword(const char* begin, const char* end,
+  const char* keyword, size_t keyword_length) {
+  return static_cast<size_t>(end - begin) == keyword_length &&
+    memcmp(begin, keyword, keyword_length) == 0;
+}
+
+// first word of the rest of the line, like the stream based parser did
+inline std::string ParseName(const char* p, const char* end) {
+  p = SkipSpaces(p, end);
+  return std::string(p, SkipWord(p, end));
+}
+
+// obj indices are one based, negative ones count back from the last element
+inline int ResolveIndex(int value, size_t local_count, int relative_flag,
+  int* flags) {
+  if (value > 0)
+    return value - 1;
+  if (value < 0) {
+    *flags |= relative_flag;
+    return static_cast<int>(local_count) + value;
+  }
+  return -1;
+}
+
+void ParseFace(const char* p, const char* end, ObjChunk* chunk,
+  std::vector<ObjIndex>* polygon, std::vector<int>* polygon_flags) {
+  polygon->clear();
+  polygon_flags->clear();
+
+  while (true) {
+    p = SkipSpaces(p, end);
+    if (p >= end)
+      break;
+
+    ObjIndex index = { -1, -1, -1 };
+    int flags = 0;
+    int value = 0;
+
+    const char* next = core::ParseInt(p, end, &value);
+    if (next == p)
+      break;
+    p = next;
+    index.position = ResolveIndex(value, chunk->positions.size(),
+      RELATIVE_POSITION, &flags);
+
+    if (p < end && *p == '/') {
+      ++p;
+      next = core::ParseInt(p, end, &value);
+      if (next != p) {
+        index.uv = ResolveIndex(value, chunk->uvs.size(), RELATIVE_UV, &flags);
+        p = next;
+      }
+
+      if (p < end && *p == '/') {
+        ++p;
+        next = core::ParseInt(p, end, &value);
+        if (next != p) {
+          index.normal = ResolveIndex(value, chunk->normals.size(),
+            RELATIVE_NORMAL, &flags);
+          p = next;
+        }
+      }
+    }
+
+    // skip anything else glued to the index
+    p = SkipWord(p, end);
+
+    polygon->push_back(index);
+    polygon_flags->push_back(flags);
+  }
+
+  // triangle fan around the first vertex
+  for (size_t i = 2; i < polygon->size(); ++i) {
+    const size_t corners[3] = { 0, i - 1, i };
+    for (size_t corner : corners) {
+      if ((*polygon_flags)[corner]) {
+        chunk->relative_face_vertices.push_back(std::make_pair(
+          chunk->face_vertices.size(), (*polygon_flags)[corner]));
+      }
+      chunk->face_vertices.push_back((*polygon)[corner]);
+    }
+  }
+}
+
+void AddEvent(ObjChunk* chunk, ObjEvent::Type type, const std::string& name) {
+  ObjEvent event;
+  event.type = type;
+  event.face_offset = chunk->face_vertices.size();
+  event.name = name;
+  chunk->events.push_back(event);
+}
+
+void ParseChunk(const char* begin, const char* end, ObjChunk* chunk) {
+  std::vector<ObjIndex> polygon;
+  std::vector<int> polygon_flags;
+
+  // the chunk may start in the middle of a vertex block whose faces are in
+  // the previous chunk, so the first v is always reported
+  bool faces_since_vertices = true;
+
+  const char* line = begin;
+  while (line < end) {
+    const char* line_end = static_cast<const char*>(
+      memchr(line, '\n', end - line));
+    if (line_end == nullptr)
+      line_end = end;
+
+    const char* p = SkipSpaces(line, line_end);
+    const char* keyword_end = SkipWord(p, line_end);
+
+    if (keyword_end - p == 1 && *p == 'v') {
+      if (faces_since_vertices) {
+        AddEvent(chunk, ObjEvent::VERTICES, std::string());
+        faces_since_vertices = false;
+      }
+
+      float xyz[3] = { 0.f, 0.f, 0.f };
+      core::ParseFloats(keyword_end, line_end, xyz, 3);
+      chunk->positions.push_back(math::Vector3f(xyz[0], xyz[1], xyz[2]));
+    }
+    else if (IsKeyword(p, keyword_end, "vt", 2)) {
+      float uv[2] = { 0.f, 0.f };
+      core::ParseFloats(keyword_end, line_end, uv, 2);
+      chunk->uvs.push_back(math::Vector2f(uv[0], 1 - uv[1]));
+    }
+    else if (IsKeyword(p, keyword_end, "vn", 2)) {
+      float xyz[3] = { 0.f, 0.f, 0.f };
+      core::ParseFloats(keyword_end, line_end, xyz, 3);
+      chunk->normals.push_back(math::Vector3f(xyz[0], xyz[1], xyz[2]));
+    }
+    else if (keyword_end - p == 1 && *p == 'f') {
+      faces_since_vertices = true;
+      ParseFace(keyword_end, line_end, chunk, &polygon, &polygon_flags);
+    }
+    else if (keyword_end - p == 1 && *p == 'o') {
+      AddEvent(chunk, ObjEvent::OBJECT, ParseName(keyword_end, line_end));
+    }
+    else if (keyword_end - p == 1 && *p == 'g') {
+      AddEvent(chunk, ObjEvent::GROUP, ParseName(keyword_end, line_end));
+    }
+    else if (IsKeyword(p, keyword_end, "usemtl", 6)) {
+      AddEvent(chunk, ObjEvent::USE_MATERIAL,
+        ParseName(keyword_end, line_end));
+    }
+    else if (IsKeyword(p, keyword_end, "mtllib", 6)) {
+      AddEvent(chunk, ObjEvent::MATERIAL_LIBRARY,
+        ParseName(keyword_end, line_end));
+    }
+
+    line = line_end + 1;
+  }
+}
+
+// copies a chunk to its place in the output and turns its relative indices
+// into absolute ones
+void MergeChunk(const ObjChunk& chunk, const ObjIndex& base,
+  size_t face_base, ObjData* obj_data) {
+  std::copy(chunk.positions.begin(), chunk.positions.end(),
+    obj_data->positions.begin() + base.position);
+  std::copy(chunk.uvs.begin(), chunk.uvs.end(),
+    obj_data->uvs.begin() + base.uv);
+  std::copy(chunk.normals.begin(), chunk.normals.end(),
+    obj_data->normals.begin() + base.normal);
+
+  ObjIndex* face_vertices = obj_data->face_vertices.data() + face_base;
+  std::copy(chunk.face_vertices.begin(), chunk.face_vertices.end(),
+    face_vertices);
+
+  for (const std::pair<size_t, int>& relative : chunk.relative_face_vertices) {
+    ObjIndex& index = face_vertices[relative.first];
+    if (relative.second & RELATIVE_POSITION)
+      index.position += base.position;
+    if (relative.second & RELATIVE_UV)
+      index.uv += base.uv;
+    if (relative.second & RELATIVE_NORMAL)
+      index.normal += base.normal;
+  }
+}
+
+int GetThreadsCount(size_t size, int threads_count) {
+  if (threads_count <= 0) {
+    threads_count = static_cast<int>(std::thread::hardware_concurrency());
+    if (threads_count <= 0)
+      threads_count = 1;
+  }
+
+  const size_t max_threads_count = std::max<size_t>(1, size / kMinChunkSize);
+  return static_cast<int>(std::min<size_t>(threads_count, max_threads_count));
+}
+}  // namespace
+
+void ObjParser::Parse(const char* data, size_t size, int threads_count,
+  ObjData* obj_data) {
+  *obj_data = ObjData();
+  if (data == nullptr || size == 0)
+    return;
+
+  threads_count = GetThreadsCount(size, threads_count);
+
+  // chunk boundaries are moved to the start of the next line
+  std::vector<const char*> boundaries(threads_count + 1);
+  boundaries[0] = data;
+  boundaries[threads_count] = data + size;
+  for (int i = 1; i < threads_count; ++i) {
+    const char* p = std::max(boundaries[i - 1], data + size * i / threads_count);
+    const char* line_end = static_cast<const char*>(
+      memchr(p, '\n', data + size - p));
+    boundaries[i] = line_end ? line_end + 1 : data + size;
+  }
+
+  std::vector<ObjChunk> chunks(threads_count);
+  if (threads_count == 1) {
+    ParseChunk(boundaries[0], boundaries[1], &chunks[0]);
+  }
+  else {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threads_count; ++i) {
+      threads.emplace_back(ParseChunk, boundaries[i], boundaries[i + 1],
+        &chunks[i]);
+    }
+    for (std::thread& thread : threads)
+      thread.join();
+  }
+
+  // offsets of every chunk in the concatenated arrays
+  std::vector<ObjIndex> bases(threads_count);
+  std::vector<size_t> face_bases(threads_count);
+  ObjIndex total = { 0, 0, 0 };
+  size_t faces_total = 0;
+  size_t events_total = 0;
+  for (int i = 0; i < threads_count; ++i) {
+    bases[i] = total;
+    face_bases[i] = faces_total;
+    total.position += static_cast<int>(chunks[i].positions.size());
+    total.uv += static_cast<int>(chunks[i].uvs.size());
+    total.normal += static_cast<int>(chunks[i].normals.size());
+    faces_total += chunks[i].face_vertices.size();
+    events_total += chunks[i].events.size();
+  }
+
+  obj_data->positions.resize(total.position);
+  obj_data->uvs.resize(total.uv);
+  obj_data->normals.resize(total.normal);
+  obj_data->face_vertices.resize(faces_total);
+
+  if (threads_count == 1) {
+    MergeChunk(chunks[0], bases[0], face_bases[0], obj_data);
+  }
+  else {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threads_count; ++i) {
+      threads.emplace_back(MergeChunk, std::cref(chunks[i]), bases[i],
+        face_bases[i], obj_data);
+    }
+    for (std::thread& thread : threads)
+      thread.join();
+  }
+
+  obj_data->events.reserve(events_total);
+  for (int i = 0; i < threads_count; ++i) {
+    for (ObjEvent& event : chunks[i].events) {
+      event.face_offset += face_bases[i];
+      obj_data->events.push_back(std::move(event));
+    }
+  }
+}
+
+bool ObjParser::ParseFile(const std::string& path, int threads_count,
+  ObjData* obj_data) {
+  core::FileView file;
+  if (!core::FileSystem::Open(path, &file))
+    return false;
+
+  Parse(file.GetData(), file.GetSize(), threads_count, obj_data);
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
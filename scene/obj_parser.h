@@ -0,0 +1,59 @@
+#ifndef MAGNET_SCENE_OBJ_PARSER_H_
+#define MAGNET_SCENE_OBJ_PARSER_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "math/vector2.h"
+#include "math/vector3.h"
+
+namespace magnet {
+namespace scene {
+// zero based indices into ObjData positions/uvs/normals, -1 if the face
+// vertex has no uv or normal
+struct ObjIndex {
+  int position;
+  int uv;
+  int normal;
+};
+
+// statements that start or end meshes, in file order. face_offset is the
+// number of face vertices in front of the statement.
+struct ObjEvent {
+  enum Type {
+    OBJECT,             // o <name>
+    GROUP,              // g <name>
+    USE_MATERIAL,       // usemtl <name>
+    MATERIAL_LIBRARY,   // mtllib <file>
+    VERTICES            // first v after faces or at the start of a chunk
+  };
+
+  Type type;
+  size_t face_offset;
+  std::string name;
+};
+
+struct ObjData {
+  std::vector<math::Vector3f> positions;
+  std::vector<math::Vector2f> uvs;          // v is flipped to 1 - v
+  std::vector<math::Vector3f> normals;
+  std::vector<ObjIndex> face_vertices;      // three per triangle
+  std::vector<ObjEvent> events;
+};
+
+// parses obj text into flat arrays. the input is split into line aligned
+// chunks that are parsed on their own threads and concatenated afterwards,
+// relative (negative) indices are resolved while concatenating.
+// polygons are triangulated as fans.
+class ObjParser {
+ public:
+  // threads_count 0 picks a count from the hardware and the input size
+  static void Parse(const char* data, size_t size, int threads_count,
+    ObjData* obj_data);
+  static bool ParseFile(const std::string& path, int threads_count,
+    ObjData* obj_data);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_OBJ_PARSER_H_
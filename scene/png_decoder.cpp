@@ -0,0 +1,544 @@
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "core/inflate.h"
+#include "core/simd.h"
+
+#include "png_decoder.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+static const uint8_t kSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+static const uint32_t kMaxDimension = 1 << 24;
+
+enum ColorType {
+  COLOR_GRAY = 0,
+  COLOR_RGB = 2,
+  COLOR_PALETTE = 3,
+  COLOR_GRAY_ALPHA = 4,
+  COLOR_RGBA = 6
+};
+
+enum Filter {
+  FILTER_NONE,
+  FILTER_SUB,
+  FILTER_UP,
+  FILTER_AVERAGE,
+  FILTER_PAETH
+};
+
+// adam7 passes, the last one holds the odd rows
+static const int kPassesCount = 7;
+static const uint32_t kPassStartX[kPassesCount] = { 0, 4, 0, 2, 0, 1, 0 };
+static const uint32_t kPassStartY[kPassesCount] = { 0, 0, 4, 0, 2, 0, 1 };
+static const uint32_t kPassStepX[kPassesCount] = { 8, 8, 4, 4, 2, 2, 1 };
+static const uint32_t kPassStepY[kPassesCount] = { 8, 8, 8, 4, 4, 2, 2 };
+
+struct Header {
+  uint32_t width;
+  uint32_t height;
+  int bit_depth;
+  int color_type;
+  bool interlaced;
+  int channels;
+};
+
+struct Image {
+  Header header;
+  uint8_t palette[256][4];
+  bool has_color_key;
+  uint16_t color_key[3];
+  std::vector<const uint8_t*> idat_chunks;
+  std::vector<uint32_t> idat_sizes;
+};
+
+inline uint32_t ReadUint32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+    (static_cast<uint32_t>(p[1]) << 16) |
+    (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+inline uint32_t ReadUint16(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 8) | p[1];
+}
+
+bool ReadHeader(const uint8_t* data, size_t size, Header* header) {
+  // signature, IHDR length and type, 13 bytes of IHDR
+  if (size < 33 || memcmp(data, kSignature, sizeof(kSignature)) != 0 ||
+    ReadUint32(data + 8) != 13 || memcmp(data + 12, "IHDR", 4) != 0) {
+    return false;
+  }
+
+  const uint8_t* p = data + 16;
+  header->width = ReadUint32(p);
+  header->height = ReadUint32(p + 4);
+  header->bit_depth = p[8];
+  header->color_type = p[9];
+  header->interlaced = p[12] == 1;
+  if (header->width == 0 || header->height == 0 ||
+    header->width > kMaxDimension || header->height > kMaxDimension ||
+    p[10] != 0 || p[11] != 0 || p[12] > 1) {
+    return false;
+  }
+
+  const int kDepth = header->bit_depth;
+  switch (header->color_type) {
+  case COLOR_GRAY:
+    header->channels = 1;
+    return kDepth == 1 || kDepth == 2 || kDepth == 4 || kDepth == 8 ||
+      kDepth == 16;
+  case COLOR_PALETTE:
+    header->channels = 1;
+    return kDepth == 1 || kDepth == 2 || kDepth == 4 || kDepth == 8;
+  case COLOR_RGB:
+    header->channels = 3;
+    return kDepth == 8 || kDepth == 16;
+  case COLOR_GRAY_ALPHA:
+    header->channels = 2;
+    return kDepth == 8 || kDepth == 16;
+  case COLOR_RGBA:
+    header->channels = 4;
+    return kDepth == 8 || kDepth == 16;
+  default:
+    return false;
+  }
+}
+
+bool ReadChunks(const uint8_t* data, size_t size, Image* image) {
+  if (!ReadHeader(data, size, &image->header))
+    return false;
+
+  for (int i = 0; i < 256; ++i) {
+    image->palette[i][0] = 0;
+    image->palette[i][1] = 0;
+    image->palette[i][2] = 0;
+    image->palette[i][3] = 255;
+  }
+  image->has_color_key = false;
+
+  size_t offset = 33;
+  while (true) {
+    if (size - offset < 12)
+      return false;
+    const uint32_t kLength = ReadUint32(data + offset);
+    const uint8_t* type = data + offset + 4;
+    const uint8_t* chunk = data + offset + 8;
+    if (kLength > size - offset - 12)
+      return false;
+
+    if (memcmp(type, "IDAT", 4) == 0) {
+      image->idat_chunks.push_back(chunk);
+      image->idat_sizes.push_back(kLength);
+    }
+    else if (memcmp(type, "PLTE", 4) == 0) {
+      if (kLength % 3 != 0 || kLength > 256 * 3)
+        return false;
+      for (uint32_t i = 0; i < kLength / 3; ++i) {
+        image->palette[i][0] = chunk[i * 3];
+        image->palette[i][1] = chunk[i * 3 + 1];
+        image->palette[i][2] = chunk[i * 3 + 2];
+      }
+    }
+    else if (memcmp(type, "tRNS", 4) == 0) {
+      const int kColorType = image->header.color_type;
+      if (kColorType == COLOR_PALETTE) {
+        for (uint32_t i = 0; i < kLength && i < 256; ++i)
+          image->palette[i][3] = chunk[i];
+      }
+      else if (kColorType == COLOR_GRAY && kLength >= 2) {
+        image->has_color_key = true;
+        image->color_key[0] = static_cast<uint16_t>(ReadUint16(chunk));
+      }
+      else if (kColorType == COLOR_RGB && kLength >= 6) {
+        image->has_color_key = true;
+        for (int i = 0; i < 3; ++i)
+          image->color_key[i] = static_cast<uint16_t>(ReadUint16(chunk + i * 2));
+      }
+    }
+    else if (memcmp(type, "IEND", 4) == 0) {
+      break;
+    }
+
+    offset += 12 + kLength;
+  }
+
+  return !image->idat_chunks.empty();
+}
+
+inline size_t GetRowBytes(const Header& header, uint32_t width) {
+  return (static_cast<size_t>(width) * header.channels * header.bit_depth +
+    7) / 8;
+}
+
+inline uint32_t GetPassSize(uint32_t size, uint32_t start, uint32_t step) {
+  return size > start ? (size - start + step - 1) / step : 0;
+}
+
+inline uint8_t Paeth(int a, int b, int c) {
+  const int kPa = b > c ? b - c : c - b;
+  const int kPb = a > c ? a - c : c - a;
+  const int kPc = a + b - c - c > 0 ? a + b - c - c : c + c - a - b;
+  if (kPa <= kPb && kPa <= kPc)
+    return static_cast<uint8_t>(a);
+  return static_cast<uint8_t>(kPb <= kPc ? b : c);
+}
+
+// src and dst may be the same row, prior is the unfiltered row above
+void UnfilterScalar(int filter, const uint8_t* src, const uint8_t* prior,
+  uint8_t* dst, size_t size, size_t bpp) {
+  switch (filter) {
+  case FILTER_NONE:
+    if (dst != src)
+      memcpy(dst, src, size);
+    break;
+  case FILTER_SUB:
+    for (size_t i = 0; i < bpp && i < size; ++i)
+      dst[i] = src[i];
+    for (size_t i = bpp; i < size; ++i)
+      dst[i] = static_cast<uint8_t>(src[i] + dst[i - bpp]);
+    break;
+  case FILTER_UP:
+    for (size_t i = 0; i < size; ++i)
+      dst[i] = static_cast<uint8_t>(src[i] + prior[i]);
+    break;
+  case FILTER_AVERAGE:
+    for (size_t i = 0; i < bpp && i < size; ++i)
+      dst[i] = static_cast<uint8_t>(src[i] + (prior[i] >> 1));
+    for (size_t i = bpp; i < size; ++i)
+      dst[i] = static_cast<uint8_t>(src[i] + ((dst[i - bpp] + prior[i]) >> 1));
+    break;
+  case FILTER_PAETH:
+    for (size_t i = 0; i < bpp && i < size; ++i)
+      dst[i] = static_cast<uint8_t>(src[i] + prior[i]);
+    for (size_t i = bpp; i < size; ++i) {
+      dst[i] = static_cast<uint8_t>(src[i] +
+        Paeth(dst[i - bpp], prior[i], prior[i - bpp]));
+    }
+    break;
+  }
+}
+
+#ifdef MAGNET_SSE2
+// sub, average and paeth depend on the pixel to the left, the channels of
+// one pixel are done together. up has no dependency and runs 16 bytes wide.
+inline __m128i LoadPixel(const uint8_t* p, size_t bpp) {
+  uint32_t value = 0;
+  memcpy(&value, p, bpp);
+  return _mm_cvtsi32_si128(static_cast<int>(value));
+}
+
+inline void StorePixel(uint8_t* p, __m128i pixel, size_t bpp) {
+  const uint32_t kValue = static_cast<uint32_t>(_mm_cvtsi128_si32(pixel));
+  memcpy(p, &kValue, bpp);
+}
+
+inline __m128i Select(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline __m128i Abs16(__m128i value) {
+  return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+}
+
+void UnfilterUpSse2(const uint8_t* src, const uint8_t* prior, uint8_t* dst,
+  size_t size) {
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const __m128i kSum = _mm_add_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(prior + i)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), kSum);
+  }
+  for (; i < size; ++i)
+    dst[i] = static_cast<uint8_t>(src[i] + prior[i]);
+}
+
+void UnfilterSubSse2(const uint8_t* src, uint8_t* dst, size_t size,
+  size_t bpp) {
+  __m128i a = _mm_setzero_si128();
+  for (size_t i = 0; i + bpp <= size; i += bpp) {
+    a = _mm_add_epi8(a, LoadPixel(src + i, bpp));
+    StorePixel(dst + i, a, bpp);
+  }
+}
+
+void UnfilterAverageSse2(const uint8_t* src, const uint8_t* prior,
+  uint8_t* dst, size_t size, size_t bpp) {
+  // avg_epu8 rounds up, the filter rounds down
+  const __m128i kOne = _mm_set1_epi8(1);
+  __m128i a = _mm_setzero_si128();
+  for (size_t i = 0; i + bpp <= size; i += bpp) {
+    const __m128i kB = LoadPixel(prior + i, bpp);
+    const __m128i kAverage = _mm_sub_epi8(_mm_avg_epu8(a, kB),
+      _mm_and_si128(_mm_xor_si128(a, kB), kOne));
+    a = _mm_add_epi8(LoadPixel(src + i, bpp), kAverage);
+    StorePixel(dst + i, a, bpp);
+  }
+}
+
+void UnfilterPaethSse2(const uint8_t* src, const uint8_t* prior,
+  uint8_t* dst, size_t size, size_t bpp) {
+  const __m128i kZero = _mm_setzero_si128();
+  __m128i a = kZero;
+  __m128i c = kZero;
+  for (size_t i = 0; i + bpp <= size; i += bpp) {
+    const __m128i kB = _mm_unpacklo_epi8(LoadPixel(prior + i, bpp), kZero);
+    const __m128i kX = _mm_unpacklo_epi8(LoadPixel(src + i, bpp), kZero);
+
+    // |p - a| = |b - c|, |p - b| = |a - c|, |p - c| = |b - c + a - c|
+    const __m128i kBc = _mm_sub_epi16(kB, c);
+    const __m128i kAc = _mm_sub_epi16(a, c);
+    const __m128i kPa = Abs16(kBc);
+    const __m128i kPb = Abs16(kAc);
+    const __m128i kPc = Abs16(_mm_add_epi16(kBc, kAc));
+    const __m128i kSmallest = _mm_min_epi16(kPc, _mm_min_epi16(kPa, kPb));
+
+    // ties prefer a, then b
+    __m128i nearest = Select(_mm_cmpeq_epi16(kSmallest, kPb), kB, c);
+    nearest = Select(_mm_cmpeq_epi16(kSmallest, kPa), a, nearest);
+
+    a = _mm_and_si128(_mm_add_epi16(nearest, kX), _mm_set1_epi16(0xff));
+    c = kB;
+    StorePixel(dst + i, _mm_packus_epi16(a, a), bpp);
+  }
+}
+#endif  // MAGNET_SSE2
+
+void Unfilter(int filter, const uint8_t* src, const uint8_t* prior,
+  uint8_t* dst, size_t size, size_t bpp, bool use_simd) {
+#ifdef MAGNET_SSE2
+  if (use_simd) {
+    if (filter == FILTER_UP) {
+      UnfilterUpSse2(src, prior, dst, size);
+      return;
+    }
+    if (bpp == 3 || bpp == 4) {
+      switch (filter) {
+      case FILTER_SUB:
+        UnfilterSubSse2(src, dst, size, bpp);
+        return;
+      case FILTER_AVERAGE:
+        UnfilterAverageSse2(src, prior, dst, size, bpp);
+        return;
+      case FILTER_PAETH:
+        UnfilterPaethSse2(src, prior, dst, size, bpp);
+        return;
+      default:
+        break;
+      }
+    }
+  }
+#endif  // MAGNET_SSE2
+  UnfilterScalar(filter, src, prior, dst, size, bpp);
+}
+
+// sample x of a row, 1 to 16 bits
+inline uint32_t GetSample(const uint8_t* row, size_t x, int depth) {
+  switch (depth) {
+  case 8:
+    return row[x];
+  case 16:
+    return ReadUint16(row + x * 2);
+  default: {
+    const size_t kBit = x * depth;
+    const int kShift = 8 - depth - static_cast<int>(kBit & 7);
+    return (row[kBit >> 3] >> kShift) & ((1u << depth) - 1);
+  }
+  }
+}
+
+// unfiltered row to rgba
+void ExpandRow(const Image& image, const uint8_t* row, uint32_t width,
+  uint8_t* rgba) {
+  const Header& header = image.header;
+  const int kDepth = header.bit_depth;
+
+  switch (header.color_type) {
+  case COLOR_RGBA:
+    if (kDepth == 8) {
+      memcpy(rgba, row, static_cast<size_t>(width) * 4);
+    }
+    else {
+      for (uint32_t x = 0; x < width; ++x) {
+        for (int i = 0; i < 4; ++i)
+          rgba[x * 4 + i] = row[(x * 4 + i) * 2];
+      }
+    }
+    break;
+  case COLOR_RGB:
+    for (uint32_t x = 0; x < width; ++x) {
+      uint8_t* pixel = rgba + x * 4;
+      if (kDepth == 8) {
+        pixel[0] = row[x * 3];
+        pixel[1] = row[x * 3 + 1];
+        pixel[2] = row[x * 3 + 2];
+      }
+      else {
+        pixel[0] = row[x * 6];
+        pixel[1] = row[x * 6 + 2];
+        pixel[2] = row[x * 6 + 4];
+      }
+      pixel[3] = 255;
+      if (image.has_color_key &&
+        GetSample(row, x * 3, kDepth) == image.color_key[0] &&
+        GetSample(row, x * 3 + 1, kDepth) == image.color_key[1] &&
+        GetSample(row, x * 3 + 2, kDepth) == image.color_key[2]) {
+        pixel[3] = 0;
+      }
+    }
+    break;
+  case COLOR_PALETTE:
+    for (uint32_t x = 0; x < width; ++x)
+      memcpy(rgba + x * 4, image.palette[GetSample(row, x, kDepth)], 4);
+    break;
+  case COLOR_GRAY: {
+    // low bit depths are scaled to the full byte
+    const uint32_t kScale = kDepth < 8 ? 255 / ((1u << kDepth) - 1) : 1;
+    for (uint32_t x = 0; x < width; ++x) {
+      const uint32_t kSample = GetSample(row, x, kDepth);
+      const uint8_t kGray = static_cast<uint8_t>(
+        kDepth == 16 ? kSample >> 8 : kSample * kScale);
+      uint8_t* pixel = rgba + x * 4;
+      pixel[0] = kGray;
+      pixel[1] = kGray;
+      pixel[2] = kGray;
+      pixel[3] = image.has_color_key && kSample == image.color_key[0] ?
+        0 : 255;
+    }
+    break;
+  }
+  case COLOR_GRAY_ALPHA:
+    for (uint32_t x = 0; x < width; ++x) {
+      const size_t kStride = kDepth == 16 ? 4 : 2;
+      const uint8_t kGray = row[x * kStride];
+      uint8_t* pixel = rgba + x * 4;
+      pixel[0] = kGray;
+      pixel[1] = kGray;
+      pixel[2] = kGray;
+      pixel[3] = row[x * kStride + kStride / 2];
+    }
+    break;
+  }
+}
+}  // namespace
+
+bool PngDecoder::IsPng(const void* data, size_t size) {
+  return size >= sizeof(kSignature) &&
+    memcmp(data, kSignature, sizeof(kSignature)) == 0;
+}
+
+bool PngDecoder::ReadSize(const void* data, size_t size, int* width,
+  int* height) {
+  Header header;
+  if (!ReadHeader(static_cast<const uint8_t*>(data), size, &header))
+    return false;
+  *width = static_cast<int>(header.width);
+  *height = static_cast<int>(header.height);
+  return true;
+}
+
+bool PngDecoder::Decode(const void* data, size_t size, unsigned char* rgba,
+  size_t pitch, bool use_simd) {
+  Image image;
+  if (!ReadChunks(static_cast<const uint8_t*>(data), size, &image))
+    return false;
+  const Header& header = image.header;
+
+  // the zlib stream may be split over several IDAT chunks
+  const uint8_t* stream = image.idat_chunks[0];
+  size_t stream_size = image.idat_sizes[0];
+  std::vector<uint8_t> joined_stream;
+  if (image.idat_chunks.size() > 1) {
+    for (size_t i = 0; i < image.idat_chunks.size(); ++i) {
+      joined_stream.insert(joined_stream.end(), image.idat_chunks[i],
+        image.idat_chunks[i] + image.idat_sizes[i]);
+    }
+    stream = joined_stream.data();
+    stream_size = joined_stream.size();
+  }
+
+  // every row of every pass starts with its filter byte
+  const int kPasses = header.interlaced ? kPassesCount : 1;
+  uint64_t filtered_size = 0;
+  for (int pass = 0; pass < kPasses; ++pass) {
+    const uint32_t kWidth = header.interlaced ? GetPassSize(header.width,
+      kPassStartX[pass], kPassStepX[pass]) : header.width;
+    const uint32_t kHeight = header.interlaced ? GetPassSize(header.height,
+      kPassStartY[pass], kPassStepY[pass]) : header.height;
+    if (kWidth > 0 && kHeight > 0)
+      filtered_size += static_cast<uint64_t>(kHeight) *
+        (GetRowBytes(header, kWidth) + 1);
+  }
+  if (filtered_size > static_cast<size_t>(-1) / 2)
+    return false;
+
+  std::vector<uint8_t> filtered(static_cast<size_t>(filtered_size));
+  size_t written = 0;
+  if (!core::InflateZlib(stream, stream_size, filtered.data(),
+    filtered.size(), &written) || written != filtered.size()) {
+    return false;
+  }
+
+  const size_t kBpp = (header.channels * header.bit_depth + 7) / 8;
+  const size_t kMaxRowBytes = GetRowBytes(header, header.width);
+  const std::vector<uint8_t> kZeroRow(kMaxRowBytes, 0);
+
+  // 8 bit rgba rows are unfiltered straight into the output
+  if (!header.interlaced && header.color_type == COLOR_RGBA &&
+    header.bit_depth == 8) {
+    const uint8_t* src = filtered.data();
+    for (uint32_t y = 0; y < header.height; ++y) {
+      const int kFilter = *src++;
+      if (kFilter > FILTER_PAETH)
+        return false;
+      uint8_t* dst = rgba + y * pitch;
+      const uint8_t* prior = y > 0 ? dst - pitch : kZeroRow.data();
+      Unfilter(kFilter, src, prior, dst, kMaxRowBytes, kBpp, use_simd);
+      src += kMaxRowBytes;
+    }
+    return true;
+  }
+
+  // others are unfiltered in place and expanded
+  std::vector<uint8_t> pass_row(header.interlaced ?
+    static_cast<size_t>(header.width) * 4 : 0);
+  uint8_t* src = filtered.data();
+  for (int pass = 0; pass < kPasses; ++pass) {
+    const uint32_t kStartX = header.interlaced ? kPassStartX[pass] : 0;
+    const uint32_t kStartY = header.interlaced ? kPassStartY[pass] : 0;
+    const uint32_t kStepX = header.interlaced ? kPassStepX[pass] : 1;
+    const uint32_t kStepY = header.interlaced ? kPassStepY[pass] : 1;
+    const uint32_t kWidth = GetPassSize(header.width, kStartX, kStepX);
+    const uint32_t kHeight = GetPassSize(header.height, kStartY, kStepY);
+    if (kWidth == 0 || kHeight == 0)
+      continue;
+
+    const size_t kRowBytes = GetRowBytes(header, kWidth);
+    const uint8_t* prior = kZeroRow.data();
+    for (uint32_t y = 0; y < kHeight; ++y) {
+      const int kFilter = *src++;
+      if (kFilter > FILTER_PAETH)
+        return false;
+      Unfilter(kFilter, src, prior, src, kRowBytes, kBpp, use_simd);
+
+      const uint32_t kImageY = kStartY + y * kStepY;
+      if (header.interlaced) {
+        ExpandRow(image, src, kWidth, pass_row.data());
+        uint8_t* dst = rgba + kImageY * pitch;
+        for (uint32_t x = 0; x < kWidth; ++x)
+          memcpy(dst + (kStartX + x * kStepX) * 4, &pass_row[x * 4], 4);
+      }
+      else {
+        ExpandRow(image, src, kWidth, rgba + kImageY * pitch);
+      }
+
+      prior = src;
+      src += kRowBytes;
+    }
+  }
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
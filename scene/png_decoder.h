@@ -0,0 +1,24 @@
+#ifndef MAGNET_SCENE_PNG_DECODER_H_
+#define MAGNET_SCENE_PNG_DECODER_H_
+
+#include <stddef.h>
+
+namespace magnet {
+namespace scene {
+// decodes png files to 8 bit rgba. every color type, bit depth and
+// interlacing is supported, 16 bit channels keep their high byte and tRNS
+// chunks become alpha. crcs are not checked. reentrant, nothing is shared
+// between calls.
+class PngDecoder {
+ public:
+  static bool IsPng(const void* data, size_t size);
+  static bool ReadSize(const void* data, size_t size, int* width, int* height);
+
+  // writes the rows top to bottom, pitch bytes apart. use_simd picks the
+  // sse2 unfilters where the cpu has them.
+  static bool Decode(const void* data, size_t size, unsigned char* rgba,
+    size_t pitch, bool use_simd = true);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_PNG_DECODER_H_
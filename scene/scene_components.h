@@ -0,0 +1,36 @@
+#ifndef MAGNET_SCENE_SCENE_COMPONENTS_H_
+#define MAGNET_SCENE_SCENE_COMPONENTS_H_
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "math/matrix4.h"
+
+#include "entity_store.h"
+
+namespace magnet {
+namespace render {
+class Mesh;
+class Material;
+}  // namespace render
+
+namespace scene {
+// the components of the entity store the scene manager updates every
+// frame. an authored entity and each mesh component below it are one
+// store entity each, their transforms are nodes of the scene manager's
+// transform hierarchy.
+
+// copied from the hierarchy when the node changed
+struct WorldTransform {
+  math::Matrix4f local_to_world;
+};
+
+// the meshes of a mesh component and their materials, paired by index
+struct MeshDraw {
+  std::vector<std::shared_ptr<render::Mesh>> meshes;
+  std::vector<std::shared_ptr<render::Material>> materials;
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_SCENE_COMPONENTS_H_
@@ -1,33 +1,82 @@
-#include <fstream>
-#include <assert.h>
-#include <fstream>
-#include "external\IL\il.h"
+#include <set>
 
+#include "core/file_system.h"
 #include "math\transformation.h"
 
+#include "asset_loader.h"
 #include "camera_component.h"
+#include "compiled_scene.h"
 #include "component_factory.h"
+#include "cook_manifest.h"
 #include "entity_factory.h"
+#include "render\material.h"
 #include "render\mesh.h"
+#include "render\render_manager.h"
+#include "render\resource_manager.h"
 #include "render\surface.h"
 #include "mesh_component.h"
 #include "normal_entity.h"
 #include "camera_entity.h"
+#include "scene_components.h"
 #include "scene_manager.h"
+#include "ibl_baker.h"
+#include "sh_projector.h"
 
 namespace magnet {
 namespace scene {
 namespace {
-static const char MESH_PATH[256] = "C:\\DDrive\\projects\\magnet\\data\\mesh\\";
-static const char TEXTURE_PATH[256] = "C:\\DDrive\\projects\\magnet\\data\\texture\\";
+// virtual paths, the application mounts the data folder and archives
+static const char MESH_PATH[256] = "mesh/";
+static const char TEXTURE_PATH[256] = "texture/";
+
+// rows of the entity store one update task works on
+static const uint32_t kRowsPerTask = 256;
+
+bool HasOnlyMeshComponents(const std::list<IComponent*>& components) {
+  for (const IComponent* component : components) {
+    if (component->GetType() != IComponent::ComponentType::MESH ||
+      !HasOnlyMeshComponents(component->GetComponents())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// an entity and its components in depth first order, the nodes of its
+// subtree of the hierarchy. the entity itself has no component.
+struct StoreSubtree {
+  std::vector<const IComponent*> components;
+  std::vector<TransformNode> parents;
+  std::vector<math::Transformationf> locals;
+};
+
+void AddToSubtree(const IComponent& component, TransformNode parent,
+  StoreSubtree* subtree) {
+  const TransformNode kNode =
+    static_cast<TransformNode>(subtree->components.size());
+  subtree->components.push_back(&component);
+  subtree->parents.push_back(parent);
+  subtree->locals.push_back(component.GetTransformation());
+  for (const IComponent* child : component.GetComponents())
+    AddToSubtree(*child, kNode, subtree);
+}
 }  // namespace
 
 SceneManager* SceneManager::instance_ = nullptr;
 
-SceneManager::SceneManager() {
+SceneManager::SceneManager() :
+  mesh_folder_path_(MESH_PATH),
+  texture_folder_path_(TEXTURE_PATH),
+  scene_cache_enabled_(true),
+  mesh_cache_enabled_(true),
+  texture_cache_enabled_(true),
+  max_load_jobs_(0),
+  default_material_(std::make_shared<render::Material>()) {
 }
 
 SceneManager::~SceneManager() {
+  for (IEntity* entity : entities_)
+    EntityFactory::GetInstance()->DestroyEntity(entity);
 }
 
 SceneManager* SceneManager::GetInstance() {
@@ -48,759 +97,566 @@ std::vector<IEntity*>* SceneManager::GetEntities() {
   return &entities_;
 }
 
-void SceneManager::LoadSceneFile(const std::string& path) {
-  if (path.empty()) return;
-
-  FILE *pFile = fopen(path.c_str(), "r");
-  fseek(pFile, 0, SEEK_END);
-  int iSize = ftell(pFile);
-  rewind(pFile);
-  char* pData = new char[iSize];
-  int iResult = fread(pData, 1, iSize, pFile);
-
-  tinyxml2::XMLDocument doc;
-  doc.Parse(pData);
-  tinyxml2::XMLElement* scene_element = doc.FirstChildElement("scene");
-  if (scene_element) {
-    tinyxml2::XMLElement* child_element = scene_element->FirstChildElement();
-    while (child_element) {
-      std::string name(child_element->Name());
-      if (name == "entity") {
-        ParseEntity(child_element);
-      }
-      else if (name == "startingpoint") {
-        ParseStartingPoint(child_element, &starting_point_);
-      }
-      child_element = child_element->NextSiblingElement();
-    }
-  }
-
-  fclose(pFile);
-
-  ilInit();
-  for (auto texture : textures_) {
-    LoadTexture(texture.second);
-  }
+const std::vector<EntityHandle>& SceneManager::GetEntityHandles() const {
+  return entity_handles_;
 }
 
-void SceneManager::ParseStartingPoint(tinyxml2::XMLElement* element,
-  math::Vector3f* starting_point) {
-
+EntityHandle SceneManager::AddEntity(IEntity* entity) {
+  const EntityHandle kHandle = RegisterEntity(entity);
+  if (kHandle != kInvalidEntityHandle)
+    AddToEntityStore(entity);
+  return kHandle;
 }
 
-void SceneManager::ParseEntity(tinyxml2::XMLElement* element) {
-  // attributes
-  const std::string entity_name(element->Attribute("name"));
-  const std::string entity_type(element->Attribute("type"));
-
-  IEntity* entity = nullptr;
-  if (entity_type == "normal") {
-    entity = EntityFactory::GetInstance()->CreateEntity(
-      "NormalEntity", entity_name);
-  } else if (entity_type == "camera") {
-    entity = EntityFactory::GetInstance()->CreateEntity(
-      "CameraEntity", entity_name);
-  }
+IEntity* SceneManager::GetEntity(EntityHandle handle) const {
+  if (!entity_handle_allocator_.IsValid(handle))
+    return nullptr;
+  return entities_[entity_positions_[core::HandleAllocator::GetIndex(handle)]];
+}
 
-  if (entity == nullptr)
-    return;
+bool SceneManager::DestroyEntity(EntityHandle handle) {
+  if (!entity_handle_allocator_.IsValid(handle))
+    return false;
+  const uint32_t kPosition =
+    entity_positions_[core::HandleAllocator::GetIndex(handle)];
+  IEntity* entity = entities_[kPosition];
+  RemoveFromEntityStore(*entity);
+  RemoveCameras(entity->GetComponents());
+
+  // the last entity takes its place
+  entities_[kPosition] = entities_.back();
+  entity_handles_[kPosition] = entity_handles_.back();
+  entity_positions_[core::HandleAllocator::GetIndex(
+    entity_handles_[kPosition])] = kPosition;
+  entities_.pop_back();
+  entity_handles_.pop_back();
+  entity_handle_allocator_.Free(handle);
+  EntityFactory::GetInstance()->DestroyEntity(entity);
+  return true;
+}
 
+EntityHandle SceneManager::RegisterEntity(IEntity* entity) {
+  const EntityHandle kHandle = entity_handle_allocator_.Allocate();
+  if (kHandle == kInvalidEntityHandle)
+    return kInvalidEntityHandle;
+  const uint32_t kIndex = core::HandleAllocator::GetIndex(kHandle);
+  if (kIndex >= entity_positions_.size())
+    entity_positions_.resize(kIndex + 1);
+  entity_positions_[kIndex] = static_cast<uint32_t>(entities_.size());
   entities_.push_back(entity);
+  entity_handles_.push_back(kHandle);
+  return kHandle;
+}
 
-  math::Transformationf entity_transformation;
-  tinyxml2::XMLElement* child_element = element->FirstChildElement();
-  while (child_element) {
-    const std::string kName(child_element->Name());
-    if (kName == "transform") {
-      ParseTransformation(child_element, &entity_transformation);
-      entity->SetTransformation(entity_transformation);
-    }
-    else if (kName == "component") {
-      ParseComponent(child_element, entity);
+void SceneManager::RemoveCameras(const std::list<IComponent*>& components) {
+  for (const IComponent* component : components) {
+    if (component->GetType() == IComponent::ComponentType::CAMERA) {
+      for (auto it = cameras_.begin(); it != cameras_.end(); ++it) {
+        if (it->second == component) {
+          cameras_.erase(it);
+          break;
+        }
+      }
     }
-    child_element = child_element->NextSiblingElement();
+    RemoveCameras(component->GetComponents());
   }
-  entity->Initialize();
 }
 
-void SceneManager::ParseComponent(tinyxml2::XMLElement* element, IEntity* entity) {
-  const std::string kComponentName(element->Attribute("name"));
-  const std::string kComponentType(element->Attribute("type"));
+EntityStore* SceneManager::GetEntityStore() {
+  return &entity_store_;
+}
 
-  if (kComponentType == "camera") {
-    CameraComponent* camera_component = static_cast<CameraComponent*>(
-      ComponentFactory::GetInstance()->CreateComponent(
-        "CameraComponent", kComponentName));
+TransformHierarchy* SceneManager::GetTransformHierarchy() {
+  return &transform_hierarchy_;
+}
 
-    ParseComponent(element, camera_component);
+const std::map<std::string, std::shared_ptr<render::Mesh>>&
+SceneManager::GetMeshes() const {
+  return meshes_;
+}
 
-    // for easy access
+const std::map<std::string, std::shared_ptr<render::Texture>>&
+SceneManager::GetTextures() const {
+  return textures_;
+}
 
-    cameras_.insert(std::pair<std::string, CameraComponent*>(
-      kComponentName, camera_component));
+void SceneManager::SetTextureFolderPath(const std::string& folder_path) {
+  texture_folder_path_ = folder_path;
+}
 
-    entity->AddComponent(camera_component);
-  }
-  else if (kComponentType == "mesh") {
-    MeshComponent* mesh_component =
-      static_cast<MeshComponent*>(
-        ComponentFactory::GetInstance()->CreateComponent(
-          "MeshComponent", kComponentName));
-    ParseComponent(element, mesh_component);
-    entity->AddComponent(mesh_component);
-  }
+void SceneManager::SetMeshFolderPath(const std::string& folder_path) {
+  mesh_folder_path_ = folder_path;
 }
 
-void SceneManager::ParseComponent(tinyxml2::XMLElement* element,
-  IComponent* current_component) {
-  math::Transformationf component_transformation;
-  tinyxml2::XMLElement* child_element = element->FirstChildElement();
-  while (child_element) {
-    const std::string kName(child_element->Name());
-    if (kName == "transform") {
-      ParseTransformation(child_element, &component_transformation);
-      current_component->SetTransformation(component_transformation);
-    }
-    else if (kName == "camera") {
-      ParseCamera(child_element, current_component);
-    }
-    else if (kName == "mesh") {
-      ParseTriangleMesh(child_element, current_component);
-    }
-    //else if (kName == "material") {
-    //  ParseMaterial(child_element, current_component);
-    //}
-    else if (kName == "component") {
-      const std::string kComponentName(child_element->Attribute("name"));
-      const std::string kComponentType(child_element->Attribute("type"));
-      if (kComponentType == "camera") {
-        CameraComponent* camera_component = static_cast<CameraComponent*>(
-          ComponentFactory::GetInstance()->CreateComponent(
-            "CameraComponent", kComponentName));
-
-        ParseComponent(child_element, camera_component);
-
-        // for easy access
-        cameras_.insert(std::pair<std::string, CameraComponent*>(
-          kComponentName, camera_component));
-
-        current_component->AddComponent(camera_component);
-      }
-      else if (kComponentType == "mesh") {
-        IComponent* component =
-          ComponentFactory::GetInstance()->CreateComponent(
-            "MeshComponent", kComponentName);
-        ParseComponent(child_element, component);
-        current_component->AddComponent(component);
-      }
-    }
-    child_element = child_element->NextSiblingElement();
-  }
+const std::string& SceneManager::GetTextureFolderPath() const {
+  return texture_folder_path_;
 }
 
-void SceneManager::ParseCamera(tinyxml2::XMLElement* element, IComponent* component) {
-  if (component->GetType() == IComponent::ComponentType::CAMERA) {
-    CameraComponent* camera_component =
-      static_cast<CameraComponent*>(component);
+const std::string& SceneManager::GetMeshFolderPath() const {
+  return mesh_folder_path_;
+}
 
-    const std::string kType(element->Attribute("type"));
-    if (kType == "free") {
-      camera_component->SetCameraType(CameraComponent::CameraType::FREE);
-    }
-    else if (kType == "firstperson") {
-      camera_component->SetCameraType(
-        CameraComponent::CameraType::FIRST_PERSON);
-    }
-    else if (kType == "thirdperson") {
-      camera_component->SetCameraType(
-        CameraComponent::CameraType::THIRD_PERSON);
-    }
-    else if (kType == "thirdpersonfixed") {
-      camera_component->SetCameraType(
-        CameraComponent::CameraType::THIRD_PERSON_FIXED);
-    }
-    else if (kType == "topview") {
-      camera_component->SetCameraType(CameraComponent::CameraType::TOP_VIEW);
-    }
-    else if (kType == "topviewfixed") {
-      camera_component->SetCameraType(
-        CameraComponent::CameraType::TOP_VIEW_FIXED);
-    }
+void SceneManager::SetSceneCacheEnabled(bool enabled) {
+  scene_cache_enabled_ = enabled;
+}
 
-    tinyxml2::XMLElement* child_element = element->FirstChildElement();
-    while (child_element) {
-      const std::string kName(child_element->Name());
-      if (kName == "lookat") {
-        const char* kLookat = child_element->GetText();
-        math::Vector3f lookat;
-        sscanf(kLookat, "%f %f %f", &lookat.x_, &lookat.y_, &lookat.z_);
-        camera_component->SetLocalLookat(lookat);
-      }
-      else if (kName == "fov") {
-        float fov;
-        child_element->QueryFloatText(&fov);
-        camera_component->SetFov(fov);
-      }
-      else if (kName == "aspectratio") {
-        float aspect_ratio;
-        child_element->QueryFloatText(&aspect_ratio);
-        camera_component->SetAspectRatio(aspect_ratio);
-      }
-      else if (kName == "up") {
-        const char* kUp = child_element->GetText();
-        math::Vector3f up;
-        sscanf(kUp, "%f %f %f", &up.x_, &up.y_, &up.z_);
-        camera_component->SetUp(up);
-      }
-      child_element = child_element->NextSiblingElement();
-    }
-  }
+bool SceneManager::IsSceneCacheEnabled() const {
+  return scene_cache_enabled_;
 }
 
-void SceneManager::ParseTransformation(tinyxml2::XMLElement* element,
-  math::Transformationf* transformation) {
-  tinyxml2::XMLElement* child_element = element->FirstChildElement();
-  while (child_element) {
-    const std::string kName(child_element->Name());
-    if (kName == "translate") {
-      const char* kTranslate = child_element->GetText();
-      math::Vector3f translate;
-      sscanf(kTranslate, "%f %f %f", &translate.x_, &translate.y_, &translate.z_);
+void SceneManager::SetMeshCacheFolderPath(const std::string& folder_path) {
+  mesh_cache_folder_path_ = folder_path;
+}
 
-      transformation->SetTranslation(translate);
-    }
-    else if (kName == "scale") {
-      const char* kScale = child_element->GetText();
-      math::Vector3f scale;
-      sscanf(kScale, "%f %f %f", &scale.x_, &scale.y_, &scale.z_);
+const std::string& SceneManager::GetMeshCacheFolderPath() const {
+  return mesh_cache_folder_path_;
+}
 
-      transformation->SetScale(scale);
-    }
-    else if (kName == "rotate") {
-      const char* kRotate = child_element->GetText();
-      math::Vector3f rotate;
-      sscanf(kRotate, "%f %f %f", &rotate.x_, &rotate.y_, &rotate.z_);
-
-      transformation->Rotate(rotate.x_, 1.f, 0.f, 0.f);
-      transformation->Rotate(rotate.y_, 0.f, 1.f, 0.f);
-      transformation->Rotate(rotate.z_, 0.f, 0.f, 1.f);
-    }
-    child_element = child_element->NextSiblingElement();
-  }
+void SceneManager::SetMeshCacheEnabled(bool enabled) {
+  mesh_cache_enabled_ = enabled;
 }
 
-void SceneManager::ParseTriangleMesh(tinyxml2::XMLElement* element, IComponent* component) {
-  if (component->GetType() == IComponent::ComponentType::MESH) {
-    MeshComponent* mesh_component = static_cast<MeshComponent*>(component);
+bool SceneManager::IsMeshCacheEnabled() const {
+  return mesh_cache_enabled_;
+}
 
-    const std::string kMeshType(element->Attribute("type"));
-    const std::string kMeshName(element->GetText());
-    auto iter = meshes_.find(kMeshName);
-    if (iter == meshes_.end()) {
-      if (kMeshType == "obj") {
-        LoadMeshObj(kMeshName, mesh_component);
-      }
-    }
-    else {
-      mesh_component->AddMesh(iter->second);
-    }
-  }
+void SceneManager::SetTextureCacheFolderPath(const std::string& folder_path) {
+  texture_cache_folder_path_ = folder_path;
 }
 
-void ParseMaterial(tinyxml2::XMLElement* element, IComponent* component) {
+const std::string& SceneManager::GetTextureCacheFolderPath() const {
+  return texture_cache_folder_path_;
+}
 
+void SceneManager::SetTextureCacheEnabled(bool enabled) {
+  texture_cache_enabled_ = enabled;
 }
 
-void SceneManager::LoadTexture(std::shared_ptr<render::Texture> texture) {
-  if (texture->GetType() == render::TEXTURE_TYPE_2D) {
-    std::string path = std::string(TEXTURE_PATH) + texture->GetName();
+bool SceneManager::IsTextureCacheEnabled() const {
+  return texture_cache_enabled_;
+}
 
-    // load images using IL
-    unsigned int uTextureID;
-    ilGenImages(1, &uTextureID);
-    ilBindImage(uTextureID);
+void SceneManager::SetMaxLoadJobs(int jobs_count) {
+  max_load_jobs_ = jobs_count;
+}
 
-    // the formatting setting influences of Texture loading, so must be set up before loading
-    ilEnable(IL_FORMAT_SET);
-    ilSetInteger(IL_FORMAT_MODE, IL_RGBA); // assume all textures are rgba
+void SceneManager::SetMipFilter(MipFilter filter) {
+  texture_cook_.mip_filter = filter;
+}
 
-    if (!ilLoadImage(path.c_str())) {
-      return;
-    }
+void SceneManager::SetTextureCompression(TextureCompression compression,
+  BcQuality quality) {
+  texture_cook_.compression = compression;
+  texture_cook_.quality = quality;
+}
 
-    int iWidth = ilGetInteger(IL_IMAGE_WIDTH);
-    int iHeight = ilGetInteger(IL_IMAGE_HEIGHT);
+void SceneManager::SetHdrFormat(HdrFormat format) {
+  texture_cook_.hdr_format = format;
+}
 
-    texture->SetDimension(iWidth, iHeight);
+void SceneManager::SetLoadProgressCallback(
+  const LoadProgressCallback& callback) {
+  load_progress_callback_ = callback;
+}
 
-    void* pData = texture->CreateDataBuffer();
+void SceneManager::CreateRenderResources() {
+  render::RenderManager* render_manager = render::RenderManager::GetInstance();
+  render::ResourceManager* resource_manager =
+    render::ResourceManager::GetInstance();
+  ID3D11Device* device = render_manager->GetDevice();
 
-    if (texture->GetFormat() == render::TEXTURE_FORMAT_R8G8B8A8_UINT) {
-      assert(ilGetInteger(IL_IMAGE_TYPE) == IL_UNSIGNED_BYTE);
+  for (auto mesh : meshes_) {
+    resource_manager->CreateMeshResource(mesh.second.get(), device);
+  }
 
-      unsigned char* pDataUINT8 = static_cast<unsigned char*>(pData);
-      unsigned char* pImageData = ilGetData();
-      for (int y = 0; y < iHeight; y++) {
-        for (int x = 0; x < iWidth; x++) {
-          int i = (y * iWidth + x) * 4;
-          pDataUINT8[i] = pImageData[i];
-          pDataUINT8[i + 1] = pImageData[i + 1];
-          pDataUINT8[i + 2] = pImageData[i + 2];
-          pDataUINT8[i + 3] = pImageData[i + 3];
-        }
+  // the first cube map lights the sky, projected from its texels before
+  // they go to the gpu, and prefiltered for specular reflections
+  bool sky_lighting_set = false;
+  for (auto texture : textures_) {
+    if (!sky_lighting_set && ShProjector::CanProject(*texture.second)) {
+      math::Vector4f coefficients[kMaxShCoefficientsCount];
+      sky_lighting_set = ShProjector::ProjectCached(*texture.second, 3,
+        texture_cook_.srgb, 0, coefficients);
+      if (sky_lighting_set) {
+        render_manager->SetSkyLighting(coefficients,
+          kMaxShCoefficientsCount);
+        BakeSpecularEnvironment(*texture.second);
       }
     }
-
-    ilDeleteImage(uTextureID);
   }
-  // load 6 cube map textures
-  else if (texture->GetType() == render::TEXTURE_TYPE_CUBE) {
-    float* pData = 0;
-
-    char caPath[256];
-    for (int i = 0; i < 6; ++i) {
-      strcpy(caPath, TEXTURE_PATH);
-
-      char caName[256];
-      strcpy(caName, texture->GetName().c_str());
-      int length = strlen(caName);
-      char caPostfix[3] = { caName[length - 3], caName[length - 2], caName[length - 1] };
-      length -= 4;
-      caName[length++] = '_';
-      caName[length++] = 'c';
-      caName[length++] = '0';
-
-      char cIndex[10];
-      itoa(i, cIndex, 10);
-      caName[length++] = cIndex[0];
-      caName[length++] = '.';
-      caName[length++] = caPostfix[0];
-      caName[length++] = caPostfix[1];
-      caName[length++] = caPostfix[2];
-      caName[length] = '\0';
-
-      strcat(caPath, caName);
-
-      // load images using IL
-      unsigned int uTextureID;
-      ilGenImages(1, &uTextureID);
-      ilBindImage(uTextureID);
-
-      // the formatting setting influences of Texture loading, so must be set up before loading
-      ilEnable(IL_FORMAT_SET);
-      ilSetInteger(IL_FORMAT_MODE, IL_RGBA); // assume all textures are rgba
-
-      if (!ilLoadImage(caPath)) {
-        assert(0);
-      }
 
-      int w = ilGetInteger(IL_IMAGE_WIDTH);
-      int h = ilGetInteger(IL_IMAGE_HEIGHT);
-
-      if (i == 0) {
-        texture->SetDimension(w, h);
-        pData = static_cast<float*>(texture->CreateDataBuffer());
-      }
-
-      if (texture->GetFormat() == render::TEXTURE_FORMAT_R32G32B32A32_FLOAT) {
-        assert(ilGetInteger(IL_IMAGE_TYPE) == IL_FLOAT);
-
-        float* pDataOffset = pData + i * w * h * 4;
-
-        float* pImageData = reinterpret_cast<float*>(ilGetData());
-        for (int y = 0; y < h; y++) {
-          for (int x = 0; x < w; x++) {
-            int offset = (y * w + x) * 4;
-            pDataOffset[offset] = pImageData[offset];
-            pDataOffset[offset + 1] = pImageData[offset + 1];
-            pDataOffset[offset + 2] = pImageData[offset + 2];
-            pDataOffset[offset + 3] = pImageData[offset + 3];
-          }
-        }
-
-      }
-
-      ilDeleteImage(uTextureID);
+  for (auto texture : textures_) {
+    if (texture.second->GetDataBufferPtr()) {
+      resource_manager->CreateTextureResource(texture.second.get(), device);
     }
   }
 }
 
-std::shared_ptr<render::Mesh> SceneManager::CreateMesh(
-  const std::string& name, bool has_normal, bool has_uv,
-  const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
-  std::shared_ptr<render::Mesh> mesh = std::make_shared<render::Mesh>(name);
-
-  int floats_count = 0;
-  if (vertices.size() > 0) {
-    mesh->AddVertexDecl(render::VertexDecl::POSITION);
-    floats_count += 3;
+void SceneManager::BakeSpecularEnvironment(const render::Texture& sky) {
+  std::string specular_cache_path;
+  std::string lut_cache_path;
+  if (texture_cache_enabled_) {
+    const std::string& kFolder = texture_cache_folder_path_.empty() ?
+      texture_folder_path_ : texture_cache_folder_path_;
+    specular_cache_path = kFolder + sky.GetName() + ".specular.tcache";
+    lut_cache_path = kFolder + "brdf_lut.tcache";
   }
 
-  if (has_normal) {
-    mesh->AddVertexDecl(render::VertexDecl::NORMAL);
-    floats_count += 3;
-  }
-
-  if (has_uv) {
-    mesh->AddVertexDecl(render::VertexDecl::UV);
-    floats_count += 2;
+  IblBakeDesc desc;
+  desc.srgb = texture_cook_.srgb;
+  std::shared_ptr<render::Texture> specular =
+    std::make_shared<render::Texture>(sky.GetName() + "_specular",
+    render::SAMPLER_MIP_LINEAR_WRAP, render::TEXTURE_LABEL_SKY,
+    render::TEXTURE_FORMAT_R16G16B16A16_FLOAT, render::TEXTURE_TYPE_CUBE);
+  std::shared_ptr<render::Texture> lut = std::make_shared<render::Texture>(
+    "brdf_lut", render::SAMPLER_NOMIP_LINEAR_UNWRAP,
+    render::TEXTURE_LABEL_COLOR_0, render::TEXTURE_FORMAT_R16G16B16A16_FLOAT,
+    render::TEXTURE_TYPE_2D);
+  if (!IblBaker::BakeSpecularCached(desc, sky, specular_cache_path,
+    specular.get()) ||
+    !IblBaker::BakeBrdfLutCached(desc, lut_cache_path, lut.get())) {
+    return;
   }
 
-  float* vertex_data_buffer =
-    mesh->CreateVertexDataBuffer(vertices.size(), floats_count);
-  for (int i = 0; i < vertices.size(); ++i) {
-    const Vertex& vertex = vertices[i];
+  textures_[specular->GetName()] = specular;
+  textures_[lut->GetName()] = lut;
+  render::RenderManager::GetInstance()->SetSpecularEnvironment(
+    specular->GetName(), lut->GetName());
+}
 
-    int index = 0;
-    if (vertices.size() > 0) {
-      vertex_data_buffer[i * floats_count + index] = vertex.position.x_;
-      vertex_data_buffer[i * floats_count + index + 1] = vertex.position.y_;
-      vertex_data_buffer[i * floats_count + index + 2] = vertex.position.z_;
+void SceneManager::LoadSceneFile(const std::string& path) {
+  if (path.empty()) return;
 
-      index += 3;
-    }
+  // an archive written by magnet_cook holds caches without their sources
+  CookManifest cook_manifest;
+  const bool kCooked = cook_manifest.Read(kCookManifestName);
+  CompiledScene scene;
+  if (!LoadCompiledScene(path, kCooked ? &cook_manifest : nullptr, &scene))
+    return;
+  ReserveComponents(scene);
+  const size_t kFirstEntity = entities_.size();
+  for (uint32_t i = 0; i < scene.GetEntitiesCount(); ++i)
+    CreateEntity(scene, scene.GetEntity(i));
+
+  // creating the entities only collected the meshes, they and the material
+  // libraries and textures they name are loaded by jobs. the components
+  // are wired up once everything is done.
+  AssetLoaderDesc desc;
+  desc.mesh_folder_path = mesh_folder_path_;
+  desc.texture_folder_path = texture_folder_path_;
+  desc.mesh_cache_folder_path = mesh_cache_folder_path_;
+  desc.mesh_cache_enabled = mesh_cache_enabled_;
+  desc.texture_cache_folder_path = texture_cache_folder_path_;
+  desc.texture_cache_enabled = texture_cache_enabled_;
+  desc.texture_cook = texture_cook_;
+  desc.max_jobs = max_load_jobs_;
+  desc.cook_manifest = kCooked ? &cook_manifest : nullptr;
+  AssetLoader asset_loader(desc);
+  for (const MeshRequest& request : mesh_requests_) {
+    asset_loader.RequestMesh(request.name);
+  }
+  asset_loader.Run(load_progress_callback_);
 
-    if (has_normal) {
-      vertex_data_buffer[i * floats_count + index] = vertex.normal.x_;
-      vertex_data_buffer[i * floats_count + index + 1] = vertex.normal.y_;
-      vertex_data_buffer[i * floats_count + index + 2] = vertex.normal.z_;
+  for (const std::shared_ptr<render::Texture>& texture :
+    asset_loader.GetTextures()) {
+    textures_.insert(std::pair<std::string, std::shared_ptr<render::Texture>>(
+      texture->GetName(), texture));
+  }
 
-      index += 3;
+  // in scene order, the first library defining a material wins
+  std::set<std::string> added_libraries;
+  for (const MeshRequest& request : mesh_requests_) {
+    const MeshCacheData* mesh_data = asset_loader.GetMeshData(request.name);
+    if (mesh_data == nullptr) continue;
+    for (const std::string& library : mesh_data->material_libraries) {
+      const std::vector<MtlMaterial>* materials =
+        asset_loader.GetMaterialLibrary(library);
+      if (materials != nullptr && added_libraries.insert(library).second) {
+        AddMaterials(*materials);
+      }
     }
+  }
 
-    if (has_uv) {
-      vertex_data_buffer[i * floats_count + index] = vertex.uv.x_;
-      vertex_data_buffer[i * floats_count + index + 1] = vertex.uv.y_;
-
-      index += 2;
+  for (const MeshRequest& request : mesh_requests_) {
+    const MeshCacheData* mesh_data = asset_loader.GetMeshData(request.name);
+    if (mesh_data != nullptr) {
+      AddMeshes(*mesh_data, request.mesh_component);
     }
   }
-  mesh->SetVertsCount(vertices.size());
-  mesh->SetFacesCount(indices.size() / 3);
-  unsigned int* index_data_buffer =
-    mesh->CreateIndexDataBuffer(indices.size() / 3);
-  for (int i = 0; i < indices.size(); ++i) {
-    index_data_buffer[i] = indices[i];
-  }
+  mesh_requests_.clear();
 
-  //mesh->CreateVBO();
-  return mesh;
+  for (size_t i = kFirstEntity; i < entities_.size(); ++i)
+    AddToEntityStore(entities_[i]);
 }
 
-void SceneManager::LoadMeshObj(const std::string& name, MeshComponent* mesh_component) {
-  std::string file_path = std::string(MESH_PATH) + name;
-
-  std::ifstream in_file(file_path);
+void SceneManager::UnloadScene() {
+  while (!entity_handles_.empty())
+    DestroyEntity(entity_handles_.back());
+  ComponentFactory::GetInstance()->ReleaseUnusedComponents();
+}
 
-  if (!in_file.is_open()) {
-    return;
+void SceneManager::ReserveComponents(const CompiledScene& scene) {
+  uint32_t camera_components_count = 0;
+  uint32_t mesh_components_count = 0;
+  for (uint32_t i = 0; i < scene.GetEntitiesCount(); ++i) {
+    const SceneEntityRecord& kEntity = scene.GetEntity(i);
+    for (uint32_t j = 0; j < kEntity.components_count; ++j) {
+      if (scene.GetComponent(kEntity.first_component + j).type ==
+        SCENE_COMPONENT_CAMERA) {
+        ++camera_components_count;
+      }
+      else {
+        ++mesh_components_count;
+      }
+    }
   }
+  ComponentFactory::GetInstance()->ReserveComponents("CameraComponent",
+    camera_components_count);
+  ComponentFactory::GetInstance()->ReserveComponents("MeshComponent",
+    mesh_components_count);
+}
 
-  std::vector<math::Vector3f> positions;
-  std::vector<math::Vector2f> uvs;
-  std::vector<math::Vector3f> normals;
-
-  std::vector<Vertex> vertices;
-  std::vector<unsigned int> indices;
-  std::map<int, std::list<CacheEntry>> cache;
-
-  std::string material_file = "";
-
-  char word[32];
-  char mesh_name[64];
-
-  bool is_parsing_faces = false;
+void SceneManager::AddMaterials(const std::vector<MtlMaterial>& materials) {
+  for (const MtlMaterial& mtl_material : materials) {
+    // materials without a color are not created
+    if (!mtl_material.has_color ||
+      materials_.find(mtl_material.name) != materials_.end()) {
+      continue;
+    }
 
-  while (1) {
-    in_file >> word;
+    std::shared_ptr<render::Material> material =
+      std::make_shared<render::Material>();
+    materials_.insert(std::pair<std::string, std::shared_ptr<render::Material>>(
+      mtl_material.name, material));
+  }
+}
 
-    if (!in_file) {
-      break;
-    }
+void SceneManager::AddMeshes(const MeshCacheData& mesh_data,
+  MeshComponent* mesh_component) {
+  for (size_t i = 0; i < mesh_data.meshes.size(); ++i) {
+    const std::shared_ptr<render::Mesh>& mesh = mesh_data.meshes[i];
+    meshes_.insert(std::pair<std::string, std::shared_ptr<render::Mesh>>(
+      mesh->GetName(), mesh));
+    mesh_component->AddMesh(mesh);
 
-    if (strcmp(word, "#") == 0) {
-      // comment
-    }
-    else if (strcmp(word, "o") == 0) {
-      // object name
-      in_file >> mesh_name;
-    }
-    else if (strcmp(word, "v") == 0) {
-      // parsing f to parsing v, create a mesh
-      if (is_parsing_faces) {
-        const std::string kMeshName(mesh_name);
-        std::shared_ptr<render::Mesh> mesh = CreateMesh(
-          kMeshName, normals.size() > 0, uvs.size() > 0, vertices, indices);
-
-        meshes_.insert(std::pair<std::string, std::shared_ptr<render::Mesh>>(
-          kMeshName, mesh));
-        mesh_component->AddMesh(mesh);
-
-        vertices.clear();
-        indices.clear();
-        cache.clear();
-
-        is_parsing_faces = false;
+    // the component pairs meshes and materials by index, a mesh without
+    // a known material gets the default one
+    std::shared_ptr<render::Material> material = default_material_;
+    const int kMaterial = i < mesh_data.mesh_materials.size() ?
+      mesh_data.mesh_materials[i] : -1;
+    if (kMaterial >= 0) {
+      auto it = materials_.find(mesh_data.materials[kMaterial]);
+      if (it != materials_.end()) {
+        material = it->second;
       }
-
-      // parse vertex
-      float x, y, z;
-      in_file >> x >> y >> z;
-      positions.push_back(math::Vector3f(x, y, z));
-    }
-    else if (strcmp(word, "vt") == 0) {
-      // uv
-      float u, v;
-      in_file >> u >> v;
-      uvs.push_back(math::Vector2f(u, 1 - v));
-    }
-    else if (strcmp(word, "vn") == 0) {
-      // normal
-      float x, y, z;
-      in_file >> x >> y >> z;
-      normals.push_back(math::Vector3f(x, y, z));
     }
-    else if (strcmp(word, "f") == 0) {
-      is_parsing_faces = true;
-
-      // face/triangle
-      int index_position, index_uv, index_normal;
-      Vertex vertex;
-
-      for (int i = 0; i < 3; ++i) {
-        in_file >> index_position;
-        vertex.position = positions[index_position - 1];
-
-        if ('/' == in_file.peek()) {
-          in_file.ignore();
-
-          if ('/' != in_file.peek()) {
-            in_file >> index_uv;
-            vertex.uv = uvs[index_uv - 1];
-          }
-
-          if ('/' == in_file.peek()) {
-            in_file.ignore();
-
-            in_file >> index_normal;
-            vertex.normal = normals[index_normal - 1];
-          }
-        }
-
-        //  find in the cache
-        auto it = cache.find(index_position);
-        if (it != cache.end()) {
-          //  search the entries
-          bool found_it = false;
-          std::list<CacheEntry>& list = it->second;
-          for (auto it_list : list) {
-            //  found it
-            if (it_list.uv_index == index_uv &&
-              it_list.normal_index == index_normal) {
-              found_it = true;
-              indices.push_back(it_list.vertex_index);
-              break;
-            }
-          }
-
-          if (!found_it) {
-            //  add this vertex
-            vertices.push_back(vertex);
-            indices.push_back(vertices.size() - 1);
-
-            //  add cache entry in the list
-            CacheEntry entry;
-            entry.normal_index = index_normal;
-            entry.uv_index = index_uv;
-            entry.vertex_index = vertices.size() - 1;
-
-            it->second.push_back(entry);
-          }
-        }
-        else {
-          // add the vertex
-          vertices.push_back(vertex);
-          indices.push_back(vertices.size() - 1);
-
-          std::list<CacheEntry> list;
+    mesh_component->AddMaterial(material);
+  }
+}
 
-          // add cache entry
-          CacheEntry entry;
-          entry.normal_index = index_normal;
-          entry.uv_index = index_uv;
-          entry.vertex_index = vertices.size() - 1;
+bool SceneManager::LoadCompiledScene(const std::string& path,
+  const CookManifest* cook_manifest, CompiledScene* scene) {
+  core::FileView file;
+  if (!core::FileSystem::Open(path, &file)) {
+    const CookManifest::Asset* cooked = cook_manifest != nullptr ?
+      cook_manifest->FindAsset(path) : nullptr;
+    return cooked != nullptr && !cooked->cache.empty() &&
+      scene->Read(cooked->cache, cooked->source_key);
+  }
 
-          list.push_back(entry);
+  // the compiled scene next to the file is used as long as the file did
+  // not change, the xml stays what is edited
+  const std::string kCachePath = path + kCompiledSceneExtension;
+  const uint64_t kSourceKey =
+    CompiledScene::ComputeSourceKey(file.GetData(), file.GetSize());
+  if (scene_cache_enabled_ && scene->Read(kCachePath, kSourceKey))
+    return true;
+  if (!scene->Compile(file.GetData(), file.GetSize()))
+    return false;
+  if (scene_cache_enabled_)
+    scene->Write(kCachePath, kSourceKey);
+  return true;
+}
 
-          cache.insert(std::pair<int, std::list<CacheEntry>>(index_position, list));
-        }
+void SceneManager::CreateEntity(const CompiledScene& scene,
+  const SceneEntityRecord& record) {
+  IEntity* entity = EntityFactory::GetInstance()->CreateEntity(
+    record.type == SCENE_ENTITY_CAMERA ? "CameraEntity" : "NormalEntity",
+    scene.GetString(record.name));
+  if (entity == nullptr)
+    return;
+  if (RegisterEntity(entity) == kInvalidEntityHandle) {
+    EntityFactory::GetInstance()->DestroyEntity(entity);
+    return;
+  }
+  if (record.transform >= 0)
+    entity->SetTransformation(GetTransformation(scene, record.transform));
+
+  // parents come before their children
+  std::vector<IComponent*> components(record.components_count);
+  for (uint32_t i = 0; i < record.components_count; ++i) {
+    const SceneComponentRecord& component_record =
+      scene.GetComponent(record.first_component + i);
+    const std::string kComponentName = scene.GetString(component_record.name);
+    IComponent* component = ComponentFactory::GetInstance()->CreateComponent(
+      component_record.type == SCENE_COMPONENT_CAMERA ?
+      "CameraComponent" : "MeshComponent", kComponentName);
+    components[i] = component;
+
+    if (component_record.transform >= 0) {
+      component->SetTransformation(
+        GetTransformation(scene, component_record.transform));
+    }
+    if (component_record.type == SCENE_COMPONENT_CAMERA) {
+      CameraComponent* camera_component =
+        static_cast<CameraComponent*>(component);
+      if (component_record.camera >= 0) {
+        SetCamera(scene.GetCamera(component_record.camera),
+          camera_component);
       }
+      // for easy access
+      cameras_.insert(std::pair<std::string, CameraComponent*>(
+        kComponentName, camera_component));
     }
-    else if (strcmp(word, "mtllib") == 0) {
-      in_file >> word;
-
-      const std::string kMaterialFilePath =
-        std::string(MESH_PATH) + std::string(word);
-
-      // load materials from the material file
-      std::ifstream material_filestream(kMaterialFilePath);
-
-      if (!material_filestream) break;
-
-      std::shared_ptr<render::Material> material;
-
-      math::Vector3f base_color;
-      std::string texture_name;
-      bool has_color = false;
-      bool has_texture = false;
-      bool first_material = true;
-      char material_name[64];
-
-      while (1) {
-        material_filestream >> word;
-
-        if (!material_filestream) break;
-
-        // create a new material for current instance
-        if (strcmp(word, "newmtl") == 0) {
-          if (first_material) {
-            material_filestream >> material_name;
-            first_material = false;
-            continue;
-          }
-
-          //  create last/current material
-          if (has_color && has_texture) {
-            material = std::make_shared<render::Material>();
-            /*material->SetShaderType(Shader::ShaderType::TEXTURE_PNT);
-            material->SetColorTextureName(std::string(kTexturePath) +
-              texture_name);
-            material->SetBaseColor(
-              QVector4D(base_color.x(), base_color.y(), base_color.z(), 1.f));
-            material->Initialize();*/
-            materials_.insert(std::pair<std::string, std::shared_ptr<render::Material>>(
-              std::string(material_name), material));
-          }
-          else if (has_color && !has_texture) {
-            material = std::make_shared<render::Material>();
-            /*material->SetShaderType(Shader::ShaderType::COLOR_PNT);
-            material->SetBaseColor(
-              QVector4D(base_color.x(), base_color.y(), base_color.z(), 1.f));
-            material->Initialize();*/
-            materials_.insert(std::pair<std::string, std::shared_ptr<render::Material>>(
-              std::string(material_name), material));
-          }
-
-          material_filestream >> material_name;
-
-          material = nullptr;
-          has_texture = false;
-          texture_name = "";
-          has_color = false;
-        }
-        else if (strcmp(word, "Kd") == 0) {
-          float r, g, b;
-          material_filestream >> r >> g >> b;
-          base_color = math::Vector3f(r, g, b);
-          has_color = true;
-        }
-        else if (strcmp(word, "Ka") == 0) {
-        }
-        else if (strcmp(word, "Ks") == 0) {
-        }
-        else if (strcmp(word, "map_Kd") == 0) {
-          material_filestream >> word;
-          texture_name = std::string(word);
-          has_texture = true;
-
-          auto it = textures_.find(texture_name);
-          if (it == textures_.end()) {
-            std::shared_ptr<render::Texture> texture = std::make_shared<render::Texture>(texture_name);
-            textures_.insert(std::pair<std::string, std::shared_ptr<render::Texture>>(
-              texture_name, texture));
-          }
-        }
-        else if (strcmp(word, "map_Ka") == 0) {
-        }
-        else if (strcmp(word, "map_Ks") == 0) {
-        }
-        else if (strcmp(word, "Ns") == 0) {
-        }
-        else if (strcmp(word, "illum") == 0) {
-        }
-
-        material_filestream.ignore(256, '\n');
+    else {
+      // loaded after the whole file is read
+      for (uint32_t j = 0; j < component_record.meshes_count; ++j) {
+        MeshRequest request;
+        request.name = scene.GetString(
+          scene.GetMeshReference(component_record.first_mesh + j));
+        request.mesh_component = static_cast<MeshComponent*>(component);
+        mesh_requests_.push_back(request);
       }
+    }
 
-      // last material of the file
-      if (has_color && has_texture) {
-        material = std::make_shared<render::Material>();
-        /*material->SetShaderType(Shader::ShaderType::TEXTURE_PNT);
-        material->SetColorTextureName(std::string(kTexturePath) + texture_name);
-        material->SetBaseColor(
-          QVector4D(base_color.x(), base_color.y(), base_color.z(), 1.f));
-        material->Initialize();*/
-        materials_.insert(std::pair<std::string, std::shared_ptr<render::Material>>(
-          std::string(material_name), material));
-       }
-      else if (has_color && !has_texture) {
-        material = std::make_shared<render::Material>();
-        /*material->SetShaderType(Shader::ShaderType::COLOR_PNT);
-        material->SetBaseColor(
-          QVector4D(base_color.x(), base_color.y(), base_color.z(), 1.f));
-        material->Initialize();*/
-        materials_.insert(std::pair<std::string, std::shared_ptr<render::Material>>(
-          std::string(material_name), material));
-      }
+    if (component_record.parent < 0) {
+      entity->AddComponent(component);
     }
-    else if (strcmp(word, "g") == 0) {
-      // group name
-      // in_file >> mesh_name;
+    else {
+      components[component_record.parent - record.first_component]->
+        AddComponent(component);
     }
-    else if (strcmp(word, "usemtl") == 0) {
-      in_file >> word;
+  }
+  entity->Initialize();
+}
 
-      auto it = materials_.find(std::string(word));
-      if (it != materials_.end()) {
-        mesh_component->AddMaterial(it->second);
-      }
+void SceneManager::SetCamera(const SceneCameraRecord& record,
+  CameraComponent* camera_component) {
+  if (record.fields & SCENE_CAMERA_TYPE) {
+    camera_component->SetCameraType(
+      static_cast<CameraComponent::CameraType>(record.type));
+  }
+  if (record.fields & SCENE_CAMERA_LOOKAT) {
+    camera_component->SetLocalLookat(math::Vector3f(record.lookat[0],
+      record.lookat[1], record.lookat[2]));
+  }
+  if (record.fields & SCENE_CAMERA_FOV)
+    camera_component->SetFov(record.fov);
+  if (record.fields & SCENE_CAMERA_ASPECT_RATIO)
+    camera_component->SetAspectRatio(record.aspect_ratio);
+  if (record.fields & SCENE_CAMERA_UP) {
+    camera_component->SetUp(math::Vector3f(record.up[0], record.up[1],
+      record.up[2]));
+  }
+}
 
-      if (is_parsing_faces) {
-        const std::string kMeshName("meshpiece");
-        std::shared_ptr<render::Mesh> mesh = CreateMesh(
-          kMeshName, normals.size() > 0, uvs.size() > 0, vertices, indices);
+math::Transformationf SceneManager::GetTransformation(
+  const CompiledScene& scene, uint32_t transform) {
+  const float* kTranslation = scene.GetTranslation(transform);
+  const float* kRotation = scene.GetRotation(transform);
+  const float* kScale = scene.GetScale(transform);
+  math::Transformationf transformation;
+  transformation.SetTranslation(math::Vector3f(kTranslation[0],
+    kTranslation[1], kTranslation[2]));
+  transformation.SetRotation(math::Quaternionf(kRotation[0], kRotation[1],
+    kRotation[2], kRotation[3]));
+  transformation.SetScale(math::Vector3f(kScale[0], kScale[1], kScale[2]));
+  return transformation;
+}
 
-        vertices.clear();
-        indices.clear();
-        cache.clear();
+void SceneManager::AddToEntityStore(IEntity* entity) {
+  if (!HasOnlyMeshComponents(entity->GetComponents()))
+    return;
 
-        meshes_.insert(std::pair<std::string, std::shared_ptr<render::Mesh>>(
-          kMeshName, mesh));
-        mesh_component->AddMesh(mesh);
-      }
-    }
+  StoreSubtree subtree;
+  subtree.components.push_back(nullptr);
+  subtree.parents.push_back(kInvalidTransformNode);
+  subtree.locals.push_back(entity->GetTransformation());
+  for (const IComponent* component : entity->GetComponents())
+    AddToSubtree(*component, 0, &subtree);
+  const uint32_t kCount = static_cast<uint32_t>(subtree.components.size());
+  const TransformNode kRoot = transform_hierarchy_.AddSubtree(
+    subtree.parents.data(), subtree.locals.data(), kCount);
+  if (kRoot == kInvalidTransformNode)
+    return;
 
-    in_file.ignore(256, '\n');
+  // a removed entity's nodes may be reused, its store entities are not
+  if (transform_entities_.size() < kRoot + kCount)
+    transform_entities_.resize(kRoot + kCount, kInvalidEntityId);
+  for (uint32_t i = 0; i < kCount; ++i) {
+    const EntityId kId = entity_store_.CreateEntity();
+    entity_store_.AddComponent(kId, WorldTransform());
+    if (subtree.components[i] != nullptr) {
+      const MeshComponent* mesh_component =
+        static_cast<const MeshComponent*>(subtree.components[i]);
+      MeshDraw draw;
+      draw.meshes = mesh_component->GetMeshes();
+      draw.materials = mesh_component->GetMaterials();
+      entity_store_.AddComponent(kId, std::move(draw));
+    }
+    transform_entities_[kRoot + i] = kId;
   }
+  entity->SetStoreEntity(&entity_store_, transform_entities_[kRoot],
+    &transform_hierarchy_, kRoot);
+}
 
-  // parsing f to file end
-  if (is_parsing_faces) {
-    const std::string kMeshName(mesh_name);
-    std::shared_ptr<render::Mesh> mesh = CreateMesh(
-      kMeshName, normals.size() > 0, uvs.size() > 0, vertices, indices);
-
-    meshes_.insert(
-      std::pair<std::string, std::shared_ptr<render::Mesh>>(kMeshName, mesh));
-    mesh_component->AddMesh(mesh);
+void SceneManager::RemoveFromEntityStore(const IEntity& entity) {
+  if (!entity.IsInStore())
+    return;
+  const TransformNode kRoot = entity.GetTransformNode();
+  const uint32_t kCount = transform_hierarchy_.GetSubtreeSize(kRoot);
+  for (TransformNode node = kRoot; node < kRoot + kCount; ++node) {
+    entity_store_.DestroyEntity(transform_entities_[node]);
+    transform_entities_[node] = kInvalidEntityId;
+  }
+  transform_hierarchy_.RemoveSubtree(kRoot);
+}
 
-    vertices.clear();
-    indices.clear();
-    cache.clear();
+void SceneManager::UpdateEntities() {
+  // cameras first, the meshes are drawn with the view of this frame
+  for (IEntity* entity : entities_) {
+    if (!entity->IsInStore())
+      entity->Update();
+  }
+  UpdateTransforms();
+  DrawMeshes();
+}
 
-    is_parsing_faces = false;
+void SceneManager::UpdateTransforms() {
+  // only what moved since the last frame is recomputed and copied
+  transform_hierarchy_.Update();
+  for (TransformNode node : transform_hierarchy_.GetChangedNodes()) {
+    entity_store_.GetComponent<WorldTransform>(
+      transform_entities_[node])->local_to_world =
+      transform_hierarchy_.GetWorld(node);
   }
 }
 
+void SceneManager::DrawMeshes() {
+  render::RenderManager* render_manager = render::RenderManager::GetInstance();
+  entity_store_.ParallelForEach<WorldTransform, MeshDraw>(kRowsPerTask,
+    [render_manager](EntityId id, const WorldTransform& world,
+    const MeshDraw& draw) {
+    for (size_t i = 0; i < draw.meshes.size(); ++i) {
+      render::Surface surface;
+      surface.SetMesh(draw.meshes[i]);
+      surface.SetMaterial(draw.materials[i]);
+      surface.SetWorld(world.local_to_world);
+      render_manager->Update(&surface);
+    }
+  });
+}
+
 void SceneManager::GetCurrentCameraMatrix(math::Matrix4f* view, math::Matrix4f* projection) {
   auto it = cameras_.find("current");
   if (it != cameras_.end()) {
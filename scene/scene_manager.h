@@ -1,16 +1,22 @@
 #ifndef MAGNET_SCENE_SCENE_MANAGER_H_
 #define MAGNET_SCENE_SCENE_MANAGER_H_
 
+#include <list>
 #include <map>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
-#include "external\tinyxml2\tinyxml2.h"
-
 #include "math\vector2.h"
 #include "math\vector3.h"
 #include "math\transformation.h"
+#include "core/handle_allocator.h"
+
+#include "asset_loader.h"
+#include "compiled_scene.h"
+#include "entity_store.h"
+#include "transform_hierarchy.h"
 
 namespace magnet {
 namespace render {
@@ -28,19 +34,10 @@ class InputManager;
 class Transformation;
 class MeshComponent;
 
-
-struct Vertex {
-  math::Vector3f position;
-  math::Vector3f normal;
-  math::Vector2f uv;
-};
-
-struct CacheEntry {
-  CacheEntry() : uv_index(-1), normal_index(-1), vertex_index(-1) {}
-  int uv_index;
-  int normal_index;
-  int vertex_index;
-};
+// a generational handle of an entity of the scene manager, see
+// core::HandleAllocator
+typedef core::Handle EntityHandle;
+static const EntityHandle kInvalidEntityHandle = core::kInvalidHandle;
 
 class SceneManager {
  private:
@@ -58,52 +55,144 @@ class SceneManager {
 
   //void OnWindowResize(int width, int height);
 
-  void AddEntity(IEntity* entity);
+  // takes an entity of the EntityFactory whose meshes are loaded, it is
+  // destroyed with DestroyEntity or the scene manager
+  EntityHandle AddEntity(IEntity* entity);
+  // null once the entity is destroyed
+  IEntity* GetEntity(EntityHandle handle) const;
+  // O(1), false for a stale handle. the last entity of GetEntities takes
+  // the place of the destroyed one.
+  bool DestroyEntity(EntityHandle handle);
   std::shared_ptr<render::Material> GetMaterial(std::string name);
 
   std::vector<IEntity*>* GetEntities();
+  // the handles of GetEntities, in the same order
+  const std::vector<EntityHandle>& GetEntityHandles() const;
+  // the entities whose components are all meshes live here as well, one
+  // store entity for the entity and one for each of its components
+  EntityStore* GetEntityStore();
+  // the transforms of the store entities, one node each
+  TransformHierarchy* GetTransformHierarchy();
+  const std::map<std::string, std::shared_ptr<render::Mesh>>& GetMeshes() const;
+  const std::map<std::string, std::shared_ptr<render::Texture>>& GetTextures() const;
   void GetCurrentCameraMatrix(math::Matrix4f* view, math::Matrix4f* projection);
 
- private:
   void SetTextureFolderPath(const std::string& folder_path);
   void SetMeshFolderPath(const std::string& folder_path);
   const std::string& GetTextureFolderPath() const;
   const std::string& GetMeshFolderPath() const;
 
-  void LoadTexture(std::shared_ptr<render::Texture> texture);
-  void LoadMeshObj(const std::string& name, MeshComponent* mesh_component);
+  // scene files are compiled into tables once and read from the compiled
+  // file next to them until they change
+  void SetSceneCacheEnabled(bool enabled);
+  bool IsSceneCacheEnabled() const;
+  // cooked meshes are written to and read from this folder, the mesh folder
+  // if empty
+  void SetMeshCacheFolderPath(const std::string& folder_path);
+  const std::string& GetMeshCacheFolderPath() const;
+  void SetMeshCacheEnabled(bool enabled);
+  bool IsMeshCacheEnabled() const;
+  // cooked textures likewise, the texture folder if empty
+  void SetTextureCacheFolderPath(const std::string& folder_path);
+  const std::string& GetTextureCacheFolderPath() const;
+  void SetTextureCacheEnabled(bool enabled);
+  bool IsTextureCacheEnabled() const;
+
+  // jobs loading assets at the same time, 0 for one per TaskManager thread
+  void SetMaxLoadJobs(int jobs_count);
+  // filter of the mip chains built for textures loaded without one,
+  // MIP_FILTER_NONE keeps the single level
+  void SetMipFilter(MipFilter filter);
+  // block compression of 8 bit textures, TEXTURE_COMPRESSION_NONE keeps
+  // them uncompressed
+  void SetTextureCompression(TextureCompression compression,
+    BcQuality quality);
+  // what 32 bit float textures are stored as, HDR_FORMAT_FLOAT16 by default
+  void SetHdrFormat(HdrFormat format);
+  // called on the thread in LoadSceneFile whenever an asset finished loading
+  void SetLoadProgressCallback(const LoadProgressCallback& callback);
+
+  // loads an xml scene file, or the compiled scene magnet_cook packed
+  // for it
+  void LoadSceneFile(const std::string& path);
+  // destroys every entity and frees the component pool slabs left empty,
+  // the loaded meshes, materials and textures are kept
+  void UnloadScene();
 
-  std::shared_ptr<render::Mesh> CreateMesh(
-    const std::string& name, bool has_normal, bool has_uv,
-    const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+  // create gpu resources of all loaded meshes and textures
+  void CreateRenderResources();
 
-  //  load config file
-  void LoadSceneFile(const std::string& path);
-  void ParseStartingPoint(tinyxml2::XMLElement* element,
-    math::Vector3f* starting_point);
-  void ParseEntity(tinyxml2::XMLElement* element);
-  void ParseComponent(tinyxml2::XMLElement* element, IEntity* entity);
-  void ParseComponent(tinyxml2::XMLElement* element,
-    IComponent* current_component);
-  void ParseCamera(tinyxml2::XMLElement* element, IComponent* component);
-  void ParseTransformation(tinyxml2::XMLElement* element,
-    math::Transformationf* transformation);
-  void ParseTriangleMesh(tinyxml2::XMLElement* element, IComponent* component);
-  void ParseMaterial(tinyxml2::XMLElement* element, IComponent* component);
+  // one frame of the scene. entities outside the store update themselves
+  // first, then the transforms that changed are recomputed and the meshes
+  // of the store drawn as TaskManager tasks. returns once all of them are
+  // done.
+  void UpdateEntities();
+
+ private:
+  // a mesh element of the scene file, loaded after parsing
+  struct MeshRequest {
+    std::string name;
+    MeshComponent* mesh_component;
+  };
+
+  // the components of the scene are created from one slab per type
+  void ReserveComponents(const CompiledScene& scene);
+  void AddMaterials(const std::vector<MtlMaterial>& materials);
+  void AddMeshes(const MeshCacheData& mesh_data,
+    MeshComponent* mesh_component);
+  // bakes the specular cube map and the brdf lut of the sky, adds them to
+  // the textures and hands their names to the render manager
+  void BakeSpecularEnvironment(const render::Texture& sky);
+
+  // the scene from path, compiled now or earlier, or through the manifest
+  // of a packed build without the scene file
+  bool LoadCompiledScene(const std::string& path,
+    const CookManifest* cook_manifest, CompiledScene* scene);
+  void CreateEntity(const CompiledScene& scene,
+    const SceneEntityRecord& record);
+  EntityHandle RegisterEntity(IEntity* entity);
+  void SetCamera(const SceneCameraRecord& record,
+    CameraComponent* camera_component);
+  math::Transformationf GetTransformation(const CompiledScene& scene,
+    uint32_t transform);
+
+  // the entity and its component tree copied into the store if all of
+  // its components are meshes, loaded by then
+  void AddToEntityStore(IEntity* entity);
+  void RemoveFromEntityStore(const IEntity& entity);
+  void RemoveCameras(const std::list<IComponent*>& components);
+  void UpdateTransforms();
+  void DrawMeshes();
 
  private:
   std::vector<IEntity*> entities_;
+  std::vector<EntityHandle> entity_handles_;  // of entities_
+  core::HandleAllocator entity_handle_allocator_;
+  std::vector<uint32_t> entity_positions_;    // in entities_, by index
+  EntityStore entity_store_;
+  TransformHierarchy transform_hierarchy_;
+  std::vector<EntityId> transform_entities_;  // the store entity of a node
 
   std::map<std::string, CameraComponent*> cameras_;
   std::map<std::string, std::shared_ptr<render::Mesh>> meshes_;
   std::map<std::string, std::shared_ptr<render::Material>> materials_;
   std::map<std::string, std::shared_ptr<render::Texture>> textures_;
+  std::shared_ptr<render::Material> default_material_;
+  std::vector<MeshRequest> mesh_requests_;
 
   math::Vector3f starting_point_;
   bool system_enabled_;
 
   std::string mesh_folder_path_;        // folder path of meshes
   std::string texture_folder_path_;     // folder path of textures
+  bool scene_cache_enabled_;
+  std::string mesh_cache_folder_path_;  // folder path of cooked meshes
+  bool mesh_cache_enabled_;
+  std::string texture_cache_folder_path_;   // folder path of cooked textures
+  bool texture_cache_enabled_;
+  int max_load_jobs_;
+  TextureCookDesc texture_cook_;
+  LoadProgressCallback load_progress_callback_;
 };
 }  // namespace scene
 }  // namespace magnet
@@ -0,0 +1,288 @@
+#include <math.h>
+#include <stdint.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "core/hash.h"
+#include "core/parallel_for.h"
+#include "core/simd.h"
+#include "render/texture.h"
+
+#include "sh_projector.h"
+#include "texel_decoder.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+// rows of faces smaller than this are not worth a thread
+static const size_t kMinTexelsPerThread = 32 * 1024;
+
+// a row sums coefficient k, channel c at k * 3 + c and its solid angle last
+static const int kChannelSumsCount = kMaxShCoefficientsCount * 3;
+static const int kRowSumsCount = kChannelSumsCount + 1;
+
+static const float kPi = 3.14159265f;
+
+// the real sh basis up to order 3
+static const float kBasis0 = 0.282095f;
+static const float kBasis1 = 0.488603f;
+static const float kBasis2 = 1.092548f;
+static const float kBasis20 = 0.315392f;
+static const float kBasis22 = 0.546274f;
+
+// direction through texel (u, v) of a face in [-1, 1], each axis as the
+// factors of u, v and 1. d3d cube map face order and orientation.
+static const float kFaceAxes[6][3][3] = {
+  { { 0.f, 0.f, 1.f }, { 0.f, -1.f, 0.f }, { -1.f, 0.f, 0.f } },  // +x
+  { { 0.f, 0.f, -1.f }, { 0.f, -1.f, 0.f }, { 1.f, 0.f, 0.f } },  // -x
+  { { 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f } },    // +y
+  { { 1.f, 0.f, 0.f }, { 0.f, 0.f, -1.f }, { 0.f, -1.f, 0.f } },  // -y
+  { { 1.f, 0.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f } },   // +z
+  { { -1.f, 0.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, -1.f } }  // -z
+};
+
+bool IsSrgb(render::TextureFormat format, bool srgb) {
+  return format == render::TEXTURE_FORMAT_R8G8B8A8_UNORM_SRGB ||
+    (srgb && format != render::TEXTURE_FORMAT_R8G8B8A8_UINT &&
+      format != render::TEXTURE_FORMAT_R16G16B16A16_FLOAT &&
+      format != render::TEXTURE_FORMAT_R32G32B32A32_FLOAT);
+}
+
+inline void EvaluateBasis(float x, float y, float z, float* basis) {
+  basis[0] = kBasis0;
+  basis[1] = kBasis1 * y;
+  basis[2] = kBasis1 * z;
+  basis[3] = kBasis1 * x;
+  basis[4] = kBasis2 * x * y;
+  basis[5] = kBasis2 * y * z;
+  basis[6] = kBasis20 * (3.f * z * z - 1.f);
+  basis[7] = kBasis2 * x * z;
+  basis[8] = kBasis22 * (x * x - y * y);
+}
+
+// texels from x on, the weight of a texel is its solid angle up to a
+// constant, 1 / (1 + u^2 + v^2)^(3/2)
+void ProjectTexels(const float* axes, const float* texels, int x, int width,
+  float v, float* sums) {
+  const float kScale = 2.f / width;
+  for (; x < width; ++x) {
+    const float kU = (x + 0.5f) * kScale - 1.f;
+    const float kLengthSquared = 1.f + kU * kU + v * v;
+    const float kInverseLength = 1.f / sqrtf(kLengthSquared);
+    const float kWeight = kInverseLength / kLengthSquared;
+    float direction[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      direction[axis] = (axes[axis * 3] * kU + axes[axis * 3 + 1] * v +
+        axes[axis * 3 + 2]) * kInverseLength;
+    }
+
+    float basis[kMaxShCoefficientsCount];
+    EvaluateBasis(direction[0], direction[1], direction[2], basis);
+    const float* texel = texels + x * 4;
+    for (int k = 0; k < kMaxShCoefficientsCount; ++k) {
+      const float kFactor = basis[k] * kWeight;
+      sums[k * 3] += texel[0] * kFactor;
+      sums[k * 3 + 1] += texel[1] * kFactor;
+      sums[k * 3 + 2] += texel[2] * kFactor;
+    }
+    sums[kChannelSumsCount] += kWeight;
+  }
+}
+
+#ifdef MAGNET_SSE2
+// four texels a step, one per lane, the rest by ProjectTexels
+void ProjectRowSse2(const float* axes, const float* texels, int width,
+  float v, float* sums) {
+  const float kScale = 2.f / width;
+  const __m128 kOne = _mm_set1_ps(1.f);
+  const __m128 kVSquared = _mm_set1_ps(1.f + v * v);
+  __m128 axis_u[3];
+  __m128 axis_constant[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    axis_u[axis] = _mm_set1_ps(axes[axis * 3]);
+    axis_constant[axis] = _mm_set1_ps(axes[axis * 3 + 1] * v +
+      axes[axis * 3 + 2]);
+  }
+
+  __m128 channel_sums[kChannelSumsCount];
+  for (int i = 0; i < kChannelSumsCount; ++i)
+    channel_sums[i] = _mm_setzero_ps();
+  __m128 weight_sum = _mm_setzero_ps();
+
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128 kX = _mm_add_ps(_mm_cvtepi32_ps(_mm_set_epi32(x + 3, x + 2,
+      x + 1, x)), _mm_set1_ps(0.5f));
+    const __m128 kU = _mm_sub_ps(_mm_mul_ps(kX, _mm_set1_ps(kScale)), kOne);
+    const __m128 kLengthSquared = _mm_add_ps(kVSquared, _mm_mul_ps(kU, kU));
+    const __m128 kInverseLength = _mm_div_ps(kOne, _mm_sqrt_ps(kLengthSquared));
+    const __m128 kWeight = _mm_div_ps(kInverseLength, kLengthSquared);
+    __m128 direction[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      direction[axis] = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(axis_u[axis], kU),
+        axis_constant[axis]), kInverseLength);
+    }
+    const __m128 kDx = direction[0];
+    const __m128 kDy = direction[1];
+    const __m128 kDz = direction[2];
+
+    // the basis times the solid angle
+    __m128 basis[kMaxShCoefficientsCount];
+    const __m128 kWeight1 = _mm_mul_ps(kWeight, _mm_set1_ps(kBasis1));
+    const __m128 kWeight2 = _mm_mul_ps(kWeight, _mm_set1_ps(kBasis2));
+    basis[0] = _mm_mul_ps(kWeight, _mm_set1_ps(kBasis0));
+    basis[1] = _mm_mul_ps(kWeight1, kDy);
+    basis[2] = _mm_mul_ps(kWeight1, kDz);
+    basis[3] = _mm_mul_ps(kWeight1, kDx);
+    basis[4] = _mm_mul_ps(kWeight2, _mm_mul_ps(kDx, kDy));
+    basis[5] = _mm_mul_ps(kWeight2, _mm_mul_ps(kDy, kDz));
+    basis[6] = _mm_mul_ps(_mm_mul_ps(kWeight, _mm_set1_ps(kBasis20)),
+      _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.f), _mm_mul_ps(kDz, kDz)), kOne));
+    basis[7] = _mm_mul_ps(kWeight2, _mm_mul_ps(kDx, kDz));
+    basis[8] = _mm_mul_ps(_mm_mul_ps(kWeight, _mm_set1_ps(kBasis22)),
+      _mm_sub_ps(_mm_mul_ps(kDx, kDx), _mm_mul_ps(kDy, kDy)));
+
+    // rgba texels to a lane per texel
+    __m128 red = _mm_loadu_ps(texels + x * 4);
+    __m128 green = _mm_loadu_ps(texels + x * 4 + 4);
+    __m128 blue = _mm_loadu_ps(texels + x * 4 + 8);
+    __m128 alpha = _mm_loadu_ps(texels + x * 4 + 12);
+    _MM_TRANSPOSE4_PS(red, green, blue, alpha);
+
+    for (int k = 0; k < kMaxShCoefficientsCount; ++k) {
+      channel_sums[k * 3] = _mm_add_ps(channel_sums[k * 3],
+        _mm_mul_ps(red, basis[k]));
+      channel_sums[k * 3 + 1] = _mm_add_ps(channel_sums[k * 3 + 1],
+        _mm_mul_ps(green, basis[k]));
+      channel_sums[k * 3 + 2] = _mm_add_ps(channel_sums[k * 3 + 2],
+        _mm_mul_ps(blue, basis[k]));
+    }
+    weight_sum = _mm_add_ps(weight_sum, kWeight);
+  }
+
+  float lanes[4];
+  for (int i = 0; i < kChannelSumsCount; ++i) {
+    _mm_storeu_ps(lanes, channel_sums[i]);
+    sums[i] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  }
+  _mm_storeu_ps(lanes, weight_sum);
+  sums[kChannelSumsCount] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+  ProjectTexels(axes, texels, x, width, v, sums);
+}
+#endif  // MAGNET_SSE2
+
+struct CachedProjection {
+  math::Vector4f coefficients[kMaxShCoefficientsCount];
+};
+
+std::mutex g_cache_mutex;
+std::unordered_map<uint64_t, CachedProjection> g_cache;
+}  // namespace
+
+bool ShProjector::CanProject(const render::Texture& texture) {
+  if (texture.GetType() != render::TEXTURE_TYPE_CUBE ||
+    texture.GetDataBufferPtr() == nullptr || texture.GetWidth() <= 0 ||
+    texture.GetHeight() <= 0) {
+    return false;
+  }
+  return CanDecodeTexels(texture.GetFormat());
+}
+
+bool ShProjector::Project(const render::Texture& texture, int order,
+  bool srgb, int threads_count, math::Vector4f* coefficients,
+  bool use_simd) {
+  if (order < 1 || order > 3 || !CanProject(texture))
+    return false;
+  const int kWidth = texture.GetWidth();
+  const int kHeight = texture.GetHeight();
+  const int kRowsCount = 6 * kHeight;
+  const size_t kRowPitch = texture.GetRowPitch(0);
+  const uint8_t* data =
+    static_cast<const uint8_t*>(texture.GetDataBufferPtr());
+  std::vector<float> row_sums(static_cast<size_t>(kRowsCount) *
+    kRowSumsCount, 0.f);
+
+  const int kThreadsCount = core::GetParallelThreadsCount(
+    static_cast<size_t>(kWidth) * kRowsCount, kMinTexelsPerThread,
+    threads_count);
+  core::ParallelFor(kRowsCount, kThreadsCount, [&](int begin, int end) {
+    std::vector<float> texels(static_cast<size_t>(kWidth) * 4);
+    for (int row = begin; row < end; ++row) {
+      const int kFace = row / kHeight;
+      const int kY = row % kHeight;
+      DecodeTexels(texture.GetFormat(), srgb, data + kFace *
+        texture.GetFaceSize() + kY * kRowPitch, kWidth, texels.data());
+
+      const float* axes = &kFaceAxes[kFace][0][0];
+      const float kV = (kY + 0.5f) * 2.f / kHeight - 1.f;
+      float* sums = &row_sums[static_cast<size_t>(row) * kRowSumsCount];
+#ifdef MAGNET_SSE2
+      if (use_simd) {
+        ProjectRowSse2(axes, texels.data(), kWidth, kV, sums);
+        continue;
+      }
+#endif
+      ProjectTexels(axes, texels.data(), 0, kWidth, kV, sums);
+    }
+  });
+
+  double totals[kRowSumsCount] = {};
+  for (int row = 0; row < kRowsCount; ++row) {
+    const float* sums = &row_sums[static_cast<size_t>(row) * kRowSumsCount];
+    for (int i = 0; i < kRowSumsCount; ++i)
+      totals[i] += sums[i];
+  }
+
+  // the weights add up to the whole sphere
+  const double kScale = totals[kChannelSumsCount] > 0.0 ?
+    4.0 * kPi / totals[kChannelSumsCount] : 0.0;
+  for (int k = 0; k < order * order; ++k) {
+    coefficients[k] = math::Vector4f(
+      static_cast<float>(totals[k * 3] * kScale),
+      static_cast<float>(totals[k * 3 + 1] * kScale),
+      static_cast<float>(totals[k * 3 + 2] * kScale), 0.f);
+  }
+  return true;
+}
+
+bool ShProjector::ProjectCached(const render::Texture& texture, int order,
+  bool srgb, int threads_count, math::Vector4f* coefficients) {
+  if (order < 1 || order > 3 || !CanProject(texture))
+    return false;
+
+  // the top levels of the faces and what decides how they are read
+  const uint32_t kSettings[4] = { static_cast<uint32_t>(texture.GetFormat()),
+    static_cast<uint32_t>(texture.GetWidth()),
+    static_cast<uint32_t>(texture.GetHeight()),
+    IsSrgb(texture.GetFormat(), srgb) ? 1u : 0u };
+  uint64_t key = core::Hash64(kSettings, sizeof(kSettings));
+  const uint8_t* data =
+    static_cast<const uint8_t*>(texture.GetDataBufferPtr());
+  const size_t kTopSize = texture.GetRowPitch(0) * texture.GetHeight();
+  for (int face = 0; face < 6; ++face)
+    key = core::Hash64(data + face * texture.GetFaceSize(), kTopSize, key);
+
+  {
+    std::lock_guard<std::mutex> guard(g_cache_mutex);
+    auto it = g_cache.find(key);
+    if (it != g_cache.end()) {
+      for (int k = 0; k < order * order; ++k)
+        coefficients[k] = it->second.coefficients[k];
+      return true;
+    }
+  }
+
+  CachedProjection projection;
+  if (!Project(texture, 3, srgb, threads_count, projection.coefficients))
+    return false;
+  for (int k = 0; k < order * order; ++k)
+    coefficients[k] = projection.coefficients[k];
+
+  std::lock_guard<std::mutex> guard(g_cache_mutex);
+  g_cache[key] = projection;
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
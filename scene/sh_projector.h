@@ -0,0 +1,41 @@
+#ifndef MAGNET_SCENE_SH_PROJECTOR_H_
+#define MAGNET_SCENE_SH_PROJECTOR_H_
+
+#include "math/vector4.h"
+
+namespace magnet {
+namespace render {
+class Texture;
+}  // namespace render
+
+namespace scene {
+// coefficients of order 3 spherical harmonics, the most sky lighting uses
+static const int kMaxShCoefficientsCount = 9;
+
+// projects the radiance of a cube map onto real spherical harmonics on the
+// cpu, from the data the texture was loaded with, so nothing is read back
+// from the gpu. every texel of the top level is weighted by the solid angle
+// it covers. coefficients hold linear rgb in x, y and z.
+//
+// rows of the faces are split over threads, four texels of a row are
+// projected at once on sse2. each row sums on its own and the rows are
+// added in order, so the result does not depend on the threads count.
+class ShProjector {
+ public:
+  // cube maps of 8 bit, half and float rgba texels
+  static bool CanProject(const render::Texture& texture);
+
+  // order 2 gives 4 coefficients, order 3 gives 9. srgb decodes 8 bit
+  // unorm texels first, _SRGB formats always. threads_count 0 for all
+  // cores.
+  static bool Project(const render::Texture& texture, int order, bool srgb,
+    int threads_count, math::Vector4f* coefficients, bool use_simd = true);
+
+  // Project, remembering the result by a hash of the texels, the format
+  // and the settings, so a sky seen again is not projected again
+  static bool ProjectCached(const render::Texture& texture, int order,
+    bool srgb, int threads_count, math::Vector4f* coefficients);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_SH_PROJECTOR_H_
@@ -0,0 +1,66 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <mutex>
+
+#include "core/half.h"
+
+#include "texel_decoder.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+float g_srgb_to_linear[256];
+std::once_flag g_table_initialized;
+
+void InitializeTable() {
+  for (int i = 0; i < 256; ++i) {
+    const float kValue = i / 255.f;
+    g_srgb_to_linear[i] = kValue <= 0.04045f ? kValue / 12.92f :
+      powf((kValue + 0.055f) / 1.055f, 2.4f);
+  }
+}
+}  // namespace
+
+bool CanDecodeTexels(render::TextureFormat format) {
+  switch (format) {
+  case render::TEXTURE_FORMAT_R8G8B8A8_UINT:
+  case render::TEXTURE_FORMAT_R8G8B8A8_UNORM:
+  case render::TEXTURE_FORMAT_R8G8B8A8_UNORM_SRGB:
+  case render::TEXTURE_FORMAT_B8G8R8A8_UNORM:
+  case render::TEXTURE_FORMAT_R16G16B16A16_FLOAT:
+  case render::TEXTURE_FORMAT_R32G32B32A32_FLOAT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void DecodeTexels(render::TextureFormat format, bool srgb, const void* data,
+  size_t count, float* rgba) {
+  switch (format) {
+  case render::TEXTURE_FORMAT_R32G32B32A32_FLOAT:
+    memcpy(rgba, data, count * 4 * sizeof(float));
+    return;
+  case render::TEXTURE_FORMAT_R16G16B16A16_FLOAT:
+    core::HalfToFloat(static_cast<const uint16_t*>(data), count * 4, rgba);
+    return;
+  default:
+    break;
+  }
+
+  std::call_once(g_table_initialized, InitializeTable);
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  const bool kSrgb = format == render::TEXTURE_FORMAT_R8G8B8A8_UNORM_SRGB ||
+    (srgb && format != render::TEXTURE_FORMAT_R8G8B8A8_UINT);
+  const bool kBgra = format == render::TEXTURE_FORMAT_B8G8R8A8_UNORM;
+  for (size_t i = 0; i < count * 4; i += 4) {
+    for (int c = 0; c < 3; ++c) {
+      const uint8_t kByte = bytes[i + (kBgra ? 2 - c : c)];
+      rgba[i + c] = kSrgb ? g_srgb_to_linear[kByte] : kByte / 255.f;
+    }
+    rgba[i + 3] = bytes[i + 3] / 255.f;
+  }
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,20 @@
+#ifndef MAGNET_SCENE_TEXEL_DECODER_H_
+#define MAGNET_SCENE_TEXEL_DECODER_H_
+
+#include <stddef.h>
+
+#include "render/texture.h"
+
+namespace magnet {
+namespace scene {
+// 8 bit, half and float rgba texels, what the cpu passes over lighting
+// textures read
+bool CanDecodeTexels(render::TextureFormat format);
+
+// count texels to linear rgba floats. srgb decodes the rgb of 8 bit unorm
+// texels, _SRGB formats always.
+void DecodeTexels(render::TextureFormat format, bool srgb, const void* data,
+  size_t count, float* rgba);
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_TEXEL_DECODER_H_
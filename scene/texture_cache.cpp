@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+
+#include "core/file_system.h"
+#include "core/hash.h"
+#include "render/texture.h"
+
+#include "texture_cache.h"
+#include "texture_cooker.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+static const char kMagic[4] = { 'M', 'T', 'E', 'X' };
+
+// bump kFormatVersion when the layout below changes and kCookerVersion when
+// TextureCooker makes different data from the same source and settings
+static const uint32_t kFormatVersion = 2;
+static const uint32_t kCookerVersion = 2;
+
+static const size_t kDataAlignment = 16;
+static const uint32_t kMaxSize = 16384;       // d3d11 texture2d limit
+static const uint32_t kMaxMipLevels = 15;
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t source_key;
+  uint64_t file_size;
+  uint32_t format;
+  uint32_t type;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mip_levels;
+  uint32_t reserved;
+  uint64_t data_offset;
+  uint64_t data_size;
+};
+
+static_assert(sizeof(FileHeader) % kDataAlignment == 0,
+  "texture cache data would not be aligned");
+
+// the settings that change the cooked data, packed so padding in
+// TextureCookDesc does not reach the hash
+struct CookSettings {
+  uint32_t mip_filter;
+  uint32_t srgb;
+  uint32_t compression;
+  uint32_t quality;
+  uint32_t hdr_format;
+  uint32_t label;                     // normal maps become bc5
+  uint32_t format;                    // srgb or not before loading
+};
+
+size_t GetDataSize(const render::Texture& texture) {
+  return texture.GetFaceSize() *
+    (texture.GetType() == render::TEXTURE_TYPE_CUBE ? 6 : 1);
+}
+}  // namespace
+
+uint64_t TextureCache::ComputeSourceKey(const void* source, size_t size,
+  const TextureCookDesc& desc, const render::Texture& texture) {
+  CookSettings settings;
+  settings.mip_filter = desc.mip_filter;
+  settings.srgb = desc.srgb ? 1 : 0;
+  settings.compression = desc.compression;
+  settings.quality = desc.compression != TEXTURE_COMPRESSION_NONE ?
+    desc.quality : 0;
+  settings.hdr_format = desc.hdr_format;
+  settings.label = texture.GetLabel();
+  settings.format = texture.GetFormat();
+  const uint64_t kSettingsKey = core::Hash64(&settings, sizeof(settings),
+    (static_cast<uint64_t>(kFormatVersion) << 32) | kCookerVersion);
+  return core::Hash64(source, size, kSettingsKey);
+}
+
+bool TextureCache::Write(const std::string& path, uint64_t source_key,
+  const render::Texture& texture) {
+  const void* data = texture.GetDataBufferPtr();
+  if (data == nullptr)
+    return false;
+
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kFormatVersion;
+  header.source_key = source_key;
+  header.format = texture.GetFormat();
+  header.type = texture.GetType();
+  header.width = texture.GetWidth();
+  header.height = texture.GetHeight();
+  header.mip_levels = texture.GetMipLevels();
+  header.data_offset = sizeof(FileHeader);
+  header.data_size = GetDataSize(texture);
+  header.file_size = header.data_offset + header.data_size;
+
+  // written next to the final file and renamed, a reader never sees a
+  // partially written cache
+  const std::string native_path = core::FileSystem::GetNativePath(path);
+  const std::string temp_path = native_path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr)
+    return false;
+
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+    fwrite(data, 1, static_cast<size_t>(header.data_size), file) ==
+      header.data_size;
+
+  written = fclose(file) == 0 && written;
+  if (written) {
+    remove(native_path.c_str());
+    written = rename(temp_path.c_str(), native_path.c_str()) == 0;
+  }
+  if (!written)
+    remove(temp_path.c_str());
+
+  return written;
+}
+
+bool TextureCache::Read(const std::string& path, uint64_t source_key,
+  render::Texture* texture) {
+  core::FileView file;
+  if (!core::FileSystem::Open(path, &file))
+    return false;
+  return Read(file, source_key, texture);
+}
+
+bool TextureCache::Read(const core::FileView& file, uint64_t source_key,
+  render::Texture* texture) {
+  if (!file.IsOpen())
+    return false;
+
+  const char* base = file.GetData();
+  const uint64_t file_size = file.GetSize();
+  if (file_size < sizeof(FileHeader))
+    return false;
+
+  FileHeader header;
+  memcpy(&header, base, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+    header.version != kFormatVersion ||
+    header.source_key != source_key ||
+    header.file_size != file_size ||
+    header.format > render::TEXTURE_FORMAT_BC7_UNORM_SRGB ||
+    header.type > render::TEXTURE_TYPE_CUBE ||
+    header.width == 0 || header.width > kMaxSize ||
+    header.height == 0 || header.height > kMaxSize ||
+    header.mip_levels == 0 || header.mip_levels > kMaxMipLevels ||
+    header.data_offset % kDataAlignment != 0) {
+    return false;
+  }
+
+  // the texture is left alone unless the data matches the header
+  render::Texture layout(texture->GetName());
+  layout.SetFormat(static_cast<render::TextureFormat>(header.format));
+  layout.SetType(static_cast<render::TextureType>(header.type));
+  layout.SetDimension(header.width, header.height);
+  layout.SetMipLevels(header.mip_levels);
+  if (header.data_offset > file_size ||
+    header.data_size != GetDataSize(layout) ||
+    header.data_size > file_size - header.data_offset) {
+    return false;
+  }
+
+  texture->SetFormat(layout.GetFormat());
+  texture->SetType(layout.GetType());
+  texture->SetDimension(header.width, header.height);
+  texture->SetMipLevels(header.mip_levels);
+  texture->SetExternalData(base + header.data_offset, file.GetOwner());
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,46 @@
+#ifndef MAGNET_SCENE_TEXTURE_CACHE_H_
+#define MAGNET_SCENE_TEXTURE_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace magnet {
+namespace core {
+class FileView;
+}  // namespace core
+
+namespace render {
+class Texture;
+}  // namespace render
+
+namespace scene {
+struct TextureCookDesc;
+
+// cooked textures. a file holds a header with the format, type, size and
+// mip levels and the 16 byte aligned data buffer of the texture. it is only
+// valid for the source bytes, cook settings and cooker version whose key is
+// stored in the header. reading maps the file, the texture points into the
+// mapping.
+class TextureCache {
+ public:
+  // hash of the source bytes and the settings they were cooked with,
+  // seeded with the cooker version. texture is the one to be cooked, not
+  // loaded yet: its label and format choose the compressed format too.
+  static uint64_t ComputeSourceKey(const void* source, size_t size,
+    const TextureCookDesc& desc, const render::Texture& texture);
+
+  static bool Write(const std::string& path, uint64_t source_key,
+    const render::Texture& texture);
+
+  // fails if the file is missing, damaged or was cooked from other source
+  // bytes, with other settings or by another cooker version
+  static bool Read(const std::string& path, uint64_t source_key,
+    render::Texture* texture);
+  // the same for a file already read, the texture keeps it alive
+  static bool Read(const core::FileView& file, uint64_t source_key,
+    render::Texture* texture);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_TEXTURE_CACHE_H_
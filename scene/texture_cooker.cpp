@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "core/half.h"
+#include "render/texture.h"
+
+#include "texture_cooker.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+bool HasAlpha(const render::Texture& texture) {
+  const size_t kFacesCount =
+    texture.GetType() == render::TEXTURE_TYPE_CUBE ? 6 : 1;
+  const uint8_t* texels =
+    static_cast<const uint8_t*>(texture.GetDataBufferPtr());
+  // the top level decides, smaller ones are filtered from it
+  const size_t kTexelsCount =
+    static_cast<size_t>(texture.GetWidth()) * texture.GetHeight();
+  for (size_t face = 0; face < kFacesCount; ++face) {
+    const uint8_t* face_texels = texels + face * texture.GetFaceSize();
+    for (size_t i = 0; i < kTexelsCount; ++i) {
+      if (face_texels[i * 4 + 3] != 255)
+        return true;
+    }
+  }
+  return false;
+}
+
+// the packed formats keep the layout of the float one with smaller texels
+bool ConvertHdr(HdrFormat hdr_format, render::Texture* texture) {
+  if (texture->GetFormat() != render::TEXTURE_FORMAT_R32G32B32A32_FLOAT ||
+    hdr_format == HDR_FORMAT_FLOAT32) {
+    return false;
+  }
+
+  const size_t kFacesCount =
+    texture->GetType() == render::TEXTURE_TYPE_CUBE ? 6 : 1;
+  const size_t kTexelsCount = texture->GetFaceSize() * kFacesCount / 16;
+  const float* texels = static_cast<const float*>(texture->GetDataBufferPtr());
+  std::shared_ptr<std::vector<uint8_t>> packed;
+  if (hdr_format == HDR_FORMAT_FLOAT16) {
+    packed = std::make_shared<std::vector<uint8_t>>(kTexelsCount * 8);
+    core::FloatToHalf(texels, kTexelsCount * 4,
+      reinterpret_cast<uint16_t*>(packed->data()));
+    texture->SetFormat(render::TEXTURE_FORMAT_R16G16B16A16_FLOAT);
+  }
+  else {
+    packed = std::make_shared<std::vector<uint8_t>>(kTexelsCount * 4);
+    core::FloatToRgb9e5(texels, kTexelsCount,
+      reinterpret_cast<uint32_t*>(packed->data()));
+    texture->SetFormat(render::TEXTURE_FORMAT_R9G9B9E5_SHAREDEXP);
+  }
+  const uint8_t* data = packed->data();
+  texture->SetExternalData(data, std::move(packed));
+  return true;
+}
+
+bool GetCompressedFormat(const TextureCookDesc& desc,
+  const render::Texture& texture, render::TextureFormat* format) {
+  bool srgb = false;
+  switch (texture.GetFormat()) {
+  case render::TEXTURE_FORMAT_R8G8B8A8_UNORM:
+    break;
+  case render::TEXTURE_FORMAT_R8G8B8A8_UNORM_SRGB:
+    srgb = true;
+    break;
+  default:
+    return false;
+  }
+
+  if (texture.GetLabel() == render::TEXTURE_LABEL_NORMAL) {
+    *format = render::TEXTURE_FORMAT_BC5_UNORM;
+    return true;
+  }
+  switch (desc.compression) {
+  case TEXTURE_COMPRESSION_BC:
+    if (HasAlpha(texture)) {
+      *format = srgb ? render::TEXTURE_FORMAT_BC3_UNORM_SRGB :
+        render::TEXTURE_FORMAT_BC3_UNORM;
+    }
+    else {
+      *format = srgb ? render::TEXTURE_FORMAT_BC1_UNORM_SRGB :
+        render::TEXTURE_FORMAT_BC1_UNORM;
+    }
+    return true;
+  case TEXTURE_COMPRESSION_BC7:
+    *format = srgb ? render::TEXTURE_FORMAT_BC7_UNORM_SRGB :
+      render::TEXTURE_FORMAT_BC7_UNORM;
+    return true;
+  default:
+    return false;
+  }
+}
+}  // namespace
+
+bool TextureCooker::Cook(const TextureCookDesc& desc,
+  render::Texture* texture) {
+  if (texture->GetDataBufferPtr() == nullptr)
+    return false;
+
+  if (desc.mip_filter != MIP_FILTER_NONE &&
+    MipGenerator::CanGenerate(*texture)) {
+    MipGeneratorDesc mip_desc;
+    mip_desc.filter = desc.mip_filter;
+    mip_desc.srgb = desc.srgb;
+    mip_desc.threads_count = desc.threads_count;
+    MipGenerator::Generate(mip_desc, texture);
+  }
+  if (ConvertHdr(desc.hdr_format, texture))
+    return true;
+
+  render::TextureFormat format;
+  if (desc.compression == TEXTURE_COMPRESSION_NONE ||
+    !GetCompressedFormat(desc, *texture, &format)) {
+    return true;
+  }
+
+  // every level of every face, into a buffer laid out for the new format
+  const int kFacesCount =
+    texture->GetType() == render::TEXTURE_TYPE_CUBE ? 6 : 1;
+  const int kMipLevels = texture->GetMipLevels();
+  size_t face_size = 0;
+  for (int level = 0; level < kMipLevels; ++level) {
+    face_size += render::GetSurfaceSize(format, texture->GetMipWidth(level),
+      texture->GetMipHeight(level));
+  }
+  std::shared_ptr<std::vector<uint8_t>> blocks =
+    std::make_shared<std::vector<uint8_t>>(face_size * kFacesCount);
+
+  const uint8_t* texels =
+    static_cast<const uint8_t*>(texture->GetDataBufferPtr());
+  for (int face = 0; face < kFacesCount; ++face) {
+    const uint8_t* face_texels = texels + face * texture->GetFaceSize();
+    uint8_t* output = blocks->data() + face * face_size;
+    for (int level = 0; level < kMipLevels; ++level) {
+      const int kWidth = texture->GetMipWidth(level);
+      const int kHeight = texture->GetMipHeight(level);
+      BcEncoder::EncodeSurface(format, desc.quality,
+        face_texels + texture->GetMipOffset(level), kWidth, kHeight,
+        texture->GetRowPitch(level), desc.threads_count, output);
+      output += render::GetSurfaceSize(format, kWidth, kHeight);
+    }
+  }
+
+  texture->SetFormat(format);
+  const uint8_t* data = blocks->data();
+  texture->SetExternalData(data, std::move(blocks));
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,49 @@
+#ifndef MAGNET_SCENE_TEXTURE_COOKER_H_
+#define MAGNET_SCENE_TEXTURE_COOKER_H_
+
+#include "bc_encoder.h"
+#include "mip_generator.h"
+
+namespace magnet {
+namespace render {
+class Texture;
+}  // namespace render
+
+namespace scene {
+enum TextureCompression {
+  TEXTURE_COMPRESSION_NONE,
+  TEXTURE_COMPRESSION_BC,     // bc1, bc3 with alpha, bc5 for normal maps
+  TEXTURE_COMPRESSION_BC7     // bc7, bc5 for normal maps
+};
+
+// what 32 bit float textures, hdr environment maps mostly, are stored as
+enum HdrFormat {
+  HDR_FORMAT_FLOAT32,
+  HDR_FORMAT_FLOAT16,     // half the size, below visible error for lighting
+  HDR_FORMAT_RGB9E5       // a quarter, drops alpha
+};
+
+struct TextureCookDesc {
+  TextureCookDesc() : mip_filter(MIP_FILTER_BOX), srgb(true),
+    compression(TEXTURE_COMPRESSION_BC), quality(BC_QUALITY_NORMAL),
+    hdr_format(HDR_FORMAT_FLOAT16), threads_count(0) {}
+  MipFilter mip_filter;             // chains for textures without mips
+  bool srgb;                        // 8 bit colors are srgb encoded
+  TextureCompression compression;
+  BcQuality quality;
+  HdrFormat hdr_format;
+  int threads_count;                // 0 for all cores
+};
+
+// turns a loaded texture into what the gpu gets: builds the mip chain it
+// lacks and block compresses 8 bit unorm textures, _srgb formats stay srgb.
+// 32 bit float textures are converted to hdr_format after their mips are
+// filtered at full precision, integer ones keep their format. the new
+// data replaces the data buffer of the texture.
+class TextureCooker {
+ public:
+  static bool Cook(const TextureCookDesc& desc, render::Texture* texture);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_TEXTURE_COOKER_H_
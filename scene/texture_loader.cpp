@@ -0,0 +1,358 @@
+#include <assert.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <mutex>
+#ifdef _WIN32
+#include "external\IL\il.h"
+#endif
+
+#include "core/half.h"
+#include "core/file_system.h"
+#include "core/parallel_for.h"
+#include "core/simd.h"
+#include "render\texture.h"
+
+#include "dds_reader.h"
+#include "png_decoder.h"
+#include "texture_cache.h"
+#include "texture_cooker.h"
+#include "texture_loader.h"
+#include "tga_decoder.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+bool HasExtension(const std::string& name, const char* extension) {
+  const size_t kLength = strlen(extension);
+  if (name.size() < kLength)
+    return false;
+  for (size_t i = 0; i < kLength; ++i) {
+    if (tolower(name[name.size() - kLength + i]) != extension[i])
+      return false;
+  }
+  return true;
+}
+
+// cube maps are six files, <name>_c00.<extension> to <name>_c05
+std::string GetCubeFacePath(const std::string& folder_path,
+  const std::string& name, int face) {
+  const size_t kDot = name.rfind('.');
+  std::string path = folder_path + name.substr(0, kDot) + "_c0";
+  path += static_cast<char>('0' + face);
+  if (kDot != std::string::npos)
+    path += name.substr(kDot);
+  return path;
+}
+
+// a png or tga file, decoded without shared state
+struct BuiltinImage {
+  core::FileView file;
+  bool png;
+  int width;
+  int height;
+};
+
+bool OpenBuiltin(const std::string& path, BuiltinImage* image) {
+  if (!core::FileSystem::Open(path, &image->file))
+    return false;
+  const char* kData = image->file.GetData();
+  const size_t kSize = image->file.GetSize();
+  image->png = PngDecoder::IsPng(kData, kSize);
+  if (!image->png && !HasExtension(path, ".tga"))
+    return false;
+  return image->png ?
+    PngDecoder::ReadSize(kData, kSize, &image->width, &image->height) :
+    TgaDecoder::ReadSize(kData, kSize, &image->width, &image->height);
+}
+
+bool DecodeBuiltin(const BuiltinImage& image, unsigned char* rgba) {
+  const size_t kPitch = static_cast<size_t>(image.width) * 4;
+  return image.png ?
+    PngDecoder::Decode(image.file.GetData(), image.file.GetSize(), rgba,
+      kPitch) :
+    TgaDecoder::Decode(image.file.GetData(), image.file.GetSize(), rgba,
+      kPitch);
+}
+
+// png and tga decode straight into the texture
+bool LoadBuiltin(const std::string& path, render::Texture* texture) {
+  BuiltinImage image;
+  if (!OpenBuiltin(path, &image))
+    return false;
+
+  texture->SetDimension(image.width, image.height);
+  unsigned char* data = static_cast<unsigned char*>(
+    texture->CreateDataBuffer());
+  const bool kDecoded = data != nullptr && DecodeBuiltin(image, data);
+  if (!kDecoded)
+    texture->DestroyDataBuffer();
+  return kDecoded;
+}
+
+// the six faces decode on their own threads, each into its slice of the
+// cube data buffer
+bool LoadBuiltinCube(const std::string& folder_path, int threads_count,
+  render::Texture* texture) {
+  BuiltinImage faces[6];
+  for (int face = 0; face < 6; ++face) {
+    if (!OpenBuiltin(GetCubeFacePath(folder_path, texture->GetName(), face),
+      &faces[face])) {
+      return false;
+    }
+    if (faces[face].width != faces[0].width ||
+      faces[face].height != faces[0].height) {
+      return false;
+    }
+  }
+
+  texture->SetDimension(faces[0].width, faces[0].height);
+  unsigned char* data = static_cast<unsigned char*>(
+    texture->CreateDataBuffer());
+  if (data == nullptr)
+    return false;
+
+  const size_t kFaceSize = texture->GetFaceSize();
+  bool decoded[6] = {};
+  core::ParallelFor(6, core::GetParallelThreadsCount(6, 1, threads_count),
+    [&](int begin, int end) {
+    for (int face = begin; face < end; ++face)
+      decoded[face] = DecodeBuiltin(faces[face], data + face * kFaceSize);
+  });
+  for (int face = 0; face < 6; ++face) {
+    if (!decoded[face]) {
+      texture->DestroyDataBuffer();
+      return false;
+    }
+  }
+  return true;
+}
+
+// dds files keep their format and mip chain, the texture points into the
+// mapped file or archive and nothing is decoded or copied before the gpu
+// upload
+bool LoadDds(const std::string& path, render::Texture* texture) {
+  core::FileView file;
+  if (!core::FileSystem::Open(path, &file))
+    return false;
+
+  DdsInfo info;
+  if (!DdsReader::ReadInfo(file.GetData(), file.GetSize(), &info))
+    return false;
+
+  texture->SetFormat(info.format);
+  texture->SetType(info.type);
+  texture->SetDimension(info.width, info.height);
+  texture->SetMipLevels(info.mip_levels);
+  const char* pixels = file.GetData() + info.data_offset;
+  texture->SetExternalData(pixels, file.GetOwner());
+  return true;
+}
+
+#ifdef _WIN32
+// the faces of large cube maps are written once and not read again before
+// the upload, non temporal stores keep them from evicting the cache
+void CopyStreaming(void* destination, const void* source, size_t size) {
+  unsigned char* output = static_cast<unsigned char*>(destination);
+  const unsigned char* input = static_cast<const unsigned char*>(source);
+  size_t i = 0;
+#ifdef MAGNET_SSE2
+  if ((reinterpret_cast<uintptr_t>(output) & 15) == 0) {
+    for (; i + 64 <= size; i += 64) {
+      for (int k = 0; k < 64; k += 16) {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(output + i + k),
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + k)));
+      }
+    }
+    _mm_sfence();
+  }
+#endif  // MAGNET_SSE2
+  memcpy(output + i, input + i, size - i);
+}
+
+std::mutex& GetDevilMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// devil decodes the bytes the file system found, the image type comes
+// from the extension as not every format has a signature
+bool LoadDevilImage(const std::string& path) {
+  core::FileView file;
+  if (!core::FileSystem::Open(path, &file))
+    return false;
+  return ilLoadL(ilTypeFromExt(path.c_str()), file.GetData(),
+    static_cast<ILuint>(file.GetSize())) == IL_TRUE;
+}
+
+bool LoadWithDevil(const std::string& folder_path, render::Texture* texture) {
+  // devil keeps the bound image and its settings in globals
+  std::lock_guard<std::mutex> guard(GetDevilMutex());
+  static std::once_flag devil_initialized;
+  std::call_once(devil_initialized, []() { ilInit(); });
+
+  if (texture->GetType() == render::TEXTURE_TYPE_2D) {
+    std::string path = folder_path + texture->GetName();
+
+    // load images using IL
+    unsigned int uTextureID;
+    ilGenImages(1, &uTextureID);
+    ilBindImage(uTextureID);
+
+    // the formatting setting influences of Texture loading, so must be set up before loading
+    ilEnable(IL_FORMAT_SET);
+    ilSetInteger(IL_FORMAT_MODE, IL_RGBA); // assume all textures are rgba
+
+    if (!LoadDevilImage(path)) {
+      ilDeleteImage(uTextureID);
+      return false;
+    }
+
+    int iWidth = ilGetInteger(IL_IMAGE_WIDTH);
+    int iHeight = ilGetInteger(IL_IMAGE_HEIGHT);
+
+    texture->SetDimension(iWidth, iHeight);
+
+    void* pData = texture->CreateDataBuffer();
+
+    if (texture->GetFormat() == render::TEXTURE_FORMAT_R8G8B8A8_UINT ||
+      texture->GetFormat() == render::TEXTURE_FORMAT_R8G8B8A8_UNORM) {
+      assert(ilGetInteger(IL_IMAGE_TYPE) == IL_UNSIGNED_BYTE);
+
+      memcpy(pData, ilGetData(), 4 * iWidth * iHeight);
+    }
+
+    ilDeleteImage(uTextureID);
+  }
+  // load 6 cube map textures
+  else if (texture->GetType() == render::TEXTURE_TYPE_CUBE) {
+    unsigned char* data = nullptr;
+    for (int i = 0; i < 6; ++i) {
+      const std::string kPath =
+        GetCubeFacePath(folder_path, texture->GetName(), i);
+
+      // load images using IL
+      unsigned int uTextureID;
+      ilGenImages(1, &uTextureID);
+      ilBindImage(uTextureID);
+
+      // the formatting setting influences of Texture loading, so must be set up before loading
+      ilEnable(IL_FORMAT_SET);
+      ilSetInteger(IL_FORMAT_MODE, IL_RGBA); // assume all textures are rgba
+
+      if (!LoadDevilImage(kPath)) {
+        ilDeleteImage(uTextureID);
+        texture->DestroyDataBuffer();
+        return false;
+      }
+
+      int w = ilGetInteger(IL_IMAGE_WIDTH);
+      int h = ilGetInteger(IL_IMAGE_HEIGHT);
+
+      if (i == 0) {
+        texture->SetDimension(w, h);
+        data = static_cast<unsigned char*>(texture->CreateDataBuffer());
+      }
+      if (data == nullptr || w != texture->GetWidth() ||
+        h != texture->GetHeight()) {
+        ilDeleteImage(uTextureID);
+        texture->DestroyDataBuffer();
+        return false;
+      }
+
+      const size_t kTexelsCount = static_cast<size_t>(w) * h;
+      unsigned char* face_data = data + i * texture->GetFaceSize();
+      if (texture->GetFormat() == render::TEXTURE_FORMAT_R32G32B32A32_FLOAT) {
+        assert(ilGetInteger(IL_IMAGE_TYPE) == IL_FLOAT);
+
+        CopyStreaming(face_data, ilGetData(), kTexelsCount * 16);
+      }
+      else if (texture->GetFormat() ==
+        render::TEXTURE_FORMAT_R16G16B16A16_FLOAT) {
+        assert(ilGetInteger(IL_IMAGE_TYPE) == IL_FLOAT);
+
+        core::FloatToHalf(reinterpret_cast<const float*>(ilGetData()),
+          kTexelsCount * 4, reinterpret_cast<uint16_t*>(face_data));
+      }
+      else if (render::GetFormatBytes(texture->GetFormat()) == 4 &&
+        !render::IsBlockCompressed(texture->GetFormat())) {
+        assert(ilGetInteger(IL_IMAGE_TYPE) == IL_UNSIGNED_BYTE);
+
+        CopyStreaming(face_data, ilGetData(), kTexelsCount * 4);
+      }
+
+      ilDeleteImage(uTextureID);
+    }
+  }
+
+  return true;
+}
+#endif  // _WIN32
+}  // namespace
+
+bool TextureLoader::Load(const std::string& folder_path,
+  render::Texture* texture, int threads_count) {
+  if (HasExtension(texture->GetName(), ".dds") &&
+    LoadDds(folder_path + texture->GetName(), texture)) {
+    return true;
+  }
+
+  const render::TextureFormat kFormat = texture->GetFormat();
+  if (kFormat == render::TEXTURE_FORMAT_R8G8B8A8_UINT ||
+    kFormat == render::TEXTURE_FORMAT_R8G8B8A8_UNORM) {
+    if (texture->GetType() == render::TEXTURE_TYPE_2D &&
+      LoadBuiltin(folder_path + texture->GetName(), texture)) {
+      return true;
+    }
+    if (texture->GetType() == render::TEXTURE_TYPE_CUBE &&
+      LoadBuiltinCube(folder_path, threads_count, texture)) {
+      return true;
+    }
+  }
+
+  // other formats, float cube maps and dds files the reader does not
+  // support, devil ships for windows only
+#ifdef _WIN32
+  return LoadWithDevil(folder_path, texture);
+#else
+  return false;
+#endif
+}
+
+bool TextureLoader::LoadCooked(const std::string& folder_path,
+  const TextureCookDesc& desc, const std::string& cache_path,
+  render::Texture* texture) {
+  core::FileView source;
+  if (!cache_path.empty())
+    core::FileSystem::Open(folder_path + texture->GetName(), &source);
+  return LoadCooked(folder_path, desc, source, core::FileView(), cache_path,
+    texture);
+}
+
+bool TextureLoader::LoadCooked(const std::string& folder_path,
+  const TextureCookDesc& desc, const core::FileView& source,
+  const core::FileView& cache, const std::string& cache_path,
+  render::Texture* texture) {
+  // the cooked texture is used as long as the source bytes did not change.
+  // cube maps of six files have no single source and are cooked every time.
+  const bool kUseCache = !cache_path.empty() && source.IsOpen();
+  const uint64_t kSourceKey = kUseCache ? TextureCache::ComputeSourceKey(
+    source.GetData(), source.GetSize(), desc, *texture) : 0;
+  if (kUseCache && (cache.IsOpen() ?
+    TextureCache::Read(cache, kSourceKey, texture) :
+    TextureCache::Read(cache_path, kSourceKey, texture))) {
+    return true;
+  }
+
+  if (!Load(folder_path, texture, desc.threads_count))
+    return false;
+  TextureCooker::Cook(desc, texture);
+
+  if (kUseCache)
+    TextureCache::Write(cache_path, kSourceKey, *texture);
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,46 @@
+#ifndef MAGNET_SCENE_TEXTURE_LOADER_H_
+#define MAGNET_SCENE_TEXTURE_LOADER_H_
+
+#include <string>
+
+namespace magnet {
+namespace core {
+class FileView;
+}  // namespace core
+
+namespace render {
+class Texture;
+}  // namespace render
+
+namespace scene {
+struct TextureCookDesc;
+
+// decodes the image files of a texture into its data buffer. dds files are
+// mapped and used as they are, with their own format and mip levels. 8 bit
+// png and tga files are decoded by PngDecoder and TgaDecoder, several at a
+// time. cube maps are read from six files named <name>_c00 to <name>_c05,
+// 8 bit ones decode their faces on threads_count threads, 0 for all cores,
+// straight into the cube buffer. other files go through devil one at a
+// time. may be called from any thread.
+class TextureLoader {
+ public:
+  static bool Load(const std::string& folder_path, render::Texture* texture,
+    int threads_count = 0);
+
+  // loads and cooks the texture, or reads what an earlier call cooked from
+  // the same source and settings from the cache file. an empty cache_path
+  // cooks every time.
+  static bool LoadCooked(const std::string& folder_path,
+    const TextureCookDesc& desc, const std::string& cache_path,
+    render::Texture* texture);
+  // the same with the source and maybe the cache file already read. a
+  // source view that is not open skips the cache, a cache view that is not
+  // open is read from cache_path.
+  static bool LoadCooked(const std::string& folder_path,
+    const TextureCookDesc& desc, const core::FileView& source,
+    const core::FileView& cache, const std::string& cache_path,
+    render::Texture* texture);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_TEXTURE_LOADER_H_
@@ -0,0 +1,244 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "core/simd.h"
+
+#include "tga_decoder.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+static const size_t kHeaderSize = 18;
+
+enum ImageType {
+  IMAGE_COLOR_MAPPED = 1,
+  IMAGE_TRUECOLOR = 2,
+  IMAGE_GRAY = 3,
+  IMAGE_RLE_COLOR_MAPPED = 9,
+  IMAGE_RLE_TRUECOLOR = 10,
+  IMAGE_RLE_GRAY = 11
+};
+
+struct Header {
+  int image_type;
+  int color_map_first;
+  int color_map_length;
+  int color_map_depth;
+  int width;
+  int height;
+  int depth;
+  int alpha_bits;
+  bool top_to_bottom;
+  bool right_to_left;
+  size_t color_map_offset;
+  size_t pixels_offset;
+};
+
+inline int ReadUint16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+bool ReadHeader(const uint8_t* data, size_t size, Header* header) {
+  if (size < kHeaderSize)
+    return false;
+
+  header->image_type = data[2];
+  header->color_map_first = ReadUint16(data + 3);
+  header->color_map_length = ReadUint16(data + 5);
+  header->color_map_depth = data[7];
+  header->width = ReadUint16(data + 12);
+  header->height = ReadUint16(data + 14);
+  header->depth = data[16];
+  header->alpha_bits = data[17] & 15;
+  header->right_to_left = (data[17] & 0x10) != 0;
+  header->top_to_bottom = (data[17] & 0x20) != 0;
+  header->color_map_offset = kHeaderSize + data[0];
+  header->pixels_offset = header->color_map_offset + (data[1] == 1 ?
+    static_cast<size_t>(header->color_map_length) *
+    ((header->color_map_depth + 7) / 8) : 0);
+  if (header->width == 0 || header->height == 0 ||
+    header->pixels_offset > size) {
+    return false;
+  }
+
+  switch (header->image_type) {
+  case IMAGE_COLOR_MAPPED:
+  case IMAGE_RLE_COLOR_MAPPED:
+    return data[1] == 1 && header->depth == 8 &&
+      (header->color_map_depth == 15 || header->color_map_depth == 16 ||
+        header->color_map_depth == 24 || header->color_map_depth == 32);
+  case IMAGE_TRUECOLOR:
+  case IMAGE_RLE_TRUECOLOR:
+    return header->depth == 15 || header->depth == 16 ||
+      header->depth == 24 || header->depth == 32;
+  case IMAGE_GRAY:
+  case IMAGE_RLE_GRAY:
+    return header->depth == 8 || header->depth == 16;
+  default:
+    return false;
+  }
+}
+
+// one stored pixel, bgr(a), a1r5g5b5 or gray(alpha), to rgba
+void ConvertPixel(const uint8_t* p, int depth, bool gray, bool has_alpha,
+  uint8_t* rgba) {
+  if (gray) {
+    rgba[0] = p[0];
+    rgba[1] = p[0];
+    rgba[2] = p[0];
+    rgba[3] = depth == 16 && has_alpha ? p[1] : 255;
+    return;
+  }
+
+  switch (depth) {
+  case 15:
+  case 16: {
+    const int kValue = ReadUint16(p);
+    const int kRed = (kValue >> 10) & 31;
+    const int kGreen = (kValue >> 5) & 31;
+    const int kBlue = kValue & 31;
+    rgba[0] = static_cast<uint8_t>((kRed << 3) | (kRed >> 2));
+    rgba[1] = static_cast<uint8_t>((kGreen << 3) | (kGreen >> 2));
+    rgba[2] = static_cast<uint8_t>((kBlue << 3) | (kBlue >> 2));
+    rgba[3] = depth == 16 && has_alpha && !(kValue & 0x8000) ? 0 : 255;
+    break;
+  }
+  case 24:
+    rgba[0] = p[2];
+    rgba[1] = p[1];
+    rgba[2] = p[0];
+    rgba[3] = 255;
+    break;
+  case 32:
+    rgba[0] = p[2];
+    rgba[1] = p[1];
+    rgba[2] = p[0];
+    rgba[3] = has_alpha ? p[3] : 255;
+    break;
+  }
+}
+
+// bgra to rgba, alpha forced opaque if the file has no alpha bits
+void SwizzleRow(const uint8_t* src, uint8_t* dst, int width, bool has_alpha) {
+  const uint32_t kOpaque = has_alpha ? 0 : 0xff000000u;
+  int x = 0;
+#ifdef MAGNET_SSE2
+  const __m128i kGreenAlpha = _mm_set1_epi32(0xff00ff00);
+  const __m128i kLowByte = _mm_set1_epi32(0xff);
+  const __m128i kAlpha = _mm_set1_epi32(static_cast<int>(kOpaque));
+  for (; x + 4 <= width; x += 4) {
+    const __m128i kPixels =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+    const __m128i kRed = _mm_and_si128(_mm_srli_epi32(kPixels, 16), kLowByte);
+    const __m128i kBlue = _mm_slli_epi32(_mm_and_si128(kPixels, kLowByte), 16);
+    const __m128i kResult = _mm_or_si128(_mm_or_si128(
+      _mm_and_si128(kPixels, kGreenAlpha), _mm_or_si128(kRed, kBlue)), kAlpha);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), kResult);
+  }
+#endif  // MAGNET_SSE2
+  for (; x < width; ++x) {
+    uint32_t pixel;
+    memcpy(&pixel, src + x * 4, 4);
+    pixel = (pixel & 0xff00ff00u) | ((pixel >> 16) & 0xff) |
+      ((pixel & 0xff) << 16) | kOpaque;
+    memcpy(dst + x * 4, &pixel, 4);
+  }
+}
+}  // namespace
+
+bool TgaDecoder::ReadSize(const void* data, size_t size, int* width,
+  int* height) {
+  Header header;
+  if (!ReadHeader(static_cast<const uint8_t*>(data), size, &header))
+    return false;
+  *width = header.width;
+  *height = header.height;
+  return true;
+}
+
+bool TgaDecoder::Decode(const void* data, size_t size, unsigned char* rgba,
+  size_t pitch) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  Header header;
+  if (!ReadHeader(bytes, size, &header))
+    return false;
+
+  const bool kColorMapped = header.image_type == IMAGE_COLOR_MAPPED ||
+    header.image_type == IMAGE_RLE_COLOR_MAPPED;
+  const bool kGray = header.image_type == IMAGE_GRAY ||
+    header.image_type == IMAGE_RLE_GRAY;
+  const bool kRle = header.image_type >= IMAGE_RLE_COLOR_MAPPED;
+  const bool kHasAlpha = header.alpha_bits > 0;
+  const size_t kPixelBytes = (header.depth + 7) / 8;
+  const uint8_t* pixels = bytes + header.pixels_offset;
+  const size_t kPixelsSize = size - header.pixels_offset;
+  const size_t kPixelsCount =
+    static_cast<size_t>(header.width) * header.height;
+
+  // uncompressed 32 bit files, the common case, swizzle whole rows
+  if (!kRle && !kColorMapped && !kGray && header.depth == 32 &&
+    !header.right_to_left) {
+    if (kPixelsSize < kPixelsCount * 4)
+      return false;
+    for (int y = 0; y < header.height; ++y) {
+      const int kRow = header.top_to_bottom ? y : header.height - 1 - y;
+      SwizzleRow(pixels + static_cast<size_t>(y) * header.width * 4,
+        rgba + kRow * pitch, header.width, kHasAlpha);
+    }
+    return true;
+  }
+
+  uint8_t color_map[256][4];
+  if (kColorMapped) {
+    memset(color_map, 0, sizeof(color_map));
+    const size_t kEntryBytes = (header.color_map_depth + 7) / 8;
+    const uint8_t* entries = bytes + header.color_map_offset;
+    for (int i = 0; i < header.color_map_length; ++i) {
+      const int kIndex = header.color_map_first + i;
+      if (kIndex < 256) {
+        ConvertPixel(entries + i * kEntryBytes, header.color_map_depth, false,
+          kHasAlpha || header.color_map_depth == 32, color_map[kIndex]);
+      }
+    }
+  }
+
+  // pixels are stored in file order, rle packets may cross rows
+  const uint8_t* p = pixels;
+  const uint8_t* end = bytes + size;
+  size_t index = 0;
+  int run_left = 0;
+  bool run_repeats = false;
+  while (index < kPixelsCount) {
+    if (kRle && run_left == 0) {
+      if (p >= end)
+        return false;
+      run_repeats = (*p & 0x80) != 0;
+      run_left = (*p & 0x7f) + 1;
+      ++p;
+    }
+    if (static_cast<size_t>(end - p) < kPixelBytes)
+      return false;
+
+    uint8_t pixel[4];
+    if (kColorMapped)
+      memcpy(pixel, color_map[*p], 4);
+    else
+      ConvertPixel(p, header.depth, kGray, kHasAlpha, pixel);
+
+    // a repeated pixel is read once at the end of its run
+    if (!kRle || !run_repeats || run_left == 1)
+      p += kPixelBytes;
+    if (kRle)
+      --run_left;
+
+    const int kX = static_cast<int>(index % header.width);
+    const int kY = static_cast<int>(index / header.width);
+    const int kColumn = header.right_to_left ? header.width - 1 - kX : kX;
+    const int kRow = header.top_to_bottom ? kY : header.height - 1 - kY;
+    memcpy(rgba + kRow * pitch + kColumn * 4, pixel, 4);
+    ++index;
+  }
+  return true;
+}
+}  // namespace scene
+}  // namespace magnet
@@ -0,0 +1,22 @@
+#ifndef MAGNET_SCENE_TGA_DECODER_H_
+#define MAGNET_SCENE_TGA_DECODER_H_
+
+#include <stddef.h>
+
+namespace magnet {
+namespace scene {
+// decodes truecolor, grayscale and color mapped tga files, run length
+// encoded or not, to 8 bit rgba. images without alpha bits get opaque
+// alpha. reentrant, nothing is shared between calls.
+class TgaDecoder {
+ public:
+  static bool ReadSize(const void* data, size_t size, int* width, int* height);
+
+  // writes the rows top to bottom whatever the origin of the file,
+  // pitch bytes apart
+  static bool Decode(const void* data, size_t size, unsigned char* rgba,
+    size_t pitch);
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_TGA_DECODER_H_
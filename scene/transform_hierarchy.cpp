@@ -0,0 +1,408 @@
+#include <string.h>
+#include <algorithm>
+
+#include "core/simd.h"
+
+#include "transform_hierarchy.h"
+
+namespace magnet {
+namespace scene {
+namespace {
+// nodes one pass of the kernel composes
+static const uint32_t kBatchSize = 4;
+// a zero quaternion gives the identity rather than a division by zero
+static const float kMinSquareLength = 1e-30f;
+
+#ifdef MAGNET_SSE2
+inline void Transpose(const float* a, const float* b, const float* c,
+  const float* d, __m128* x, __m128* y, __m128* z, __m128* w) {
+  __m128 row0 = _mm_loadu_ps(a);
+  __m128 row1 = _mm_loadu_ps(b);
+  __m128 row2 = _mm_loadu_ps(c);
+  __m128 row3 = _mm_loadu_ps(d);
+  _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+  *x = row0;
+  *y = row1;
+  *z = row2;
+  *w = row3;
+}
+
+// row of four matrices from its columns, each holding one per matrix
+inline void StoreRow(__m128 column0, __m128 column1, __m128 column2,
+  __m128 column3, int row, float* matrices) {
+  _MM_TRANSPOSE4_PS(column0, column1, column2, column3);
+  _mm_storeu_ps(matrices + row * 4, column0);
+  _mm_storeu_ps(matrices + 16 + row * 4, column1);
+  _mm_storeu_ps(matrices + 32 + row * 4, column2);
+  _mm_storeu_ps(matrices + 48 + row * 4, column3);
+}
+#endif  // MAGNET_SSE2
+
+// the local matrices of four nodes, sixteen floats each
+void ComposeLocals(const float* const* translations,
+  const float* const* rotations, const float* const* scales,
+  float* matrices) {
+#ifdef MAGNET_SSE2
+  __m128 tx, ty, tz, tw;
+  __m128 qx, qy, qz, qw;
+  __m128 sx, sy, sz, sw;
+  Transpose(translations[0], translations[1], translations[2],
+    translations[3], &tx, &ty, &tz, &tw);
+  Transpose(rotations[0], rotations[1], rotations[2], rotations[3],
+    &qx, &qy, &qz, &qw);
+  Transpose(scales[0], scales[1], scales[2], scales[3], &sx, &sy, &sz, &sw);
+
+  const __m128 kOne = _mm_set1_ps(1.f);
+  const __m128 kSquareLength = _mm_add_ps(
+    _mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+    _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw)));
+  const __m128 kTwoOverLength = _mm_div_ps(_mm_set1_ps(2.f),
+    _mm_max_ps(kSquareLength, _mm_set1_ps(kMinSquareLength)));
+  const __m128 kX = _mm_mul_ps(qx, kTwoOverLength);
+  const __m128 kY = _mm_mul_ps(qy, kTwoOverLength);
+  const __m128 kZ = _mm_mul_ps(qz, kTwoOverLength);
+  const __m128 kXx = _mm_mul_ps(qx, kX);
+  const __m128 kYy = _mm_mul_ps(qy, kY);
+  const __m128 kZz = _mm_mul_ps(qz, kZ);
+  const __m128 kXy = _mm_mul_ps(qx, kY);
+  const __m128 kXz = _mm_mul_ps(qx, kZ);
+  const __m128 kYz = _mm_mul_ps(qy, kZ);
+  const __m128 kXw = _mm_mul_ps(qw, kX);
+  const __m128 kYw = _mm_mul_ps(qw, kY);
+  const __m128 kZw = _mm_mul_ps(qw, kZ);
+
+  const __m128 kZero = _mm_setzero_ps();
+  StoreRow(_mm_mul_ps(_mm_sub_ps(kOne, _mm_add_ps(kYy, kZz)), sx),
+    _mm_mul_ps(_mm_sub_ps(kXy, kZw), sy),
+    _mm_mul_ps(_mm_add_ps(kXz, kYw), sz), tx, 0, matrices);
+  StoreRow(_mm_mul_ps(_mm_add_ps(kXy, kZw), sx),
+    _mm_mul_ps(_mm_sub_ps(kOne, _mm_add_ps(kXx, kZz)), sy),
+    _mm_mul_ps(_mm_sub_ps(kYz, kXw), sz), ty, 1, matrices);
+  StoreRow(_mm_mul_ps(_mm_sub_ps(kXz, kYw), sx),
+    _mm_mul_ps(_mm_add_ps(kYz, kXw), sy),
+    _mm_mul_ps(_mm_sub_ps(kOne, _mm_add_ps(kXx, kYy)), sz), tz, 2,
+    matrices);
+  StoreRow(kZero, kZero, kZero, kOne, 3, matrices);
+#else
+  for (uint32_t i = 0; i < kBatchSize; ++i) {
+    const float* t = translations[i];
+    const float* q = rotations[i];
+    const float* s = scales[i];
+    const float kTwoOverLength = 2.f / std::max(q[0] * q[0] + q[1] * q[1] +
+      q[2] * q[2] + q[3] * q[3], kMinSquareLength);
+    const float kX = q[0] * kTwoOverLength;
+    const float kY = q[1] * kTwoOverLength;
+    const float kZ = q[2] * kTwoOverLength;
+    const float kXx = q[0] * kX;
+    const float kYy = q[1] * kY;
+    const float kZz = q[2] * kZ;
+    const float kXy = q[0] * kY;
+    const float kXz = q[0] * kZ;
+    const float kYz = q[1] * kZ;
+    const float kXw = q[3] * kX;
+    const float kYw = q[3] * kY;
+    const float kZw = q[3] * kZ;
+
+    float* m = matrices + i * 16;
+    m[0] = (1.f - kYy - kZz) * s[0];
+    m[1] = (kXy - kZw) * s[1];
+    m[2] = (kXz + kYw) * s[2];
+    m[3] = t[0];
+    m[4] = (kXy + kZw) * s[0];
+    m[5] = (1.f - kXx - kZz) * s[1];
+    m[6] = (kYz - kXw) * s[2];
+    m[7] = t[1];
+    m[8] = (kXz - kYw) * s[0];
+    m[9] = (kYz + kXw) * s[1];
+    m[10] = (1.f - kXx - kYy) * s[2];
+    m[11] = t[2];
+    m[12] = 0.f;
+    m[13] = 0.f;
+    m[14] = 0.f;
+    m[15] = 1.f;
+  }
+#endif  // MAGNET_SSE2
+}
+
+// result = a * b, result is neither of them
+void Multiply(const float* a, const float* b, float* result) {
+#ifdef MAGNET_SSE2
+  const __m128 kRow0 = _mm_loadu_ps(b);
+  const __m128 kRow1 = _mm_loadu_ps(b + 4);
+  const __m128 kRow2 = _mm_loadu_ps(b + 8);
+  const __m128 kRow3 = _mm_loadu_ps(b + 12);
+  for (int row = 0; row < 4; ++row) {
+    const float* a_row = a + row * 4;
+    const __m128 kSum = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a_row[0]), kRow0),
+      _mm_mul_ps(_mm_set1_ps(a_row[1]), kRow1)),
+      _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a_row[2]), kRow2),
+      _mm_mul_ps(_mm_set1_ps(a_row[3]), kRow3)));
+    _mm_storeu_ps(result + row * 4, kSum);
+  }
+#else
+  for (int row = 0; row < 4; ++row) {
+    for (int column = 0; column < 4; ++column) {
+      result[row * 4 + column] = a[row * 4] * b[column] +
+        a[row * 4 + 1] * b[4 + column] + a[row * 4 + 2] * b[8 + column] +
+        a[row * 4 + 3] * b[12 + column];
+    }
+  }
+#endif  // MAGNET_SSE2
+}
+}  // namespace
+
+TransformHierarchy::TransformHierarchy() : free_nodes_count_(0) {
+}
+
+TransformNode TransformHierarchy::AddNode(TransformNode parent,
+  const math::Transformationf& local) {
+  const TransformNode kNode = static_cast<TransformNode>(parents_.size());
+  if (parent != kInvalidTransformNode &&
+    (parent >= kNode || parent + subtree_sizes_[parent] != kNode)) {
+    return kInvalidTransformNode;
+  }
+
+  for (TransformNode ancestor = parent; ancestor != kInvalidTransformNode;
+    ancestor = parents_[ancestor]) {
+    ++subtree_sizes_[ancestor];
+  }
+  locals_.push_back(LocalTrs());
+  parents_.push_back(parent);
+  subtree_sizes_.push_back(1);
+  worlds_.push_back(math::Matrix4f());
+  dirty_.push_back(0);
+  WriteLocal(kNode, local);
+  MarkDirty(kNode);
+  return kNode;
+}
+
+TransformNode TransformHierarchy::AddSubtree(const TransformNode* parents,
+  const math::Transformationf* locals, uint32_t count) {
+  if (count == 0 || parents[0] != kInvalidTransformNode)
+    return kInvalidTransformNode;
+  std::vector<uint32_t> sizes(count, 1);
+  for (uint32_t i = 1; i < count; ++i) {
+    const TransformNode kParent = parents[i];
+    if (kParent >= i || kParent + sizes[kParent] != i)
+      return kInvalidTransformNode;
+    for (TransformNode ancestor = kParent; ancestor != kInvalidTransformNode;
+      ancestor = parents[ancestor]) {
+      ++sizes[ancestor];
+    }
+  }
+
+  // the smallest free range that fits, what is left of it stays free
+  TransformNode root;
+  auto range = free_ranges_.lower_bound(std::make_pair(count, 0u));
+  if (range != free_ranges_.end()) {
+    const uint32_t kRangeSize = range->first;
+    root = range->second;
+    EraseFreeRange(root, kRangeSize);
+    if (kRangeSize > count)
+      InsertFreeRange(root + count, kRangeSize - count);
+  }
+  else {
+    root = static_cast<TransformNode>(parents_.size());
+    locals_.resize(root + count);
+    parents_.resize(root + count);
+    subtree_sizes_.resize(root + count);
+    worlds_.resize(root + count);
+    dirty_.resize(root + count, 0);
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    parents_[root + i] = i == 0 ? kInvalidTransformNode : root + parents[i];
+    subtree_sizes_[root + i] = sizes[i];
+    WriteLocal(root + i, locals[i]);
+  }
+  // the root being dirty recomputes all of them
+  MarkDirty(root);
+  return root;
+}
+
+bool TransformHierarchy::RemoveSubtree(TransformNode root) {
+  if (root >= parents_.size() || parents_[root] != kInvalidTransformNode ||
+    subtree_sizes_[root] == 0) {
+    return false;
+  }
+
+  // dirty nodes still listed are skipped by the update
+  const uint32_t kSize = subtree_sizes_[root];
+  for (TransformNode node = root; node < root + kSize; ++node) {
+    parents_[node] = kInvalidTransformNode;
+    subtree_sizes_[node] = 0;
+    dirty_[node] = 0;
+  }
+  FreeRange(root, kSize);
+  return true;
+}
+
+void TransformHierarchy::FreeRange(TransformNode first, uint32_t size) {
+  auto next = free_range_sizes_.find(first + size);
+  if (next != free_range_sizes_.end()) {
+    const uint32_t kNextSize = next->second;
+    EraseFreeRange(first + size, kNextSize);
+    size += kNextSize;
+  }
+  auto previous = free_range_sizes_.lower_bound(first);
+  if (previous != free_range_sizes_.begin()) {
+    --previous;
+    if (previous->first + previous->second == first) {
+      const TransformNode kPreviousFirst = previous->first;
+      const uint32_t kPreviousSize = previous->second;
+      EraseFreeRange(kPreviousFirst, kPreviousSize);
+      first = kPreviousFirst;
+      size += kPreviousSize;
+    }
+  }
+
+  if (first + size < parents_.size()) {
+    InsertFreeRange(first, size);
+  }
+  else {
+    locals_.resize(first);
+    parents_.resize(first);
+    subtree_sizes_.resize(first);
+    worlds_.resize(first);
+    dirty_.resize(first);
+  }
+}
+
+void TransformHierarchy::InsertFreeRange(TransformNode first, uint32_t size) {
+  free_ranges_.insert(std::make_pair(size, first));
+  free_range_sizes_[first] = size;
+  free_nodes_count_ += size;
+}
+
+void TransformHierarchy::EraseFreeRange(TransformNode first, uint32_t size) {
+  free_ranges_.erase(std::make_pair(size, first));
+  free_range_sizes_.erase(first);
+  free_nodes_count_ -= size;
+}
+
+void TransformHierarchy::SetLocal(TransformNode node,
+  const math::Transformationf& local) {
+  WriteLocal(node, local);
+  MarkDirty(node);
+}
+
+void TransformHierarchy::WriteLocal(TransformNode node,
+  const math::Transformationf& local) {
+  const math::Vector3f& kTranslation = local.GetTranslation();
+  const math::Quaternionf& kRotation = local.GetRotation();
+  const math::Vector3f& kScale = local.GetScale();
+  LocalTrs& trs = locals_[node];
+  trs.translation[0] = kTranslation.x_;
+  trs.translation[1] = kTranslation.y_;
+  trs.translation[2] = kTranslation.z_;
+  trs.translation[3] = 0.f;
+  trs.rotation[0] = kRotation.x_;
+  trs.rotation[1] = kRotation.y_;
+  trs.rotation[2] = kRotation.z_;
+  trs.rotation[3] = kRotation.w_;
+  trs.scale[0] = kScale.x_;
+  trs.scale[1] = kScale.y_;
+  trs.scale[2] = kScale.z_;
+  trs.scale[3] = 0.f;
+}
+
+void TransformHierarchy::MarkDirty(TransformNode node) {
+  if (!dirty_[node]) {
+    dirty_[node] = 1;
+    dirty_nodes_.push_back(node);
+  }
+}
+
+TransformNode TransformHierarchy::GetParent(TransformNode node) const {
+  return parents_[node];
+}
+
+uint32_t TransformHierarchy::GetSubtreeSize(TransformNode node) const {
+  return subtree_sizes_[node];
+}
+
+const math::Matrix4f& TransformHierarchy::GetWorld(TransformNode node) const {
+  return worlds_[node];
+}
+
+uint32_t TransformHierarchy::GetNodesCount() const {
+  return static_cast<uint32_t>(parents_.size());
+}
+
+uint32_t TransformHierarchy::GetFreeNodesCount() const {
+  return free_nodes_count_;
+}
+
+void TransformHierarchy::Clear() {
+  locals_.clear();
+  parents_.clear();
+  subtree_sizes_.clear();
+  worlds_.clear();
+  dirty_.clear();
+  dirty_nodes_.clear();
+  changed_nodes_.clear();
+  free_ranges_.clear();
+  free_range_sizes_.clear();
+  free_nodes_count_ = 0;
+}
+
+void TransformHierarchy::Update() {
+  changed_nodes_.clear();
+  if (dirty_nodes_.empty())
+    return;
+
+  // a dirty node inside a subtree found dirty before is recomputed with it.
+  // a node listed twice or removed since is no longer dirty, or cut off
+  // the arrays.
+  std::sort(dirty_nodes_.begin(), dirty_nodes_.end());
+  TransformNode covered_end = 0;
+  for (TransformNode node : dirty_nodes_) {
+    if (node >= dirty_.size() || !dirty_[node])
+      continue;
+    dirty_[node] = 0;
+    if (node < covered_end)
+      continue;
+    covered_end = node + subtree_sizes_[node];
+    for (TransformNode i = node; i < covered_end; ++i)
+      changed_nodes_.push_back(i);
+  }
+  dirty_nodes_.clear();
+
+  // parents come before their children, every batch composes its local
+  // matrices first and then walks them in order. the last batch repeats
+  // its last node.
+  const uint32_t kChangedCount = static_cast<uint32_t>(changed_nodes_.size());
+  float locals[kBatchSize * 16];
+  for (uint32_t begin = 0; begin < kChangedCount; begin += kBatchSize) {
+    const uint32_t kCount = std::min(kBatchSize, kChangedCount - begin);
+    const float* translations[kBatchSize];
+    const float* rotations[kBatchSize];
+    const float* scales[kBatchSize];
+    for (uint32_t i = 0; i < kBatchSize; ++i) {
+      const LocalTrs& kTrs =
+        locals_[changed_nodes_[begin + std::min(i, kCount - 1)]];
+      translations[i] = kTrs.translation;
+      rotations[i] = kTrs.rotation;
+      scales[i] = kTrs.scale;
+    }
+    ComposeLocals(translations, rotations, scales, locals);
+
+    for (uint32_t i = 0; i < kCount; ++i) {
+      const TransformNode kNode = changed_nodes_[begin + i];
+      const TransformNode kParent = parents_[kNode];
+      if (kParent == kInvalidTransformNode) {
+        memcpy(worlds_[kNode].m1_, locals + i * 16, sizeof(float) * 16);
+      }
+      else {
+        Multiply(worlds_[kParent].m1_, locals + i * 16, worlds_[kNode].m1_);
+      }
+    }
+  }
+}
+
+const std::vector<TransformNode>& TransformHierarchy::GetChangedNodes() const {
+  return changed_nodes_;
+}
+}  // namespace scene
+}  // namespace magnet
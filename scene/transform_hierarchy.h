@@ -0,0 +1,95 @@
+#ifndef MAGNET_SCENE_TRANSFORM_HIERARCHY_H_
+#define MAGNET_SCENE_TRANSFORM_HIERARCHY_H_
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "math/matrix4.h"
+#include "math/transformation.h"
+
+namespace magnet {
+namespace scene {
+typedef uint32_t TransformNode;
+static const TransformNode kInvalidTransformNode = 0xffffffff;
+
+// the transforms of a scene in flat arrays, a node knows the index of its
+// parent and how many nodes its subtree has. nodes are added depth first,
+// so a subtree is the node and the ones right after it.
+//
+//   TransformNode root = hierarchy.AddNode(kInvalidTransformNode, local);
+//   TransformNode child = hierarchy.AddNode(root, child_local);
+//   hierarchy.SetLocal(root, moved);
+//   hierarchy.Update();       // recomputes root and child
+//   hierarchy.GetWorld(child);
+//
+// setting a local transform marks the node dirty, an update recomputes the
+// world matrices of the dirty subtrees and no others, four nodes at a time.
+// a removed subtree leaves its range to the next subtrees that fit in it,
+// merged with the free ranges next to it. free nodes at the end of the
+// arrays are cut off them.
+class TransformHierarchy {
+ public:
+  TransformHierarchy();
+
+  // the parent is the last node added or one of its ancestors, otherwise
+  // the node is not added and kInvalidTransformNode returned
+  TransformNode AddNode(TransformNode parent,
+    const math::Transformationf& local);
+  // count nodes in depth first order, parents[i] the index of the parent
+  // within them and kInvalidTransformNode for the first one, the root of
+  // the subtree. placed in the range of removed subtrees if one is large
+  // enough, after everything else otherwise. kInvalidTransformNode if the
+  // nodes are not depth first.
+  TransformNode AddSubtree(const TransformNode* parents,
+    const math::Transformationf* locals, uint32_t count);
+  // a node without a parent and its subtree, false for any other node
+  bool RemoveSubtree(TransformNode root);
+  void SetLocal(TransformNode node, const math::Transformationf& local);
+  TransformNode GetParent(TransformNode node) const;
+  // the node and its descendants, 0 for a removed node
+  uint32_t GetSubtreeSize(TransformNode node) const;
+  const math::Matrix4f& GetWorld(TransformNode node) const;
+  // removed nodes included
+  uint32_t GetNodesCount() const;
+  uint32_t GetFreeNodesCount() const;
+  void Clear();
+
+  // world = parent world * translation * rotation * scale for the dirty
+  // nodes and everything below them
+  void Update();
+  // the nodes the last update recomputed, parents before children
+  const std::vector<TransformNode>& GetChangedNodes() const;
+
+ private:
+  // padded to four floats, a node is loaded a vector at a time
+  struct LocalTrs {
+    float translation[4];
+    float rotation[4];                // x, y, z, w
+    float scale[4];
+  };
+
+  void WriteLocal(TransformNode node, const math::Transformationf& local);
+  void MarkDirty(TransformNode node);
+  // merges the nodes with the free ranges around them, or cuts them off the
+  // arrays if the merged range reaches the end
+  void FreeRange(TransformNode first, uint32_t size);
+  void InsertFreeRange(TransformNode first, uint32_t size);
+  void EraseFreeRange(TransformNode first, uint32_t size);
+
+  std::vector<LocalTrs> locals_;
+  std::vector<TransformNode> parents_;
+  std::vector<uint32_t> subtree_sizes_; // the node and its descendants
+  std::vector<math::Matrix4f> worlds_;
+  std::vector<uint8_t> dirty_;
+  std::vector<TransformNode> dirty_nodes_;
+  std::vector<TransformNode> changed_nodes_;
+  std::set<std::pair<uint32_t, TransformNode>> free_ranges_;  // size, first
+  std::map<TransformNode, uint32_t> free_range_sizes_;     // by first node
+  uint32_t free_nodes_count_;
+};
+}  // namespace scene
+}  // namespace magnet
+#endif  // MAGNET_SCENE_TRANSFORM_HIERARCHY_H_